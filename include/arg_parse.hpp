@@ -0,0 +1,53 @@
+#ifndef ARG_PARSE_HPP
+#define ARG_PARSE_HPP
+
+
+#include <string>
+#include <cctype>
+#include <cmath>
+
+
+// Converses checadas das opes numricas da linha de comando. Um valor
+// malformado, com sobra no fim ou fora da faixa devolve false, e quem chama
+// trata como erro de uso: nada de exceo escapando nem de "-1" que d a
+// volta e vira um nmero enorme.
+
+// Inteiro sem sinal em [min, max]
+template <typename T>
+bool parse_count(const std::string& s, unsigned long min, unsigned long max, T& out) {
+    if (s.empty() || !std::isdigit(static_cast<unsigned char>(s[0]))) return false;
+    try {
+        size_t used = 0;
+        unsigned long v = std::stoul(s, &used);
+        if (used != s.size() || v < min || v > max) return false;
+        out = static_cast<T>(v);
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
+// Nmero real finito em [min, max]
+inline bool parse_real(const std::string& s, double min, double max, double& out) {
+    try {
+        size_t used = 0;
+        double v = std::stod(s, &used);
+        if (used != s.size() || !std::isfinite(v) || v < min || v > max) return false;
+        out = v;
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
+// Durao com frao em [0, max], convertida em milsimos (segundos em ms,
+// milissegundos em us)
+inline bool parse_millis(const std::string& s, double max, unsigned& out) {
+    double v;
+    if (!parse_real(s, 0, max, v)) return false;
+    out = static_cast<unsigned>(v * 1000);
+    return true;
+}
+
+
+#endif
@@ -5,24 +5,112 @@
 #include <string>
 #include <vector>
 #include <mutex>
+#include <memory>
+#include <unordered_map>
 
+#include "message_history.hpp"
 
-struct ClientInfo {
-int sock;
-std::string username;
-};
 
+// Definido pelo servidor; a sala s guarda e compara ponteiros
+struct ClientInfo;
+
+using RoomMember = std::shared_ptr<ClientInfo>;
 
+
+// Sala de chat: membros separados pelo shard dono de cada conexo, para que
+// o broadcast mande a cada shard s a sua lista e custe O(membros da sala).
+// join/leave alteram a lista de trabalho do shard em O(1) sob o mutex da
+// prpria sala; o broadcast recebe retratos imutveis, refeitos s para os
+// shards que mudaram desde o ltimo retrato. Entrar N usurios custa O(N),
+// no uma cpia da lista por entrada, e o broadcast seguinte paga uma cpia
+// por shard alterado. Salas diferentes nunca disputam o mesmo lock.
 class ChatRoom {
 public:
-void join(const ClientInfo& client);
-void leave(int sock);
-void broadcast(const std::string& msg, int from_sock);
+using MemberList = std::vector<RoomMember>;
+using Snapshot = std::vector<std::shared_ptr<const MemberList>>;
+
+ChatRoom(std::string name, unsigned shards, size_t history_capacity);
+
+ChatRoom(const ChatRoom&) = delete;
+ChatRoom& operator=(const ChatRoom&) = delete;
+
+const std::string& name() const { return name_; }
+
+// Retorna false se o membro j estava na sala
+bool join(const RoomMember& member, unsigned shard);
+// Retorna false se o membro no estava na sala
+bool leave(const ClientInfo* member, unsigned shard);
+
+size_t size() const;
+
+// Lista de membros de cada shard (nullptr = nenhum)
+Snapshot snapshot() const;
+// O mesmo em out, reaproveitando a capacidade (broadcast sem alocar)
+void snapshot(Snapshot& out) const;
+
+MessageHistory& history() { return history_; }
+
+private:
+struct ShardMembers {
+    MemberList members;                                  // ordem qualquer
+    std::unordered_map<const ClientInfo*, size_t> pos;   // ndice em members
+    bool dirty = false;                                  // retrato desatualizado
+};
+
+// Refaz os retratos dos shards alterados; chamado com mtx_ pego
+void publish() const;
+
+mutable std::mutex mtx_;
+std::string name_;
+mutable std::vector<ShardMembers> by_shard_;
+mutable Snapshot published_;  // ltimo retrato de cada shard
+size_t size_ = 0;
+MessageHistory history_;
+};
+
+
+// Tabela de salas por nome, com locks em faixas (stripes) para que criar ou
+// remover salas no serialize o servidor inteiro. A sala padro nunca 
+// removida; as outras somem quando o ltimo membro sai.
+class RoomRegistry {
+public:
+static constexpr size_t STRIPES = 64;
+
+RoomRegistry(std::string default_room, unsigned shards, size_t default_history,
+             size_t room_history);
+
+const std::shared_ptr<ChatRoom>& default_room() const { return default_; }
+
+// Entra na sala (criando-a se preciso). Retorna a sala.
+std::shared_ptr<ChatRoom> join(const std::string& name, const RoomMember& member, unsigned shard);
+
+// Sala existente com esse nome (nullptr se no houver), sem criar
+std::shared_ptr<ChatRoom> find(const std::string& name) const;
 
+// Sai da sala e a remove se ficou vazia
+void leave(const std::shared_ptr<ChatRoom>& room, const ClientInfo* member, unsigned shard);
+
+// Nome e tamanho de cada sala, em ordem decrescente de tamanho
+std::vector<std::pair<std::string, size_t>> list() const;
+
+size_t count() const;
+
+// Nomes aceitos: 1 a 32 caracteres entre letras, dgitos, '-' e '_'
+static bool valid_name(const std::string& name);
 
 private:
-std::mutex mtx_;
-std::vector<ClientInfo> clients_;
+struct Stripe {
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, std::shared_ptr<ChatRoom>> rooms;
 };
 
+Stripe& stripe_of(const std::string& name) const;
+
+unsigned shards_;
+size_t room_history_;
+std::shared_ptr<ChatRoom> default_;
+std::unique_ptr<Stripe[]> stripes_;
+};
+
+
 #endif
@@ -0,0 +1,129 @@
+#ifndef CREDENTIALS_HPP
+#define CREDENTIALS_HPP
+
+
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <mutex>
+#include <memory>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+
+// Primitivas usadas pelo armazenamento de senhas (implementao local, sem
+// dependncias externas)
+namespace crypto {
+
+using Digest = std::array<uint8_t, 32>;
+
+Digest sha256(const void* data, size_t len);
+Digest hmac_sha256(const void* key, size_t key_len, const void* data, size_t len);
+
+// PBKDF2-HMAC-SHA256 (RFC 8018); out_len bytes em out
+void pbkdf2_sha256(std::string_view password, const uint8_t* salt, size_t salt_len,
+                   unsigned iterations, uint8_t* out, size_t out_len);
+
+// Comparao em tempo que no depende de onde os dados diferem
+bool equal_ct(const uint8_t* a, const uint8_t* b, size_t len);
+
+// Bytes aleatrios do kernel
+bool random_bytes(uint8_t* out, size_t len);
+
+std::string to_hex(const uint8_t* data, size_t len);
+bool from_hex(std::string_view hex, uint8_t* out, size_t len);
+
+}
+
+
+// Senhas guardadas como PBKDF2 com sal por usurio, no formato
+//   pbkdf2-sha256$<iteraes>$<sal em hex>$<hash em hex>
+// A verificao  deliberadamente lenta; o servidor a roda fora das threads
+// de I/O. Depois de carregado o contedo s  lido, sem lock.
+class CredentialStore {
+public:
+static constexpr unsigned DEFAULT_ITERATIONS = 100000;
+static constexpr size_t SALT_BYTES = 16;
+static constexpr size_t HASH_BYTES = 32;
+
+CredentialStore();
+
+// Gera a forma guardada de uma senha, com sal aleatrio
+static std::string hash_password(std::string_view password,
+                                 unsigned iterations = DEFAULT_ITERATIONS);
+
+// Acrescenta ou substitui um usurio; false se encoded for invlido
+bool add(const std::string& user, std::string_view encoded);
+bool add_password(const std::string& user, std::string_view password,
+                  unsigned iterations = DEFAULT_ITERATIONS);
+
+// Linhas "usuario:pbkdf2-sha256$..." ou, por compatibilidade, "usuario:senha"
+// (convertida na carga com legacy_iterations). Retorna false se o arquivo
+// no abrir ou tiver linha invlida; error descreve o problema e loaded
+// conta os usurios lidos.
+bool load(const std::string& path, unsigned legacy_iterations, size_t& loaded, size_t& legacy,
+          std::string& error);
+
+// Lento: custa as iteraes do usurio. Usurios inexistentes custam o
+// mesmo que um usurio padro, para no revelar quem existe.
+bool verify(const std::string& user, std::string_view password) const;
+
+bool contains(const std::string& user) const { return users_.count(user) != 0; }
+size_t size() const { return users_.size(); }
+
+private:
+struct Entry {
+    unsigned iterations = 0;
+    std::array<uint8_t, SALT_BYTES> salt{};
+    std::array<uint8_t, HASH_BYTES> hash{};
+};
+
+static bool parse(std::string_view encoded, Entry& e);
+static bool check(const Entry& e, std::string_view password);
+
+std::unordered_map<std::string, Entry> users_;
+Entry dummy_;
+};
+
+
+// Logins verificados recentemente: quem reconecta com a mesma senha dentro
+// do prazo  aceito sem repetir o PBKDF2. Guarda s um HMAC de
+// usurio+senha com chave aleatria do processo, nunca a senha.
+class AuthCache {
+public:
+// ttl_ms = 0 desliga o cache
+AuthCache(uint64_t ttl_ms, size_t max_entries);
+
+bool enabled() const { return ttl_ns_ > 0; }
+
+bool check(const std::string& user, std::string_view password);
+void remember(const std::string& user, std::string_view password);
+void forget(const std::string& user);
+
+size_t size() const;
+
+private:
+static constexpr size_t STRIPES = 16;
+
+struct Slot {
+    crypto::Digest tag;
+    uint64_t expires_ns;
+};
+
+struct alignas(64) Stripe {
+    mutable std::mutex mtx;
+    std::unordered_map<std::string, Slot> slots;
+};
+
+crypto::Digest tag_of(const std::string& user, std::string_view password) const;
+Stripe& stripe_of(const std::string& user);
+
+uint64_t ttl_ns_;
+size_t max_per_stripe_;
+uint8_t key_[32];
+std::unique_ptr<Stripe[]> stripes_;
+};
+
+
+#endif
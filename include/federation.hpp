@@ -0,0 +1,166 @@
+#ifndef FEDERATION_HPP
+#define FEDERATION_HPP
+
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <cstdint>
+#include <initializer_list>
+#include <string_view>
+#include <thread>
+
+#include "message.hpp"
+#include "reactor.hpp"
+
+
+// Outro n da federao: HOST:PORTA ou s PORTA (127.0.0.1)
+struct PeerAddress {
+    std::string host = "127.0.0.1";
+    int port = 0;
+};
+
+bool parse_peer_address(const std::string& s, PeerAddress& out);
+std::string peer_address_to_string(const PeerAddress& a);
+
+
+struct FederationOptions {
+    std::string node;               // nome deste n, nico na federao
+    int port = 0;                   // links de entrada; 0 = porta livre qualquer
+    unsigned heartbeat_ms = 500;    // PING num link de sada parado
+    unsigned timeout_ms = 3000;     // link de entrada sem nada recebido: n perdido
+    unsigned retry_ms = 1000;       // espera antes de reconectar um link de sada
+    size_t max_buffer = 64 << 20;   // sada acumulada para um n lento antes de derrubar o link
+};
+
+
+// Liga vrios chat_server numa s conversa. Cada n abre um link de sada
+// para cada outro n (add_peer) e recebe os deles numa porta prpria; por
+// um link s viajam frames do n que o abriu, ento a ordem das mensagens
+// de um n  a mesma em todos os outros.
+//
+// Frames: [u32 tamanho][u8 tipo][campos], strings como [u32 tamanho][bytes].
+// Ao conectar, o link comea com HELLO (nome do n e todos os usurios
+// locais com sua sala) e o outro lado responde WELCOME com o prprio nome;
+// depois vm JOIN/LEAVE (presena), ROOM (mensagem de sala, s para ns com
+// membros nela), DELIVER (mensagem para um usurio do n de destino) e PING.
+// Os frames enfileirados numa volta do lao saem num nico send() por link.
+//
+// Um n  perdido quando o link de entrada dele fecha ou fica timeout_ms sem
+// receber nada; seus usurios saem de uma vez (node_lost). Links de sada
+// que caem so refeitos a cada retry_ms e o HELLO ressincroniza a presena.
+//
+// Tudo roda numa thread prpria, iniciada por start(); os mtodos pblicos
+// podem ser chamados de qualquer thread e os handlers so chamados na thread
+// da federao. O construtor lana std::runtime_error se a porta no abrir.
+class Federation {
+public:
+using UserList = std::vector<std::pair<std::string, std::string>>;  // usurio, sala
+
+struct Handlers {
+    // Usurio de outro n entrou ou trocou de sala; room vazio: saiu
+    std::function<void(const std::string& node, const std::string& user, const std::string& room)> presence;
+    // Mensagem de sala originada em outro n
+    std::function<void(const std::string& room, MessageRef msg)> room_message;
+    // Mensagem de outro n para o usurio local to (from vazio: aviso do sistema)
+    std::function<void(const std::string& node, const std::string& to, const std::string& from,
+                       MessageRef msg)> deliver;
+    // N perdido: todos os seus usurios saram
+    std::function<void(const std::string& node, const UserList& users)> node_lost;
+    // Links abertos, fechados ou recusados, para o log de quem usa
+    std::function<void(const std::string& text)> event;
+};
+
+struct Stats {
+    std::atomic<uint64_t> frames_out{0};
+    std::atomic<uint64_t> frames_in{0};
+    std::atomic<uint64_t> batches_out{0};  // send() com pelo menos um frame
+    std::atomic<uint64_t> bytes_out{0};
+    std::atomic<uint64_t> bytes_in{0};
+    std::atomic<uint64_t> links_lost{0};
+    std::atomic<size_t> peers{0};          // links de sada com WELCOME recebido
+    std::atomic<size_t> nodes{0};          // ns com link de entrada ativo
+    std::atomic<size_t> remote_users{0};
+};
+
+Federation(FederationOptions opts, Handlers handlers);
+~Federation();
+
+Federation(const Federation&) = delete;
+Federation& operator=(const Federation&) = delete;
+
+const std::string& node() const { return opts_.node; }
+int port() const { return port_; }
+const Stats& stats() const { return stats_; }
+
+// Comea a aceitar e abrir links (os handlers j podem ser chamados)
+void start();
+
+void add_peer(const PeerAddress& addr);
+
+// Presena dos usurios deste n (trocar de sala  um novo user_joined)
+void user_joined(const std::string& user, const std::string& room);
+void user_left(const std::string& user);
+
+// Mensagem de sala para os ns que tm membros nela
+void room_message(const std::string& room, MessageRef msg);
+
+// Mensagem para um usurio do n node; se ele no estiver l, o n de
+// destino devolve um aviso para from
+void deliver(const std::string& node, const std::string& to, const std::string& from, MessageRef msg);
+
+// N que tem o usurio online, ou vazio. S na thread da federao
+// (dentro dos handlers).
+std::string owner(const std::string& user) const;
+
+private:
+struct Link;
+
+struct RemoteNode {
+    Link* inbound = nullptr;
+    std::unordered_map<std::string, std::string> users;  // usurio -> sala
+    std::unordered_map<std::string, size_t> rooms;       // sala -> membros
+};
+
+void run_on_loop(EventLoop::Task t);
+
+void accept_links();
+void connect_link(Link& l);
+void on_event(Link& l, uint32_t events);
+void on_frame(Link& l, uint8_t type, const char* p, size_t n);
+void on_hello(Link& l, const char* p, size_t n);
+void drop_link(Link& l, const char* why);
+
+void queue(Link& l, uint8_t type, const std::string_view* fields, size_t count);
+void queue(Link& l, uint8_t type, std::initializer_list<std::string_view> fields);
+bool flush(Link& l);
+void flush_dirty();
+void tick();
+
+void set_user(RemoteNode& rn, const std::string& node, const std::string& user, const std::string& room);
+void report(const std::string& text);
+Link* outbound_to(const std::string& node);
+
+FederationOptions opts_;
+Handlers handlers_;
+Stats stats_;
+int listen_fd_ = -1;
+int port_ = 0;
+
+EventLoop loop_;
+std::thread thr_;
+
+// S na thread da federao
+std::vector<std::unique_ptr<Link>> outbound_;
+std::unordered_map<int, std::unique_ptr<Link>> inbound_;   // por fd
+std::unordered_map<std::string, RemoteNode> nodes_;
+std::unordered_map<std::string, std::string> local_;      // usurio local -> sala
+std::vector<Link*> dirty_;
+std::vector<std::unique_ptr<Link>> closed_;  // liberados depois da volta do lao
+};
+
+
+#endif
@@ -0,0 +1,107 @@
+#ifndef HANDOFF_HPP
+#define HANDOFF_HPP
+
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+
+#include <sys/types.h>
+
+
+// Atualizao a quente: o processo em execuo inicia o binrio novo e
+// passa para ele descritores (listeners e conexes) e um bloco de estado
+// serializado por um socket Unix, com os fds em mensagens SCM_RIGHTS. O
+// servidor decide o que vai no bloco; aqui ficam o transporte, a
+// codificao dos campos e o exec do sucessor.
+namespace handoff {
+
+// Varivel de ambiente com o nmero do fd do socket herdado pelo sucessor
+constexpr const char* ENV_FD = "CHAT_HANDOFF_FD";
+
+// Campos gravados em sequncia: inteiros de tamanho fixo na ordem de bytes
+// da mquina (os dois processos rodam nela) e strings com um u32 de
+// tamanho na frente
+class Writer {
+public:
+void u8(uint8_t v) { put(&v, sizeof(v)); }
+void u32(uint32_t v) { put(&v, sizeof(v)); }
+void u64(uint64_t v) { put(&v, sizeof(v)); }
+void str(std::string_view s) {
+    u32(static_cast<uint32_t>(s.size()));
+    buf_.append(s.data(), s.size());
+}
+
+const std::string& data() const { return buf_; }
+
+private:
+void put(const void* p, size_t n) { buf_.append(static_cast<const char*>(p), n); }
+
+std::string buf_;
+};
+
+// L os campos na mesma ordem. Um campo que passa do fim do bloco falha, e
+// dali em diante todas as leituras falham (ok() fica false).
+class Reader {
+public:
+explicit Reader(std::string_view data) : data_(data) {}
+
+bool u8(uint8_t& v) { return get(&v, sizeof(v)); }
+bool u32(uint32_t& v) { return get(&v, sizeof(v)); }
+bool u64(uint64_t& v) { return get(&v, sizeof(v)); }
+bool str(std::string& s) {
+    uint32_t n;
+    if (!u32(n) || data_.size() - pos_ < n) return ok_ = false;
+    s.assign(data_.data() + pos_, n);
+    pos_ += n;
+    return true;
+}
+
+bool ok() const { return ok_; }
+// Tudo lido, sem sobra
+bool done() const { return ok_ && pos_ == data_.size(); }
+
+private:
+bool get(void* p, size_t n) {
+    if (!ok_ || data_.size() - pos_ < n) return ok_ = false;
+    std::memcpy(p, data_.data() + pos_, n);
+    pos_ += n;
+    return true;
+}
+
+std::string_view data_;
+size_t pos_ = 0;
+bool ok_ = true;
+};
+
+// Inicia path com argv e o ambiente atual mais ENV_FD. Retorna o pid do
+// sucessor (-1 se o fork falhar) e, em sock, a ponta do socket que fica
+// com quem chamou. Um exec que falha termina o filho com 127, e quem
+// chamou v o socket fechado.
+pid_t spawn(const std::string& path, char* const argv[], int& sock);
+
+// Socket herdado do processo anterior, ou -1 se este processo no veio de
+// um spawn. Retira ENV_FD do ambiente para que no passe adiante.
+int inherited();
+
+// Envia o bloco e os descritores; os fds continuam abertos deste lado
+bool send(int sock, const std::string& blob, const std::vector<int>& fds);
+// Recebe o que send mandou, esperando no mximo timeout_ms ao todo. Os fds
+// chegam com FD_CLOEXEC; em caso de erro os j recebidos so fechados.
+bool receive(int sock, std::string& blob, std::vector<int>& fds, unsigned timeout_ms);
+
+// Passos do protocolo, um byte do sucessor para o processo antigo cada:
+// READY quando terminou a parte da inicializao que no depende do estado
+// (o antigo segue atendendo at l) e ACK depois de assumir as conexes
+// (at l o antigo no pode fechar nada)
+enum Step : char { READY = 'R', ACK = 'K' };
+
+bool notify(int sock, Step step);
+bool wait_step(int sock, Step step, unsigned timeout_ms);
+
+} // namespace handoff
+
+
+#endif
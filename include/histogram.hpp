@@ -0,0 +1,72 @@
+#ifndef HISTOGRAM_HPP
+#define HISTOGRAM_HPP
+
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+
+// Histograma log-linear no estilo HDR: cada potncia de 2  dividida em
+// SUB_BUCKETS faixas iguais, o que d erro relativo de no mximo 1/32
+// (~3%) em qualquer escala, de 1 ns a horas, com tamanho fixo.
+// record()  um fetch_add relaxed: vrios escritores podem registrar ao
+// mesmo tempo e leitores podem consultar sem parar ningum.
+class Histogram {
+public:
+static constexpr unsigned SUB_BITS = 5;
+static constexpr uint64_t SUB_BUCKETS = uint64_t(1) << SUB_BITS;
+static constexpr size_t BUCKETS = (64 - SUB_BITS + 1) * SUB_BUCKETS;
+
+Histogram() = default;
+Histogram(const Histogram&) = delete;
+Histogram& operator=(const Histogram&) = delete;
+
+void record(uint64_t v) {
+    counts_[index_of(v)].fetch_add(1, std::memory_order_relaxed);
+    count_.fetch_add(1, std::memory_order_relaxed);
+    sum_.fetch_add(v, std::memory_order_relaxed);
+    uint64_t m = max_.load(std::memory_order_relaxed);
+    while (v > m && !max_.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+}
+
+// Soma os valores de other neste histograma
+void merge(const Histogram& other);
+void reset();
+
+uint64_t count() const { return count_.load(std::memory_order_relaxed); }
+uint64_t max() const { return max_.load(std::memory_order_relaxed); }
+uint64_t sum() const { return sum_.load(std::memory_order_relaxed); }
+double mean() const;
+
+// Valor abaixo do qual est a frao q (0..1) das amostras; devolve o
+// limite superior da faixa, ento nunca subestima
+uint64_t percentile(double q) const;
+
+// Percorre as faixas no vazias: f(limite_superior, contagem)
+template <typename F>
+void for_each_bucket(F&& f) const {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        uint64_t c = counts_[i].load(std::memory_order_relaxed);
+        if (c) f(upper_bound(i), c);
+    }
+}
+
+static size_t index_of(uint64_t v) {
+    if (v < SUB_BUCKETS) return static_cast<size_t>(v);
+    unsigned mag = 63 - static_cast<unsigned>(__builtin_clzll(v));
+    unsigned shift = mag - SUB_BITS;
+    return static_cast<size_t>((shift + 1) * SUB_BUCKETS + ((v >> shift) & (SUB_BUCKETS - 1)));
+}
+
+static uint64_t upper_bound(size_t i);
+
+private:
+std::atomic<uint64_t> counts_[BUCKETS] = {};
+std::atomic<uint64_t> count_{0};
+std::atomic<uint64_t> sum_{0};
+std::atomic<uint64_t> max_{0};
+};
+
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef HISTORY_LOG_HPP
+#define HISTORY_LOG_HPP
+
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+#include "message.hpp"
+
+
+// Poltica de fsync do log de histrico
+enum class FsyncPolicy {
+    ALWAYS,    // cada append espera o fdatasync (em grupo com os concorrentes)
+    INTERVAL,  // uma thread sincroniza tudo o que chegou a cada fsync_ms
+    NEVER      // fica a cargo do kernel
+};
+
+struct HistoryLogOptions {
+    std::string dir;
+    size_t segment_bytes = 16 * 1024 * 1024;
+    size_t max_segments = 8;   // segmentos mais antigos so apagados
+    FsyncPolicy fsync = FsyncPolicy::INTERVAL;
+    unsigned fsync_ms = 50;
+};
+
+// "always", "never" ou um intervalo em milissegundos
+bool parse_fsync_policy(const std::string& s, HistoryLogOptions& opts);
+
+
+// Log de histrico persistente, s de acrscimo e dividido em segmentos de
+// tamanho fixo. Cada segmento  um arquivo pr-alocado e mapeado em memria:
+// o append  um memcpy para as pginas mapeadas e a leitura devolve
+// mensagens que apontam direto para elas, sem cpia. Um ndice esparso por
+// segmento (seq -> offset a cada INDEX_INTERVAL registros) permite achar o
+// fim do log e as ltimas mensagens na partida sem varrer os arquivos.
+class HistoryLog {
+public:
+// Abre (ou cria) o diretrio e recupera o fim do log.
+// Lana std::runtime_error se o diretrio ou o segmento atual falharem.
+explicit HistoryLog(HistoryLogOptions opts);
+~HistoryLog();
+
+HistoryLog(const HistoryLog&) = delete;
+HistoryLog& operator=(const HistoryLog&) = delete;
+
+// Grava a mensagem e devolve uma referncia a ela nas pginas mapeadas
+// (nullptr se a gravao falhar)
+MessageRef append(const MessageRef& msg);
+
+// ltimas n mensagens gravadas, em ordem, apontando para os segmentos.
+// O lock s cobre o retrato da posio; a leitura no segura os appends.
+std::vector<MessageRef> tail(size_t n) const;
+
+// Garante em disco tudo o que foi gravado at agora
+void sync();
+
+uint64_t first_seq() const;
+uint64_t next_seq() const;
+size_t segment_count() const;
+
+static constexpr uint64_t INDEX_INTERVAL = 64;
+
+private:
+struct IndexEntry {
+    uint64_t seq;
+    uint64_t offset;
+};
+
+struct Segment {
+    uint64_t base = 0;             // seq do primeiro registro
+    std::string path;
+    std::string idx_path;
+    int fd = -1;
+    int idx_fd = -1;
+    char* map = nullptr;
+    size_t size = 0;
+    std::vector<IndexEntry> index; // sem a entrada implcita (base, 0)
+    ~Segment();
+};
+using SegmentPtr = std::shared_ptr<Segment>;
+
+SegmentPtr create_segment(uint64_t base);
+SegmentPtr open_segment(uint64_t base);
+void recover();
+bool roll();
+void sync_upto(uint64_t seq);
+void flusher_loop();
+
+// Percorre registros vlidos e consecutivos a partir de (off, seq) at end.
+// Devolve o offset logo aps o ltimo registro vlido.
+template <typename F>
+size_t scan(const Segment& seg, size_t off, uint64_t& seq, size_t end, F&& on_record) const;
+
+HistoryLogOptions opts_;
+int dir_fd_ = -1;
+
+mutable std::mutex mtx_;           // protege segmentos e posio de escrita
+std::deque<SegmentPtr> segments_;
+SegmentPtr cur_;
+size_t write_off_ = 0;
+uint64_t next_seq_ = 0;
+
+std::mutex sync_mtx_;              // um fdatasync por vez; os demais pegam carona
+std::atomic<uint64_t> durable_seq_{0};
+
+std::mutex flush_mtx_;
+std::condition_variable flush_cv_;
+bool stopping_ = false;
+std::thread flusher_;
+};
+
+
+#endif
@@ -0,0 +1,97 @@
+#ifndef LINE_FRAMER_HPP
+#define LINE_FRAMER_HPP
+
+
+#include <string>
+#include <string_view>
+#include <cstring>
+#include <cstdint>
+
+
+// Separa um fluxo TCP em linhas terminadas por '\n'.
+// As linhas completas de cada leitura so entregues como string_view
+// apontando para o prprio buffer do recv(), sem cpia; s o pedao final
+// incompleto  guardado at a prxima leitura. Assim vrias linhas num
+// mesmo segmento viram vrios comandos e uma linha dividida em dois
+// segmentos chega inteira. Linhas maiores que max_line so descartadas.
+class LineFramer {
+public:
+explicit LineFramer(size_t max_line = 4096) : max_line_(max_line) {}
+
+// Chama on_line(std::string_view) para cada linha completa (sem o '\n' e
+// sem '\r' final). Se on_line retornar false, o restante  ignorado e
+// feed retorna false.
+template <typename F>
+bool feed(const char* data, size_t n, F&& on_line) {
+    const char* p = data;
+    const char* end = data + n;
+
+    while (p < end) {
+        const char* nl = static_cast<const char*>(std::memchr(p, '\n', end - p));
+        if (!nl) {
+            stash(p, end - p);
+            break;
+        }
+
+        size_t len = nl - p;
+        const char* start = p;
+        p = nl + 1;
+
+        if (discarding_) {
+            discarding_ = false;
+            continue;
+        }
+
+        std::string_view line;
+        if (!pending_.empty()) {
+            if (pending_.size() + len > max_line_) {
+                ++overflowed_;
+                pending_.clear();
+                continue;
+            }
+            pending_.append(start, len);
+            line = pending_;
+        } else {
+            if (len > max_line_) {
+                ++overflowed_;
+                continue;
+            }
+            line = std::string_view(start, len);
+        }
+
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+
+        bool keep = on_line(line);
+        pending_.clear();
+        if (!keep) return false;
+    }
+    return true;
+}
+
+// Quantidade de linhas descartadas por excederem max_line
+uint64_t overflowed() const { return overflowed_; }
+size_t pending() const { return pending_.size(); }
+// Comeo de linha guardado  espera do resto
+std::string_view partial() const { return pending_; }
+size_t max_line() const { return max_line_; }
+
+private:
+void stash(const char* p, size_t n) {
+    if (discarding_) return;
+    if (pending_.size() + n > max_line_) {
+        pending_.clear();
+        discarding_ = true;
+        ++overflowed_;
+        return;
+    }
+    pending_.append(p, n);
+}
+
+std::string pending_;    // linha incompleta da leitura anterior
+size_t max_line_;
+bool discarding_ = false;
+uint64_t overflowed_ = 0;
+};
+
+
+#endif
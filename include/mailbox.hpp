@@ -0,0 +1,118 @@
+#ifndef MAILBOX_HPP
+#define MAILBOX_HPP
+
+
+#include <string>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#include "message.hpp"
+#include "ring_buffer.hpp"
+
+
+struct MailboxOptions {
+    size_t max_messages = 100;               // por usurio, memria e disco somados
+    size_t memory_bytes = 64 * 1024 * 1024;  // soma das caixas em memria
+    std::string dir;                         // vazio = s memria
+};
+
+
+// Caixas de mensagens privadas para quem est offline. As caixas ficam em
+// faixas com lock prprio (escolhidas pelo hash do nome), ento guardar e
+// entregar para usurios diferentes no disputa lock nenhum. Passando do
+// oramento de memria, a caixa de quem recebe vai para um arquivo em dir
+// (sem dir, a mensagem  recusada); no destrutor tudo o que est em memria
+// tambm vai para o disco, e a prxima execuo encontra as caixas l.
+// Os arquivos no passam por fsync: sobrevivem a um reincio do servidor,
+// no a uma queda da mquina.
+// A leitura e a gravao dos arquivos correm fora do lock da faixa: um disco
+// lento atrasa s quem transborda ou recebe uma caixa que est em disco (na
+// thread que chamou), no as caixas em memria da mesma faixa. Cada arquivo
+// tem no mximo max_messages registros.
+class MailboxStore {
+public:
+enum class Result {
+STORED,  // guardada
+FULL,    // caixa do usurio (ou a memria, sem dir) cheia
+FAILED   // erro ao gravar em disco
+};
+
+struct Stats {
+    std::atomic<uint64_t> stored{0};
+    std::atomic<uint64_t> delivered{0};
+    std::atomic<uint64_t> refused{0};
+    std::atomic<uint64_t> spilled{0};  // mensagens gravadas em disco
+};
+
+static constexpr size_t STRIPES = 64;
+
+// Com opts.dir, cria o diretrio se preciso e conta as caixas deixadas por
+// execues anteriores. Lana runtime_error se o diretrio no abrir.
+explicit MailboxStore(const MailboxOptions& opts);
+~MailboxStore();
+
+MailboxStore(const MailboxStore&) = delete;
+MailboxStore& operator=(const MailboxStore&) = delete;
+
+Result deposit(const std::string& user, const MessageRef& msg);
+
+// Esvazia a caixa de user, acrescentando a out as mensagens na ordem em
+// que chegaram. Retorna quantas eram (0 se no havia caixa).
+size_t take(const std::string& user, std::string& out);
+
+size_t pending(const std::string& user) const;
+size_t messages() const { return messages_.load(std::memory_order_relaxed); }
+size_t memory_bytes() const { return memory_bytes_.load(std::memory_order_relaxed); }
+const Stats& stats() const { return stats_; }
+
+// Grava em disco as caixas que esto em memria (s com dir). Retorna
+// quantas mensagens foram gravadas.
+size_t spill_all();
+
+// Chama f(usurio, mensagem) para cada mensagem guardada em memria, na
+// ordem de chegada de cada caixa (as do disco ficam de fora)
+template <typename F>
+void for_each_in_memory(F&& f) const {
+    for (size_t i = 0; i < STRIPES; ++i) {
+        std::lock_guard<std::mutex> lg(stripes_[i].mtx);
+        for (const auto& [user, box] : stripes_[i].boxes) {
+            for (size_t j = 0; j < box.memory.size(); ++j) f(user, box.memory[j]);
+        }
+    }
+}
+
+private:
+struct Box {
+    RingBuffer<MessageRef> memory;  // as mais novas; as do disco vm antes
+    size_t on_disk = 0;
+};
+
+struct alignas(64) Stripe {
+    mutable std::mutex mtx;  // caixas da faixa; nunca fica pego durante I/O
+    std::mutex file_mtx;     // arquivos da faixa; pego antes de mtx
+    std::unordered_map<std::string, Box> boxes;
+};
+
+Stripe& stripe_of(const std::string& user) const;
+std::string path_of(const std::string& user) const;
+bool full(const Stripe& s, const std::string& user) const;
+// Acrescenta buf ao arquivo de user; em caso de erro o arquivo volta ao
+// tamanho anterior
+bool append_file(const std::string& user, const std::string& buf) const;
+// Acrescenta ao arquivo de user as mensagens em memria da caixa; sem erro
+// a caixa fica s em disco. Chamado com file_mtx e mtx pegos.
+bool spill(const std::string& user, Box& box);
+void load_dir();
+
+MailboxOptions opts_;
+std::unique_ptr<Stripe[]> stripes_;
+std::atomic<size_t> messages_{0};
+std::atomic<size_t> memory_bytes_{0};
+Stats stats_;
+};
+
+
+#endif
@@ -3,6 +3,14 @@
 
 
 #include <string>
+#include <string_view>
+#include <chrono>
+#include <memory>
+#include <initializer_list>
+#include <cstring>
+#include <new>
+
+#include "slab.hpp"
 
 
 struct Message {
@@ -13,4 +21,73 @@ std::chrono::system_clock::time_point ts;
 };
 
 
+// Mensagem j formatada para o fio, imutvel e com contagem de referncias.
+//  montada uma nica vez e compartilhada pelas filas de sada de todos os
+// destinatrios, pelo histrico e pelo logger, sem cpias por destinatrio.
+// Tambm pode apontar para memria de terceiros (ex.: pginas mapeadas do
+// log de histrico), mantida viva por owner enquanto a mensagem existir.
+class MessageBuffer {
+public:
+explicit MessageBuffer(std::string bytes) : bytes_(std::move(bytes)), view_(bytes_) {}
+MessageBuffer(std::shared_ptr<const void> owner, std::string_view bytes)
+    : view_(bytes), owner_(std::move(owner)) {}
+
+MessageBuffer(const MessageBuffer&) = delete;
+MessageBuffer& operator=(const MessageBuffer&) = delete;
+
+const char* data() const { return view_.data(); }
+size_t size() const { return view_.size(); }
+std::string_view view() const { return view_; }
+
+private:
+std::string bytes_;
+std::string_view view_;
+std::shared_ptr<const void> owner_;
+};
+
+using MessageRef = std::shared_ptr<const MessageBuffer>;
+
+
+namespace detail {
+
+// Devolve ao slab o bloco com o MessageBuffer e os bytes logo depois dele
+struct SlabMessageRelease {
+    size_t block;
+    void operator()(const MessageBuffer* m) const {
+        m->~MessageBuffer();
+        slab::deallocate(const_cast<MessageBuffer*>(m), block);
+    }
+};
+
+}
+
+// Concatena as partes num bloco do slab que guarda tambm o MessageBuffer;
+// o bloco de controle do shared_ptr tambm vem do slab, ento montar uma
+// mensagem no passa pelo alocador global
+inline MessageRef make_message(std::initializer_list<std::string_view> parts) {
+size_t total = 0;
+for (auto p : parts) total += p.size();
+
+size_t block = sizeof(MessageBuffer) + total;
+char* mem = static_cast<char*>(slab::allocate(block));
+char* bytes = mem + sizeof(MessageBuffer);
+char* w = bytes;
+for (auto p : parts) {
+    if (!p.empty()) std::memcpy(w, p.data(), p.size());
+    w += p.size();
+}
+auto* msg = new (mem) MessageBuffer(nullptr, std::string_view(bytes, total));
+return MessageRef(msg, detail::SlabMessageRelease{block}, slab::Allocator<MessageBuffer>());
+}
+
+inline MessageRef make_message(std::string bytes) {
+return std::allocate_shared<MessageBuffer>(slab::Allocator<MessageBuffer>(), std::move(bytes));
+}
+
+// Mensagem sem cpia sobre memria mantida viva por owner
+inline MessageRef make_message_view(std::shared_ptr<const void> owner, std::string_view bytes) {
+return std::allocate_shared<MessageBuffer>(slab::Allocator<MessageBuffer>(), std::move(owner), bytes);
+}
+
+
 #endif
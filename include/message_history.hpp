@@ -0,0 +1,49 @@
+#ifndef MESSAGE_HISTORY_HPP
+#define MESSAGE_HISTORY_HPP
+
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+#include "message.hpp"
+
+
+// Histrico de mensagens em buffer circular pr-alocado.
+// Escritores reservam a prxima posio com um fetch_add e nunca esperam
+// por leitores; cada posio tem uma trava mnima que s cobre a troca ou a
+// cpia de uma referncia. Leitores tiram um retrato das ltimas n
+// mensagens sem trava global; posies sobrescritas ou ainda em escrita
+// durante a leitura so puladas.
+class MessageHistory {
+public:
+explicit MessageHistory(size_t capacity = 100);
+
+MessageHistory(const MessageHistory&) = delete;
+MessageHistory& operator=(const MessageHistory&) = delete;
+
+void add(MessageRef msg);
+
+std::vector<MessageRef> get_recent(size_t n) const;
+
+size_t capacity() const { return capacity_; }
+uint64_t total() const { return head_.load(std::memory_order_acquire); }
+
+private:
+struct Slot {
+    std::atomic<uint64_t> seq{0};   // ndice da mensagem + 1 (0 = vazio)
+    std::atomic_flag busy = ATOMIC_FLAG_INIT;
+    MessageRef ref;
+};
+
+static void lock(Slot& s);
+static void unlock(Slot& s);
+
+size_t capacity_;
+std::unique_ptr<Slot[]> slots_;
+std::atomic<uint64_t> head_{0};
+};
+
+
+#endif
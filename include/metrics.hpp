@@ -0,0 +1,221 @@
+#ifndef METRICS_HPP
+#define METRICS_HPP
+
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <cstdint>
+
+#include "histogram.hpp"
+
+
+// Registro de mtricas do servidor: contadores, medidores e histogramas de
+// latncia, exportados no formato de exposio do Prometheus e num resumo
+// legvel para o /stats. Cada thread escreve na sua prpria clula (slot),
+// ento uma atualizao  um fetch_add relaxed numa linha de cache que s
+// ela toca; somar as clulas fica para quem l.
+namespace metrics {
+
+// Clulas por mtrica; threads alm disso dividem clulas (ainda sem lock)
+constexpr unsigned MAX_SLOTS = 32;
+
+// Clula da thread atual, atribuda em rodzio na primeira chamada
+unsigned thread_slot();
+
+// Tempo monotnico em nanossegundos, para medir estgios
+inline uint64_t now_ns() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+}
+
+
+class Counter {
+public:
+void inc(uint64_t n = 1) {
+    cells_[metrics::thread_slot()].v.fetch_add(n, std::memory_order_relaxed);
+}
+
+uint64_t value() const;
+
+private:
+struct alignas(64) Cell {
+    std::atomic<uint64_t> v{0};
+};
+Cell cells_[metrics::MAX_SLOTS];
+};
+
+
+// Valor que sobe e desce (conexes ativas, por exemplo)
+class Gauge {
+public:
+void add(int64_t n) {
+    cells_[metrics::thread_slot()].v.fetch_add(n, std::memory_order_relaxed);
+}
+void sub(int64_t n) { add(-n); }
+
+int64_t value() const;
+
+private:
+struct alignas(64) Cell {
+    std::atomic<int64_t> v{0};
+};
+Cell cells_[metrics::MAX_SLOTS];
+};
+
+
+namespace metrics {
+
+// Syscalls de I/O por tipo, contadas por quem as faz (lao de eventos, fila
+// de sada, leitura e accept do servidor), para comparar os backends de I/O
+enum class Syscall { ACCEPT, RECV, SEND, EPOLL_WAIT, URING_ENTER, OTHER, COUNT };
+
+Counter& syscalls(Syscall s);
+const char* syscall_name(Syscall s);
+
+}
+
+
+// Histograma de latncia em nanossegundos. Cada clula  um Histogram
+// inteiro, alocado s quando uma thread daquela clula registra algo.
+class LatencyHistogram {
+public:
+LatencyHistogram() = default;
+~LatencyHistogram();
+LatencyHistogram(const LatencyHistogram&) = delete;
+LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+void record(uint64_t ns) { cell(metrics::thread_slot()).record(ns); }
+
+// Registra o tempo decorrido desde start_ns
+void record_since(uint64_t start_ns) {
+    uint64_t now = metrics::now_ns();
+    record(now > start_ns ? now - start_ns : 0);
+}
+
+// Soma das clulas em out
+void snapshot(Histogram& out) const;
+
+private:
+Histogram& cell(unsigned slot) {
+    Histogram* h = cells_[slot].load(std::memory_order_acquire);
+    return h ? *h : allocate(slot);
+}
+Histogram& allocate(unsigned slot);
+
+std::atomic<Histogram*> cells_[metrics::MAX_SLOTS] = {};
+};
+
+
+// Histogramas de espera e de posse de um mutex
+struct LockStats {
+LatencyHistogram& wait;
+LatencyHistogram& hold;
+};
+
+template <typename Mutex>
+class TimedLockGuard {
+public:
+TimedLockGuard(Mutex& m, LockStats& stats) : m_(m), stats_(stats) {
+    uint64_t t0 = metrics::now_ns();
+    m_.lock();
+    acquired_ = metrics::now_ns();
+    stats_.wait.record(acquired_ - t0);
+}
+
+~TimedLockGuard() {
+    uint64_t t = metrics::now_ns();
+    m_.unlock();
+    stats_.hold.record(t - acquired_);
+}
+
+TimedLockGuard(const TimedLockGuard&) = delete;
+TimedLockGuard& operator=(const TimedLockGuard&) = delete;
+
+private:
+Mutex& m_;
+LockStats& stats_;
+uint64_t acquired_;
+};
+
+
+// As mtricas so registradas na partida e vivem enquanto o registro viver;
+// as referncias devolvidas podem ser guardadas. Mtricas com o mesmo nome e
+// rtulos diferentes (labels no formato 'stage="filter"') formam uma famlia.
+class MetricsRegistry {
+public:
+Counter& counter(const std::string& name, const std::string& help, const std::string& labels = "");
+Gauge& gauge(const std::string& name, const std::string& help, const std::string& labels = "");
+LatencyHistogram& histogram(const std::string& name, const std::string& help,
+                            const std::string& labels = "");
+
+// Medidor calculado na hora da leitura
+void gauge_fn(const std::string& name, const std::string& help, std::function<int64_t()> fn,
+              const std::string& labels = "");
+
+// Contador mantido fora do registro, lido na hora da exportao
+void counter_fn(const std::string& name, const std::string& help, std::function<uint64_t()> fn,
+                const std::string& labels = "");
+
+// Formato de exposio de texto do Prometheus (verso 0.0.4); os
+// histogramas saem em segundos com limites fixos de 1 us a 10 s
+std::string render_prometheus() const;
+
+// Resumo para humanos: valores e p50/p99/p999/mx dos histogramas
+std::string render_text() const;
+
+private:
+enum class Kind { COUNTER, COUNTER_FN, GAUGE, GAUGE_FN, HISTOGRAM };
+
+struct Entry {
+    Kind kind;
+    std::string name;
+    std::string help;
+    std::string labels;
+    std::unique_ptr<Counter> counter;
+    std::unique_ptr<Gauge> gauge;
+    std::function<int64_t()> fn;
+    std::function<uint64_t()> counter_fn;
+    std::unique_ptr<LatencyHistogram> histogram;
+};
+
+Entry& add(Kind kind, const std::string& name, const std::string& help, const std::string& labels);
+
+mutable std::mutex mtx_;
+std::vector<std::unique_ptr<Entry>> entries_;
+};
+
+
+// Endpoint HTTP mnimo que responde qualquer requisio com
+// render_prometheus(). Escuta em 127.0.0.1:port (port > 0) e/ou num socket
+// Unix (unix_path no vazio), numa thread prpria. Lana
+// std::runtime_error se algum endpoint pedido no abrir.
+class MetricsServer {
+public:
+MetricsServer(const MetricsRegistry& registry, int port, const std::string& unix_path);
+~MetricsServer();
+
+MetricsServer(const MetricsServer&) = delete;
+MetricsServer& operator=(const MetricsServer&) = delete;
+
+private:
+void run();
+void serve(int fd);
+
+const MetricsRegistry& registry_;
+std::string unix_path_;
+int tcp_fd_ = -1;
+int unix_fd_ = -1;
+std::atomic<bool> stop_{false};
+std::thread thr_;
+};
+
+
+#endif
@@ -0,0 +1,87 @@
+#ifndef OUTBOUND_QUEUE_HPP
+#define OUTBOUND_QUEUE_HPP
+
+
+#include <string>
+#include <string_view>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+
+#include <sys/uio.h>
+
+#include "message.hpp"
+#include "ring_buffer.hpp"
+
+
+// O que fazer quando a fila de sada de um cliente est cheia
+enum class OverflowPolicy { DROP_OLDEST, DROP_NEW, DISCONNECT };
+
+bool parse_overflow_policy(const std::string& s, OverflowPolicy& out);
+std::string overflow_policy_to_string(OverflowPolicy p);
+
+
+// Fila de sada limitada de uma conexo, esvaziada em lote (sendmsg com
+// vrios iovec, equivalente a writev() com MSG_DONTWAIT) quando o socket
+// aceita escrita, ou por envio assncrono (gather/consume) no io_uring. S a
+// thread dona da conexo chama push/flush/gather/consume; depth(), dropped()
+// e os totais de envio podem ser lidos de qualquer thread.
+class OutboundQueue {
+public:
+using Payload = MessageRef;
+
+explicit OutboundQueue(size_t max_msgs = 1024,
+                       OverflowPolicy policy = OverflowPolicy::DROP_OLDEST);
+
+// Retorna false quando a fila estourou com a poltica DISCONNECT
+bool push(Payload msg);
+
+// Escreve at esvaziar a fila ou o socket devolver EAGAIN.
+// Retorna false em erro do socket.
+bool flush(int fd);
+
+// Envio assncrono: gather descreve o comeo da fila em at max iovec e
+// fixa essas mensagens at consume (bytes que o kernel aceitou) ou release
+// (envio falhou). Enquanto fixadas, o descarte por fila cheia no as toca.
+size_t gather(iovec* iov, size_t max);
+void consume(size_t bytes);
+void release() { pinned_ = 0; }
+bool in_flight() const { return pinned_ > 0; }
+
+// Chama f(std::string_view) com o que falta enviar de cada mensagem, na
+// ordem (a primeira sem a parte que j foi para o socket)
+template <typename F>
+void unsent(F&& f) const {
+    for (size_t i = 0; i < q_.size(); ++i) {
+        std::string_view v = q_[i]->view();
+        f(i == 0 ? v.substr(head_off_) : v);
+    }
+}
+
+bool empty() const { return q_.empty(); }
+size_t depth() const { return depth_.load(std::memory_order_relaxed); }
+uint64_t dropped() const { return dropped_.load(std::memory_order_relaxed); }
+uint64_t sent_bytes() const { return sent_bytes_.load(std::memory_order_relaxed); }
+// Mensagens entregues por inteiro ao socket e escritas (sendmsg ou envios
+// do io_uring) que as levaram
+uint64_t sent_messages() const { return sent_msgs_.load(std::memory_order_relaxed); }
+uint64_t writes() const { return writes_.load(std::memory_order_relaxed); }
+
+private:
+void update_depth() { depth_.store(q_.size(), std::memory_order_relaxed); }
+
+RingBuffer<Payload> q_;  // capacidade guardada entre rajadas
+size_t head_off_ = 0;   // bytes da primeira mensagem j enviados
+size_t pinned_ = 0;     // mensagens num envio ainda em andamento
+size_t max_msgs_;
+OverflowPolicy policy_;
+
+std::atomic<size_t> depth_{0};
+std::atomic<uint64_t> dropped_{0};
+std::atomic<uint64_t> sent_bytes_{0};
+std::atomic<uint64_t> sent_msgs_{0};
+std::atomic<uint64_t> writes_{0};
+};
+
+
+#endif
@@ -0,0 +1,104 @@
+#ifndef PRESENCE_HPP
+#define PRESENCE_HPP
+
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+#include "message.hpp"
+#include "metrics.hpp"
+#include "rcu.hpp"
+
+
+// Definido pelo servidor; o registro s guarda e devolve ponteiros
+struct ClientInfo;
+
+
+// Quem est online. Leituras (busca por nome, listagem, /users) no usam
+// lock: cada faixa publica uma tabela imutvel protegida por RCU, trocada
+// inteira por quem entra ou sai. A listagem ordenada e as pginas do /users
+// j renderizadas ficam em cache por verso; servir uma pgina da verso
+// atual  copiar uma referncia.
+class PresenceRegistry {
+public:
+using Member = std::shared_ptr<ClientInfo>;
+
+static constexpr size_t STRIPES = 64;
+
+// lock_stats (opcional) mede espera e posse dos locks de escrita das faixas
+explicit PresenceRegistry(size_t page_size = 100, LockStats* lock_stats = nullptr);
+~PresenceRegistry();
+
+PresenceRegistry(const PresenceRegistry&) = delete;
+PresenceRegistry& operator=(const PresenceRegistry&) = delete;
+
+// Retorna false se o nome j estava online
+bool add(const std::string& name, const Member& member);
+// Remove o nome se o registro ainda for desta conexo
+bool remove(const std::string& name, const ClientInfo* member);
+
+Member find(const std::string& name) const;
+
+size_t size() const { return size_.load(std::memory_order_relaxed); }
+// Muda a cada entrada ou sada
+uint64_t version() const { return version_.load(std::memory_order_acquire); }
+
+// Pgina (a partir de 1) da lista completa, da verso atual
+MessageRef page(size_t page);
+
+// Pgina dos nomes que comeam com prefix (renderizada na hora)
+MessageRef search(const std::string& prefix, size_t page);
+
+// Chama f(nome, membro) para cada usurio online, fora de qualquer lock
+template <typename F>
+void for_each(F&& f) const {
+    rcu::ReadGuard guard;
+    for (size_t i = 0; i < STRIPES; ++i) {
+        const Table* t = stripes_[i].table.load(std::memory_order_acquire);
+        for (const auto& e : *t) f(e.name, e.member);
+    }
+}
+
+private:
+struct Entry {
+    std::string name;
+    Member member;
+};
+// Ordenada por nome
+using Table = std::vector<Entry>;
+
+struct alignas(64) Stripe {
+    std::mutex write_mtx;
+    std::atomic<const Table*> table{nullptr};
+};
+
+// Nomes ordenados e pginas completas de uma verso
+struct Listing {
+    uint64_t version = 0;
+    std::vector<std::string> names;
+    std::vector<MessageRef> pages;
+};
+
+Stripe& stripe_of(const std::string& name) const;
+template <typename F> void locked(Stripe& s, F&& f);
+
+const Listing* current_listing();
+MessageRef render(const std::vector<std::string>& names, size_t begin, size_t end,
+                  size_t page, size_t pages, size_t total, const std::string& prefix) const;
+
+size_t page_size_;
+LockStats* lock_stats_;
+std::unique_ptr<Stripe[]> stripes_;
+std::atomic<size_t> size_{0};
+std::atomic<uint64_t> version_{0};
+
+std::mutex listing_mtx_;   // s quem reconstri a listagem
+std::atomic<const Listing*> listing_{nullptr};
+};
+
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef RATE_LIMIT_HPP
+#define RATE_LIMIT_HPP
+
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// Um balde de fichas: rate fichas por segundo, no mximo burst guardadas.
+// rate 0 desliga o balde.
+struct BucketLimit {
+    double rate = 0;
+    double burst = 0;
+
+    bool enabled() const { return rate > 0; }
+};
+
+// "TAXA" ou "TAXA:RAJADA" (rajada padro: a taxa, no mnimo 1)
+bool parse_rate_limit(const std::string& s, BucketLimit& out);
+std::string rate_limit_to_string(const BucketLimit& l);
+
+
+// Qual balde faltou numa chamada a take()
+enum class RateVerdict { ALLOW, DENY_FIRST, DENY_SECOND };
+
+// Baldes de fichas por chave (usurio, endereo IP) numa tabela plana de
+// tamanho fixo: cada entrada guarda dois baldes (ex.: mensagens e bytes do
+// mesmo usurio) e o instante da ltima consulta, e o reabastecimento 
+// calculado na consulta a partir dele, sem timers. A tabela  dividida em
+// faixas com lock prprio; cada chave fica numa janela curta de posies da
+// sua faixa. Uma entrada cujos baldes j encheriam de novo equivale a uma
+// ausente e  reaproveitada; se a janela inteira estiver em uso, sai a
+// consultada h mais tempo (evictions()).
+class RateLimiter {
+public:
+RateLimiter(BucketLimit first, BucketLimit second = {}, size_t capacity = 65536);
+
+bool enabled() const { return first_.enabled() || second_.enabled(); }
+
+// Retira first_cost do primeiro balde e second_cost do segundo, ou nada se
+// algum deles no tiver o bastante. Um custo maior que a rajada  limitado
+// a ela (passa s com o balde cheio).
+RateVerdict take(uint64_t key, uint64_t now_ns, double first_cost = 1, double second_cost = 0);
+
+// Chaves de 64 bits para take(); nunca zero
+static uint64_t key_of(std::string_view s);
+static uint64_t key_of(uint32_t v);
+
+size_t capacity() const { return slots_.size(); }
+// Entradas em uso, incluindo as que j encheriam de novo
+size_t size() const;
+uint64_t evictions() const { return evictions_.load(std::memory_order_relaxed); }
+
+static constexpr size_t STRIPES = 64;
+static constexpr size_t PROBE = 8;  // posies examinadas por chave
+
+private:
+struct Slot {
+    uint64_t key;  // 0 = livre
+    uint64_t stamp_ns;
+    double tokens[2];
+};
+
+struct alignas(64) Stripe {
+    mutable std::mutex mtx;
+};
+
+bool idle(const Slot& s, uint64_t now_ns) const;
+void refill(Slot& s, uint64_t now_ns) const;
+
+BucketLimit first_, second_;
+size_t per_stripe_;  // potncia de dois
+std::vector<Slot> slots_;
+std::unique_ptr<Stripe[]> stripes_;
+std::atomic<uint64_t> evictions_{0};
+};
+
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef RCU_HPP
+#define RCU_HPP
+
+
+#include <functional>
+#include <cstddef>
+
+
+// RCU por pocas: leitores marcam a poca global ao entrar numa seo de
+// leitura e a limpam ao sair, sem lock e sem escrever em nada compartilhado
+// com outros leitores. Um escritor publica a nova verso do dado (store
+// atmico do ponteiro) e entrega a antiga a retire(); ela s  liberada
+// quando nenhum leitor ativo entrou antes da troca.
+namespace rcu {
+
+// Seo de leitura; pode ser aninhada. Ponteiros lidos dentro dela valem
+// at o destrutor.
+class ReadGuard {
+public:
+ReadGuard();
+~ReadGuard();
+
+ReadGuard(const ReadGuard&) = delete;
+ReadGuard& operator=(const ReadGuard&) = delete;
+};
+
+// Adia free() at que nenhum leitor possa estar usando o dado antigo.
+// Deve ser chamado depois de publicar a verso nova.
+void retire(std::function<void()> free);
+
+// Libera o que j pode ser liberado; retire() j chama sozinho
+void reclaim();
+
+// Itens aposentados ainda no liberados
+size_t pending();
+
+}
+
+
+#endif
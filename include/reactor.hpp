@@ -0,0 +1,149 @@
+#ifndef REACTOR_HPP
+#define REACTOR_HPP
+
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <new>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "slab.hpp"
+
+class IoUring;
+struct io_uring_cqe;
+struct io_uring_sqe;
+
+
+// Como o lao espera por I/O
+enum class IoBackend { EPOLL, URING };
+
+bool parse_io_backend(const std::string& s, IoBackend& out);
+std::string io_backend_to_string(IoBackend b);
+
+
+// Lao de eventos. No backend EPOLL, epoll edge-triggered; no URING, um
+// io_uring em que os fds registrados com add() viram poll multishot e as
+// operaes por concluso (accept_multishot, recv_multishot, send) so
+// entregues ao kernel juntas, numa nica io_uring_enter() por volta do lao.
+// Se o io_uring no estiver disponvel o lao usa epoll (veja backend()).
+// add/remove e as operaes por concluso s podem ser chamadas na thread do
+// lao; post/stop podem ser chamados de qualquer thread. modify s existe no
+// backend EPOLL.
+class EventLoop {
+public:
+using Handler = std::function<void(uint32_t events)>;
+using Task = std::function<void()>;
+using AcceptHandler = std::function<void(int fd)>;                    // fd < 0: -errno
+using RecvHandler = std::function<void(const char* data, ssize_t n)>;  // 0: EOF; < 0: -errno
+using SendHandler = std::function<void(ssize_t n)>;                    // bytes ou -errno
+
+explicit EventLoop(IoBackend backend = IoBackend::EPOLL);
+~EventLoop();
+
+EventLoop(const EventLoop&) = delete;
+EventLoop& operator=(const EventLoop&) = delete;
+
+IoBackend backend() const { return ring_ ? IoBackend::URING : IoBackend::EPOLL; }
+
+// Motivo de ter ficado no epoll quando URING foi pedido
+const std::string& backend_error() const { return backend_error_; }
+
+bool add(int fd, uint32_t events, Handler h);
+bool modify(int fd, uint32_t events);
+void remove(int fd);
+
+void post(Task t);
+
+// Como post, sem passar pelo alocador global: o estado de f vai num bloco
+// do slab e o Task guarda s o ponteiro, que cabe no espao interno do
+// std::function. Uma tarefa que nunca roda (lao parado no encerramento)
+// deixa o bloco para trs.
+template <typename F>
+void post_pooled(F f) {
+    F* job = new (slab::allocate(sizeof(F))) F(std::move(f));
+    post([job] {
+        (*job)();
+        job->~F();
+        slab::deallocate(job, sizeof(F));
+    });
+}
+
+// Chama t na thread do lao a cada interval_ms (timerfd). Mesma regra de
+// add: s na thread do lao ou antes de run(). Retorna false se falhar.
+bool add_timer(unsigned interval_ms, Task t);
+
+// Timer de disparo nico, desarmado at arm_timer. Retorna o id (o fd do
+// timerfd) ou -1. arm_timer substitui um prazo j armado; 0 desarma.
+int add_oneshot_timer(Task t);
+bool arm_timer(int timer, uint64_t delay_us);
+
+// S no backend URING (retornam false no EPOLL). Os handlers rodam na
+// thread do lao e deixam de ser chamados depois de remove(fd).
+// accept_multishot: um handler por conexo aceita, sem rearmar.
+// recv_multishot: os dados vm de um buffer do anel, vlido s durante a
+// chamada. send: envia iov (copiado) na prxima io_uring_enter().
+bool accept_multishot(int listen_fd, AcceptHandler h);
+bool recv_multishot(int fd, RecvHandler h);
+bool send(int fd, const iovec* iov, size_t iovcnt, SendHandler done);
+
+// Chamado a cada volta, logo antes de esperar por eventos
+void set_before_wait(Task t) { before_wait_ = std::move(t); }
+
+void run();
+void stop();
+// Depois que run() voltou: roda na thread de quem chama as tarefas que
+// ainda chegaram (postadas por outro lao enquanto este parava). Retorna
+// quantas rodaram.
+size_t drain();
+
+bool in_loop_thread() const;
+size_t handler_count() const { return handlers_.size(); }
+
+static constexpr size_t MAX_SEND_IOV = 64;
+
+private:
+struct Op;
+
+void wake();
+void run_pending();
+void run_epoll();
+void run_uring();
+
+Op* new_op(int kind, int fd);
+void free_op(Op* op);
+io_uring_sqe* next_sqe();
+bool arm(Op* op);
+void complete(const io_uring_cqe& cqe);
+
+int epfd_ = -1;
+int wakefd_;
+std::atomic<bool> stopped_{false};
+std::thread::id owner_;
+
+std::unordered_map<int, std::shared_ptr<Handler>> handlers_;
+std::vector<int> timers_;
+Task before_wait_;
+
+std::unique_ptr<IoUring> ring_;
+std::string backend_error_;
+std::vector<uint32_t> fd_gen_;  // muda a cada remove(fd): concluses antigas so ignoradas
+std::vector<uint32_t> fd_ops_;  // operaes em andamento por fd
+std::vector<Op*> all_ops_;
+std::vector<Op*> free_ops_;
+
+std::mutex tasks_mtx_;
+std::vector<Task> tasks_;
+std::vector<Task> running_;  // s na thread do lao
+};
+
+
+#endif
@@ -0,0 +1,62 @@
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+
+#include <vector>
+#include <utility>
+#include <cstddef>
+
+
+// Fila FIFO sobre um vetor circular que s cresce (dobrando). Ao contrrio
+// do std::deque, que aloca e libera um bloco a cada poucas dezenas de
+// elementos que passam por ela, depois de atingir o tamanho de trabalho a
+// fila no aloca mais: a capacidade fica com o dono (uma conexo, um shard).
+template <typename T>
+class RingBuffer {
+public:
+bool empty() const { return count_ == 0; }
+size_t size() const { return count_; }
+size_t capacity() const { return slots_.size(); }
+
+T& operator[](size_t i) { return slots_[(head_ + i) & (slots_.size() - 1)]; }
+const T& operator[](size_t i) const { return slots_[(head_ + i) & (slots_.size() - 1)]; }
+T& front() { return (*this)[0]; }
+
+void push_back(T v) {
+    if (count_ == slots_.size()) grow();
+    (*this)[count_] = std::move(v);
+    ++count_;
+}
+
+void pop_front() {
+    slots_[head_] = T();
+    head_ = (head_ + 1) & (slots_.size() - 1);
+    --count_;
+}
+
+// Remove o i-simo elemento empurrando os anteriores uma posio para
+// frente: custa O(i), no O(size()), para remoes perto do comeo
+void erase(size_t i) {
+    for (; i > 0; --i) (*this)[i] = std::move((*this)[i - 1]);
+    pop_front();
+}
+
+void clear() {
+    while (!empty()) pop_front();
+}
+
+private:
+void grow() {
+    std::vector<T> bigger(slots_.empty() ? 8 : slots_.size() * 2);
+    for (size_t i = 0; i < count_; ++i) bigger[i] = std::move((*this)[i]);
+    slots_.swap(bigger);
+    head_ = 0;
+}
+
+std::vector<T> slots_;  // tamanho sempre potncia de 2
+size_t head_ = 0;
+size_t count_ = 0;
+};
+
+
+#endif
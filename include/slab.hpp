@@ -0,0 +1,51 @@
+#ifndef SLAB_HPP
+#define SLAB_HPP
+
+
+#include <cstddef>
+#include <cstdint>
+
+
+// Alocador de blocos por classe de tamanho (potncias de 2 de MIN_BLOCK a
+// MAX_BLOCK) para o caminho quente: buffers de mensagem, blocos de controle
+// dos shared_ptr, conexes e tarefas entre shards. Cada thread tem listas
+// livres prprias, ento alocar e liberar  tirar ou pr um ponteiro numa
+// lista, sem lock; s quando a lista de uma thread esvazia ou cresce demais
+// os blocos passam pela lista global (com mutex), em lotes. A memria nunca
+// volta ao sistema: depois do aquecimento o servidor no chama mais o
+// alocador global. Pedidos maiores que MAX_BLOCK vo para ::operator new.
+namespace slab {
+
+constexpr size_t MIN_BLOCK = 32;
+constexpr size_t MAX_BLOCK = 16384;
+
+void* allocate(size_t n);
+void deallocate(void* p, size_t n) noexcept;
+
+// Bytes pedidos ao sistema para as classes (s cresce)
+size_t reserved_bytes();
+
+// Alocador padro sobre o slab, para std::allocate_shared e contineres.
+// Os blocos tm o alinhamento de ::operator new.
+template <typename T>
+struct Allocator {
+    using value_type = T;
+    static_assert(alignof(T) <= alignof(std::max_align_t), "alinhamento maior que o do slab");
+
+    Allocator() noexcept = default;
+    template <typename U>
+    Allocator(const Allocator<U>&) noexcept {}
+
+    T* allocate(size_t n) { return static_cast<T*>(slab::allocate(n * sizeof(T))); }
+    void deallocate(T* p, size_t n) noexcept { slab::deallocate(p, n * sizeof(T)); }
+};
+
+template <typename T, typename U>
+bool operator==(const Allocator<T>&, const Allocator<U>&) { return true; }
+template <typename T, typename U>
+bool operator!=(const Allocator<T>&, const Allocator<U>&) { return false; }
+
+}
+
+
+#endif
@@ -3,7 +3,13 @@
 
 
 #include <string>
+#include <string_view>
 #include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <chrono>
 
 
 namespace tslog {
@@ -11,15 +17,130 @@ namespace tslog {
 
 enum class Level { DEBUG = 0, INFO, WARN, ERROR };
 
+// O que log() faz quando a fila do logger est cheia
+enum class FullPolicy {
+BLOCK,  // espera a thread de escrita abrir espao
+DROP,   // descarta a linha
+COUNT   // descarta e registra no log quantas linhas foram perdidas
+};
+
+struct Options {
+size_t queue_capacity = 8192;   // entradas na fila (arredondado para potncia de 2)
+size_t flush_bytes = 64 * 1024; // escreve quando o lote passa deste tamanho...
+unsigned flush_ms = 100;        // ...ou quando a linha mais antiga tem esta idade
+FullPolicy on_full = FullPolicy::BLOCK;
+bool binary = false;            // registros binrios, lidos com tslog_decode
+};
+
+
+// Formato de log com "{}" no lugar de cada argumento. Registrado uma vez
+// (normalmente como static local na chamada) e identificado por um nmero:
+// no modo binrio s o nmero e os argumentos crus vo para o arquivo.
+// text deve ter durao esttica.
+class Format {
+public:
+explicit Format(const char* text);
+
+const char* text() const { return text_; }
+uint32_t id() const { return id_; }
+
+private:
+const char* text_;
+uint32_t id_;
+};
+
+// Texto de um formato registrado (nullptr se o id no existir)
+const char* format_text(uint32_t id);
+
+
+namespace detail {
+
+// Tipos dos argumentos codificados: 1 byte de tipo seguido do valor
+enum ArgType : uint8_t { ARG_I64 = 1, ARG_U64, ARG_F64, ARG_STR, ARG_CHAR, ARG_BOOL };
+
+inline void put(std::string& b, const void* p, size_t n) {
+b.append(static_cast<const char*>(p), n);
+}
+
+inline void put_str(std::string& b, const char* s, size_t n) {
+uint32_t len = static_cast<uint32_t>(n);
+b.push_back(static_cast<char>(ARG_STR));
+put(b, &len, sizeof(len));
+b.append(s, n);
+}
+
+template <typename T>
+void encode(std::string& b, const T& v) {
+using D = std::decay_t<T>;
+if constexpr (std::is_array_v<T>) {
+    put_str(b, v, std::strlen(v));
+} else if constexpr (std::is_same_v<D, bool>) {
+    b.push_back(static_cast<char>(ARG_BOOL));
+    b.push_back(v ? 1 : 0);
+} else if constexpr (std::is_same_v<D, char>) {
+    b.push_back(static_cast<char>(ARG_CHAR));
+    b.push_back(v);
+} else if constexpr (std::is_integral_v<D> && std::is_signed_v<D>) {
+    int64_t x = v;
+    b.push_back(static_cast<char>(ARG_I64));
+    put(b, &x, sizeof(x));
+} else if constexpr (std::is_integral_v<D> || std::is_enum_v<D>) {
+    uint64_t x = static_cast<uint64_t>(v);
+    b.push_back(static_cast<char>(ARG_U64));
+    put(b, &x, sizeof(x));
+} else if constexpr (std::is_floating_point_v<D>) {
+    double x = v;
+    b.push_back(static_cast<char>(ARG_F64));
+    put(b, &x, sizeof(x));
+} else if constexpr (std::is_same_v<D, const char*> || std::is_same_v<D, char*>) {
+    put_str(b, v ? v : "(null)", v ? std::strlen(v) : 6);
+} else {
+    static_assert(std::is_convertible_v<const T&, std::string_view>,
+                  "tslog: tipo de argumento no suportado");
+    std::string_view sv = v;
+    put_str(b, sv.data(), sv.size());
+}
+}
+
+} // namespace detail
+
+// Substitui cada "{}" de fmt pelo prximo argumento codificado em args.
+// Usado pela thread de escrita no modo texto e pelo tslog_decode.
+// Retorna false se os argumentos estiverem corrompidos.
+bool render(std::string& out, std::string_view fmt, const char* args, size_t len);
+
 
 class Logger {
 public:
 static Logger& instance();
 
+// Chamadas de log antes de init() so ignoradas
 void init(const std::string& filename, Level level = Level::DEBUG);
+void init(const std::string& filename, Level level, const Options& opts);
 
 void log(Level level, const std::string& msg);
 
+// Registra um texto compartilhado sem copi-lo: o logger guarda a referncia
+// em owner at escrever a linha. prefix deve ter durao esttica.
+void log(Level level, const char* prefix, std::shared_ptr<const void> owner,
+         std::string_view text);
+
+// Entrada tipada: s os argumentos crus so copiados para a fila e a
+// formatao fica para a thread de escrita (modo texto) ou para o
+// tslog_decode (modo binrio). Abaixo do nvel mnimo custa uma comparao.
+template <typename... Args>
+void logf(Level level, const Format& fmt, const Args&... args) {
+    if (!enabled(level)) return;
+    thread_local std::string buf;
+    buf.clear();
+    (detail::encode(buf, args), ...);
+    log_encoded(level, fmt, buf.data(), buf.size());
+}
+
+bool enabled(Level level) const {
+    return static_cast<int>(level) >= min_level_.load(std::memory_order_relaxed);
+}
+
 void debug(const std::string& msg);
 void info(const std::string& msg);
 void warn(const std::string& msg);
@@ -29,6 +150,9 @@ void shutdown();
 
 void set_level(Level level);
 
+// Linhas descartadas por fila cheia (polticas DROP e COUNT)
+uint64_t dropped() const;
+
 private:
 Logger();
 ~Logger();
@@ -36,6 +160,9 @@ Logger();
 Logger(const Logger&) = delete;
 Logger& operator=(const Logger&) = delete;
 
+void log_encoded(Level level, const Format& fmt, const char* args, size_t len);
+
+std::atomic<int> min_level_{static_cast<int>(Level::DEBUG)};
 
 struct Impl;
 std::unique_ptr<Impl> pimpl;
@@ -43,6 +170,129 @@ std::unique_ptr<Impl> pimpl;
 
 std::string level_to_string(Level l);
 
+// "block", "drop" ou "count"
+bool parse_full_policy(const std::string& s, FullPolicy& out);
+
+// "debug", "info", "warn" ou "error" (maisculas ou minsculas)
+bool parse_level(const std::string& s, Level& out);
+
+
+// Nvel mnimo compilado (0 = DEBUG ... 3 = ERROR). As macros TSLOG_*
+// abaixo dele somem do binrio: nem o teste do nvel em tempo de execuo
+// sobra. Definido no build, por exemplo -DTSLOG_MIN_LEVEL=1 sem DEBUG.
+#ifndef TSLOG_MIN_LEVEL
+#define TSLOG_MIN_LEVEL 0
+#endif
+
+constexpr bool compiled_in(Level level) {
+    return static_cast<int>(level) >= TSLOG_MIN_LEVEL;
+}
+
+// Limite de frequncia de uma chamada de log: no mximo uma linha a cada
+// intervalo, contando as que foram suprimidas no meio. Compartilhado entre
+// threads (CAS no instante da prxima linha liberada).
+class RateLimit {
+public:
+explicit RateLimit(uint64_t interval_ms) : interval_ns_(interval_ms * 1000000) {}
+
+// true se a linha pode sair agora; skipped recebe quantas foram suprimidas
+// desde a ltima que saiu
+bool allow(uint64_t& skipped) {
+    uint64_t now = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+    uint64_t next = next_.load(std::memory_order_relaxed);
+    if (now < next || !next_.compare_exchange_strong(next, now + interval_ns_, std::memory_order_relaxed)) {
+        skipped_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    skipped = skipped_.exchange(0, std::memory_order_relaxed);
+    return true;
+}
+
+private:
+const uint64_t interval_ns_;
+std::atomic<uint64_t> next_{0};
+std::atomic<uint64_t> skipped_{0};
+};
+
+}
+
+
+// Front end do logger para o caminho quente. Em relao a logf direto:
+//  - abaixo de TSLOG_MIN_LEVEL a chamada inteira  descartada na compilao;
+//  - abaixo do nvel em tempo de execuo os argumentos nem so avaliados;
+//  - o Format fica registrado num static da prpria chamada.
+// level precisa ser constante (Level::INFO...) e text um literal; os
+// argumentos seguem as regras de logf.
+#define TSLOG(level, text, ...)                                              \
+    do {                                                                     \
+        if constexpr (::tslog::compiled_in(level)) {                         \
+            ::tslog::Logger& tslog_l_ = ::tslog::Logger::instance();         \
+            if (tslog_l_.enabled(level)) {                                   \
+                static const ::tslog::Format tslog_fmt_(text);               \
+                tslog_l_.logf(level, tslog_fmt_, ##__VA_ARGS__);             \
+            }                                                                \
+        }                                                                    \
+    } while (0)
+
+#define TSLOG_DEBUG(text, ...) TSLOG(::tslog::Level::DEBUG, text, ##__VA_ARGS__)
+#define TSLOG_INFO(text, ...)  TSLOG(::tslog::Level::INFO, text, ##__VA_ARGS__)
+#define TSLOG_WARN(text, ...)  TSLOG(::tslog::Level::WARN, text, ##__VA_ARGS__)
+#define TSLOG_ERROR(text, ...) TSLOG(::tslog::Level::ERROR, text, ##__VA_ARGS__)
+
+// No mximo uma linha a cada ms milissegundos por chamada (somando todas as
+// threads); a linha seguinte  supresso diz quantas foram descartadas.
+// Para erros que se repetem por mensagem ou por conexo sob carga.
+#define TSLOG_EVERY_MS(level, ms, text, ...)                                 \
+    do {                                                                     \
+        if constexpr (::tslog::compiled_in(level)) {                         \
+            ::tslog::Logger& tslog_l_ = ::tslog::Logger::instance();         \
+            if (tslog_l_.enabled(level)) {                                   \
+                static ::tslog::RateLimit tslog_rl_(ms);                     \
+                uint64_t tslog_skipped_ = 0;                                 \
+                if (tslog_rl_.allow(tslog_skipped_)) {                       \
+                    if (tslog_skipped_ == 0) {                               \
+                        static const ::tslog::Format tslog_fmt_(text);       \
+                        tslog_l_.logf(level, tslog_fmt_, ##__VA_ARGS__);     \
+                    } else {                                                 \
+                        static const ::tslog::Format tslog_fmt_(             \
+                            text " (+{} suprimida(s))");                     \
+                        tslog_l_.logf(level, tslog_fmt_, ##__VA_ARGS__,      \
+                                      tslog_skipped_);                       \
+                    }                                                        \
+                }                                                            \
+            }                                                                \
+        }                                                                    \
+    } while (0)
+
+// Uma em cada n chamadas, contadas por thread (sem atomic compartilhado):
+// amostra de eventos por mensagem, como rastros de DEBUG.
+#define TSLOG_SAMPLED(level, n, text, ...)                                   \
+    do {                                                                     \
+        if constexpr (::tslog::compiled_in(level)) {                         \
+            ::tslog::Logger& tslog_l_ = ::tslog::Logger::instance();         \
+            static thread_local uint64_t tslog_calls_ = 0;                   \
+            if (tslog_l_.enabled(level) && tslog_calls_++ % (n) == 0) {      \
+                static const ::tslog::Format tslog_fmt_(text);               \
+                tslog_l_.logf(level, tslog_fmt_, ##__VA_ARGS__);             \
+            }                                                                \
+        }                                                                    \
+    } while (0)
+
+
+namespace tslog {
+
+
+// Arquivo binrio: sequncia de registros, cada um comeando por 1 byte de
+// tipo (valores em little-endian, como na memria do x86/ARM):
+//   'S' incio de sesso: "tslogbin", u32 verso; zera os formatos
+//   'F' formato: u32 id, u16 tamanho, texto
+//   'E' entrada: i64 microssegundos desde a poca, u8 nvel,
+//       u8 tamanho + TID, u32 id do formato (0 = texto puro), u32 tamanho
+//       + argumentos codificados (ou o texto)
+constexpr char BINARY_MAGIC[8] = {'t', 's', 'l', 'o', 'g', 'b', 'i', 'n'};
+constexpr uint32_t BINARY_VERSION = 1;
+
 }
 
 #endif
@@ -0,0 +1,93 @@
+#ifndef URING_HPP
+#define URING_HPP
+
+
+#include <cstdint>
+#include <cstddef>
+
+#include <linux/io_uring.h>
+
+
+// Acesso mnimo ao io_uring direto pelas syscalls (sem liburing): anis de
+// submisso e de concluso mapeados na memria e um anel de buffers
+// fornecidos, de onde o kernel tira o destino de cada recv. S a thread do
+// lao de eventos usa o anel. O construtor lana std::runtime_error se o
+// kernel no tiver o necessrio (io_uring desligado ou anterior ao 6.0,
+// que trouxe o recv multishot).
+class IoUring {
+public:
+explicit IoUring(unsigned entries);
+~IoUring();
+
+IoUring(const IoUring&) = delete;
+IoUring& operator=(const IoUring&) = delete;
+
+// Prxima entrada livre do anel de submisso, j zerada; nullptr se o anel
+// estiver cheio (submeta com enter(0) e tente de novo)
+io_uring_sqe* get_sqe();
+
+// Entradas preparadas e ainda no entregues ao kernel
+unsigned pending() const { return sq_tail_ - sq_submitted_; }
+
+// Entrega as entradas preparadas e espera at wait_nr concluses, numa
+// nica io_uring_enter(). Retorna o nmero submetido ou -errno.
+int enter(unsigned wait_nr);
+
+// Consome as concluses disponveis. O cabealho avana antes de chamar f,
+// ento f pode submeter novas entradas.
+template <typename F>
+unsigned drain(F f) {
+    unsigned n = 0;
+    unsigned head = *cq_head_;
+    while (head != __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        io_uring_cqe cqe = cqes_[head & cq_mask_];
+        __atomic_store_n(cq_head_, ++head, __ATOMIC_RELEASE);
+        f(cqe);
+        ++n;
+    }
+    return n;
+}
+
+// Registra o anel de buffers do grupo bgid: count buffers (potncia de 2)
+// de size bytes cada. Retorna false se o kernel recusar.
+bool setup_buffers(uint16_t bgid, unsigned count, unsigned size);
+
+const char* buffer(uint16_t bid) const { return bufs_ + static_cast<size_t>(bid) * buf_size_; }
+
+// Devolve um buffer ao kernel depois que o contedo foi consumido
+void recycle(uint16_t bid);
+
+private:
+int fd_ = -1;
+
+void* sq_ptr_ = nullptr;
+size_t sq_len_ = 0;
+void* cq_ptr_ = nullptr;
+size_t cq_len_ = 0;
+io_uring_sqe* sqes_ = nullptr;
+size_t sqes_len_ = 0;
+
+unsigned* sq_head_ = nullptr;
+unsigned* sq_ktail_ = nullptr;
+unsigned* sq_array_ = nullptr;
+unsigned sq_mask_ = 0;
+unsigned sq_entries_ = 0;
+unsigned sq_tail_ = 0;        // cpia local; publicada em enter()
+unsigned sq_submitted_ = 0;
+
+unsigned* cq_head_ = nullptr;
+unsigned* cq_tail_ = nullptr;
+unsigned cq_mask_ = 0;
+io_uring_cqe* cqes_ = nullptr;
+
+io_uring_buf_ring* br_ = nullptr;
+size_t br_len_ = 0;
+char* bufs_ = nullptr;
+size_t bufs_len_ = 0;
+unsigned buf_size_ = 0;
+unsigned br_mask_ = 0;
+uint16_t br_tail_ = 0;
+};
+
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef WORD_FILTER_HPP
+#define WORD_FILTER_HPP
+
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+
+
+// Filtro de palavras proibidas baseado em Aho-Corasick.
+// A lista  compilada uma vez num autmato determinstico (DFA) sem
+// diferenciar maisculas de minsculas (ASCII); a busca percorre a mensagem
+// uma nica vez, sem alocar memria, qualquer que seja o nmero de palavras.
+class WordFilter {
+public:
+WordFilter() = default;
+explicit WordFilter(const std::vector<std::string>& words, bool simd_prefilter = true);
+
+// Retorna true se alguma palavra aparece em text
+bool matches(std::string_view text) const;
+
+size_t word_count() const { return words_; }
+size_t state_count() const { return out_.size(); }
+bool prefilter_enabled() const { return nfirst_ > 0; }
+
+private:
+size_t skip_to_candidate(const unsigned char* p, size_t i, size_t n) const;
+
+uint8_t cls_[256] = {};          // byte -> classe (0 = no aparece em nenhuma palavra)
+uint32_t nclasses_ = 1;
+std::vector<uint32_t> delta_;    // estado * nclasses_ + classe -> prximo estado
+std::vector<uint8_t> out_;       // 1 se o estado termina alguma palavra
+size_t words_ = 0;
+
+// Bytes que podem iniciar uma palavra (ambas as caixas), para o pr-filtro
+unsigned char first_[16] = {};
+int nfirst_ = 0;
+};
+
+
+#endif
@@ -0,0 +1,51 @@
+#ifndef WORKER_POOL_HPP
+#define WORKER_POOL_HPP
+
+
+#include <functional>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <cstddef>
+
+
+// Threads fixas para trabalho pesado de CPU (verificao de senha) fora
+// dos laos de I/O. A fila  limitada: submit() recusa em vez de acumular,
+// e quem chamou decide o que responder ao cliente.
+class WorkerPool {
+public:
+using Job = std::function<void()>;
+
+WorkerPool(unsigned threads, size_t max_queue);
+~WorkerPool();
+
+WorkerPool(const WorkerPool&) = delete;
+WorkerPool& operator=(const WorkerPool&) = delete;
+
+// false quando a fila est cheia ou o pool j foi parado
+bool submit(Job job);
+
+// Termina os trabalhos j aceitos e encerra as threads
+void stop();
+
+size_t depth() const { return depth_.load(std::memory_order_relaxed); }
+size_t max_queue() const { return max_queue_; }
+unsigned threads() const { return static_cast<unsigned>(threads_.size()); }
+
+private:
+void run();
+
+size_t max_queue_;
+std::mutex mtx_;
+std::condition_variable cv_;
+std::deque<Job> jobs_;
+bool stopping_ = false;
+std::atomic<size_t> depth_{0};
+std::vector<std::thread> threads_;
+};
+
+
+#endif
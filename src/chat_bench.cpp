@@ -0,0 +1,741 @@
+// Gerador de carga do chat: milhares de usurios autenticados num s
+// processo, medindo a latncia de broadcast (envio -> recebimento em cada
+// destinatrio) e a vazo. O resultado sai em JSON para comparar execues.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <chrono>
+#include <climits>
+#include <cstring>
+#include <cerrno>
+#include <cstdio>
+#include <map>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <netdb.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#include "arg_parse.hpp"
+#include "histogram.hpp"
+#include "line_framer.hpp"
+#include "credentials.hpp"
+
+using Clock = std::chrono::steady_clock;
+
+static int64_t now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now().time_since_epoch()).count();
+}
+
+// Limites das opes numricas
+constexpr unsigned long MAX_USERS = 1000000;
+constexpr unsigned long MAX_SIZE = 1024 * 1024;
+constexpr double MAX_SECONDS = 86400;
+
+struct BenchConfig {
+    std::string host = "127.0.0.1";
+    std::string port = "12345";
+    unsigned users = 1000;
+    unsigned rooms = 1;            // usurios distribudos em rodzio entre as salas
+    unsigned senders = 0;          // 0 = 10% dos usurios
+    double rate = 1.0;             // mensagens/s por remetente
+    size_t size = 64;              // bytes por mensagem, sem o \n
+    double duration = 10.0;
+    double drain = 2.0;            // espera pelas entregas depois do ltimo envio
+    double login_timeout = 30.0;
+    unsigned relogins = 0;         // rodadas de /quit + novo login depois do primeiro
+    double private_ratio = 0;      // frao dos envios que vo por /msg para um usurio
+    unsigned threads = 0;          // 0 = nmero de ncleos
+    std::string prefix = "bench";
+    std::string password = "bench";
+    std::string label;
+    std::string output;            // vazio = stdout
+    std::string write_users;       // s gera o arquivo de usurios e sai
+    unsigned iterations = 10000;   // custo do PBKDF2 no arquivo gerado
+    std::string server_metrics;    // host:porta do endpoint de mtricas; vazio = no consulta
+};
+
+BenchConfig config;
+
+enum Phase { LOGIN, RUN, DRAIN, STOP };
+std::atomic<int> phase{LOGIN};
+std::atomic<unsigned> logged_in{0};
+std::atomic<unsigned> login_failed{0};
+std::atomic<unsigned> login_busy{0};      // recusados por fila de verificao cheia
+std::atomic<unsigned> login_round{0};     // 0 = primeiro login; cada rodada reconecta todos
+const addrinfo* server_addr = nullptr;
+std::atomic<int64_t> run_start_ns{0};
+
+// Membros autenticados de cada sala (define quantas entregas cada envio espera)
+std::unique_ptr<std::atomic<uint32_t>[]> room_size;
+
+// Entregas pendentes por mensagem: quem zera o contador  o ltimo
+// destinatrio e registra a latncia de fan-out completo
+std::unique_ptr<std::atomic<uint32_t>[]> remaining;
+uint64_t max_messages = 0;
+std::atomic<uint64_t> next_message{0};
+
+struct Conn {
+    int fd = -1;
+    unsigned id = 0;
+    unsigned room = 0;
+    bool logged = false;
+    bool joining = false;
+    bool sender = false;
+    bool quitting = false;      // mandou /quit e espera o servidor fechar
+    unsigned round = 0;         // rodada de login desta conexo
+    int64_t connect_ns = 0;
+    LineFramer framer{64 * 1024};
+    std::string outbuf;
+};
+
+struct Worker {
+    std::vector<std::unique_ptr<Conn>> conns;
+    std::vector<Conn*> senders;
+    int epfd = -1;
+    std::thread thr;
+    unsigned round = 0;
+
+    Histogram login;     // connect -> boas-vindas, primeiro login
+    Histogram relogin;   // o mesmo nas rodadas seguintes
+    Histogram latency;   // envio -> cada destinatrio
+    Histogram fanout;    // envio -> ltimo destinatrio
+    Histogram private_latency;   // /msg -> destinatrio
+    uint64_t sent = 0;
+    uint64_t private_sent = 0;
+    uint64_t private_received = 0;
+    uint64_t expected = 0;   // entregas esperadas pelos envios desta thread
+    uint64_t received = 0;
+    uint64_t bytes_out = 0;
+    uint64_t bytes_in = 0;
+    uint64_t errors = 0;
+};
+
+static bool set_nonblocking(int fd) {
+    int flags = fcntl(fd, F_GETFL, 0);
+    return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+static void close_conn(Worker& w, Conn& c) {
+    if (c.fd < 0) return;
+    epoll_ctl(w.epfd, EPOLL_CTL_DEL, c.fd, nullptr);
+    close(c.fd);
+    c.fd = -1;
+    ++w.errors;
+}
+
+static void flush(Worker& w, Conn& c) {
+    while (!c.outbuf.empty() && c.fd >= 0) {
+        ssize_t n = send(c.fd, c.outbuf.data(), c.outbuf.size(), MSG_NOSIGNAL);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) close_conn(w, c);
+            return;
+        }
+        w.bytes_out += static_cast<uint64_t>(n);
+        c.outbuf.erase(0, static_cast<size_t>(n));
+    }
+}
+
+static std::string room_name(unsigned room) {
+    return "b" + std::to_string(room);
+}
+
+// Login entregue: entra na contagem da sala e do total
+static void mark_logged(Conn& c) {
+    c.logged = true;
+    room_size[c.room].fetch_add(1);
+    logged_in.fetch_add(1);
+}
+
+static void on_line(Worker& w, Conn& c, std::string_view line) {
+    if (c.quitting) return;
+    if (!c.logged) {
+        // Os prompts no terminam em \n e chegam grudados na resposta.
+        // Com mais de uma sala, o usurio s conta depois do /join.
+        if (c.joining) {
+            if (line.find("Voc entrou na sala") == std::string_view::npos) return;
+            mark_logged(c);
+        } else if (line.find("Bem-vindo") != std::string_view::npos) {
+            uint64_t elapsed = static_cast<uint64_t>(now_ns() - c.connect_ns);
+            (c.round == 0 ? w.login : w.relogin).record(elapsed);
+            if (config.rooms > 1) {
+                c.joining = true;
+                bool was_empty = c.outbuf.empty();
+                c.outbuf += "/join " + room_name(c.room) + "\n";
+                if (was_empty) flush(w, c);
+                return;
+            }
+            mark_logged(c);
+        } else if (line.find("[SISTEMA]") != std::string_view::npos) {
+            if (line.find("ocupado") != std::string_view::npos) login_busy.fetch_add(1);
+            login_failed.fetch_add(1);
+            close_conn(w, c);
+            --w.errors;
+        }
+        return;
+    }
+
+    // "[benchN] #B <mensagem> <envio_ns> xxxx"
+    size_t at = line.find("] #B ");
+    if (at == std::string_view::npos) return;
+    int64_t t = now_ns();
+
+    const char* p = line.data() + at + 5;
+    char* end;
+    uint64_t g = std::strtoull(p, &end, 10);
+    int64_t ts = std::strtoll(end, nullptr, 10);
+    if (ts <= 0 || ts > t) return;
+
+    uint64_t lat = static_cast<uint64_t>(t - ts);
+    ++w.received;
+    if (line.compare(0, 12, "[PRIVADO de ") == 0) {
+        w.private_latency.record(lat);
+        ++w.private_received;
+        return;
+    }
+    w.latency.record(lat);
+    if (g < max_messages && remaining[g].fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        w.fanout.record(lat);
+    }
+}
+
+static bool open_conn(Worker& w, Conn& c);
+
+static void on_readable(Worker& w, Conn& c) {
+    char buf[16384];
+    while (c.fd >= 0) {
+        ssize_t n = recv(c.fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            w.bytes_in += static_cast<uint64_t>(n);
+            c.framer.feed(buf, static_cast<size_t>(n), [&](std::string_view line) {
+                on_line(w, c, line);
+                return c.fd >= 0;
+            });
+            continue;
+        }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+        if (c.quitting) {
+            // O servidor j tirou o usurio do ar: entra de novo
+            epoll_ctl(w.epfd, EPOLL_CTL_DEL, c.fd, nullptr);
+            close(c.fd);
+            c.fd = -1;
+            open_conn(w, c);
+            return;
+        }
+        close_conn(w, c);
+    }
+}
+
+// Nova rodada de login: cada conexo manda /quit e reconecta quando o
+// servidor fechar; as que tinham cado reconectam direto
+static void start_round(Worker& w, unsigned round) {
+    w.round = round;
+    for (auto& cp : w.conns) {
+        Conn& c = *cp;
+        c.round = round;
+        if (c.fd < 0) {
+            open_conn(w, c);
+            continue;
+        }
+        if (c.logged) room_size[c.room].fetch_sub(1);
+        c.logged = false;
+        c.joining = false;
+        c.quitting = true;
+        bool was_empty = c.outbuf.empty();
+        c.outbuf += "/quit\n";
+        if (was_empty) flush(w, c);
+    }
+}
+
+static void send_message(Worker& w, Conn& c, uint64_t g) {
+    // Com --private, parte dos envios vai para um s usurio, espalhado pelo id
+    bool priv = (g % 1000) < static_cast<uint64_t>(config.private_ratio * 1000);
+
+    // O contador de entregas pendentes  armado antes do envio
+    uint32_t members = room_size[c.room].load(std::memory_order_relaxed);
+    uint32_t expected = priv ? 1 : (members > 0 ? members - 1 : 0);
+    remaining[g].store(expected, std::memory_order_relaxed);
+    w.expected += expected;
+
+    char head[64];
+    int n = std::snprintf(head, sizeof(head), "#B %llu %lld ",
+                          static_cast<unsigned long long>(g), static_cast<long long>(now_ns()));
+    bool was_empty = c.outbuf.empty();
+    if (priv) {
+        unsigned to = static_cast<unsigned>((g * 2654435761ULL) % config.users);
+        c.outbuf += "/msg " + config.prefix + std::to_string(to) + " ";
+        ++w.private_sent;
+    }
+    c.outbuf.append(head, static_cast<size_t>(n));
+    if (config.size > static_cast<size_t>(n)) c.outbuf.append(config.size - n, 'x');
+    c.outbuf += '\n';
+    ++w.sent;
+    if (was_empty) flush(w, c);
+}
+
+static void worker_loop(Worker& w) {
+    epoll_event events[256];
+    size_t rr = 0;
+    uint64_t due_sent = 0;
+    const double thread_rate = config.rate * w.senders.size();
+
+    while (phase.load() != STOP) {
+        unsigned round = login_round.load();
+        if (round != w.round) start_round(w, round);
+
+        int n = epoll_wait(w.epfd, events, 256, 1);
+        for (int i = 0; i < n; ++i) {
+            Conn& c = *static_cast<Conn*>(events[i].data.ptr);
+            if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+                close_conn(w, c);
+                continue;
+            }
+            if (events[i].events & EPOLLIN) on_readable(w, c);
+            if (events[i].events & EPOLLOUT) flush(w, c);
+        }
+
+        if (phase.load() != RUN || w.senders.empty()) continue;
+
+        // Envia o que j venceu pelo relgio, em rodzio entre os remetentes
+        double elapsed = (now_ns() - run_start_ns.load()) / 1e9;
+        uint64_t due = static_cast<uint64_t>(elapsed * thread_rate);
+        for (int burst = 0; due_sent < due && burst < 1024; ++burst, ++due_sent) {
+            Conn* c = w.senders[rr++ % w.senders.size()];
+            if (c->fd < 0 || !c->logged) continue;
+            uint64_t g = next_message.fetch_add(1);
+            if (g >= max_messages) break;
+            send_message(w, *c, g);
+        }
+    }
+}
+
+static bool open_conn(Worker& w, Conn& c) {
+    const addrinfo* ai = server_addr;
+    c.quitting = false;
+    c.logged = false;
+    c.joining = false;
+    c.framer = LineFramer{64 * 1024};
+    c.outbuf.clear();
+    c.connect_ns = now_ns();
+    c.fd = socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC, ai->ai_protocol);
+    if (c.fd < 0 || connect(c.fd, ai->ai_addr, ai->ai_addrlen) < 0) {
+        std::cerr << "Falha ao conectar usurio " << c.id << ": " << strerror(errno) << std::endl;
+        if (c.fd >= 0) close(c.fd);
+        c.fd = -1;
+        ++w.errors;
+        return false;
+    }
+    int one = 1;
+    setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    set_nonblocking(c.fd);
+
+    epoll_event ev{};
+    ev.events = EPOLLIN | EPOLLOUT | EPOLLET;
+    ev.data.ptr = &c;
+    epoll_ctl(w.epfd, EPOLL_CTL_ADD, c.fd, &ev);
+
+    // Login em pipeline: usurio e senha no mesmo segmento
+    c.outbuf = config.prefix + std::to_string(c.id) + "\n" + config.password + "\n";
+    flush(w, c);
+    return true;
+}
+
+static bool connect_all(Worker& w) {
+    w.epfd = epoll_create1(EPOLL_CLOEXEC);
+    if (w.epfd < 0) return false;
+    for (auto& cp : w.conns) open_conn(w, *cp);
+    return true;
+}
+
+static void raise_fd_limit() {
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
+    }
+}
+
+static void usage(const char* prog) {
+    std::cerr << "Uso: " << prog << " [host] [porta] [--users N] [--rooms N] [--senders N] [--rate MSG/S]\n"
+              << "       [--size BYTES] [--duration S] [--drain S] [--threads N]\n"
+              << "       [--prefix NOME] [--password SENHA] [--relogins N] [--label TEXTO] [--output ARQUIVO]\n"
+              << "       [--private FRAO]\n"
+              << "       [--server-metrics [HOST:]PORTA]\n"
+              << "       " << prog << " --write-users ARQUIVO [--users N] [--prefix NOME] [--password SENHA]\n"
+              << "       [--iterations N]\n";
+}
+
+static bool parse_args(int argc, char** argv, BenchConfig& cfg) {
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has = i + 1 < argc;
+        if (arg == "--users" && has) {
+            if (!parse_count(argv[++i], 1, MAX_USERS, cfg.users)) return false;
+        }
+        else if (arg == "--rooms" && has) {
+            if (!parse_count(argv[++i], 1, MAX_USERS, cfg.rooms)) return false;
+        }
+        else if (arg == "--senders" && has) {
+            if (!parse_count(argv[++i], 0, MAX_USERS, cfg.senders)) return false;
+        }
+        else if (arg == "--rate" && has) {
+            if (!parse_real(argv[++i], 0, 1e6, cfg.rate) || cfg.rate == 0) return false;
+        }
+        else if (arg == "--size" && has) {
+            if (!parse_count(argv[++i], 0, MAX_SIZE, cfg.size)) return false;
+        }
+        else if (arg == "--duration" && has) {
+            if (!parse_real(argv[++i], 0, MAX_SECONDS, cfg.duration) || cfg.duration == 0) return false;
+        }
+        else if (arg == "--drain" && has) {
+            if (!parse_real(argv[++i], 0, MAX_SECONDS, cfg.drain)) return false;
+        }
+        else if (arg == "--threads" && has) {
+            if (!parse_count(argv[++i], 0, 1024, cfg.threads)) return false;
+        }
+        else if (arg == "--prefix" && has) cfg.prefix = argv[++i];
+        else if (arg == "--password" && has) cfg.password = argv[++i];
+        else if (arg == "--label" && has) cfg.label = argv[++i];
+        else if (arg == "--output" && has) cfg.output = argv[++i];
+        else if (arg == "--write-users" && has) cfg.write_users = argv[++i];
+        else if (arg == "--iterations" && has) {
+            if (!parse_count(argv[++i], 1, UINT_MAX, cfg.iterations)) return false;
+        }
+        else if (arg == "--relogins" && has) {
+            if (!parse_count(argv[++i], 0, MAX_USERS, cfg.relogins)) return false;
+        }
+        else if (arg == "--private" && has) {
+            if (!parse_real(argv[++i], 0, 1, cfg.private_ratio)) return false;
+        }
+        else if (arg == "--server-metrics" && has) cfg.server_metrics = argv[++i];
+        else if (!arg.empty() && arg[0] != '-' && positional == 0) { cfg.host = arg; ++positional; }
+        else if (!arg.empty() && arg[0] != '-' && positional == 1) { cfg.port = arg; ++positional; }
+        else return false;
+    }
+    if (cfg.rooms > cfg.users) cfg.rooms = cfg.users;
+    if (cfg.senders == 0) cfg.senders = std::max(1u, cfg.users / 10);
+    if (cfg.senders > cfg.users) cfg.senders = cfg.users;
+    if (cfg.threads == 0) cfg.threads = std::max(1u, std::thread::hardware_concurrency());
+    if (cfg.threads > cfg.users) cfg.threads = cfg.users;
+    return true;
+}
+
+static std::string json_string(const std::string& s) {
+    std::string out = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Taxa por segundo; uma fase que durou ~0 s d 0, no inf/nan (invlidos em JSON)
+static double per_sec(double n, double secs) {
+    return secs > 0 ? n / secs : 0.0;
+}
+
+static void json_histogram(std::ostream& os, const char* name, const Histogram& h) {
+    auto us = [](uint64_t ns) { return ns / 1000.0; };
+    os << "  \"" << name << "\": {\"count\": " << h.count()
+       << ", \"mean_us\": " << us(static_cast<uint64_t>(h.mean()))
+       << ", \"p50_us\": " << us(h.percentile(0.50))
+       << ", \"p90_us\": " << us(h.percentile(0.90))
+       << ", \"p99_us\": " << us(h.percentile(0.99))
+       << ", \"p999_us\": " << us(h.percentile(0.999))
+       << ", \"max_us\": " << us(h.max()) << "}";
+}
+
+// Contadores de syscalls de I/O do servidor, lidos do endpoint Prometheus
+struct ServerSyscalls {
+    std::string backend;
+    std::map<std::string, uint64_t> calls;
+};
+
+static bool scrape_server(const std::string& target, ServerSyscalls& out) {
+    std::string host = "127.0.0.1", port = target;
+    size_t colon = target.rfind(':');
+    if (colon != std::string::npos) {
+        host = target.substr(0, colon);
+        port = target.substr(colon + 1);
+    }
+    addrinfo hints{}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0 || !res) return false;
+    int fd = socket(res->ai_family, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    bool ok = fd >= 0 && connect(fd, res->ai_addr, res->ai_addrlen) == 0;
+    freeaddrinfo(res);
+    std::string body;
+    if (ok) {
+        const char req[] = "GET /metrics HTTP/1.0\r\n\r\n";
+        ok = send(fd, req, sizeof(req) - 1, MSG_NOSIGNAL) == static_cast<ssize_t>(sizeof(req) - 1);
+        char buf[16384];
+        for (ssize_t n; ok && (n = recv(fd, buf, sizeof(buf), 0)) > 0;) body.append(buf, n);
+    }
+    if (fd >= 0) close(fd);
+    if (!ok) return false;
+
+    // Linhas chat_syscalls_total{call="recv"} 123 e chat_io_backend{backend="uring"} 1
+    std::istringstream in(body);
+    std::string line;
+    auto label = [](const std::string& l) {
+        size_t a = l.find('"'), b = l.find('"', a + 1);
+        return (a == std::string::npos || b == std::string::npos) ? std::string() : l.substr(a + 1, b - a - 1);
+    };
+    while (std::getline(in, line)) {
+        size_t sp = line.rfind(' ');
+        if (sp == std::string::npos) continue;
+        if (line.compare(0, 20, "chat_syscalls_total{") == 0) {
+            out.calls[label(line)] = std::stoull(line.substr(sp + 1));
+        } else if (line.compare(0, 16, "chat_io_backend{") == 0 && line.substr(sp + 1) == "1") {
+            out.backend = label(line);
+        }
+    }
+    return !out.calls.empty();
+}
+
+static int write_users_file(const BenchConfig& cfg) {
+    std::ofstream out(cfg.write_users);
+    if (!out) {
+        std::cerr << "No foi possvel criar " << cfg.write_users << std::endl;
+        return 1;
+    }
+    // O PBKDF2 de cada linha  caro: divide entre as threads
+    std::vector<std::string> lines(cfg.users);
+    std::vector<std::thread> threads;
+    std::atomic<unsigned> next{0};
+    for (unsigned t = 0; t < std::max(1u, std::thread::hardware_concurrency()); ++t) {
+        threads.emplace_back([&] {
+            for (unsigned i; (i = next.fetch_add(1)) < cfg.users;) {
+                lines[i] = cfg.prefix + std::to_string(i) + ':' +
+                           CredentialStore::hash_password(cfg.password, cfg.iterations);
+            }
+        });
+    }
+    for (auto& t : threads) t.join();
+    for (const auto& l : lines) out << l << '\n';
+    std::cerr << cfg.users << " usurio(s) gravados em " << cfg.write_users << " ("
+              << cfg.iterations << " iteraes)" << std::endl;
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    BenchConfig& cfg = config;
+    if (!parse_args(argc, argv, cfg)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (!cfg.write_users.empty()) return write_users_file(cfg);
+
+    raise_fd_limit();
+
+    addrinfo hints{}, *res = nullptr;
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(cfg.host.c_str(), cfg.port.c_str(), &hints, &res) != 0 || !res) {
+        std::cerr << "getaddrinfo() falhou para " << cfg.host << ":" << cfg.port << std::endl;
+        return 1;
+    }
+
+    // Usurios e remetentes distribudos em rodzio entre as threads
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (unsigned t = 0; t < cfg.threads; ++t) workers.push_back(std::make_unique<Worker>());
+    for (unsigned i = 0; i < cfg.users; ++i) {
+        Worker& w = *workers[i % cfg.threads];
+        auto c = std::make_unique<Conn>();
+        c->id = i;
+        c->room = i % cfg.rooms;
+        c->sender = i < cfg.senders;
+        if (c->sender) w.senders.push_back(c.get());
+        w.conns.push_back(std::move(c));
+    }
+
+    // Capacidade de mensagens: a taxa pedida durante a durao, com folga
+    max_messages = static_cast<uint64_t>(cfg.senders * cfg.rate * cfg.duration * 1.05) + cfg.senders;
+    remaining.reset(new std::atomic<uint32_t>[max_messages]);
+    room_size.reset(new std::atomic<uint32_t>[cfg.rooms]);
+    for (unsigned r = 0; r < cfg.rooms; ++r) room_size[r].store(0);
+
+    server_addr = res;
+    auto t_connect = Clock::now();
+    for (auto& w : workers) {
+        Worker* wp = w.get();
+        if (!connect_all(*wp)) {
+            std::cerr << "epoll_create1() falhou" << std::endl;
+            return 1;
+        }
+        wp->thr = std::thread(worker_loop, std::ref(*wp));
+    }
+
+    // Espera todos os logins (ou o prazo)
+    auto wait_logins = [&](Clock::time_point since) {
+        while (logged_in.load() + login_failed.load() < cfg.users &&
+               std::chrono::duration<double>(Clock::now() - since).count() < cfg.login_timeout) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        }
+        return std::chrono::duration<double>(Clock::now() - since).count();
+    };
+    double login_s = wait_logins(t_connect);
+    unsigned online = logged_in.load();
+    unsigned failed = login_failed.load(), busy = login_busy.load();
+    std::cerr << online << "/" << cfg.users << " usurio(s) autenticados em " << login_s << " s" << std::endl;
+
+    // Tempestade de reconexes: todos saem e entram de novo a cada rodada
+    double relogin_s = 0;
+    unsigned relogged = 0;
+    for (unsigned r = 1; r <= cfg.relogins && online > 0; ++r) {
+        logged_in.store(0);
+        login_failed.store(0);
+        auto t_round = Clock::now();
+        login_round.store(r);
+        relogin_s += wait_logins(t_round);
+        relogged += logged_in.load();
+        failed += login_failed.load();
+        online = logged_in.load();
+    }
+    busy = login_busy.load();
+    if (cfg.relogins > 0) {
+        std::cerr << relogged << " relogin(s) em " << cfg.relogins << " rodada(s), " << relogin_s << " s" << std::endl;
+    }
+    if (online < 2) {
+        std::cerr << "Usurios insuficientes para medir broadcast (use --users do servidor)" << std::endl;
+        phase.store(STOP);
+        for (auto& w : workers) w->thr.join();
+        return 1;
+    }
+
+    // Syscalls do servidor s durante a carga (e a drenagem), sem os logins
+    ServerSyscalls sys_before, sys_after;
+    bool scraped = !cfg.server_metrics.empty() && scrape_server(cfg.server_metrics, sys_before);
+    if (!cfg.server_metrics.empty() && !scraped) {
+        std::cerr << "No foi possvel ler as mtricas do servidor em " << cfg.server_metrics << std::endl;
+    }
+
+    run_start_ns.store(now_ns());
+    phase.store(RUN);
+    std::this_thread::sleep_for(std::chrono::duration<double>(cfg.duration));
+    phase.store(DRAIN);
+    double run_s = (now_ns() - run_start_ns.load()) / 1e9;
+    std::this_thread::sleep_for(std::chrono::duration<double>(cfg.drain));
+    phase.store(STOP);
+    for (auto& w : workers) w->thr.join();
+    scraped = scraped && scrape_server(cfg.server_metrics, sys_after);
+
+    Histogram login, relogin, latency, fanout, private_latency;
+    uint64_t private_sent = 0, private_received = 0;
+    uint64_t sent = 0, expected_deliveries = 0, received = 0, bytes_out = 0, bytes_in = 0, errors = 0;
+    for (auto& w : workers) {
+        login.merge(w->login);
+        relogin.merge(w->relogin);
+        latency.merge(w->latency);
+        fanout.merge(w->fanout);
+        private_latency.merge(w->private_latency);
+        private_sent += w->private_sent;
+        private_received += w->private_received;
+        sent += w->sent;
+        expected_deliveries += w->expected;
+        received += w->received;
+        bytes_out += w->bytes_out;
+        bytes_in += w->bytes_in;
+        errors += w->errors;
+        for (auto& c : w->conns) {
+            if (c->fd >= 0) close(c->fd);
+        }
+        close(w->epfd);
+    }
+    freeaddrinfo(res);
+
+    std::ostringstream os;
+    os << "{\n"
+       << "  \"label\": " << json_string(cfg.label) << ",\n"
+       << "  \"config\": {\"host\": " << json_string(cfg.host) << ", \"port\": " << json_string(cfg.port)
+       << ", \"users\": " << cfg.users << ", \"rooms\": " << cfg.rooms << ", \"senders\": " << cfg.senders
+       << ", \"rate_per_sender\": " << cfg.rate << ", \"size\": " << cfg.size
+       << ", \"duration_s\": " << cfg.duration << ", \"threads\": " << cfg.threads
+       << ", \"relogins\": " << cfg.relogins << ", \"private_ratio\": " << cfg.private_ratio << "},\n"
+       << "  \"online\": " << online << ",\n"
+       << "  \"login_failed\": " << failed << ",\n"
+       << "  \"login_busy\": " << busy << ",\n"
+       << "  \"login_s\": " << login_s << ",\n"
+       << "  \"logins_per_sec\": " << per_sec(login.count(), login_s) << ",\n"
+       << "  \"relogin_rounds\": " << cfg.relogins << ",\n"
+       << "  \"relogins\": " << relogged << ",\n"
+       << "  \"relogins_per_sec\": " << per_sec(relogged, relogin_s) << ",\n"
+       << "  \"errors\": " << errors << ",\n"
+       << "  \"sent\": " << sent << ",\n"
+       << "  \"delivered\": " << received << ",\n"
+       << "  \"expected_deliveries\": " << expected_deliveries << ",\n"
+       << "  \"delivery_ratio\": " << (expected_deliveries ? double(received) / expected_deliveries : 0.0) << ",\n"
+       << "  \"fanout_complete\": " << fanout.count() << ",\n"
+       << "  \"msgs_per_sec\": " << per_sec(sent, run_s) << ",\n"
+       << "  \"private_sent\": " << private_sent << ",\n"
+       << "  \"private_delivered\": " << private_received << ",\n"
+       << "  \"deliveries_per_sec\": " << per_sec(received, run_s + cfg.drain) << ",\n"
+       << "  \"bytes_out\": " << bytes_out << ",\n"
+       << "  \"bytes_in\": " << bytes_in << ",\n";
+    uint64_t syscalls = 0;
+    if (scraped) {
+        os << "  \"server_syscalls\": {\"backend\": " << json_string(sys_after.backend) << ", \"calls\": {";
+        bool first = true;
+        for (const auto& kv : sys_after.calls) {
+            uint64_t d = kv.second - sys_before.calls[kv.first];
+            syscalls += d;
+            os << (first ? "" : ", ") << json_string(kv.first) << ": " << d;
+            first = false;
+        }
+        os << "}, \"total\": " << syscalls
+           << ", \"per_delivery\": " << (received ? double(syscalls) / received : 0.0) << "},\n";
+    }
+    json_histogram(os, "login_latency", login);
+    os << ",\n";
+    json_histogram(os, "relogin_latency", relogin);
+    os << ",\n";
+    json_histogram(os, "latency", latency);
+    os << ",\n";
+    json_histogram(os, "fanout_latency", fanout);
+    os << ",\n";
+    json_histogram(os, "private_latency", private_latency);
+    os << "\n}\n";
+
+    if (cfg.output.empty()) {
+        std::cout << os.str();
+    } else {
+        std::ofstream out(cfg.output);
+        out << os.str();
+    }
+
+    std::cerr << "login p50 " << login.percentile(0.5) / 1000.0 << " us, p99 " << login.percentile(0.99) / 1000.0
+              << " us (" << per_sec(login.count(), login_s) << " logins/s)";
+    if (relogin.count()) {
+        std::cerr << "; relogin p50 " << relogin.percentile(0.5) / 1000.0 << " us, p99 "
+                  << relogin.percentile(0.99) / 1000.0 << " us";
+    }
+    std::cerr << std::endl;
+    std::cerr << "enviadas " << sent << " (" << per_sec(sent, run_s) << " msg/s), entregues " << received
+              << " de " << expected_deliveries << "; latncia p50 " << latency.percentile(0.5) / 1000.0
+              << " us, p99 " << latency.percentile(0.99) / 1000.0 << " us, p999 "
+              << latency.percentile(0.999) / 1000.0 << " us" << std::endl;
+    if (private_sent) {
+        std::cerr << "privadas " << private_sent << ", entregues " << private_received << "; latncia p50 "
+                  << private_latency.percentile(0.5) / 1000.0 << " us, p99 "
+                  << private_latency.percentile(0.99) / 1000.0 << " us" << std::endl;
+    }
+    if (scraped) {
+        std::cerr << "servidor (" << sys_after.backend << "): " << syscalls << " syscall(s) de I/O, "
+                  << (received ? double(syscalls) / received : 0.0) << " por mensagem entregue" << std::endl;
+    }
+    return 0;
+}
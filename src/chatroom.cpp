@@ -0,0 +1,136 @@
+#include "chatroom.hpp"
+
+#include <algorithm>
+#include <functional>
+
+
+ChatRoom::ChatRoom(std::string name, unsigned shards, size_t history_capacity)
+    : name_(std::move(name)), by_shard_(shards ? shards : 1), published_(shards ? shards : 1),
+      history_(history_capacity) {}
+
+bool ChatRoom::join(const RoomMember& member, unsigned shard) {
+    std::lock_guard<std::mutex> lg(mtx_);
+    auto& sm = by_shard_[shard];
+    if (!sm.pos.emplace(member.get(), sm.members.size()).second) return false;
+    sm.members.push_back(member);
+    sm.dirty = true;
+    ++size_;
+    return true;
+}
+
+bool ChatRoom::leave(const ClientInfo* member, unsigned shard) {
+    std::lock_guard<std::mutex> lg(mtx_);
+    auto& sm = by_shard_[shard];
+    auto it = sm.pos.find(member);
+    if (it == sm.pos.end()) return false;
+
+    // O ltimo ocupa o lugar de quem saiu
+    size_t i = it->second;
+    sm.pos.erase(it);
+    if (i + 1 != sm.members.size()) {
+        sm.members[i] = std::move(sm.members.back());
+        sm.pos[sm.members[i].get()] = i;
+    }
+    sm.members.pop_back();
+    sm.dirty = true;
+    --size_;
+    return true;
+}
+
+void ChatRoom::publish() const {
+    for (size_t i = 0; i < by_shard_.size(); ++i) {
+        auto& sm = by_shard_[i];
+        if (!sm.dirty) continue;
+        published_[i] = sm.members.empty() ? nullptr : std::make_shared<const MemberList>(sm.members);
+        sm.dirty = false;
+    }
+}
+
+size_t ChatRoom::size() const {
+    std::lock_guard<std::mutex> lg(mtx_);
+    return size_;
+}
+
+ChatRoom::Snapshot ChatRoom::snapshot() const {
+    std::lock_guard<std::mutex> lg(mtx_);
+    publish();
+    return published_;
+}
+
+void ChatRoom::snapshot(Snapshot& out) const {
+    std::lock_guard<std::mutex> lg(mtx_);
+    publish();
+    out.assign(published_.begin(), published_.end());
+}
+
+
+RoomRegistry::RoomRegistry(std::string default_room, unsigned shards, size_t default_history,
+                           size_t room_history)
+    : shards_(shards ? shards : 1), room_history_(room_history),
+      stripes_(new Stripe[STRIPES]) {
+    default_ = std::make_shared<ChatRoom>(default_room, shards_, default_history);
+    stripe_of(default_room).rooms[default_room] = default_;
+}
+
+RoomRegistry::Stripe& RoomRegistry::stripe_of(const std::string& name) const {
+    return stripes_[std::hash<std::string>{}(name) % STRIPES];
+}
+
+// Entrada e sada acontecem sob o lock da faixa: assim uma sala que acabou
+// de esvaziar no  removida enquanto outro usurio est entrando nela
+std::shared_ptr<ChatRoom> RoomRegistry::join(const std::string& name, const RoomMember& member,
+                                             unsigned shard) {
+    Stripe& s = stripe_of(name);
+    std::lock_guard<std::mutex> lg(s.mtx);
+    auto& room = s.rooms[name];
+    if (!room) room = std::make_shared<ChatRoom>(name, shards_, room_history_);
+    room->join(member, shard);
+    return room;
+}
+
+std::shared_ptr<ChatRoom> RoomRegistry::find(const std::string& name) const {
+    Stripe& s = stripe_of(name);
+    std::lock_guard<std::mutex> lg(s.mtx);
+    auto it = s.rooms.find(name);
+    return it != s.rooms.end() ? it->second : nullptr;
+}
+
+void RoomRegistry::leave(const std::shared_ptr<ChatRoom>& room, const ClientInfo* member,
+                         unsigned shard) {
+    Stripe& s = stripe_of(room->name());
+    std::lock_guard<std::mutex> lg(s.mtx);
+    room->leave(member, shard);
+    if (room != default_ && room->size() == 0) {
+        auto it = s.rooms.find(room->name());
+        if (it != s.rooms.end() && it->second == room) s.rooms.erase(it);
+    }
+}
+
+std::vector<std::pair<std::string, size_t>> RoomRegistry::list() const {
+    std::vector<std::pair<std::string, size_t>> out;
+    for (size_t i = 0; i < STRIPES; ++i) {
+        std::lock_guard<std::mutex> lg(stripes_[i].mtx);
+        for (const auto& pair : stripes_[i].rooms) out.emplace_back(pair.first, pair.second->size());
+    }
+    std::sort(out.begin(), out.end(), [](const auto& a, const auto& b) {
+        return a.second != b.second ? a.second > b.second : a.first < b.first;
+    });
+    return out;
+}
+
+size_t RoomRegistry::count() const {
+    size_t n = 0;
+    for (size_t i = 0; i < STRIPES; ++i) {
+        std::lock_guard<std::mutex> lg(stripes_[i].mtx);
+        n += stripes_[i].rooms.size();
+    }
+    return n;
+}
+
+bool RoomRegistry::valid_name(const std::string& name) {
+    if (name.empty() || name.size() > 32) return false;
+    return std::all_of(name.begin(), name.end(), [](char c) {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') ||
+               c == '-' || c == '_';
+    });
+}
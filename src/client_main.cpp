@@ -2,20 +2,47 @@
 #include <string>
 #include <thread>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <string_view>
+#include <chrono>
 #include <cstring>
+#include <cstdio>
+#include <cstdlib>
+#include <cerrno>
 #include <termios.h>
 
 #include <sys/types.h>
 #include <sys/socket.h>
 #include <netdb.h>
+#include <poll.h>
+#include <fcntl.h>
 #include <unistd.h>
 
 #include "tslog.hpp"
+#include "line_framer.hpp"
+#include "arg_parse.hpp"
 
 using namespace tslog;
 
 std::atomic<bool> running{true};
 
+constexpr unsigned long MAX_BATCH = 64 * 1024 * 1024;  // --batch, em bytes
+constexpr double MAX_WAIT_SECONDS = 3600;              // --wait
+
+struct ClientConfig {
+    std::string host = "127.0.0.1";
+    std::string port = "12345";
+    bool headless = false;
+    std::string user;            // --user ou CHAT_USER
+    std::string password;        // --password ou CHAT_PASSWORD
+    std::string input = "-";     // linhas a enviar; "-" = stdin
+    std::string output = "-";    // trfego recebido; "-" = stdout
+    size_t batch = 64 * 1024;    // bytes lidos da entrada e enviados de uma vez
+    double wait = 5.0;           // espera pelo fechamento do servidor no fim
+};
+
 // Funo para ler senha sem exibir caracteres
 std::string read_password() {
     std::string password;
@@ -58,13 +85,48 @@ void reader_thread_fn(int sockfd) {
     }
 }
 
-int main(int argc, char** argv) {
-    std::string host = (argc > 1) ? argv[1] : "127.0.0.1";
-    std::string port = (argc > 2) ? argv[2] : "12345";
+void usage(const char* prog) {
+    std::cerr << "Uso: " << prog << " [host] [porta]\n"
+              << "       " << prog << " [host] [porta] --headless [--user NOME] [--password SENHA]\n"
+              << "       [--input ARQUIVO] [--output ARQUIVO] [--batch BYTES] [--wait S]\n"
+              << "Sem --user/--password o modo headless usa CHAT_USER e CHAT_PASSWORD.\n";
+}
 
-    Logger::instance().init("client.log", Level::INFO);
-    Logger::instance().info("Cliente iniciando: " + host + ":" + port);
+bool parse_args(int argc, char** argv, ClientConfig& cfg) {
+    int positional = 0;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool has = i + 1 < argc;
+        if (arg == "--headless") cfg.headless = true;
+        else if (arg == "--user" && has) cfg.user = argv[++i];
+        else if (arg == "--password" && has) cfg.password = argv[++i];
+        else if (arg == "--input" && has) cfg.input = argv[++i];
+        else if (arg == "--output" && has) cfg.output = argv[++i];
+        else if (arg == "--batch" && has) {
+            if (!parse_count(argv[++i], 1, MAX_BATCH, cfg.batch)) return false;
+        }
+        else if (arg == "--wait" && has) {
+            if (!parse_real(argv[++i], 0, MAX_WAIT_SECONDS, cfg.wait)) return false;
+        }
+        else if (!arg.empty() && arg[0] != '-' && positional == 0) { cfg.host = arg; ++positional; }
+        else if (!arg.empty() && arg[0] != '-' && positional == 1) { cfg.port = arg; ++positional; }
+        else return false;
+    }
+    if (cfg.headless) {
+        if (cfg.user.empty()) {
+            const char* u = std::getenv("CHAT_USER");
+            if (u) cfg.user = u;
+        }
+        if (cfg.password.empty()) {
+            const char* pw = std::getenv("CHAT_PASSWORD");
+            if (pw) cfg.password = pw;
+        }
+        if (cfg.user.empty() || cfg.password.empty()) return false;
+    }
+    return true;
+}
 
+int connect_to(const std::string& host, const std::string& port) {
     struct addrinfo hints{}, *res = nullptr;
     hints.ai_family = AF_UNSPEC;
     hints.ai_socktype = SOCK_STREAM;
@@ -72,7 +134,7 @@ int main(int argc, char** argv) {
     if (getaddrinfo(host.c_str(), port.c_str(), &hints, &res) != 0) {
         std::cerr << "Erro: no foi possvel resolver o endereo.\n";
         Logger::instance().error("getaddrinfo() falhou");
-        return 1;
+        return -1;
     }
 
     int sockfd = -1;
@@ -89,8 +151,248 @@ int main(int argc, char** argv) {
     if (sockfd < 0) {
         std::cerr << "Erro: no foi possvel conectar ao servidor.\n";
         Logger::instance().error("Falha ao conectar");
+    }
+    return sockfd;
+}
+
+// ---- Modo headless (bots e testes de integrao) ----
+//
+// Sem TTY: credenciais vm de --user/--password ou do ambiente, o login vai
+// inteiro num send() s e as linhas da entrada so lidas e enviadas em
+// blocos de cfg.batch bytes, sem esperar resposta entre uma e outra. O que
+// chega do servidor vai para um FILE* com buffer grande, descarregado
+// quando o socket fica sem dados. No fim, contagens e taxas vo para stderr.
+
+struct Traffic {
+    uint64_t lines = 0;
+    uint64_t bytes = 0;
+};
+
+enum class AuthState { PENDING, OK, FAILED };
+
+struct HeadlessState {
+    std::mutex mtx;
+    std::condition_variable cv;
+    AuthState auth = AuthState::PENDING;
+    std::string auth_reply;                  // linha que decidiu o login
+    std::atomic<bool> input_done{false};
+    Traffic received;
+};
+
+bool send_all(int sockfd, const char* data, size_t n) {
+    while (n > 0) {
+        ssize_t w = send(sockfd, data, n, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+void set_auth(HeadlessState& st, AuthState a, std::string_view reply) {
+    std::lock_guard<std::mutex> lg(st.mtx);
+    if (st.auth != AuthState::PENDING) return;
+    st.auth = a;
+    size_t tag = reply.find("[SISTEMA]");
+    if (tag != std::string_view::npos) reply.remove_prefix(tag);  // sem os prompts
+    st.auth_reply.assign(reply.data(), reply.size());
+    st.cv.notify_all();
+}
+
+// L at o servidor fechar ou, com a entrada j esgotada, at passar
+// cfg.wait segundos sem chegar nada
+void headless_reader(int sockfd, const ClientConfig& cfg, FILE* out, HeadlessState& st) {
+    std::vector<char> buf(64 * 1024);
+    LineFramer framer(64 * 1024);
+    auto last_rx = std::chrono::steady_clock::now();
+
+    for (;;) {
+        struct pollfd pfd{sockfd, POLLIN, 0};
+        int pr = poll(&pfd, 1, 100);
+        if (pr < 0 && errno != EINTR) break;
+        if (pr <= 0) {
+            if (st.input_done.load()) {
+                std::chrono::duration<double> idle = std::chrono::steady_clock::now() - last_rx;
+                if (idle.count() >= cfg.wait) break;
+            }
+            continue;
+        }
+
+        ssize_t n = recv(sockfd, buf.data(), buf.size(), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) {
+            if (n < 0) Logger::instance().error("Erro ao receber dados");
+            break;
+        }
+        last_rx = std::chrono::steady_clock::now();
+
+        fwrite(buf.data(), 1, static_cast<size_t>(n), out);
+        st.received.bytes += static_cast<uint64_t>(n);
+        for (const char* p = buf.data(), *end = p + n;
+             (p = static_cast<const char*>(std::memchr(p, '\n', end - p))) != nullptr; ++p) {
+            ++st.received.lines;
+        }
+        if (static_cast<size_t>(n) < buf.size()) fflush(out);
+
+        // Os prompts no terminam em '\n': a resposta do login chega na
+        // mesma linha que eles
+        if (st.auth == AuthState::PENDING) {
+            framer.feed(buf.data(), static_cast<size_t>(n), [&](std::string_view line) {
+                if (line.find("Bem-vindo") != std::string_view::npos) {
+                    set_auth(st, AuthState::OK, line);
+                } else if (line.find("falhou") != std::string_view::npos ||
+                           line.find("j est online") != std::string_view::npos ||
+                           line.find("ocupado") != std::string_view::npos) {
+                    set_auth(st, AuthState::FAILED, line);
+                }
+                return st.auth == AuthState::PENDING;
+            });
+        }
+    }
+    fflush(out);
+    set_auth(st, AuthState::FAILED, "[SISTEMA] Conexo fechada durante o login.");
+}
+
+void report(const char* what, const Traffic& t, double secs) {
+    double s = secs > 0 ? secs : 1e-9;
+    std::fprintf(stderr, "%s: %llu linha(s), %llu bytes em %.3f s (%.0f linhas/s, %.2f MB/s)\n", what,
+                 static_cast<unsigned long long>(t.lines), static_cast<unsigned long long>(t.bytes), secs,
+                 t.lines / s, t.bytes / s / 1e6);
+}
+
+int run_headless(int sockfd, const ClientConfig& cfg) {
+    int in_fd = STDIN_FILENO;
+    if (cfg.input != "-") {
+        in_fd = open(cfg.input.c_str(), O_RDONLY | O_CLOEXEC);
+        if (in_fd < 0) {
+            std::cerr << "Erro: no foi possvel abrir " << cfg.input << ": " << std::strerror(errno) << "\n";
+            return 1;
+        }
+    }
+    FILE* out = stdout;
+    if (cfg.output != "-") {
+        out = std::fopen(cfg.output.c_str(), "w");
+        if (!out) {
+            std::cerr << "Erro: no foi possvel abrir " << cfg.output << ": " << std::strerror(errno) << "\n";
+            if (in_fd != STDIN_FILENO) close(in_fd);
+            return 1;
+        }
+    }
+    setvbuf(out, nullptr, _IOFBF, 1 << 20);
+
+    HeadlessState st;
+    std::thread reader(headless_reader, sockfd, std::cref(cfg), out, std::ref(st));
+
+    // Usurio e senha de uma vez: o servidor responde aos dois prompts em ordem
+    std::string login = cfg.user + "\n" + cfg.password + "\n";
+    send_all(sockfd, login.data(), login.size());
+
+    // O servidor s guarda umas poucas linhas enquanto verifica a senha;
+    // o fluxo comea depois da confirmao
+    AuthState auth;
+    std::string auth_reply;
+    {
+        std::unique_lock<std::mutex> lk(st.mtx);
+        st.cv.wait(lk, [&] { return st.auth != AuthState::PENDING; });
+        auth = st.auth;
+        auth_reply = st.auth_reply;
+    }
+
+    int rc = 0;
+    Traffic sent;
+    auto t0 = std::chrono::steady_clock::now();
+    if (auth != AuthState::OK) {
+        std::cerr << "Erro: login recusado: " << auth_reply << "\n";
+        Logger::instance().error("Autenticao falhou");
+        rc = 1;
+    } else {
+        Logger::instance().info("Autenticado com sucesso (headless)");
+
+        // Cada bloco lido vira um send(); linha incompleta no fim do bloco
+        // espera o prximo. Linhas vazias no so enviadas.
+        std::vector<char> in(cfg.batch);
+        std::string pending, batch;
+        batch.reserve(cfg.batch + 4096);
+        for (;;) {
+            ssize_t n = read(in_fd, in.data(), in.size());
+            if (n < 0 && errno == EINTR) continue;
+            if (n < 0) {
+                std::cerr << "Erro ao ler a entrada: " << std::strerror(errno) << "\n";
+                rc = 1;
+                break;
+            }
+            if (n == 0 && !pending.empty()) {
+                pending.push_back('\n');  // ltima linha sem '\n'
+            } else if (n == 0) {
+                break;
+            } else {
+                pending.append(in.data(), static_cast<size_t>(n));
+            }
+
+            batch.clear();
+            size_t pos = 0;
+            for (size_t nl; (nl = pending.find('\n', pos)) != std::string::npos; pos = nl + 1) {
+                size_t len = nl - pos;
+                if (len > 0 && pending[nl - 1] == '\r') --len;
+                if (len == 0) continue;
+                batch.append(pending, pos, len);
+                batch.push_back('\n');
+                ++sent.lines;
+            }
+            pending.erase(0, pos);
+
+            if (!batch.empty()) {
+                if (!send_all(sockfd, batch.data(), batch.size())) {
+                    Logger::instance().error("Erro ao enviar mensagem");
+                    rc = 1;
+                    break;
+                }
+                sent.bytes += batch.size();
+            }
+            if (n == 0) break;
+        }
+    }
+    double send_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    st.input_done.store(true);
+    reader.join();
+    double total_secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    shutdown(sockfd, SHUT_RDWR);
+
+    if (out != stdout) std::fclose(out);
+    if (in_fd != STDIN_FILENO) close(in_fd);
+
+    report("Enviadas", sent, send_secs);
+    report("Recebidas", st.received, total_secs);
+    return rc;
+}
+
+int main(int argc, char** argv) {
+    ClientConfig cfg;
+    if (!parse_args(argc, argv, cfg)) {
+        usage(argv[0]);
         return 1;
     }
+    const std::string& host = cfg.host;
+    const std::string& port = cfg.port;
+
+    Logger::instance().init("client.log", Level::INFO);
+    Logger::instance().info("Cliente iniciando: " + host + ":" + port);
+
+    int sockfd = connect_to(host, port);
+    if (sockfd < 0) return 1;
+
+    if (cfg.headless) {
+        Logger::instance().info("Conectado com sucesso (headless)");
+        int rc = run_headless(sockfd, cfg);
+        close(sockfd);
+        Logger::instance().info("Cliente encerrado");
+        Logger::instance().shutdown();
+        return rc;
+    }
 
     std::cout << "=== Cliente de Chat ===" << std::endl;
     std::cout << "Conectado ao servidor " << host << ":" << port << std::endl;
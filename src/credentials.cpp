@@ -0,0 +1,386 @@
+#include "credentials.hpp"
+
+#include <fstream>
+#include <algorithm>
+#include <iterator>
+#include <chrono>
+#include <cstring>
+#include <cerrno>
+
+#include <unistd.h>
+#include <sys/random.h>
+
+
+namespace crypto {
+
+namespace {
+
+constexpr uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+// Estado incremental; copivel, o que permite guardar o HMAC j com a
+// chave processada e reaproveit-lo em todas as iteraes do PBKDF2
+class Sha256 {
+public:
+void update(const void* data, size_t len) {
+    const uint8_t* p = static_cast<const uint8_t*>(data);
+    total_ += len;
+    if (used_) {
+        size_t take = std::min(len, sizeof(buf_) - used_);
+        std::memcpy(buf_ + used_, p, take);
+        used_ += take;
+        p += take;
+        len -= take;
+        if (used_ < sizeof(buf_)) return;
+        compress(buf_);
+        used_ = 0;
+    }
+    for (; len >= 64; p += 64, len -= 64) compress(p);
+    std::memcpy(buf_, p, len);
+    used_ = len;
+}
+
+Digest final() {
+    uint64_t bits = total_ * 8;
+    uint8_t pad = 0x80;
+    update(&pad, 1);
+    uint8_t zero = 0;
+    while (used_ != 56) update(&zero, 1);
+    uint8_t len_be[8];
+    for (int i = 0; i < 8; ++i) len_be[i] = static_cast<uint8_t>(bits >> (56 - 8 * i));
+    update(len_be, 8);
+
+    Digest out;
+    for (int i = 0; i < 8; ++i) {
+        out[4 * i] = static_cast<uint8_t>(h_[i] >> 24);
+        out[4 * i + 1] = static_cast<uint8_t>(h_[i] >> 16);
+        out[4 * i + 2] = static_cast<uint8_t>(h_[i] >> 8);
+        out[4 * i + 3] = static_cast<uint8_t>(h_[i]);
+    }
+    return out;
+}
+
+private:
+void compress(const uint8_t* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = (uint32_t(block[4 * i]) << 24) | (uint32_t(block[4 * i + 1]) << 16) |
+               (uint32_t(block[4 * i + 2]) << 8) | uint32_t(block[4 * i + 3]);
+    }
+    for (int i = 16; i < 64; ++i) {
+        uint32_t s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        uint32_t s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = h_[0], b = h_[1], c = h_[2], d = h_[3];
+    uint32_t e = h_[4], f = h_[5], g = h_[6], h = h_[7];
+    for (int i = 0; i < 64; ++i) {
+        uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+        uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+        h = g; g = f; f = e; e = d + t1;
+        d = c; c = b; b = a; a = t1 + t2;
+    }
+    h_[0] += a; h_[1] += b; h_[2] += c; h_[3] += d;
+    h_[4] += e; h_[5] += f; h_[6] += g; h_[7] += h;
+}
+
+uint32_t h_[8] = {0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                  0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+uint8_t buf_[64];
+size_t used_ = 0;
+uint64_t total_ = 0;
+};
+
+// HMAC com os blocos ipad/opad j comprimidos
+class Hmac {
+public:
+Hmac(const void* key, size_t key_len) {
+    uint8_t k[64] = {0};
+    if (key_len > 64) {
+        Digest d = sha256(key, key_len);
+        std::memcpy(k, d.data(), d.size());
+    } else {
+        std::memcpy(k, key, key_len);
+    }
+    uint8_t pad[64];
+    for (int i = 0; i < 64; ++i) pad[i] = k[i] ^ 0x36;
+    inner_.update(pad, 64);
+    for (int i = 0; i < 64; ++i) pad[i] = k[i] ^ 0x5c;
+    outer_.update(pad, 64);
+}
+
+Digest mac(const void* data, size_t len) const {
+    Sha256 in = inner_;
+    in.update(data, len);
+    Digest d = in.final();
+    Sha256 out = outer_;
+    out.update(d.data(), d.size());
+    return out.final();
+}
+
+private:
+Sha256 inner_;
+Sha256 outer_;
+};
+
+}
+
+
+Digest sha256(const void* data, size_t len) {
+    Sha256 s;
+    s.update(data, len);
+    return s.final();
+}
+
+Digest hmac_sha256(const void* key, size_t key_len, const void* data, size_t len) {
+    return Hmac(key, key_len).mac(data, len);
+}
+
+void pbkdf2_sha256(std::string_view password, const uint8_t* salt, size_t salt_len,
+                   unsigned iterations, uint8_t* out, size_t out_len) {
+    Hmac prf(password.data(), password.size());
+    std::string first(reinterpret_cast<const char*>(salt), salt_len);
+    first.append(4, '\0');
+
+    for (uint32_t block = 1; out_len > 0; ++block) {
+        for (int i = 0; i < 4; ++i) first[salt_len + i] = static_cast<char>(block >> (24 - 8 * i));
+        Digest u = prf.mac(first.data(), first.size());
+        Digest t = u;
+        for (unsigned it = 1; it < iterations; ++it) {
+            u = prf.mac(u.data(), u.size());
+            for (size_t i = 0; i < t.size(); ++i) t[i] ^= u[i];
+        }
+        size_t take = std::min(out_len, t.size());
+        std::memcpy(out, t.data(), take);
+        out += take;
+        out_len -= take;
+    }
+}
+
+bool equal_ct(const uint8_t* a, const uint8_t* b, size_t len) {
+    uint8_t diff = 0;
+    for (size_t i = 0; i < len; ++i) diff |= a[i] ^ b[i];
+    return diff == 0;
+}
+
+bool random_bytes(uint8_t* out, size_t len) {
+    while (len > 0) {
+        ssize_t n = getrandom(out, len, 0);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        out += n;
+        len -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+std::string to_hex(const uint8_t* data, size_t len) {
+    static const char digits[] = "0123456789abcdef";
+    std::string out(len * 2, '0');
+    for (size_t i = 0; i < len; ++i) {
+        out[2 * i] = digits[data[i] >> 4];
+        out[2 * i + 1] = digits[data[i] & 0xf];
+    }
+    return out;
+}
+
+bool from_hex(std::string_view hex, uint8_t* out, size_t len) {
+    if (hex.size() != len * 2) return false;
+    auto nibble = [](char c) -> int {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    };
+    for (size_t i = 0; i < len; ++i) {
+        int hi = nibble(hex[2 * i]), lo = nibble(hex[2 * i + 1]);
+        if (hi < 0 || lo < 0) return false;
+        out[i] = static_cast<uint8_t>(hi << 4 | lo);
+    }
+    return true;
+}
+
+}
+
+
+static const char* const SCHEME = "pbkdf2-sha256";
+
+static uint64_t steady_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+CredentialStore::CredentialStore() {
+    // Usado para gastar o mesmo tempo com usurios inexistentes
+    dummy_.iterations = DEFAULT_ITERATIONS;
+    crypto::random_bytes(dummy_.salt.data(), dummy_.salt.size());
+    crypto::random_bytes(dummy_.hash.data(), dummy_.hash.size());
+}
+
+std::string CredentialStore::hash_password(std::string_view password, unsigned iterations) {
+    uint8_t salt[SALT_BYTES];
+    uint8_t hash[HASH_BYTES];
+    crypto::random_bytes(salt, sizeof(salt));
+    crypto::pbkdf2_sha256(password, salt, sizeof(salt), iterations, hash, sizeof(hash));
+    return std::string(SCHEME) + "$" + std::to_string(iterations) + "$" +
+           crypto::to_hex(salt, sizeof(salt)) + "$" + crypto::to_hex(hash, sizeof(hash));
+}
+
+bool CredentialStore::parse(std::string_view encoded, Entry& e) {
+    std::string_view parts[4];
+    for (int i = 0; i < 4; ++i) {
+        size_t sep = (i < 3) ? encoded.find('$') : encoded.size();
+        if (sep == std::string_view::npos) return false;
+        parts[i] = encoded.substr(0, sep);
+        encoded.remove_prefix(std::min(encoded.size(), sep + 1));
+    }
+    if (parts[0] != SCHEME || parts[1].empty() || parts[1].size() > 9) return false;
+
+    unsigned iterations = 0;
+    for (char c : parts[1]) {
+        if (c < '0' || c > '9') return false;
+        iterations = iterations * 10 + static_cast<unsigned>(c - '0');
+    }
+    if (iterations == 0) return false;
+    e.iterations = iterations;
+    return crypto::from_hex(parts[2], e.salt.data(), e.salt.size()) &&
+           crypto::from_hex(parts[3], e.hash.data(), e.hash.size());
+}
+
+bool CredentialStore::check(const Entry& e, std::string_view password) {
+    uint8_t hash[HASH_BYTES];
+    crypto::pbkdf2_sha256(password, e.salt.data(), e.salt.size(), e.iterations, hash, sizeof(hash));
+    return crypto::equal_ct(hash, e.hash.data(), sizeof(hash));
+}
+
+bool CredentialStore::add(const std::string& user, std::string_view encoded) {
+    Entry e;
+    if (user.empty() || !parse(encoded, e)) return false;
+    users_[user] = e;
+    return true;
+}
+
+bool CredentialStore::add_password(const std::string& user, std::string_view password,
+                                   unsigned iterations) {
+    return add(user, hash_password(password, iterations));
+}
+
+bool CredentialStore::load(const std::string& path, unsigned legacy_iterations, size_t& loaded,
+                           size_t& legacy, std::string& error) {
+    loaded = legacy = 0;
+    std::ifstream in(path);
+    if (!in) {
+        error = "no foi possvel abrir " + path;
+        return false;
+    }
+    std::string line;
+    for (size_t lineno = 1; std::getline(in, line); ++lineno) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (line.empty() || line[0] == '#') continue;
+        auto colon = line.find(':');
+        if (colon == std::string::npos || colon == 0) {
+            error = path + ":" + std::to_string(lineno) + ": esperado usuario:hash";
+            return false;
+        }
+        std::string user = line.substr(0, colon);
+        std::string_view secret = std::string_view(line).substr(colon + 1);
+        if (secret.compare(0, std::strlen(SCHEME) + 1, std::string(SCHEME) + "$") == 0) {
+            if (!add(user, secret)) {
+                error = path + ":" + std::to_string(lineno) + ": hash invlido para " + user;
+                return false;
+            }
+        } else {
+            add_password(user, secret, legacy_iterations);
+            ++legacy;
+        }
+        ++loaded;
+    }
+    return true;
+}
+
+bool CredentialStore::verify(const std::string& user, std::string_view password) const {
+    auto it = users_.find(user);
+    if (it == users_.end()) {
+        check(dummy_, password);
+        return false;
+    }
+    return check(it->second, password);
+}
+
+
+AuthCache::AuthCache(uint64_t ttl_ms, size_t max_entries)
+    : ttl_ns_(ttl_ms * 1000000ULL),
+      max_per_stripe_(std::max<size_t>(1, max_entries / STRIPES)),
+      stripes_(new Stripe[STRIPES]) {
+    crypto::random_bytes(key_, sizeof(key_));
+}
+
+crypto::Digest AuthCache::tag_of(const std::string& user, std::string_view password) const {
+    std::string data;
+    data.reserve(user.size() + 1 + password.size());
+    data.append(user).push_back('\0');
+    data.append(password);
+    return crypto::hmac_sha256(key_, sizeof(key_), data.data(), data.size());
+}
+
+AuthCache::Stripe& AuthCache::stripe_of(const std::string& user) {
+    return stripes_[std::hash<std::string>{}(user) % STRIPES];
+}
+
+bool AuthCache::check(const std::string& user, std::string_view password) {
+    if (!enabled()) return false;
+    crypto::Digest tag = tag_of(user, password);
+    Stripe& s = stripe_of(user);
+    std::lock_guard<std::mutex> lg(s.mtx);
+    auto it = s.slots.find(user);
+    if (it == s.slots.end()) return false;
+    if (it->second.expires_ns <= steady_ns()) {
+        s.slots.erase(it);
+        return false;
+    }
+    return crypto::equal_ct(tag.data(), it->second.tag.data(), tag.size());
+}
+
+void AuthCache::remember(const std::string& user, std::string_view password) {
+    if (!enabled()) return;
+    crypto::Digest tag = tag_of(user, password);
+    uint64_t now = steady_ns();
+    Stripe& s = stripe_of(user);
+    std::lock_guard<std::mutex> lg(s.mtx);
+    if (s.slots.size() >= max_per_stripe_ && !s.slots.count(user)) {
+        // Cheio: abre espao descartando os vencidos; se nenhum venceu, no guarda
+        for (auto it = s.slots.begin(); it != s.slots.end();) {
+            it = (it->second.expires_ns <= now) ? s.slots.erase(it) : std::next(it);
+        }
+        if (s.slots.size() >= max_per_stripe_) return;
+    }
+    s.slots[user] = Slot{tag, now + ttl_ns_};
+}
+
+void AuthCache::forget(const std::string& user) {
+    Stripe& s = stripe_of(user);
+    std::lock_guard<std::mutex> lg(s.mtx);
+    s.slots.erase(user);
+}
+
+size_t AuthCache::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < STRIPES; ++i) {
+        std::lock_guard<std::mutex> lg(stripes_[i].mtx);
+        total += stripes_[i].slots.size();
+    }
+    return total;
+}
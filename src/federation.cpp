@@ -0,0 +1,588 @@
+#include "federation.hpp"
+#include "metrics.hpp"
+
+#include <stdexcept>
+#include <cstring>
+#include <cerrno>
+#include <algorithm>
+
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+using metrics::Syscall;
+
+// Tipos de frame
+enum : uint8_t { F_HELLO = 1, F_WELCOME, F_JOIN, F_LEAVE, F_ROOM, F_DELIVER, F_PING };
+
+constexpr uint32_t LINK_EVENTS = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+constexpr size_t READ_CHUNK = 16384;
+constexpr size_t COMPACT_BYTES = 1 << 20;
+
+struct Federation::Link {
+    int fd = -1;
+    bool outbound = false;
+    bool connected = false;   // sada: connect() concludo e HELLO enfileirado
+    bool welcomed = false;    // sada: WELCOME recebido, node conhecido
+    bool disabled = false;    // sada: aponta para este mesmo n
+    bool dirty = false;
+    bool dead = false;        // entrada: fechado, aguardando ser liberado
+    bool warned = false;      // sada: falha de conexo j avisada
+    PeerAddress addr;
+    std::string node;
+    std::string in;
+    std::string out;
+    size_t out_off = 0;
+    uint64_t last_rx = 0;
+    uint64_t last_tx = 0;
+    uint64_t since = 0;       // incio do connect() ou da queda
+};
+
+
+bool parse_peer_address(const std::string& s, PeerAddress& out) {
+    PeerAddress a;
+    std::string port = s;
+    auto colon = s.rfind(':');
+    if (colon != std::string::npos) {
+        a.host = s.substr(0, colon);
+        port = s.substr(colon + 1);
+        if (a.host == "localhost") a.host = "127.0.0.1";
+        in_addr tmp{};
+        if (inet_pton(AF_INET, a.host.c_str(), &tmp) != 1) return false;
+    }
+    if (port.empty() || port.size() > 5 || !std::all_of(port.begin(), port.end(), [](char c) { return c >= '0' && c <= '9'; })) return false;
+    a.port = std::stoi(port);
+    if (a.port <= 0 || a.port > 65535) return false;
+    out = a;
+    return true;
+}
+
+std::string peer_address_to_string(const PeerAddress& a) {
+    return a.host + ":" + std::to_string(a.port);
+}
+
+
+static void put_u32(std::string& b, uint32_t v) {
+    char c[4] = {static_cast<char>(v >> 24), static_cast<char>(v >> 16), static_cast<char>(v >> 8),
+                 static_cast<char>(v)};
+    b.append(c, 4);
+}
+
+static uint32_t get_u32(const char* p) {
+    auto u = reinterpret_cast<const unsigned char*>(p);
+    return (uint32_t(u[0]) << 24) | (uint32_t(u[1]) << 16) | (uint32_t(u[2]) << 8) | u[3];
+}
+
+// L os campos de um frame em sequncia
+struct FieldReader {
+    const char* p;
+    size_t n;
+
+    bool next(std::string_view& out) {
+        if (n < 4) return false;
+        uint32_t len = get_u32(p);
+        if (len > n - 4) return false;
+        out = std::string_view(p + 4, len);
+        p += 4 + len;
+        n -= 4 + len;
+        return true;
+    }
+};
+
+
+Federation::Federation(FederationOptions opts, Handlers handlers)
+    : opts_(std::move(opts)), handlers_(std::move(handlers)) {
+    listen_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    int opt = 1;
+    setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = INADDR_ANY;
+    addr.sin_port = htons(static_cast<uint16_t>(opts_.port));
+    socklen_t len = sizeof(addr);
+    if (listen_fd_ < 0 || bind(listen_fd_, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listen_fd_, 64) < 0 ||
+        getsockname(listen_fd_, (sockaddr*)&addr, &len) < 0) {
+        std::string err = "federao: porta " + std::to_string(opts_.port) + ": " + strerror(errno);
+        if (listen_fd_ >= 0) close(listen_fd_);
+        throw std::runtime_error(err);
+    }
+    port_ = ntohs(addr.sin_port);
+
+    unsigned tick_ms = std::max(10u, std::min(opts_.heartbeat_ms, opts_.retry_ms) / 2);
+    if (!loop_.add(listen_fd_, EPOLLIN | EPOLLET, [this](uint32_t) { accept_links(); }) ||
+        !loop_.add_timer(tick_ms, [this] { tick(); })) {
+        close(listen_fd_);
+        throw std::runtime_error("federao: falha ao registrar no lao de eventos");
+    }
+    loop_.set_before_wait([this] { flush_dirty(); });
+}
+
+void Federation::start() {
+    if (!thr_.joinable()) thr_ = std::thread([this] { loop_.run(); });
+}
+
+Federation::~Federation() {
+    loop_.stop();
+    if (thr_.joinable()) thr_.join();
+    for (auto& l : outbound_) {
+        if (l->fd >= 0) close(l->fd);
+    }
+    for (auto& pair : inbound_) close(pair.first);
+    close(listen_fd_);
+}
+
+void Federation::run_on_loop(EventLoop::Task t) {
+    if (loop_.in_loop_thread()) {
+        t();
+    } else {
+        loop_.post(std::move(t));
+    }
+}
+
+void Federation::report(const std::string& text) {
+    if (handlers_.event) handlers_.event(text);
+}
+
+
+// ---- Interface pblica (qualquer thread) ----
+
+void Federation::add_peer(const PeerAddress& addr) {
+    run_on_loop([this, addr] {
+        auto l = std::make_unique<Link>();
+        l->outbound = true;
+        l->addr = addr;
+        outbound_.push_back(std::move(l));
+        connect_link(*outbound_.back());
+    });
+}
+
+void Federation::user_joined(const std::string& user, const std::string& room) {
+    run_on_loop([this, user, room] {
+        local_[user] = room;
+        for (auto& l : outbound_) queue(*l, F_JOIN, {user, room});
+    });
+}
+
+void Federation::user_left(const std::string& user) {
+    run_on_loop([this, user] {
+        if (local_.erase(user) == 0) return;
+        for (auto& l : outbound_) queue(*l, F_LEAVE, {user});
+    });
+}
+
+void Federation::room_message(const std::string& room, MessageRef msg) {
+    run_on_loop([this, room, msg = std::move(msg)] {
+        for (auto& l : outbound_) {
+            if (!l->welcomed) continue;
+            auto it = nodes_.find(l->node);
+            if (it == nodes_.end() || it->second.rooms.count(room) == 0) continue;
+            queue(*l, F_ROOM, {room, msg->view()});
+        }
+    });
+}
+
+void Federation::deliver(const std::string& node, const std::string& to, const std::string& from,
+                         MessageRef msg) {
+    run_on_loop([this, node, to, from, msg = std::move(msg)] {
+        if (Link* l = outbound_to(node)) {
+            queue(*l, F_DELIVER, {to, from, msg->view()});
+        } else {
+            report("Mensagem para " + to + " descartada: sem link para o n " + node);
+        }
+    });
+}
+
+std::string Federation::owner(const std::string& user) const {
+    for (const auto& pair : nodes_) {
+        if (pair.second.users.count(user)) return pair.first;
+    }
+    return std::string();
+}
+
+Federation::Link* Federation::outbound_to(const std::string& node) {
+    for (auto& l : outbound_) {
+        if (l->welcomed && l->node == node) return l.get();
+    }
+    return nullptr;
+}
+
+
+// ---- Links ----
+
+void Federation::accept_links() {
+    for (;;) {
+        metrics::syscalls(Syscall::ACCEPT).inc();
+        int fd = accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR) continue;
+            return;
+        }
+        auto l = std::make_unique<Link>();
+        l->fd = fd;
+        l->last_rx = metrics::now_ns();
+        Link* lp = l.get();
+        inbound_[fd] = std::move(l);
+        if (!loop_.add(fd, LINK_EVENTS, [this, lp](uint32_t ev) { on_event(*lp, ev); })) {
+            inbound_.erase(fd);
+            close(fd);
+        }
+    }
+}
+
+// connect() no bloqueante; o link fica ativo no primeiro EPOLLOUT
+void Federation::connect_link(Link& l) {
+    l.since = metrics::now_ns();
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return;
+    int opt = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &opt, sizeof(opt));
+
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<uint16_t>(l.addr.port));
+    inet_pton(AF_INET, l.addr.host.c_str(), &addr.sin_addr);
+    metrics::syscalls(Syscall::OTHER).inc();
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0 && errno != EINPROGRESS) {
+        close(fd);
+        return;
+    }
+    l.fd = fd;
+    if (!loop_.add(fd, LINK_EVENTS, [this, lp = &l](uint32_t ev) { on_event(*lp, ev); })) {
+        close(fd);
+        l.fd = -1;
+    }
+}
+
+void Federation::on_event(Link& l, uint32_t events) {
+    if (l.outbound && !l.connected) {
+        int err = 0;
+        socklen_t len = sizeof(err);
+        getsockopt(l.fd, SOL_SOCKET, SO_ERROR, &err, &len);
+        if (err != 0) {
+            drop_link(l, strerror(err));
+            return;
+        }
+        if (!(events & EPOLLOUT)) return;
+
+        // HELLO com a presena atual; o que mudar depois segue no mesmo link
+        l.connected = true;
+        l.warned = false;
+        std::vector<std::string_view> fields;
+        fields.reserve(1 + local_.size() * 2);
+        fields.push_back(opts_.node);
+        for (const auto& pair : local_) {
+            fields.push_back(pair.first);
+            fields.push_back(pair.second);
+        }
+        queue(l, F_HELLO, fields.data(), fields.size());
+    }
+
+    if (events & EPOLLOUT) {
+        if (!flush(l)) {
+            drop_link(l, strerror(errno));
+            return;
+        }
+    }
+    if (!(events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) return;
+
+    // Os frames que chegaram antes do fim da conexo ainda so tratados
+    char buf[READ_CHUNK];
+    const char* closed = nullptr;
+    for (;;) {
+        metrics::syscalls(Syscall::RECV).inc();
+        ssize_t n = recv(l.fd, buf, sizeof(buf), 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (n <= 0) {
+            closed = n == 0 ? "conexo encerrada" : strerror(errno);
+            break;
+        }
+        stats_.bytes_in.fetch_add(static_cast<uint64_t>(n), std::memory_order_relaxed);
+        l.last_rx = metrics::now_ns();
+        l.in.append(buf, static_cast<size_t>(n));
+    }
+
+    size_t pos = 0;
+    while (l.in.size() - pos >= 4) {
+        uint32_t len = get_u32(l.in.data() + pos);
+        if (len == 0 || len > opts_.max_buffer) {
+            drop_link(l, "frame invlido");
+            return;
+        }
+        if (l.in.size() - pos - 4 < len) break;
+        const char* f = l.in.data() + pos + 4;
+        pos += 4 + len;
+        stats_.frames_in.fetch_add(1, std::memory_order_relaxed);
+        on_frame(l, static_cast<uint8_t>(f[0]), f + 1, len - 1);
+        if (l.dead || l.fd < 0) return;
+    }
+    l.in.erase(0, pos);
+    if (closed) drop_link(l, closed);
+}
+
+void Federation::on_frame(Link& l, uint8_t type, const char* p, size_t n) {
+    FieldReader r{p, n};
+    std::string_view a, b, c;
+
+    if (l.outbound) {
+        // Do outro lado de um link de sada s vem o WELCOME
+        if (type != F_WELCOME || l.welcomed || !r.next(a)) {
+            drop_link(l, "frame inesperado");
+            return;
+        }
+        if (a == opts_.node) {
+            l.disabled = true;
+            drop_link(l, "o endereo  deste mesmo n");
+            return;
+        }
+        l.node.assign(a);
+        l.welcomed = true;
+        stats_.peers.fetch_add(1, std::memory_order_relaxed);
+        report("Link para o n " + l.node + " (" + peer_address_to_string(l.addr) + ") ativo");
+        return;
+    }
+
+    if (l.node.empty() && type != F_HELLO) {
+        drop_link(l, "link sem HELLO");
+        return;
+    }
+    auto it = nodes_.find(l.node);
+    RemoteNode* rn = (it != nodes_.end() && it->second.inbound == &l) ? &it->second : nullptr;
+
+    switch (type) {
+        case F_HELLO:
+            on_hello(l, p, n);
+            return;
+        case F_JOIN:
+            if (rn && r.next(a) && r.next(b) && !b.empty()) set_user(*rn, l.node, std::string(a), std::string(b));
+            return;
+        case F_LEAVE:
+            if (rn && r.next(a)) set_user(*rn, l.node, std::string(a), std::string());
+            return;
+        case F_ROOM:
+            if (rn && r.next(a) && r.next(b) && handlers_.room_message) {
+                handlers_.room_message(std::string(a), make_message(std::string(b)));
+            }
+            return;
+        case F_DELIVER:
+            if (rn && r.next(a) && r.next(b) && r.next(c) && handlers_.deliver) {
+                handlers_.deliver(l.node, std::string(a), std::string(b), make_message(std::string(c)));
+            }
+            return;
+        case F_PING:
+            return;
+        default:
+            drop_link(l, "frame desconhecido");
+    }
+}
+
+// Primeiro frame de um link de entrada: identifica o n e traz todos os
+// usurios dele. Um link novo do mesmo n (reincio, reconexo) substitui o
+// anterior e a presena  reconciliada com a lista recebida.
+void Federation::on_hello(Link& l, const char* p, size_t n) {
+    FieldReader r{p, n};
+    std::string_view name;
+    if (!l.node.empty() || !r.next(name) || name.empty()) {
+        drop_link(l, "HELLO invlido");
+        return;
+    }
+    if (name == opts_.node) {
+        // O WELCOME com o mesmo nome faz o outro lado desistir do link (e,
+        // se for este prprio n, no tentar de novo)
+        queue(l, F_WELCOME, {opts_.node});
+        flush(l);
+        drop_link(l, "outro n com o mesmo nome");
+        return;
+    }
+
+    std::unordered_map<std::string, std::string> users;
+    std::string_view user, room;
+    while (r.next(user) && r.next(room)) users.emplace(user, room);
+
+    l.node.assign(name);
+    RemoteNode& rn = nodes_[l.node];
+    if (rn.inbound) {
+        Link* old = rn.inbound;
+        rn.inbound = nullptr;
+        drop_link(*old, "substitudo por uma nova conexo");
+    } else {
+        stats_.nodes.fetch_add(1, std::memory_order_relaxed);
+    }
+    rn.inbound = &l;
+
+    std::vector<std::string> gone;
+    for (const auto& pair : rn.users) {
+        if (!users.count(pair.first)) gone.push_back(pair.first);
+    }
+    for (const auto& u : gone) set_user(rn, l.node, u, std::string());
+    for (const auto& pair : users) set_user(rn, l.node, pair.first, pair.second);
+
+    queue(l, F_WELCOME, {opts_.node});
+    report("N " + l.node + " conectado com " + std::to_string(users.size()) + " usurio(s)");
+}
+
+// Fecha o link. Um link de sada  reaberto pelo tick depois de retry_ms;
+// um de entrada leva junto a presena do n, se ainda for o link dele.
+void Federation::drop_link(Link& l, const char* why) {
+    if (l.fd < 0 || l.dead) return;
+    loop_.remove(l.fd);
+    close(l.fd);
+    int fd = l.fd;
+    l.fd = -1;
+    l.in.clear();
+    l.out.clear();
+    l.out_off = 0;
+
+    if (l.outbound) {
+        bool was_up = l.welcomed;
+        l.connected = false;
+        l.welcomed = false;
+        l.since = metrics::now_ns();
+        if (was_up) {
+            stats_.peers.fetch_sub(1, std::memory_order_relaxed);
+            stats_.links_lost.fetch_add(1, std::memory_order_relaxed);
+            report("Link para o n " + l.node + " caiu: " + why);
+        } else if (!l.warned || l.disabled) {
+            l.warned = true;
+            report("Sem link para " + peer_address_to_string(l.addr) + ": " + why);
+        }
+        return;
+    }
+
+    l.dead = true;
+    auto it = nodes_.find(l.node);
+    if (it != nodes_.end() && it->second.inbound == &l) {
+        UserList users(it->second.users.begin(), it->second.users.end());
+        stats_.remote_users.fetch_sub(users.size(), std::memory_order_relaxed);
+        stats_.nodes.fetch_sub(1, std::memory_order_relaxed);
+        stats_.links_lost.fetch_add(1, std::memory_order_relaxed);
+        std::string node = l.node;
+        nodes_.erase(it);
+        report("N " + node + " perdido (" + why + ")");
+        if (handlers_.node_lost) handlers_.node_lost(node, users);
+    }
+    auto own = inbound_.find(fd);
+    if (own != inbound_.end()) {
+        closed_.push_back(std::move(own->second));
+        inbound_.erase(own);
+    }
+}
+
+
+// ---- Sada em lotes ----
+
+// Frames s entram em links de sada j conectados (o HELLO de uma
+// reconexo traz o estado) ou em links de entrada identificados
+void Federation::queue(Link& l, uint8_t type, const std::string_view* fields, size_t count) {
+    if (l.fd < 0 || l.dead || (l.outbound && !l.connected)) return;
+    if (l.out.size() - l.out_off > opts_.max_buffer) {
+        drop_link(l, "sada acumulada demais");
+        return;
+    }
+
+    size_t len = 1;
+    for (size_t i = 0; i < count; ++i) len += 4 + fields[i].size();
+    put_u32(l.out, static_cast<uint32_t>(len));
+    l.out.push_back(static_cast<char>(type));
+    for (size_t i = 0; i < count; ++i) {
+        put_u32(l.out, static_cast<uint32_t>(fields[i].size()));
+        l.out.append(fields[i].data(), fields[i].size());
+    }
+    stats_.frames_out.fetch_add(1, std::memory_order_relaxed);
+    l.last_tx = metrics::now_ns();
+
+    if (!l.dirty) {
+        l.dirty = true;
+        dirty_.push_back(&l);
+    }
+}
+
+void Federation::queue(Link& l, uint8_t type, std::initializer_list<std::string_view> fields) {
+    queue(l, type, fields.begin(), fields.size());
+}
+
+// Escreve at EAGAIN; o resto sai no prximo EPOLLOUT
+bool Federation::flush(Link& l) {
+    while (l.out_off < l.out.size()) {
+        metrics::syscalls(Syscall::SEND).inc();
+        ssize_t w = send(l.fd, l.out.data() + l.out_off, l.out.size() - l.out_off, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (w > 0) {
+            l.out_off += static_cast<size_t>(w);
+            stats_.bytes_out.fetch_add(static_cast<uint64_t>(w), std::memory_order_relaxed);
+            continue;
+        }
+        if (w < 0 && errno == EINTR) continue;
+        if (w < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        return false;
+    }
+    if (l.out_off == l.out.size()) {
+        l.out.clear();
+        l.out_off = 0;
+    } else if (l.out_off > COMPACT_BYTES) {
+        l.out.erase(0, l.out_off);
+        l.out_off = 0;
+    }
+    return true;
+}
+
+// Antes de cada espera do lao: tudo o que foi enfileirado nesta volta sai
+// num send() por link. Handlers chamados por drop_link podem enfileirar mais.
+void Federation::flush_dirty() {
+    for (size_t i = 0; i < dirty_.size(); ++i) {
+        Link* l = dirty_[i];
+        l->dirty = false;
+        if (l->fd < 0 || l->dead || l->out_off == l->out.size()) continue;
+        stats_.batches_out.fetch_add(1, std::memory_order_relaxed);
+        if (!flush(*l)) drop_link(*l, strerror(errno));
+    }
+    dirty_.clear();
+    closed_.clear();
+}
+
+// Reconexes, heartbeats dos links de sada e prazo dos de entrada
+void Federation::tick() {
+    uint64_t now = metrics::now_ns();
+    const uint64_t ms = 1000000ULL;
+
+    for (auto& l : outbound_) {
+        if (l->disabled) continue;
+        if (l->fd < 0) {
+            if (now - l->since >= opts_.retry_ms * ms) connect_link(*l);
+        } else if (!l->connected) {
+            if (now - l->since >= opts_.timeout_ms * ms) drop_link(*l, "tempo de conexo esgotado");
+        } else if (now - l->last_tx >= opts_.heartbeat_ms * ms) {
+            queue(*l, F_PING, {});
+        }
+    }
+
+    std::vector<Link*> expired;
+    for (auto& pair : inbound_) {
+        if (now - pair.second->last_rx > opts_.timeout_ms * ms) expired.push_back(pair.second.get());
+    }
+    for (Link* l : expired) drop_link(*l, "sem resposta no prazo");
+}
+
+void Federation::set_user(RemoteNode& rn, const std::string& node, const std::string& user,
+                          const std::string& room) {
+    auto it = rn.users.find(user);
+    if (it != rn.users.end()) {
+        if (it->second == room) return;
+        auto rc = rn.rooms.find(it->second);
+        if (rc != rn.rooms.end() && --rc->second == 0) rn.rooms.erase(rc);
+        if (room.empty()) {
+            rn.users.erase(it);
+            stats_.remote_users.fetch_sub(1, std::memory_order_relaxed);
+        } else {
+            it->second = room;
+        }
+    } else {
+        if (room.empty()) return;
+        rn.users.emplace(user, room);
+        stats_.remote_users.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (!room.empty()) ++rn.rooms[room];
+    if (handlers_.presence) handlers_.presence(node, user, room);
+}
@@ -0,0 +1,213 @@
+#include "handoff.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdlib>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+extern char** environ;
+
+
+namespace handoff {
+
+namespace {
+
+constexpr uint32_t MAGIC = 0x31484843;  // "CHH1"
+// Descritores por mensagem; o kernel aceita at SCM_MAX_FD (253)
+constexpr size_t FDS_PER_MSG = 250;
+
+struct Header {
+    uint32_t magic;
+    uint32_t fds;
+    uint64_t bytes;
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Espera o socket ficar pronto at o prazo; false se o prazo passou
+bool wait_for(int sock, short events, Clock::time_point deadline) {
+    for (;;) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        if (left <= 0) return false;
+        pollfd pfd{sock, events, 0};
+        int rc = poll(&pfd, 1, static_cast<int>(left));
+        if (rc > 0) return true;
+        if (rc < 0 && errno != EINTR) return false;
+    }
+}
+
+bool send_all(int sock, const char* p, size_t n) {
+    while (n > 0) {
+        ssize_t w = ::send(sock, p, n, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        p += w;
+        n -= static_cast<size_t>(w);
+    }
+    return true;
+}
+
+// L exatamente n bytes. Nunca pede mais do que falta, para no consumir
+// o byte que carrega os prximos descritores.
+bool recv_all(int sock, char* p, size_t n, Clock::time_point deadline) {
+    while (n > 0) {
+        if (!wait_for(sock, POLLIN, deadline)) return false;
+        ssize_t r = ::recv(sock, p, n, 0);
+        if (r < 0 && errno == EINTR) continue;
+        if (r <= 0) return false;
+        p += r;
+        n -= static_cast<size_t>(r);
+    }
+    return true;
+}
+
+// Um byte com at FDS_PER_MSG descritores anexados
+bool send_fds(int sock, const int* fds, size_t n) {
+    char byte = 'F';
+    iovec iov{&byte, 1};
+    alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int) * FDS_PER_MSG)];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * n);
+    cmsghdr* cm = CMSG_FIRSTHDR(&msg);
+    cm->cmsg_level = SOL_SOCKET;
+    cm->cmsg_type = SCM_RIGHTS;
+    cm->cmsg_len = CMSG_LEN(sizeof(int) * n);
+    std::memcpy(CMSG_DATA(cm), fds, sizeof(int) * n);
+    for (;;) {
+        ssize_t w = sendmsg(sock, &msg, MSG_NOSIGNAL);
+        if (w < 0 && errno == EINTR) continue;
+        return w == 1;
+    }
+}
+
+bool recv_fds(int sock, std::vector<int>& fds, Clock::time_point deadline) {
+    char byte;
+    iovec iov{&byte, 1};
+    alignas(cmsghdr) char ctrl[CMSG_SPACE(sizeof(int) * FDS_PER_MSG)];
+    msghdr msg{};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl;
+    msg.msg_controllen = sizeof(ctrl);
+
+    ssize_t r;
+    do {
+        if (!wait_for(sock, POLLIN, deadline)) return false;
+        r = recvmsg(sock, &msg, MSG_CMSG_CLOEXEC);
+    } while (r < 0 && errno == EINTR);
+
+    bool got = false;
+    for (cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm; cm = CMSG_NXTHDR(&msg, cm)) {
+        if (cm->cmsg_level != SOL_SOCKET || cm->cmsg_type != SCM_RIGHTS) continue;
+        size_t n = (cm->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+        const char* data = reinterpret_cast<const char*>(CMSG_DATA(cm));
+        for (size_t i = 0; i < n; ++i) {
+            int fd;
+            std::memcpy(&fd, data + i * sizeof(int), sizeof(int));
+            fds.push_back(fd);
+        }
+        got = true;
+    }
+    return r == 1 && byte == 'F' && got && !(msg.msg_flags & MSG_CTRUNC);
+}
+
+} // namespace
+
+
+pid_t spawn(const std::string& path, char* const argv[], int& sock) {
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) return -1;
+
+    // Ambiente montado antes do fork: entre o fork e o exec o filho s
+    // pode chamar funes seguras para sinais
+    std::string prefix = std::string(ENV_FD) + "=";
+    std::vector<std::string> vars;
+    for (char** e = environ; *e; ++e) {
+        if (std::strncmp(*e, prefix.c_str(), prefix.size()) != 0) vars.emplace_back(*e);
+    }
+    vars.push_back(prefix + std::to_string(sv[1]));
+    std::vector<char*> envp;
+    for (auto& v : vars) envp.push_back(v.data());
+    envp.push_back(nullptr);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        fcntl(sv[1], F_SETFD, 0);  // s esta ponta passa pelo exec
+        execve(path.c_str(), argv, envp.data());
+        _exit(127);
+    }
+    close(sv[1]);
+    if (pid < 0) {
+        int err = errno;
+        close(sv[0]);
+        errno = err;
+        return -1;
+    }
+    sock = sv[0];
+    return pid;
+}
+
+int inherited() {
+    const char* v = std::getenv(ENV_FD);
+    if (!v) return -1;
+    char* end = nullptr;
+    long fd = std::strtol(v, &end, 10);
+    unsetenv(ENV_FD);
+    if (end == v || *end != '\0' || fd < 0) return -1;
+    fcntl(static_cast<int>(fd), F_SETFD, FD_CLOEXEC);
+    return static_cast<int>(fd);
+}
+
+bool send(int sock, const std::string& blob, const std::vector<int>& fds) {
+    Header h{MAGIC, static_cast<uint32_t>(fds.size()), blob.size()};
+    if (!send_all(sock, reinterpret_cast<const char*>(&h), sizeof(h))) return false;
+    for (size_t i = 0; i < fds.size(); i += FDS_PER_MSG) {
+        if (!send_fds(sock, fds.data() + i, std::min(FDS_PER_MSG, fds.size() - i))) return false;
+    }
+    return send_all(sock, blob.data(), blob.size());
+}
+
+bool receive(int sock, std::string& blob, std::vector<int>& fds, unsigned timeout_ms) {
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    Header h;
+    if (!recv_all(sock, reinterpret_cast<char*>(&h), sizeof(h), deadline) || h.magic != MAGIC) return false;
+
+    std::vector<int> got;
+    bool ok = true;
+    while (ok && got.size() < h.fds) ok = recv_fds(sock, got, deadline);
+    if (ok && got.size() == h.fds) {
+        blob.resize(h.bytes);
+        ok = recv_all(sock, blob.data(), blob.size(), deadline);
+    } else {
+        ok = false;
+    }
+    if (!ok) {
+        for (int fd : got) close(fd);
+        return false;
+    }
+    fds = std::move(got);
+    return true;
+}
+
+bool notify(int sock, Step step) {
+    char byte = static_cast<char>(step);
+    return send_all(sock, &byte, 1);
+}
+
+bool wait_step(int sock, Step step, unsigned timeout_ms) {
+    char byte = 0;
+    auto deadline = Clock::now() + std::chrono::milliseconds(timeout_ms);
+    return recv_all(sock, &byte, 1, deadline) && byte == static_cast<char>(step);
+}
+
+} // namespace handoff
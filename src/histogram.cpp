@@ -0,0 +1,53 @@
+#include "histogram.hpp"
+
+#include <cmath>
+
+uint64_t Histogram::upper_bound(size_t i) {
+    if (i < SUB_BUCKETS) return i;
+    uint64_t shift = i / SUB_BUCKETS - 1;
+    uint64_t sub = i % SUB_BUCKETS;
+    uint64_t lower = (SUB_BUCKETS + sub) << shift;
+    return lower + ((uint64_t(1) << shift) - 1);
+}
+
+void Histogram::merge(const Histogram& other) {
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        uint64_t c = other.counts_[i].load(std::memory_order_relaxed);
+        if (c) counts_[i].fetch_add(c, std::memory_order_relaxed);
+    }
+    count_.fetch_add(other.count(), std::memory_order_relaxed);
+    sum_.fetch_add(other.sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    uint64_t v = other.max();
+    uint64_t m = max_.load(std::memory_order_relaxed);
+    while (v > m && !max_.compare_exchange_weak(m, v, std::memory_order_relaxed)) {}
+}
+
+void Histogram::reset() {
+    for (auto& c : counts_) c.store(0, std::memory_order_relaxed);
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+double Histogram::mean() const {
+    uint64_t n = count();
+    return n ? static_cast<double>(sum_.load(std::memory_order_relaxed)) / n : 0.0;
+}
+
+uint64_t Histogram::percentile(double q) const {
+    uint64_t n = count();
+    if (n == 0) return 0;
+    uint64_t rank = static_cast<uint64_t>(std::ceil(q * n));
+    if (rank == 0) rank = 1;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; ++i) {
+        seen += counts_[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            uint64_t ub = upper_bound(i);
+            uint64_t m = max();
+            return ub < m ? ub : m;
+        }
+    }
+    return max();
+}
@@ -0,0 +1,429 @@
+#include "history_log.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cctype>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+// Cabealho de cada registro; registros ficam alinhados em 8 bytes.
+// len == 0 marca o fim (o resto do segmento pr-alocado  zero).
+struct RecordHeader {
+    uint32_t len;
+    uint32_t sum;      // FNV-1a de seq, ts e dados: detecta escrita rasgada
+    uint64_t seq;
+    int64_t ts_ms;
+};
+
+constexpr size_t HEADER_SIZE = sizeof(RecordHeader);
+
+inline size_t align8(size_t n) { return (n + 7) & ~size_t(7); }
+
+uint32_t fnv1a(const void* data, size_t n, uint32_t h) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    for (size_t i = 0; i < n; ++i) {
+        h ^= p[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+uint32_t record_sum(const RecordHeader& h, const char* body) {
+    uint32_t s = fnv1a(&h.seq, sizeof(h.seq), 2166136261u);
+    s = fnv1a(&h.ts_ms, sizeof(h.ts_ms), s);
+    return fnv1a(body, h.len, s);
+}
+
+std::string segment_name(uint64_t base, const char* ext) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%020llu%s", static_cast<unsigned long long>(base), ext);
+    return buf;
+}
+
+std::string sys_error(const std::string& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+} // namespace
+
+
+bool parse_fsync_policy(const std::string& s, HistoryLogOptions& opts) {
+    if (s == "always") {
+        opts.fsync = FsyncPolicy::ALWAYS;
+    } else if (s == "never") {
+        opts.fsync = FsyncPolicy::NEVER;
+    } else {
+        try {
+            size_t pos = 0;
+            unsigned long ms = std::stoul(s, &pos);
+            if (pos != s.size() || ms == 0) return false;
+            opts.fsync = FsyncPolicy::INTERVAL;
+            opts.fsync_ms = static_cast<unsigned>(ms);
+        } catch (const std::exception&) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+HistoryLog::Segment::~Segment() {
+    if (map) munmap(map, size);
+    if (fd >= 0) close(fd);
+    if (idx_fd >= 0) close(idx_fd);
+}
+
+HistoryLog::HistoryLog(HistoryLogOptions opts) : opts_(std::move(opts)) {
+    opts_.segment_bytes = align8(std::max<size_t>(opts_.segment_bytes, 4096));
+    if (opts_.max_segments == 0) opts_.max_segments = 1;
+
+    if (mkdir(opts_.dir.c_str(), 0755) < 0 && errno != EEXIST) {
+        throw std::runtime_error(sys_error("mkdir " + opts_.dir));
+    }
+    dir_fd_ = open(opts_.dir.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dir_fd_ < 0) {
+        throw std::runtime_error(sys_error("open " + opts_.dir));
+    }
+
+    try {
+        recover();
+    } catch (...) {
+        close(dir_fd_);
+        throw;
+    }
+    durable_seq_.store(next_seq_);
+
+    if (opts_.fsync == FsyncPolicy::INTERVAL) {
+        flusher_ = std::thread(&HistoryLog::flusher_loop, this);
+    }
+}
+
+HistoryLog::~HistoryLog() {
+    {
+        std::lock_guard<std::mutex> lg(flush_mtx_);
+        stopping_ = true;
+    }
+    flush_cv_.notify_one();
+    if (flusher_.joinable()) flusher_.join();
+
+    if (opts_.fsync != FsyncPolicy::NEVER) sync();
+    if (dir_fd_ >= 0) close(dir_fd_);
+    // Os segmentos s so desmapeados quando a ltima mensagem que aponta
+    // para eles for liberada
+}
+
+HistoryLog::SegmentPtr HistoryLog::create_segment(uint64_t base) {
+    auto seg = std::make_shared<Segment>();
+    seg->base = base;
+    seg->path = opts_.dir + "/" + segment_name(base, ".log");
+    seg->idx_path = opts_.dir + "/" + segment_name(base, ".idx");
+    seg->size = opts_.segment_bytes;
+
+    seg->fd = open(seg->path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (seg->fd < 0) return nullptr;
+
+    // Reserva os blocos agora: escrever num buraco do arquivo mapeado com o
+    // disco cheio viraria SIGBUS no meio de um broadcast
+    int err = posix_fallocate(seg->fd, 0, seg->size);
+    if (err == EOPNOTSUPP || err == EINVAL) {
+        err = (ftruncate(seg->fd, seg->size) < 0) ? errno : 0;
+    }
+    if (err != 0) {
+        unlink(seg->path.c_str());
+        errno = err;
+        return nullptr;
+    }
+
+    void* p = mmap(nullptr, seg->size, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+    if (p == MAP_FAILED) {
+        unlink(seg->path.c_str());
+        return nullptr;
+    }
+    seg->map = static_cast<char*>(p);
+
+    seg->idx_fd = open(seg->idx_path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (seg->idx_fd < 0) {
+        unlink(seg->path.c_str());
+        return nullptr;
+    }
+
+    if (opts_.fsync != FsyncPolicy::NEVER) fsync(dir_fd_);
+    return seg;
+}
+
+HistoryLog::SegmentPtr HistoryLog::open_segment(uint64_t base) {
+    auto seg = std::make_shared<Segment>();
+    seg->base = base;
+    seg->path = opts_.dir + "/" + segment_name(base, ".log");
+    seg->idx_path = opts_.dir + "/" + segment_name(base, ".idx");
+
+    seg->fd = open(seg->path.c_str(), O_RDWR | O_CLOEXEC);
+    if (seg->fd < 0) return nullptr;
+
+    struct stat st;
+    if (fstat(seg->fd, &st) < 0 || st.st_size < static_cast<off_t>(HEADER_SIZE)) return nullptr;
+    seg->size = static_cast<size_t>(st.st_size) & ~size_t(7);
+
+    void* p = mmap(nullptr, seg->size, PROT_READ | PROT_WRITE, MAP_SHARED, seg->fd, 0);
+    if (p == MAP_FAILED) return nullptr;
+    seg->map = static_cast<char*>(p);
+
+    // ndice esparso: s entradas dentro do segmento e em ordem crescente.
+    // Entradas que no batem com o registro so descartadas em recover().
+    seg->idx_fd = open(seg->idx_path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (seg->idx_fd >= 0 && fstat(seg->idx_fd, &st) == 0) {
+        std::vector<IndexEntry> entries(static_cast<size_t>(st.st_size) / sizeof(IndexEntry));
+        ssize_t n = pread(seg->idx_fd, entries.data(), entries.size() * sizeof(IndexEntry), 0);
+        entries.resize(n > 0 ? static_cast<size_t>(n) / sizeof(IndexEntry) : 0);
+
+        seg->index.reserve(entries.size());
+        for (const auto& e : entries) {
+            if (e.seq <= base || e.offset + HEADER_SIZE > seg->size) break;
+            if (!seg->index.empty() && (e.seq <= seg->index.back().seq ||
+                                        e.offset <= seg->index.back().offset)) break;
+            seg->index.push_back(e);
+        }
+    }
+    return seg;
+}
+
+template <typename F>
+size_t HistoryLog::scan(const Segment& seg, size_t off, uint64_t& seq, size_t end, F&& on_record) const {
+    while (off + HEADER_SIZE <= end) {
+        RecordHeader h;
+        std::memcpy(&h, seg.map + off, HEADER_SIZE);
+        if (h.len == 0 || h.seq != seq || h.len > end - off - HEADER_SIZE) break;
+
+        const char* body = seg.map + off + HEADER_SIZE;
+        if (h.sum != record_sum(h, body)) break;
+
+        on_record(seq, body, h.len);
+        ++seq;
+        off += align8(HEADER_SIZE + h.len);
+    }
+    return off;
+}
+
+void HistoryLog::recover() {
+    std::vector<uint64_t> bases;
+    if (DIR* d = fdopendir(dup(dir_fd_))) {
+        while (dirent* ent = readdir(d)) {
+            std::string name = ent->d_name;
+            if (name.size() != 24 || name.compare(20, 4, ".log") != 0) continue;
+            if (!std::all_of(name.begin(), name.begin() + 20, ::isdigit)) continue;
+            bases.push_back(std::stoull(name.substr(0, 20)));
+        }
+        closedir(d);
+    }
+    std::sort(bases.begin(), bases.end());
+
+    for (uint64_t base : bases) {
+        if (auto seg = open_segment(base)) segments_.push_back(std::move(seg));
+    }
+
+    if (segments_.empty()) {
+        next_seq_ = 0;
+        if (!roll()) throw std::runtime_error(sys_error("criar segmento em " + opts_.dir));
+        return;
+    }
+
+    // Fim do log: parte da ltima entrada do ndice que confere com o
+    // registro apontado e varre s o pedao depois dela
+    cur_ = segments_.back();
+    Segment& seg = *cur_;
+    size_t off = 0;
+    uint64_t seq = seg.base;
+    while (!seg.index.empty()) {
+        const IndexEntry& e = seg.index.back();
+        uint64_t s = e.seq;
+        size_t end = scan(seg, e.offset, s, seg.size, [](uint64_t, const char*, size_t) {});
+        if (end > e.offset) {
+            off = e.offset;
+            seq = e.seq;
+            break;
+        }
+        seg.index.pop_back();
+    }
+    if (seg.idx_fd >= 0 && ftruncate(seg.idx_fd, seg.index.size() * sizeof(IndexEntry)) < 0) {
+        close(seg.idx_fd);
+        seg.idx_fd = -1;
+    }
+
+    write_off_ = scan(seg, off, seq, seg.size, [](uint64_t, const char*, size_t) {});
+    next_seq_ = seq;
+}
+
+bool HistoryLog::roll() {
+    if (cur_ && opts_.fsync != FsyncPolicy::NEVER) fdatasync(cur_->fd);
+
+    auto seg = create_segment(next_seq_);
+    if (!seg) return false;
+
+    // Um segmento vazio deixado por uma execuo anterior tem a mesma base
+    if (!segments_.empty() && segments_.back()->base == seg->base) segments_.pop_back();
+    segments_.push_back(seg);
+    cur_ = std::move(seg);
+    write_off_ = 0;
+
+    while (segments_.size() > opts_.max_segments) {
+        unlink(segments_.front()->path.c_str());
+        unlink(segments_.front()->idx_path.c_str());
+        segments_.pop_front();
+    }
+    return true;
+}
+
+MessageRef HistoryLog::append(const MessageRef& msg) {
+    std::string_view body = msg->view();
+    size_t need = align8(HEADER_SIZE + body.size());
+    if (body.empty() || need > opts_.segment_bytes) return nullptr;
+
+    RecordHeader h;
+    h.len = static_cast<uint32_t>(body.size());
+    h.ts_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+
+    MessageRef mapped;
+    uint64_t written;
+    {
+        std::lock_guard<std::mutex> lg(mtx_);
+        if (write_off_ + need > cur_->size && !roll()) return nullptr;
+
+        Segment& seg = *cur_;
+        h.seq = next_seq_;
+        char* p = seg.map + write_off_;
+        std::memcpy(p + HEADER_SIZE, body.data(), body.size());
+        h.sum = record_sum(h, p + HEADER_SIZE);
+        std::memcpy(p, &h, HEADER_SIZE);
+
+        if (h.seq > seg.base && (h.seq - seg.base) % INDEX_INTERVAL == 0) {
+            IndexEntry e{h.seq, write_off_};
+            seg.index.push_back(e);
+            if (seg.idx_fd >= 0 && write(seg.idx_fd, &e, sizeof(e)) != sizeof(e)) {
+                // O ndice  s um atalho: sem ele a partida varre o segmento
+                close(seg.idx_fd);
+                seg.idx_fd = -1;
+            }
+        }
+
+        mapped = make_message_view(cur_, std::string_view(p + HEADER_SIZE, body.size()));
+        write_off_ += need;
+        written = ++next_seq_;
+    }
+
+    if (opts_.fsync == FsyncPolicy::ALWAYS) sync_upto(written);
+    return mapped;
+}
+
+std::vector<MessageRef> HistoryLog::tail(size_t n) const {
+    std::vector<MessageRef> out;
+    if (n == 0) return out;
+
+    // Sob o lock s o retrato: os segmentos a ler, at onde cada um vai e
+    // onde comear. A varredura corre depois, sem segurar os appends: o que
+    // est antes do fim retratado no muda mais, e o shared_ptr mantm o
+    // segmento mapeado mesmo que roll() o apague nesse meio tempo.
+    std::vector<std::pair<SegmentPtr, size_t>> segs;  // segmento e fim
+    uint64_t target;
+    size_t off = 0;
+    uint64_t seq;
+    {
+        std::lock_guard<std::mutex> lg(mtx_);
+        if (segments_.empty()) return out;
+
+        target = (next_seq_ > n) ? next_seq_ - n : 0;
+        target = std::max(target, segments_.front()->base);
+        out.reserve(std::min<uint64_t>(n, next_seq_ - target));
+
+        // Segmento que contm target e entrada do ndice logo antes dele
+        size_t i = segments_.size() - 1;
+        while (i > 0 && segments_[i]->base > target) --i;
+
+        const Segment& first = *segments_[i];
+        seq = first.base;
+        auto it = std::upper_bound(first.index.begin(), first.index.end(), target,
+                                   [](uint64_t s, const IndexEntry& e) { return s < e.seq; });
+        if (it != first.index.begin()) {
+            --it;
+            off = it->offset;
+            seq = it->seq;
+        }
+
+        for (; i < segments_.size(); ++i) {
+            segs.emplace_back(segments_[i], (segments_[i] == cur_) ? write_off_ : segments_[i]->size);
+        }
+    }
+
+    for (size_t k = 0; k < segs.size(); ++k) {
+        const SegmentPtr& seg = segs[k].first;
+        if (k > 0) {
+            off = 0;
+            seq = seg->base;
+        }
+        scan(*seg, off, seq, segs[k].second, [&](uint64_t s, const char* body, size_t len) {
+            if (s >= target) out.push_back(make_message_view(seg, std::string_view(body, len)));
+        });
+    }
+    return out;
+}
+
+void HistoryLog::sync_upto(uint64_t seq) {
+    std::lock_guard<std::mutex> lg(sync_mtx_);
+    if (durable_seq_.load(std::memory_order_acquire) >= seq) return;
+
+    SegmentPtr seg;
+    uint64_t target;
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        seg = cur_;
+        target = next_seq_;
+    }
+    // Segmentos anteriores j foram sincronizados em roll()
+    fdatasync(seg->fd);
+    durable_seq_.store(target, std::memory_order_release);
+}
+
+void HistoryLog::sync() {
+    uint64_t target;
+    {
+        std::lock_guard<std::mutex> lg(mtx_);
+        target = next_seq_;
+    }
+    sync_upto(target);
+}
+
+void HistoryLog::flusher_loop() {
+    std::unique_lock<std::mutex> lk(flush_mtx_);
+    while (!stopping_) {
+        flush_cv_.wait_for(lk, std::chrono::milliseconds(opts_.fsync_ms));
+        if (stopping_) break;
+        lk.unlock();
+        sync();
+        lk.lock();
+    }
+}
+
+uint64_t HistoryLog::first_seq() const {
+    std::lock_guard<std::mutex> lg(mtx_);
+    return segments_.empty() ? next_seq_ : segments_.front()->base;
+}
+
+uint64_t HistoryLog::next_seq() const {
+    std::lock_guard<std::mutex> lg(mtx_);
+    return next_seq_;
+}
+
+size_t HistoryLog::segment_count() const {
+    std::lock_guard<std::mutex> lg(mtx_);
+    return segments_.size();
+}
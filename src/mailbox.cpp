@@ -0,0 +1,324 @@
+#include "mailbox.hpp"
+
+#include <cerrno>
+#include <cstring>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+namespace {
+
+const char SUFFIX[] = ".mbox";
+
+std::string sys_error(const std::string& what) {
+    return what + ": " + std::strerror(errno);
+}
+
+// Nome do arquivo de uma caixa: letras, dgitos, '_' e '-' ficam como
+// esto, o resto vira %XX
+std::string escape(const std::string& user) {
+    static const char hex[] = "0123456789abcdef";
+    std::string out;
+    for (unsigned char ch : user) {
+        if ((ch >= 'a' && ch <= 'z') || (ch >= 'A' && ch <= 'Z') || (ch >= '0' && ch <= '9') ||
+            ch == '_' || ch == '-') {
+            out.push_back(static_cast<char>(ch));
+        } else {
+            out.push_back('%');
+            out.push_back(hex[ch >> 4]);
+            out.push_back(hex[ch & 15]);
+        }
+    }
+    return out;
+}
+
+int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    return -1;
+}
+
+bool unescape(std::string_view name, std::string& user) {
+    user.clear();
+    for (size_t i = 0; i < name.size(); ++i) {
+        if (name[i] != '%') {
+            user.push_back(name[i]);
+            continue;
+        }
+        if (i + 2 >= name.size()) return false;
+        int hi = hex_value(name[i + 1]), lo = hex_value(name[i + 2]);
+        if (hi < 0 || lo < 0) return false;
+        user.push_back(static_cast<char>(hi * 16 + lo));
+        i += 2;
+    }
+    return !user.empty();
+}
+
+// Arquivo inteiro em data; false se no abrir
+bool read_file(const std::string& path, std::string& data) {
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    char buf[65536];
+    ssize_t n;
+    while ((n = read(fd, buf, sizeof(buf))) != 0) {
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            close(fd);
+            return false;
+        }
+        data.append(buf, static_cast<size_t>(n));
+    }
+    close(fd);
+    return true;
+}
+
+// Registros: u32 tamanho + bytes da mensagem. Um registro incompleto no fim
+// (gravao interrompida)  ignorado.
+template <typename F>
+size_t for_each_record(std::string_view data, F&& f) {
+    size_t n = 0, pos = 0;
+    while (data.size() - pos >= sizeof(uint32_t)) {
+        uint32_t len;
+        std::memcpy(&len, data.data() + pos, sizeof(len));
+        if (data.size() - pos - sizeof(len) < len) break;
+        f(data.substr(pos + sizeof(len), len));
+        pos += sizeof(len) + len;
+        ++n;
+    }
+    return n;
+}
+
+void put_record(std::string& buf, std::string_view msg) {
+    uint32_t len = static_cast<uint32_t>(msg.size());
+    buf.append(reinterpret_cast<const char*>(&len), sizeof(len));
+    buf.append(msg.data(), msg.size());
+}
+
+} // namespace
+
+
+MailboxStore::MailboxStore(const MailboxOptions& opts) : opts_(opts), stripes_(new Stripe[STRIPES]) {
+    if (opts_.dir.empty()) return;
+    if (mkdir(opts_.dir.c_str(), 0755) < 0 && errno != EEXIST) {
+        throw std::runtime_error(sys_error("mkdir " + opts_.dir));
+    }
+    load_dir();
+}
+
+MailboxStore::~MailboxStore() {
+    if (!opts_.dir.empty()) spill_all();
+}
+
+MailboxStore::Stripe& MailboxStore::stripe_of(const std::string& user) const {
+    return stripes_[std::hash<std::string>{}(user) % STRIPES];
+}
+
+std::string MailboxStore::path_of(const std::string& user) const {
+    return opts_.dir + "/" + escape(user) + SUFFIX;
+}
+
+// Caixas deixadas em disco pela execuo anterior: s conta os registros;
+// as mensagens so lidas na entrega
+void MailboxStore::load_dir() {
+    DIR* d = opendir(opts_.dir.c_str());
+    if (!d) throw std::runtime_error(sys_error("opendir " + opts_.dir));
+    const size_t suffix_len = sizeof(SUFFIX) - 1;
+    std::string user, data;
+    while (dirent* e = readdir(d)) {
+        std::string_view name = e->d_name;
+        if (name.size() <= suffix_len || name.substr(name.size() - suffix_len) != SUFFIX) continue;
+        if (!unescape(name.substr(0, name.size() - suffix_len), user)) continue;
+
+        std::string path = opts_.dir + "/" + std::string(name);
+        data.clear();
+        if (!read_file(path, data)) continue;
+        size_t n = for_each_record(data, [](std::string_view) {});
+        if (n == 0) {
+            unlink(path.c_str());
+            continue;
+        }
+        Stripe& s = stripe_of(user);
+        s.boxes[user].on_disk = n;
+        messages_.fetch_add(n, std::memory_order_relaxed);
+    }
+    closedir(d);
+}
+
+bool MailboxStore::append_file(const std::string& user, const std::string& buf) const {
+    std::string path = path_of(user);
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) return false;
+    struct stat st;
+    off_t before = (fstat(fd, &st) == 0) ? st.st_size : 0;
+    size_t off = 0;
+    while (off < buf.size()) {
+        ssize_t n = write(fd, buf.data() + off, buf.size() - off);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            // Sem registro pela metade: volta o arquivo ao tamanho anterior
+            int rc = ftruncate(fd, before);
+            (void)rc;
+            close(fd);
+            return false;
+        }
+        off += static_cast<size_t>(n);
+    }
+    close(fd);
+    return true;
+}
+
+bool MailboxStore::spill(const std::string& user, Box& box) {
+    std::string buf;
+    size_t bytes = 0;
+    for (size_t i = 0; i < box.memory.size(); ++i) {
+        put_record(buf, box.memory[i]->view());
+        bytes += box.memory[i]->size();
+    }
+    if (buf.empty()) return true;
+    if (!append_file(user, buf)) return false;
+
+    box.on_disk += box.memory.size();
+    stats_.spilled.fetch_add(box.memory.size(), std::memory_order_relaxed);
+    box.memory.clear();
+    memory_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    return true;
+}
+
+bool MailboxStore::full(const Stripe& s, const std::string& user) const {
+    auto it = s.boxes.find(user);
+    size_t held = (it == s.boxes.end()) ? 0 : it->second.memory.size() + it->second.on_disk;
+    return held >= opts_.max_messages;
+}
+
+MailboxStore::Result MailboxStore::deposit(const std::string& user, const MessageRef& msg) {
+    Stripe& s = stripe_of(user);
+    std::unique_lock<std::mutex> lk(s.mtx);
+    bool over = memory_bytes_.load(std::memory_order_relaxed) + msg->size() > opts_.memory_bytes;
+    if (full(s, user) || (over && opts_.dir.empty())) {
+        stats_.refused.fetch_add(1, std::memory_order_relaxed);
+        return Result::FULL;
+    }
+    if (!over) {
+        s.boxes[user].memory.push_back(msg);
+        memory_bytes_.fetch_add(msg->size(), std::memory_order_relaxed);
+        messages_.fetch_add(1, std::memory_order_relaxed);
+        stats_.stored.fetch_add(1, std::memory_order_relaxed);
+        return Result::STORED;
+    }
+
+    // Memria no limite: a caixa inteira vai para o disco junto com a nova.
+    // O arquivo  escrito fora do lock da faixa, que segue livre para as
+    // caixas em memria; file_mtx (sempre pego antes de mtx) pe em fila as
+    // gravaes e leituras de arquivos da faixa na ordem em que as mensagens
+    // saram da memria.
+    lk.unlock();
+    std::lock_guard<std::mutex> file_lg(s.file_mtx);
+    lk.lock();
+    if (full(s, user)) {
+        stats_.refused.fetch_add(1, std::memory_order_relaxed);
+        return Result::FULL;
+    }
+    Box& box = s.boxes[user];
+    std::vector<MessageRef> moved;
+    std::string buf;
+    size_t bytes = 0;
+    for (size_t i = 0; i < box.memory.size(); ++i) {
+        put_record(buf, box.memory[i]->view());
+        bytes += box.memory[i]->size();
+        moved.push_back(std::move(box.memory[i]));
+    }
+    put_record(buf, msg->view());
+    box.memory.clear();
+    // J contadas como em disco: uma entrega concorrente espera file_mtx
+    box.on_disk += moved.size() + 1;
+    memory_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    lk.unlock();
+
+    bool ok = append_file(user, buf);
+
+    lk.lock();
+    Box& after = s.boxes[user];  // s take apaga caixas com algo em disco, e take espera file_mtx
+    if (!ok) {
+        // As que estavam em memria voltam para a frente da caixa
+        after.on_disk -= moved.size() + 1;
+        for (size_t i = 0; i < after.memory.size(); ++i) moved.push_back(std::move(after.memory[i]));
+        after.memory.clear();
+        for (auto& m : moved) after.memory.push_back(std::move(m));
+        memory_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+        if (after.memory.empty() && after.on_disk == 0) s.boxes.erase(user);
+        return Result::FAILED;
+    }
+    messages_.fetch_add(1, std::memory_order_relaxed);
+    stats_.stored.fetch_add(1, std::memory_order_relaxed);
+    stats_.spilled.fetch_add(moved.size() + 1, std::memory_order_relaxed);
+    return Result::STORED;
+}
+
+size_t MailboxStore::take(const std::string& user, std::string& out) {
+    Stripe& s = stripe_of(user);
+    std::unique_lock<std::mutex> lk(s.mtx);
+    auto it = s.boxes.find(user);
+    if (it == s.boxes.end()) return 0;
+
+    // Com mensagens em disco o arquivo  lido fora do lock da faixa (veja
+    // deposit); file_mtx continua pego at o arquivo ser apagado, para que
+    // um transbordo novo no grave nele antes disso
+    std::unique_lock<std::mutex> file_lk;
+    if (it->second.on_disk > 0) {
+        lk.unlock();
+        file_lk = std::unique_lock<std::mutex>(s.file_mtx);
+        lk.lock();
+        it = s.boxes.find(user);
+        if (it == s.boxes.end()) return 0;
+    }
+    Box box = std::move(it->second);
+    s.boxes.erase(it);
+    size_t bytes = 0;
+    for (size_t i = 0; i < box.memory.size(); ++i) bytes += box.memory[i]->size();
+    messages_.fetch_sub(box.on_disk + box.memory.size(), std::memory_order_relaxed);
+    memory_bytes_.fetch_sub(bytes, std::memory_order_relaxed);
+    lk.unlock();
+
+    size_t n = 0;
+    if (box.on_disk > 0) {
+        std::string path = path_of(user);
+        std::string data;
+        if (read_file(path, data)) {
+            n += for_each_record(data, [&out](std::string_view m) { out.append(m.data(), m.size()); });
+        }
+        unlink(path.c_str());
+    }
+    for (size_t i = 0; i < box.memory.size(); ++i) out.append(box.memory[i]->data(), box.memory[i]->size());
+    n += box.memory.size();
+
+    stats_.delivered.fetch_add(n, std::memory_order_relaxed);
+    return n;
+}
+
+size_t MailboxStore::pending(const std::string& user) const {
+    Stripe& s = stripe_of(user);
+    std::lock_guard<std::mutex> lg(s.mtx);
+    auto it = s.boxes.find(user);
+    return (it == s.boxes.end()) ? 0 : it->second.memory.size() + it->second.on_disk;
+}
+
+size_t MailboxStore::spill_all() {
+    if (opts_.dir.empty()) return 0;
+    size_t before = stats_.spilled.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < STRIPES; ++i) {
+        Stripe& s = stripes_[i];
+        std::lock_guard<std::mutex> file_lg(s.file_mtx);
+        std::lock_guard<std::mutex> lg(s.mtx);
+        for (auto& [user, box] : s.boxes) {
+            if (!box.memory.empty()) spill(user, box);
+        }
+    }
+    return stats_.spilled.load(std::memory_order_relaxed) - before;
+}
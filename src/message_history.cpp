@@ -0,0 +1,58 @@
+#include "message_history.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HISTORY_CPU_RELAX() _mm_pause()
+#else
+#define HISTORY_CPU_RELAX() do {} while (0)
+#endif
+
+MessageHistory::MessageHistory(size_t capacity)
+    : capacity_(capacity ? capacity : 1), slots_(new Slot[capacity_]) {}
+
+void MessageHistory::lock(Slot& s) {
+    while (s.busy.test_and_set(std::memory_order_acquire)) {
+        HISTORY_CPU_RELAX();
+    }
+}
+
+void MessageHistory::unlock(Slot& s) {
+    s.busy.clear(std::memory_order_release);
+}
+
+void MessageHistory::add(MessageRef msg) {
+    uint64_t i = head_.fetch_add(1, std::memory_order_acq_rel);
+    Slot& s = slots_[i % capacity_];
+
+    lock(s);
+    // Um escritor que parou entre o fetch_add e a trava pode chegar depois
+    // de i + capacity_ j ter ocupado a posio: a mensagem dele j saiu da
+    // janela e fica de fora, sem voltar seq para trs
+    if (s.seq.load(std::memory_order_relaxed) <= i) {
+        msg.swap(s.ref);
+        s.seq.store(i + 1, std::memory_order_release);
+    }
+    unlock(s);
+
+    // A mensagem antiga (agora em msg), ou a descartada,  liberada fora da
+    // trava
+}
+
+std::vector<MessageRef> MessageHistory::get_recent(size_t n) const {
+    uint64_t h = head_.load(std::memory_order_acquire);
+    uint64_t count = std::min<uint64_t>({n, capacity_, h});
+
+    std::vector<MessageRef> out;
+    out.reserve(count);
+    for (uint64_t i = h - count; i < h; ++i) {
+        Slot& s = slots_[i % capacity_];
+        lock(s);
+        if (s.seq.load(std::memory_order_relaxed) == i + 1) {
+            out.push_back(s.ref);
+        }
+        unlock(s);
+    }
+    return out;
+}
@@ -0,0 +1,377 @@
+#include "metrics.hpp"
+
+#include <sstream>
+#include <iterator>
+#include <cstdio>
+#include <cstring>
+#include <cerrno>
+#include <stdexcept>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <unistd.h>
+
+
+namespace metrics {
+
+unsigned thread_slot() {
+    static std::atomic<unsigned> next{0};
+    thread_local unsigned slot = next.fetch_add(1, std::memory_order_relaxed) % MAX_SLOTS;
+    return slot;
+}
+
+Counter& syscalls(Syscall s) {
+    static Counter counters[static_cast<size_t>(Syscall::COUNT)];
+    return counters[static_cast<size_t>(s)];
+}
+
+const char* syscall_name(Syscall s) {
+    switch (s) {
+        case Syscall::ACCEPT:      return "accept";
+        case Syscall::RECV:        return "recv";
+        case Syscall::SEND:        return "send";
+        case Syscall::EPOLL_WAIT:  return "epoll_wait";
+        case Syscall::URING_ENTER: return "io_uring_enter";
+        case Syscall::OTHER:       return "other";
+        default: return "?";
+    }
+}
+
+}
+
+
+uint64_t Counter::value() const {
+    uint64_t sum = 0;
+    for (const auto& c : cells_) sum += c.v.load(std::memory_order_relaxed);
+    return sum;
+}
+
+int64_t Gauge::value() const {
+    int64_t sum = 0;
+    for (const auto& c : cells_) sum += c.v.load(std::memory_order_relaxed);
+    return sum;
+}
+
+
+LatencyHistogram::~LatencyHistogram() {
+    for (auto& c : cells_) delete c.load(std::memory_order_relaxed);
+}
+
+Histogram& LatencyHistogram::allocate(unsigned slot) {
+    Histogram* fresh = new Histogram();
+    Histogram* expected = nullptr;
+    if (!cells_[slot].compare_exchange_strong(expected, fresh, std::memory_order_acq_rel)) {
+        // Outra thread da mesma clula chegou antes
+        delete fresh;
+        return *expected;
+    }
+    return *fresh;
+}
+
+void LatencyHistogram::snapshot(Histogram& out) const {
+    for (const auto& c : cells_) {
+        if (const Histogram* h = c.load(std::memory_order_acquire)) out.merge(*h);
+    }
+}
+
+
+MetricsRegistry::Entry& MetricsRegistry::add(Kind kind, const std::string& name,
+                                             const std::string& help, const std::string& labels) {
+    auto e = std::make_unique<Entry>();
+    e->kind = kind;
+    e->name = name;
+    e->help = help;
+    e->labels = labels;
+    std::lock_guard<std::mutex> lg(mtx_);
+    entries_.push_back(std::move(e));
+    return *entries_.back();
+}
+
+Counter& MetricsRegistry::counter(const std::string& name, const std::string& help,
+                                  const std::string& labels) {
+    Entry& e = add(Kind::COUNTER, name, help, labels);
+    e.counter = std::make_unique<Counter>();
+    return *e.counter;
+}
+
+Gauge& MetricsRegistry::gauge(const std::string& name, const std::string& help,
+                              const std::string& labels) {
+    Entry& e = add(Kind::GAUGE, name, help, labels);
+    e.gauge = std::make_unique<Gauge>();
+    return *e.gauge;
+}
+
+LatencyHistogram& MetricsRegistry::histogram(const std::string& name, const std::string& help,
+                                             const std::string& labels) {
+    Entry& e = add(Kind::HISTOGRAM, name, help, labels);
+    e.histogram = std::make_unique<LatencyHistogram>();
+    return *e.histogram;
+}
+
+void MetricsRegistry::gauge_fn(const std::string& name, const std::string& help,
+                               std::function<int64_t()> fn, const std::string& labels) {
+    Entry& e = add(Kind::GAUGE_FN, name, help, labels);
+    e.fn = std::move(fn);
+}
+
+void MetricsRegistry::counter_fn(const std::string& name, const std::string& help,
+                                 std::function<uint64_t()> fn, const std::string& labels) {
+    Entry& e = add(Kind::COUNTER_FN, name, help, labels);
+    e.counter_fn = std::move(fn);
+}
+
+
+// Limites dos buckets exportados, em nanossegundos: 1-2,5-5 por dcada
+static const uint64_t EXPORT_BOUNDS_NS[] = {
+    1000, 2500, 5000,
+    10000, 25000, 50000,
+    100000, 250000, 500000,
+    1000000, 2500000, 5000000,
+    10000000, 25000000, 50000000,
+    100000000, 250000000, 500000000,
+    1000000000, 2500000000, 5000000000, 10000000000
+};
+
+static std::string seconds(uint64_t ns) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.9g", ns / 1e9);
+    return buf;
+}
+
+static std::string with_label(const std::string& labels, const std::string& extra) {
+    if (labels.empty()) return "{" + extra + "}";
+    return "{" + labels + "," + extra + "}";
+}
+
+// Sem checar sobrelongas nem substitutos: basta para decidir a converso
+static bool valid_utf8(const std::string& s) {
+    size_t i = 0;
+    while (i < s.size()) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        size_t n = c < 0x80 ? 0 : (c >> 5) == 0x6 ? 1 : (c >> 4) == 0xe ? 2 : (c >> 3) == 0x1e ? 3 : 4;
+        if (n == 4 || s.size() - i <= n) return false;
+        for (size_t k = 1; k <= n; ++k) {
+            if ((static_cast<unsigned char>(s[i + k]) & 0xc0) != 0x80) return false;
+        }
+        i += n + 1;
+    }
+    return true;
+}
+
+// HELP no formato de exposio: UTF-8, com '\' e quebra de linha escapados.
+// Os fontes so Latin-1, ento um texto que no  UTF-8 vlido  convertido
+// byte a byte.
+static std::string help_text(const std::string& s) {
+    bool latin1 = !valid_utf8(s);
+    std::string out;
+    out.reserve(s.size() + 8);
+    for (char ch : s) {
+        unsigned char c = static_cast<unsigned char>(ch);
+        if (c == '\\') {
+            out += "\\\\";
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (latin1 && c >= 0x80) {
+            out += static_cast<char>(0xc0 | (c >> 6));
+            out += static_cast<char>(0x80 | (c & 0x3f));
+        } else {
+            out += ch;
+        }
+    }
+    return out;
+}
+
+std::string MetricsRegistry::render_prometheus() const {
+    std::lock_guard<std::mutex> lg(mtx_);
+    std::ostringstream os;
+    std::vector<bool> done(entries_.size(), false);
+
+    for (size_t i = 0; i < entries_.size(); ++i) {
+        if (done[i]) continue;
+        const Entry& head = *entries_[i];
+        const char* type = (head.kind == Kind::COUNTER || head.kind == Kind::COUNTER_FN) ? "counter"
+                         : head.kind == Kind::HISTOGRAM ? "histogram" : "gauge";
+        os << "# HELP " << head.name << ' ' << help_text(head.help) << '\n'
+           << "# TYPE " << head.name << ' ' << type << '\n';
+
+        // Todas as sries da famlia, na ordem de registro
+        for (size_t j = i; j < entries_.size(); ++j) {
+            const Entry& e = *entries_[j];
+            if (done[j] || e.name != head.name) continue;
+            done[j] = true;
+            std::string lbl = e.labels.empty() ? "" : "{" + e.labels + "}";
+
+            switch (e.kind) {
+                case Kind::COUNTER:
+                    os << e.name << lbl << ' ' << e.counter->value() << '\n';
+                    break;
+                case Kind::COUNTER_FN:
+                    os << e.name << lbl << ' ' << e.counter_fn() << '\n';
+                    break;
+                case Kind::GAUGE:
+                    os << e.name << lbl << ' ' << e.gauge->value() << '\n';
+                    break;
+                case Kind::GAUGE_FN:
+                    os << e.name << lbl << ' ' << e.fn() << '\n';
+                    break;
+                case Kind::HISTOGRAM: {
+                    Histogram h;
+                    e.histogram->snapshot(h);
+                    // Cumulativo por limite; as faixas internas no coincidem
+                    // com os limites, ento cada faixa conta no primeiro
+                    // limite que a cobre inteira
+                    std::vector<uint64_t> cum(std::size(EXPORT_BOUNDS_NS), 0);
+                    h.for_each_bucket([&](uint64_t upper, uint64_t count) {
+                        for (size_t b = 0; b < cum.size(); ++b) {
+                            if (upper <= EXPORT_BOUNDS_NS[b]) cum[b] += count;
+                        }
+                    });
+                    for (size_t b = 0; b < cum.size(); ++b) {
+                        os << e.name << "_bucket" << with_label(e.labels, "le=\"" + seconds(EXPORT_BOUNDS_NS[b]) + "\"")
+                           << ' ' << cum[b] << '\n';
+                    }
+                    os << e.name << "_bucket" << with_label(e.labels, "le=\"+Inf\"") << ' ' << h.count() << '\n'
+                       << e.name << "_sum" << lbl << ' ' << seconds(h.sum()) << '\n'
+                       << e.name << "_count" << lbl << ' ' << h.count() << '\n';
+                    break;
+                }
+            }
+        }
+    }
+    return os.str();
+}
+
+static std::string micros(uint64_t ns) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "%.1f", ns / 1000.0);
+    return buf;
+}
+
+std::string MetricsRegistry::render_text() const {
+    std::lock_guard<std::mutex> lg(mtx_);
+    std::ostringstream os;
+    for (const auto& ep : entries_) {
+        const Entry& e = *ep;
+        os << "  " << e.name;
+        if (!e.labels.empty()) os << '{' << e.labels << '}';
+        os << ": ";
+        switch (e.kind) {
+            case Kind::COUNTER:  os << e.counter->value(); break;
+            case Kind::COUNTER_FN: os << e.counter_fn(); break;
+            case Kind::GAUGE:    os << e.gauge->value(); break;
+            case Kind::GAUGE_FN: os << e.fn(); break;
+            case Kind::HISTOGRAM: {
+                Histogram h;
+                e.histogram->snapshot(h);
+                os << h.count() << " amostra(s)";
+                if (h.count()) {
+                    os << ", p50 " << micros(h.percentile(0.5)) << " us, p99 "
+                       << micros(h.percentile(0.99)) << " us, p999 " << micros(h.percentile(0.999))
+                       << " us, mx " << micros(h.max()) << " us";
+                }
+                break;
+            }
+        }
+        os << '\n';
+    }
+    return os.str();
+}
+
+
+MetricsServer::MetricsServer(const MetricsRegistry& registry, int port, const std::string& unix_path)
+    : registry_(registry), unix_path_(unix_path) {
+    if (port > 0) {
+        tcp_fd_ = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        int opt = 1;
+        setsockopt(tcp_fd_, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(static_cast<uint16_t>(port));
+        if (tcp_fd_ < 0 || bind(tcp_fd_, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(tcp_fd_, 16) < 0) {
+            std::string err = "mtricas: porta " + std::to_string(port) + ": " + strerror(errno);
+            if (tcp_fd_ >= 0) close(tcp_fd_);
+            throw std::runtime_error(err);
+        }
+    }
+
+    if (!unix_path.empty()) {
+        sockaddr_un addr{};
+        if (unix_path.size() >= sizeof(addr.sun_path)) {
+            if (tcp_fd_ >= 0) close(tcp_fd_);
+            throw std::runtime_error("mtricas: caminho do socket muito longo");
+        }
+        addr.sun_family = AF_UNIX;
+        std::memcpy(addr.sun_path, unix_path.c_str(), unix_path.size() + 1);
+        unlink(unix_path.c_str());
+        unix_fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (unix_fd_ < 0 || bind(unix_fd_, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(unix_fd_, 16) < 0) {
+            std::string err = "mtricas: " + unix_path + ": " + strerror(errno);
+            if (unix_fd_ >= 0) close(unix_fd_);
+            if (tcp_fd_ >= 0) close(tcp_fd_);
+            throw std::runtime_error(err);
+        }
+    }
+
+    if (tcp_fd_ < 0 && unix_fd_ < 0) throw std::runtime_error("mtricas: nenhum endpoint configurado");
+    thr_ = std::thread([this] { run(); });
+}
+
+MetricsServer::~MetricsServer() {
+    stop_.store(true);
+    if (thr_.joinable()) thr_.join();
+    if (tcp_fd_ >= 0) close(tcp_fd_);
+    if (unix_fd_ >= 0) {
+        close(unix_fd_);
+        unlink(unix_path_.c_str());
+    }
+}
+
+// poll() com prazo curto para notar o stop_ sem precisar de outro fd
+void MetricsServer::run() {
+    pollfd pfds[2];
+    int n = 0;
+    if (tcp_fd_ >= 0) pfds[n++] = {tcp_fd_, POLLIN, 0};
+    if (unix_fd_ >= 0) pfds[n++] = {unix_fd_, POLLIN, 0};
+
+    while (!stop_.load()) {
+        if (poll(pfds, n, 200) <= 0) continue;
+        for (int i = 0; i < n; ++i) {
+            if (!(pfds[i].revents & POLLIN)) continue;
+            int cfd = accept4(pfds[i].fd, nullptr, nullptr, SOCK_CLOEXEC);
+            if (cfd >= 0) serve(cfd);
+        }
+    }
+}
+
+void MetricsServer::serve(int fd) {
+    // L o cabealho da requisio (at a linha em branco ou 200 ms); o
+    // caminho no importa, qualquer GET recebe as mtricas
+    timeval tv{0, 200000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &tv, sizeof(tv));
+    std::string req;
+    char buf[1024];
+    while (req.size() < 8192 && req.find("\r\n\r\n") == std::string::npos &&
+           req.find("\n\n") == std::string::npos) {
+        ssize_t r = recv(fd, buf, sizeof(buf), 0);
+        if (r <= 0) break;
+        req.append(buf, static_cast<size_t>(r));
+    }
+
+    std::string body = registry_.render_prometheus();
+    std::string resp = "HTTP/1.0 200 OK\r\n"
+                       "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                       "Content-Length: " + std::to_string(body.size()) + "\r\n"
+                       "Connection: close\r\n\r\n" + body;
+    size_t off = 0;
+    while (off < resp.size()) {
+        ssize_t w = send(fd, resp.data() + off, resp.size() - off, MSG_NOSIGNAL);
+        if (w <= 0) break;
+        off += static_cast<size_t>(w);
+    }
+    close(fd);
+}
@@ -0,0 +1,124 @@
+#include "outbound_queue.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "metrics.hpp"
+
+constexpr size_t MAX_IOV = 64;
+
+bool parse_overflow_policy(const std::string& s, OverflowPolicy& out) {
+    if (s == "drop-oldest") out = OverflowPolicy::DROP_OLDEST;
+    else if (s == "drop-new") out = OverflowPolicy::DROP_NEW;
+    else if (s == "disconnect") out = OverflowPolicy::DISCONNECT;
+    else return false;
+    return true;
+}
+
+std::string overflow_policy_to_string(OverflowPolicy p) {
+    switch (p) {
+        case OverflowPolicy::DROP_OLDEST: return "drop-oldest";
+        case OverflowPolicy::DROP_NEW:    return "drop-new";
+        case OverflowPolicy::DISCONNECT:  return "disconnect";
+        default: return "?";
+    }
+}
+
+OutboundQueue::OutboundQueue(size_t max_msgs, OverflowPolicy policy)
+    : max_msgs_(max_msgs ? max_msgs : 1), policy_(policy) {}
+
+bool OutboundQueue::push(Payload msg) {
+    if (q_.size() >= max_msgs_) {
+        switch (policy_) {
+            case OverflowPolicy::DISCONNECT:
+                return false;
+
+            case OverflowPolicy::DROP_NEW:
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return true;
+
+            case OverflowPolicy::DROP_OLDEST: {
+                // Mensagens j parcialmente no socket ou num envio em
+                // andamento no podem sair sem corromper o fluxo; sai a
+                // primeira depois delas
+                size_t keep = std::max<size_t>(pinned_, head_off_ > 0 ? 1 : 0);
+                if (q_.size() <= keep) {
+                    dropped_.fetch_add(1, std::memory_order_relaxed);
+                    return true;
+                }
+                q_.erase(keep);
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                break;
+            }
+        }
+    }
+
+    q_.push_back(std::move(msg));
+    update_depth();
+    return true;
+}
+
+bool OutboundQueue::flush(int fd) {
+    while (!q_.empty()) {
+        iovec iov[MAX_IOV];
+        size_t cnt = gather(iov, MAX_IOV);
+
+        msghdr mh{};
+        mh.msg_iov = iov;
+        mh.msg_iovlen = cnt;
+        metrics::syscalls(metrics::Syscall::SEND).inc();
+        ssize_t n = sendmsg(fd, &mh, MSG_NOSIGNAL | MSG_DONTWAIT);
+        if (n < 0) {
+            release();
+            if (errno == EINTR) continue;
+            update_depth();
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        consume(static_cast<size_t>(n));
+
+        // Escrita parcial: o buffer do socket encheu
+        if (!q_.empty() && head_off_ > 0) break;
+    }
+
+    update_depth();
+    return true;
+}
+
+size_t OutboundQueue::gather(iovec* iov, size_t max) {
+    size_t cnt = 0;
+    for (; cnt < q_.size() && cnt < max; ++cnt) {
+        const MessageBuffer& s = *q_[cnt];
+        size_t off = (cnt == 0) ? head_off_ : 0;
+        iov[cnt].iov_base = const_cast<char*>(s.data() + off);
+        iov[cnt].iov_len = s.size() - off;
+    }
+    pinned_ = cnt;
+    return cnt;
+}
+
+void OutboundQueue::consume(size_t bytes) {
+    pinned_ = 0;
+    sent_bytes_.fetch_add(static_cast<uint64_t>(bytes), std::memory_order_relaxed);
+    writes_.fetch_add(1, std::memory_order_relaxed);
+
+    // Remove as mensagens enviadas por completo
+    uint64_t done = 0;
+    while (bytes > 0 && !q_.empty()) {
+        size_t rem = q_.front()->size() - head_off_;
+        if (bytes >= rem) {
+            bytes -= rem;
+            head_off_ = 0;
+            q_.pop_front();
+            ++done;
+        } else {
+            head_off_ += bytes;
+            bytes = 0;
+        }
+    }
+    sent_msgs_.fetch_add(done, std::memory_order_relaxed);
+    update_depth();
+}
@@ -0,0 +1,162 @@
+#include "presence.hpp"
+
+#include <algorithm>
+#include <functional>
+
+
+PresenceRegistry::PresenceRegistry(size_t page_size, LockStats* lock_stats)
+    : page_size_(page_size ? page_size : 1), lock_stats_(lock_stats), stripes_(new Stripe[STRIPES]) {
+    for (size_t i = 0; i < STRIPES; ++i) stripes_[i].table.store(new Table());
+}
+
+// Sem leitores neste ponto: libera direto o que ainda est publicado
+PresenceRegistry::~PresenceRegistry() {
+    for (size_t i = 0; i < STRIPES; ++i) delete stripes_[i].table.load();
+    delete listing_.load();
+}
+
+PresenceRegistry::Stripe& PresenceRegistry::stripe_of(const std::string& name) const {
+    return stripes_[std::hash<std::string>{}(name) % STRIPES];
+}
+
+template <typename F>
+void PresenceRegistry::locked(Stripe& s, F&& f) {
+    if (lock_stats_) {
+        TimedLockGuard<std::mutex> lg(s.write_mtx, *lock_stats_);
+        f();
+    } else {
+        std::lock_guard<std::mutex> lg(s.write_mtx);
+        f();
+    }
+}
+
+static bool by_name(const std::string& a, const std::string& b) { return a < b; }
+
+bool PresenceRegistry::add(const std::string& name, const Member& member) {
+    Stripe& s = stripe_of(name);
+    const Table* old = nullptr;
+    locked(s, [&] {
+        const Table* cur = s.table.load(std::memory_order_relaxed);
+        auto it = std::lower_bound(cur->begin(), cur->end(), name,
+                                   [](const Entry& e, const std::string& n) { return by_name(e.name, n); });
+        if (it != cur->end() && it->name == name) return;
+
+        auto* next = new Table();
+        next->reserve(cur->size() + 1);
+        next->insert(next->end(), cur->begin(), it);
+        next->push_back({name, member});
+        next->insert(next->end(), it, cur->end());
+        s.table.store(next, std::memory_order_release);
+        old = cur;
+    });
+    if (!old) return false;
+
+    size_.fetch_add(1, std::memory_order_relaxed);
+    version_.fetch_add(1, std::memory_order_release);
+    rcu::retire([old] { delete old; });
+    return true;
+}
+
+bool PresenceRegistry::remove(const std::string& name, const ClientInfo* member) {
+    Stripe& s = stripe_of(name);
+    const Table* old = nullptr;
+    locked(s, [&] {
+        const Table* cur = s.table.load(std::memory_order_relaxed);
+        auto it = std::lower_bound(cur->begin(), cur->end(), name,
+                                   [](const Entry& e, const std::string& n) { return by_name(e.name, n); });
+        if (it == cur->end() || it->name != name || it->member.get() != member) return;
+
+        auto* next = new Table();
+        next->reserve(cur->size() - 1);
+        next->insert(next->end(), cur->begin(), it);
+        next->insert(next->end(), it + 1, cur->end());
+        s.table.store(next, std::memory_order_release);
+        old = cur;
+    });
+    if (!old) return false;
+
+    size_.fetch_sub(1, std::memory_order_relaxed);
+    version_.fetch_add(1, std::memory_order_release);
+    rcu::retire([old] { delete old; });
+    return true;
+}
+
+PresenceRegistry::Member PresenceRegistry::find(const std::string& name) const {
+    rcu::ReadGuard guard;
+    const Table* t = stripe_of(name).table.load(std::memory_order_acquire);
+    auto it = std::lower_bound(t->begin(), t->end(), name,
+                               [](const Entry& e, const std::string& n) { return by_name(e.name, n); });
+    return (it != t->end() && it->name == name) ? it->member : nullptr;
+}
+
+MessageRef PresenceRegistry::render(const std::vector<std::string>& names, size_t begin, size_t end,
+                                    size_t page, size_t pages, size_t total,
+                                    const std::string& prefix) const {
+    std::string out = "[SISTEMA] Usurios online";
+    if (!prefix.empty()) out += " com prefixo '" + prefix + "'";
+    out += " (" + std::to_string(total) + ")";
+    if (pages > 1) out += ", pgina " + std::to_string(page) + "/" + std::to_string(pages);
+    out += ": ";
+    for (size_t i = begin; i < end; ++i) {
+        if (i > begin) out += ", ";
+        out += names[i];
+    }
+    out += '\n';
+    return make_message(std::move(out));
+}
+
+// Chamado dentro de uma seo de leitura. A listagem s  refeita quando a
+// verso mudou desde a ltima; quem chega enquanto outro reconstri espera
+// por ela em vez de refazer o mesmo trabalho.
+const PresenceRegistry::Listing* PresenceRegistry::current_listing() {
+    const Listing* l = listing_.load(std::memory_order_acquire);
+    if (l && l->version == version()) return l;
+
+    std::lock_guard<std::mutex> lg(listing_mtx_);
+    l = listing_.load(std::memory_order_acquire);
+    uint64_t v = version();
+    if (l && l->version == v) return l;
+
+    // A verso  lida antes de percorrer as faixas: uma mudana durante a
+    // varredura deixa a listagem com verso velha e ela  refeita na prxima
+    auto* next = new Listing();
+    next->version = v;
+    for_each([next](const std::string& name, const Member&) { next->names.push_back(name); });
+    std::sort(next->names.begin(), next->names.end());
+
+    size_t total = next->names.size();
+    size_t pages = std::max<size_t>(1, (total + page_size_ - 1) / page_size_);
+    next->pages.reserve(pages);
+    for (size_t p = 0; p < pages; ++p) {
+        size_t begin = p * page_size_;
+        next->pages.push_back(render(next->names, begin, std::min(total, begin + page_size_),
+                                     p + 1, pages, total, ""));
+    }
+
+    listing_.store(next, std::memory_order_release);
+    if (l) rcu::retire([l] { delete l; });
+    return next;
+}
+
+MessageRef PresenceRegistry::page(size_t page) {
+    rcu::ReadGuard guard;
+    const Listing* l = current_listing();
+    if (page == 0 || page > l->pages.size()) return nullptr;
+    return l->pages[page - 1];
+}
+
+MessageRef PresenceRegistry::search(const std::string& prefix, size_t page) {
+    rcu::ReadGuard guard;
+    const Listing* l = current_listing();
+    const auto& names = l->names;
+    auto first = std::lower_bound(names.begin(), names.end(), prefix);
+    auto last = first;
+    while (last != names.end() && last->compare(0, prefix.size(), prefix) == 0) ++last;
+
+    size_t total = static_cast<size_t>(last - first);
+    size_t pages = std::max<size_t>(1, (total + page_size_ - 1) / page_size_);
+    if (page == 0 || page > pages) return nullptr;
+    size_t begin = static_cast<size_t>(first - names.begin()) + (page - 1) * page_size_;
+    size_t end = std::min(begin + page_size_, static_cast<size_t>(last - names.begin()));
+    return render(names, begin, end, page, pages, total, prefix);
+}
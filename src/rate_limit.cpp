@@ -0,0 +1,142 @@
+#include "rate_limit.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+
+namespace {
+
+// Finalizador do splitmix64: espalha chaves parecidas (endereos vizinhos)
+// pelas faixas e posies
+uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    x ^= x >> 31;
+    return x;
+}
+
+} // namespace
+
+
+bool parse_rate_limit(const std::string& s, BucketLimit& out) {
+    size_t colon = s.find(':');
+    try {
+        size_t used = 0;
+        std::string rate = s.substr(0, colon);
+        double r = std::stod(rate, &used);
+        if (used != rate.size() || !std::isfinite(r) || r < 0) return false;
+        double b = std::max(r, 1.0);
+        if (colon != std::string::npos) {
+            std::string burst = s.substr(colon + 1);
+            b = std::stod(burst, &used);
+            if (used != burst.size() || !std::isfinite(b) || b < 1) return false;
+        }
+        out.rate = r;
+        out.burst = r > 0 ? b : 0;
+    } catch (...) {
+        return false;
+    }
+    return true;
+}
+
+std::string rate_limit_to_string(const BucketLimit& l) {
+    if (!l.enabled()) return "sem limite";
+    std::ostringstream os;
+    os << l.rate << "/s, rajada " << l.burst;
+    return os.str();
+}
+
+
+RateLimiter::RateLimiter(BucketLimit first, BucketLimit second, size_t capacity)
+    : first_(first), second_(second), stripes_(new Stripe[STRIPES]) {
+    per_stripe_ = PROBE;
+    while (per_stripe_ * STRIPES < capacity) per_stripe_ *= 2;
+    slots_.assign(per_stripe_ * STRIPES, Slot{0, 0, {0, 0}});
+}
+
+uint64_t RateLimiter::key_of(std::string_view s) {
+    // FNV-1a
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : s) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h ? h : 1;
+}
+
+uint64_t RateLimiter::key_of(uint32_t v) {
+    return (1ULL << 32) | v;
+}
+
+// Todos os baldes ligados estariam cheios agora
+bool RateLimiter::idle(const Slot& s, uint64_t now_ns) const {
+    double secs = now_ns > s.stamp_ns ? (now_ns - s.stamp_ns) * 1e-9 : 0;
+    const BucketLimit* limits[2] = {&first_, &second_};
+    for (int i = 0; i < 2; ++i) {
+        const BucketLimit& l = *limits[i];
+        if (l.enabled() && s.tokens[i] + secs * l.rate < l.burst) return false;
+    }
+    return true;
+}
+
+void RateLimiter::refill(Slot& s, uint64_t now_ns) const {
+    if (now_ns <= s.stamp_ns) return;
+    double secs = (now_ns - s.stamp_ns) * 1e-9;
+    s.tokens[0] = std::min(first_.burst, s.tokens[0] + secs * first_.rate);
+    s.tokens[1] = std::min(second_.burst, s.tokens[1] + secs * second_.rate);
+    s.stamp_ns = now_ns;
+}
+
+RateVerdict RateLimiter::take(uint64_t key, uint64_t now_ns, double first_cost, double second_cost) {
+    if (!enabled()) return RateVerdict::ALLOW;
+    uint64_t h = mix(key);
+    Stripe& st = stripes_[h >> 58];  // 64 faixas: os 6 bits de cima
+    Slot* base = slots_.data() + (h >> 58) * per_stripe_;
+    size_t mask = per_stripe_ - 1;
+
+    std::lock_guard<std::mutex> lg(st.mtx);
+    Slot* hit = nullptr;
+    Slot* reuse = nullptr;
+    Slot* oldest = nullptr;
+    for (size_t i = 0; i < PROBE; ++i) {
+        Slot& s = base[(h + i) & mask];
+        if (s.key == key) {
+            hit = &s;
+            break;
+        }
+        if (!reuse && (s.key == 0 || idle(s, now_ns))) reuse = &s;
+        if (!oldest || s.stamp_ns < oldest->stamp_ns) oldest = &s;
+    }
+    if (!hit) {
+        // Chave nova (ou esquecida): comea com os baldes cheios
+        hit = reuse;
+        if (!hit) {
+            hit = oldest;
+            evictions_.fetch_add(1, std::memory_order_relaxed);
+        }
+        *hit = Slot{key, now_ns, {first_.burst, second_.burst}};
+    } else {
+        refill(*hit, now_ns);
+    }
+
+    first_cost = std::min(first_cost, first_.burst);
+    second_cost = std::min(second_cost, second_.burst);
+    if (first_.enabled() && hit->tokens[0] < first_cost) return RateVerdict::DENY_FIRST;
+    if (second_.enabled() && hit->tokens[1] < second_cost) return RateVerdict::DENY_SECOND;
+    if (first_.enabled()) hit->tokens[0] -= first_cost;
+    if (second_.enabled()) hit->tokens[1] -= second_cost;
+    return RateVerdict::ALLOW;
+}
+
+size_t RateLimiter::size() const {
+    size_t total = 0;
+    for (size_t i = 0; i < STRIPES; ++i) {
+        std::lock_guard<std::mutex> lg(stripes_[i].mtx);
+        const Slot* base = slots_.data() + i * per_stripe_;
+        total += std::count_if(base, base + per_stripe_, [](const Slot& s) { return s.key != 0; });
+    }
+    return total;
+}
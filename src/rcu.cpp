@@ -0,0 +1,113 @@
+#include "rcu.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+
+
+namespace rcu {
+
+namespace {
+
+// Registro de um leitor. Os registros nunca so liberados: quando a thread
+// termina o registro volta a ficar livre para outra thread.
+struct alignas(64) Reader {
+    std::atomic<uint64_t> epoch{0};   // 0 = fora de seo de leitura
+    std::atomic<bool> in_use{true};
+    Reader* next = nullptr;
+};
+
+std::atomic<Reader*> readers{nullptr};
+std::atomic<uint64_t> global_epoch{1};
+
+struct Retired {
+    uint64_t epoch;
+    std::function<void()> free;
+};
+
+std::mutex retire_mtx;
+std::vector<Retired> retired;
+
+Reader* acquire_reader() {
+    for (Reader* r = readers.load(std::memory_order_acquire); r; r = r->next) {
+        bool expected = false;
+        if (r->in_use.compare_exchange_strong(expected, true)) return r;
+    }
+    Reader* r = new Reader();
+    r->next = readers.load(std::memory_order_relaxed);
+    while (!readers.compare_exchange_weak(r->next, r, std::memory_order_release)) {}
+    return r;
+}
+
+struct LocalReader {
+    Reader* reader = nullptr;
+    unsigned depth = 0;
+
+    ~LocalReader() {
+        if (reader) reader->in_use.store(false);
+    }
+};
+
+thread_local LocalReader local;
+
+}
+
+
+// store e load seq_cst: o escritor que no enxergar esta poca tambm fez
+// sua publicao antes, ento o ponteiro lido aqui j  o novo
+ReadGuard::ReadGuard() {
+    if (local.depth++ > 0) return;
+    if (!local.reader) local.reader = acquire_reader();
+    local.reader->epoch.store(global_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+}
+
+ReadGuard::~ReadGuard() {
+    if (--local.depth == 0) local.reader->epoch.store(0, std::memory_order_release);
+}
+
+void retire(std::function<void()> free) {
+    {
+        std::lock_guard<std::mutex> lg(retire_mtx);
+        uint64_t e = global_epoch.fetch_add(1, std::memory_order_seq_cst);
+        retired.push_back({e, std::move(free)});
+    }
+    reclaim();
+}
+
+void reclaim() {
+    std::vector<Retired> ready;
+    {
+        std::lock_guard<std::mutex> lg(retire_mtx);
+        if (retired.empty()) return;
+
+        // Menor poca entre os leitores ativos
+        uint64_t min_active = UINT64_MAX;
+        for (Reader* r = readers.load(std::memory_order_acquire); r; r = r->next) {
+            uint64_t e = r->epoch.load(std::memory_order_seq_cst);
+            if (e != 0 && e < min_active) min_active = e;
+        }
+
+        // Aposentado na poca e: s leitores que entraram em e ou antes
+        // podem ter o ponteiro antigo
+        size_t keep = 0;
+        for (size_t i = 0; i < retired.size(); ++i) {
+            if (retired[i].epoch < min_active) {
+                ready.push_back(std::move(retired[i]));
+            } else {
+                if (keep != i) retired[keep] = std::move(retired[i]);
+                ++keep;
+            }
+        }
+        retired.resize(keep);
+    }
+    // Fora do lock: o free pode acabar destruindo objetos que usam RCU
+    for (auto& item : ready) item.free();
+}
+
+size_t pending() {
+    std::lock_guard<std::mutex> lg(retire_mtx);
+    return retired.size();
+}
+
+}
@@ -0,0 +1,463 @@
+#include "reactor.hpp"
+#include "uring.hpp"
+#include "metrics.hpp"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+constexpr int MAX_EVENTS = 256;
+constexpr unsigned URING_ENTRIES = 1024;
+constexpr uint16_t RECV_GROUP = 0;
+constexpr unsigned RECV_BUFFERS = 512;
+constexpr unsigned RECV_BUFFER_SIZE = 4096;
+
+using metrics::Syscall;
+
+enum OpKind { OP_WAKE, OP_POLL, OP_ACCEPT, OP_RECV, OP_SEND };
+
+// Operao em andamento no io_uring. O endereo vai no user_data; o objeto
+// volta para a lista de livres s na ltima concluso da operao.
+struct EventLoop::Op {
+    int kind = OP_POLL;
+    int fd = -1;
+    uint32_t gen = 0;  // fd_gen_[fd] quando a operao foi criada
+    uint32_t events = 0;
+    AcceptHandler on_accept;
+    RecvHandler on_recv;
+    SendHandler on_send;
+    msghdr mh{};
+    iovec iov[MAX_SEND_IOV];
+};
+
+bool parse_io_backend(const std::string& s, IoBackend& out) {
+    if (s == "epoll") out = IoBackend::EPOLL;
+    else if (s == "uring" || s == "io_uring") out = IoBackend::URING;
+    else return false;
+    return true;
+}
+
+std::string io_backend_to_string(IoBackend b) {
+    return b == IoBackend::URING ? "uring" : "epoll";
+}
+
+EventLoop::EventLoop(IoBackend backend) {
+    wakefd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakefd_ < 0) {
+        throw std::runtime_error("Falha no eventfd()");
+    }
+
+    if (backend == IoBackend::URING) {
+        try {
+            ring_ = std::make_unique<IoUring>(URING_ENTRIES);
+            if (!ring_->setup_buffers(RECV_GROUP, RECV_BUFFERS, RECV_BUFFER_SIZE)) {
+                throw std::runtime_error("Falha ao registrar o anel de buffers do io_uring");
+            }
+        } catch (const std::exception& e) {
+            ring_.reset();
+            backend_error_ = e.what();
+        }
+    }
+
+    if (ring_) {
+        Op* op = new_op(OP_WAKE, wakefd_);
+        op->events = EPOLLIN;
+        arm(op);
+        return;
+    }
+
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epfd_ < 0) {
+        close(wakefd_);
+        throw std::runtime_error("Falha no epoll_create1()");
+    }
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.fd = wakefd_;
+    epoll_ctl(epfd_, EPOLL_CTL_ADD, wakefd_, &ev);
+}
+
+EventLoop::~EventLoop() {
+    // O anel sai primeiro: o kernel no pode mais apontar para as operaes
+    ring_.reset();
+    for (Op* op : all_ops_) delete op;
+    for (int fd : timers_) close(fd);
+    close(wakefd_);
+    if (epfd_ >= 0) close(epfd_);
+}
+
+bool EventLoop::add(int fd, uint32_t events, Handler h) {
+    if (ring_) {
+        Op* op = new_op(OP_POLL, fd);
+        op->events = events;
+        if (!arm(op)) {
+            free_op(op);
+            return false;
+        }
+    } else {
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.fd = fd;
+        if (epoll_ctl(epfd_, EPOLL_CTL_ADD, fd, &ev) < 0) return false;
+    }
+    handlers_[fd] = std::make_shared<Handler>(std::move(h));
+    return true;
+}
+
+bool EventLoop::modify(int fd, uint32_t events) {
+    if (ring_) return false;
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.fd = fd;
+    return epoll_ctl(epfd_, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+void EventLoop::remove(int fd) {
+    handlers_.erase(fd);
+    if (!ring_) {
+        epoll_ctl(epfd_, EPOLL_CTL_DEL, fd, nullptr);
+        return;
+    }
+
+    if (fd < 0 || static_cast<size_t>(fd) >= fd_gen_.size()) return;
+    ++fd_gen_[fd];
+    if (fd_ops_[fd] == 0) return;
+
+    // As operaes seguram o arquivo aberto: o cancelamento tem de chegar ao
+    // kernel agora, antes de quem chamou fechar o fd
+    io_uring_sqe* sqe = next_sqe();
+    if (!sqe) return;
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = fd;
+    sqe->cancel_flags = IORING_ASYNC_CANCEL_FD | IORING_ASYNC_CANCEL_ALL;
+    ring_->enter(0);
+}
+
+bool EventLoop::add_timer(unsigned interval_ms, Task t) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) return false;
+
+    itimerspec its{};
+    its.it_interval.tv_sec = interval_ms / 1000;
+    its.it_interval.tv_nsec = static_cast<long>(interval_ms % 1000) * 1000000L;
+    its.it_value = its.it_interval;
+    if (interval_ms == 0 || timerfd_settime(fd, 0, &its, nullptr) < 0 ||
+        !add(fd, EPOLLIN, [fd, t = std::move(t)](uint32_t) {
+            // Disparos perdidos se acumulam no contador; basta uma chamada
+            uint64_t expirations;
+            while (read(fd, &expirations, sizeof(expirations)) > 0) {}
+            t();
+        })) {
+        close(fd);
+        return false;
+    }
+    timers_.push_back(fd);
+    return true;
+}
+
+int EventLoop::add_oneshot_timer(Task t) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) return -1;
+
+    if (!add(fd, EPOLLIN, [fd, t = std::move(t)](uint32_t) {
+            uint64_t expirations;
+            if (read(fd, &expirations, sizeof(expirations)) > 0) t();
+        })) {
+        close(fd);
+        return -1;
+    }
+    timers_.push_back(fd);
+    return fd;
+}
+
+bool EventLoop::arm_timer(int timer, uint64_t delay_us) {
+    itimerspec its{};
+    its.it_value.tv_sec = static_cast<time_t>(delay_us / 1000000);
+    its.it_value.tv_nsec = static_cast<long>(delay_us % 1000000) * 1000L;
+    return timerfd_settime(timer, 0, &its, nullptr) == 0;
+}
+
+bool EventLoop::accept_multishot(int listen_fd, AcceptHandler h) {
+    if (!ring_) return false;
+    Op* op = new_op(OP_ACCEPT, listen_fd);
+    op->on_accept = std::move(h);
+    if (!arm(op)) {
+        free_op(op);
+        return false;
+    }
+    return true;
+}
+
+bool EventLoop::recv_multishot(int fd, RecvHandler h) {
+    if (!ring_) return false;
+    Op* op = new_op(OP_RECV, fd);
+    op->on_recv = std::move(h);
+    if (!arm(op)) {
+        free_op(op);
+        return false;
+    }
+    return true;
+}
+
+bool EventLoop::send(int fd, const iovec* iov, size_t iovcnt, SendHandler done) {
+    if (!ring_ || iovcnt == 0 || iovcnt > MAX_SEND_IOV) return false;
+    Op* op = new_op(OP_SEND, fd);
+    std::copy(iov, iov + iovcnt, op->iov);
+    op->mh = msghdr{};
+    op->mh.msg_iov = op->iov;
+    op->mh.msg_iovlen = iovcnt;
+    op->on_send = std::move(done);
+    if (!arm(op)) {
+        free_op(op);
+        return false;
+    }
+    return true;
+}
+
+EventLoop::Op* EventLoop::new_op(int kind, int fd) {
+    Op* op;
+    if (free_ops_.empty()) {
+        op = new Op();
+        all_ops_.push_back(op);
+    } else {
+        op = free_ops_.back();
+        free_ops_.pop_back();
+    }
+    if (static_cast<size_t>(fd) >= fd_gen_.size()) {
+        fd_gen_.resize(fd + 1, 0);
+        fd_ops_.resize(fd + 1, 0);
+    }
+    op->kind = kind;
+    op->fd = fd;
+    op->gen = fd_gen_[fd];
+    ++fd_ops_[fd];
+    return op;
+}
+
+void EventLoop::free_op(Op* op) {
+    --fd_ops_[op->fd];
+    op->on_accept = nullptr;
+    op->on_recv = nullptr;
+    op->on_send = nullptr;
+    free_ops_.push_back(op);
+}
+
+io_uring_sqe* EventLoop::next_sqe() {
+    io_uring_sqe* sqe = ring_->get_sqe();
+    if (!sqe) {
+        // Anel de submisso cheio: entrega o que j est preparado
+        ring_->enter(0);
+        sqe = ring_->get_sqe();
+    }
+    return sqe;
+}
+
+bool EventLoop::arm(Op* op) {
+    io_uring_sqe* sqe = next_sqe();
+    if (!sqe) return false;
+    sqe->fd = op->fd;
+    sqe->user_data = reinterpret_cast<uint64_t>(op);
+
+    switch (op->kind) {
+        case OP_WAKE:
+        case OP_POLL:
+            sqe->opcode = IORING_OP_POLL_ADD;
+            sqe->len = IORING_POLL_ADD_MULTI;
+            sqe->poll32_events = op->events;
+            break;
+        case OP_ACCEPT:
+            sqe->opcode = IORING_OP_ACCEPT;
+            sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+            sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+            break;
+        case OP_RECV:
+            sqe->opcode = IORING_OP_RECV;
+            sqe->ioprio = IORING_RECV_MULTISHOT;
+            sqe->flags = IOSQE_BUFFER_SELECT;
+            sqe->buf_group = RECV_GROUP;
+            break;
+        case OP_SEND:
+            sqe->opcode = IORING_OP_SENDMSG;
+            sqe->addr = reinterpret_cast<uint64_t>(&op->mh);
+            sqe->len = 1;
+            sqe->msg_flags = MSG_NOSIGNAL;
+            break;
+    }
+    return true;
+}
+
+// Erros de accept que no impedem as prximas conexes
+static bool accept_retry(int err) {
+    return err == -EMFILE || err == -ENFILE || err == -ENOBUFS || err == -ENOMEM ||
+           err == -ECONNABORTED || err == -EINTR || err == -EAGAIN;
+}
+
+void EventLoop::complete(const io_uring_cqe& cqe) {
+    Op* op = reinterpret_cast<Op*>(cqe.user_data);
+    if (!op) return;  // resultado de um cancelamento
+
+    bool more = (cqe.flags & IORING_CQE_F_MORE) != 0;
+    bool live = op->gen == fd_gen_[op->fd];
+    bool rearm = cqe.res >= 0;
+
+    switch (op->kind) {
+        case OP_WAKE: {
+            uint64_t v;
+            metrics::syscalls(Syscall::OTHER).inc();
+            ssize_t n = read(wakefd_, &v, sizeof(v));
+            (void)n;
+            break;
+        }
+        case OP_POLL:
+            if (live) {
+                // O handler pode ter sido removido por uma concluso anterior
+                auto it = handlers_.find(op->fd);
+                if (it != handlers_.end()) {
+                    auto h = it->second;
+                    (*h)(cqe.res < 0 ? EPOLLERR : static_cast<uint32_t>(cqe.res));
+                }
+            }
+            break;
+        case OP_ACCEPT:
+            if (live) op->on_accept(cqe.res);
+            rearm = rearm || accept_retry(cqe.res);
+            break;
+        case OP_RECV:
+            if (cqe.flags & IORING_CQE_F_BUFFER) {
+                uint16_t bid = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+                if (live) op->on_recv(ring_->buffer(bid), cqe.res);
+                ring_->recycle(bid);
+            } else if (cqe.res == -ENOBUFS) {
+                // Anel de buffers vazio: j foram devolvidos, basta rearmar
+                rearm = true;
+            } else {
+                // EOF ou erro: a conexo acabou
+                if (live) op->on_recv(nullptr, cqe.res);
+                rearm = false;
+            }
+            break;
+        case OP_SEND:
+            if (live) op->on_send(cqe.res);
+            rearm = false;
+            break;
+    }
+    if (more) return;
+
+    // O kernel encerrou a operao (multishot interrompido, por exemplo com
+    // a fila de concluses cheia); continua se o fd ainda estiver registrado
+    if (rearm && op->gen == fd_gen_[op->fd] && !stopped_.load() && arm(op)) return;
+    free_op(op);
+}
+
+void EventLoop::post(Task t) {
+    {
+        std::lock_guard<std::mutex> lg(tasks_mtx_);
+        tasks_.push_back(std::move(t));
+    }
+    metrics::syscalls(Syscall::OTHER).inc();
+    wake();
+}
+
+void EventLoop::wake() {
+    uint64_t one = 1;
+    ssize_t n = write(wakefd_, &one, sizeof(one));
+    (void)n;
+}
+
+// Seguro para uso em handler de sinal: apenas store atmico e write()
+void EventLoop::stop() {
+    stopped_.store(true);
+    wake();
+}
+
+bool EventLoop::in_loop_thread() const {
+    return std::this_thread::get_id() == owner_;
+}
+
+// Os dois vetores trocam de papel a cada volta e guardam a capacidade, ento
+// post() no aloca depois do aquecimento
+void EventLoop::run_pending() {
+    {
+        std::lock_guard<std::mutex> lg(tasks_mtx_);
+        running_.swap(tasks_);
+    }
+    for (auto& t : running_) t();
+    running_.clear();
+}
+
+size_t EventLoop::drain() {
+    size_t n = 0;
+    for (;;) {
+        size_t pending;
+        {
+            std::lock_guard<std::mutex> lg(tasks_mtx_);
+            pending = tasks_.size();
+        }
+        if (pending == 0) return n;
+        n += pending;
+        run_pending();
+    }
+}
+
+void EventLoop::run() {
+    owner_ = std::this_thread::get_id();
+    if (ring_) {
+        run_uring();
+    } else {
+        run_epoll();
+    }
+    run_pending();
+}
+
+void EventLoop::run_epoll() {
+    epoll_event events[MAX_EVENTS];
+
+    while (!stopped_.load()) {
+        if (before_wait_) before_wait_();
+        metrics::syscalls(Syscall::EPOLL_WAIT).inc();
+        int n = epoll_wait(epfd_, events, MAX_EVENTS, -1);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (int i = 0; i < n; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == wakefd_) {
+                // Uma leitura zera o contador do eventfd
+                uint64_t v;
+                metrics::syscalls(Syscall::OTHER).inc();
+                ssize_t r = read(wakefd_, &v, sizeof(v));
+                (void)r;
+                continue;
+            }
+            // O handler pode ter sido removido por um evento anterior do lote
+            auto it = handlers_.find(fd);
+            if (it == handlers_.end()) continue;
+            auto h = it->second;
+            (*h)(events[i].events);
+        }
+
+        run_pending();
+    }
+}
+
+// Uma io_uring_enter() por volta: entrega tudo o que os handlers e tarefas
+// prepararam (envios, rearmes, novas conexes) e espera a prxima concluso
+void EventLoop::run_uring() {
+    while (!stopped_.load()) {
+        if (before_wait_) before_wait_();
+        int r = ring_->enter(1);
+        if (r < 0 && r != -EINTR && r != -EAGAIN && r != -EBUSY) break;
+
+        ring_->drain([this](const io_uring_cqe& cqe) { complete(cqe); });
+        run_pending();
+    }
+}
@@ -3,198 +3,740 @@
 #include <thread>
 #include <vector>
 #include <unordered_map>
-#include <unordered_set>
 #include <mutex>
 #include <atomic>
 #include <algorithm>
 #include <sstream>
 #include <csignal>
 #include <memory>
-#include <queue>
-#include <condition_variable>
+#include <climits>
+#include <cstring>
+#include <cerrno>
+#include <fstream>
+#include <chrono>
+#include <cctype>
+#include <deque>
+#include <future>
+#include <iomanip>
 
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <sys/eventfd.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <fcntl.h>
 
 #include "tslog.hpp"
+#include "arg_parse.hpp"
+#include "reactor.hpp"
+#include "outbound_queue.hpp"
+#include "message.hpp"
+#include "line_framer.hpp"
+#include "word_filter.hpp"
+#include "message_history.hpp"
+#include "chatroom.hpp"
+#include "presence.hpp"
+#include "history_log.hpp"
+#include "mailbox.hpp"
+#include "metrics.hpp"
+#include "credentials.hpp"
+#include "worker_pool.hpp"
+#include "federation.hpp"
+#include "slab.hpp"
+#include "ring_buffer.hpp"
+#include "handoff.hpp"
+#include "rate_limit.hpp"
 
 constexpr int DEFAULT_PORT = 12345;
-constexpr int BACKLOG = 10;
+constexpr int BACKLOG = 4096;
 constexpr size_t BUF_SIZE = 4096;
-constexpr size_t MAX_HISTORY = 100;
+constexpr size_t DEFAULT_HISTORY = 100;
+constexpr size_t DEFAULT_HISTORY_REPLY = 10;
+constexpr size_t DEFAULT_ROOM_HISTORY = 50;
+constexpr size_t ROOMS_LISTED = 50;
+constexpr size_t USERS_PAGE = 100;
+const char* const DEFAULT_ROOM = "geral";
+constexpr int ACCEPT_BATCH = 64;
+constexpr unsigned DEFAULT_AUTH_TIMEOUT_MS = 10000;
+constexpr size_t DEFAULT_MAX_PENDING = 1024;
+constexpr size_t DEFAULT_AUTH_QUEUE = 256;
+constexpr unsigned DEFAULT_AUTH_CACHE_TTL_MS = 60000;
+constexpr size_t AUTH_CACHE_MAX = 65536;
+constexpr size_t DEFERRED_MAX = 32;
+constexpr unsigned CLOSE_GRACE_MS = 1000;
+constexpr uint32_t CLIENT_EVENTS = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+constexpr size_t RATE_TABLE_SIZE = 65536;  // entradas de cada tabela de limites
+constexpr uint32_t HANDOFF_VERSION = 1;
+constexpr unsigned HANDOFF_TIMEOUT_MS = 30000;
+constexpr unsigned long MAX_SHARDS = 1024;
+constexpr double MAX_TIMEOUT_SECONDS = 86400;  // prazos das opes: at um dia
 
 using namespace tslog;
 
+// Modelo de I/O do servidor
+enum class ServerMode { THREADS, EPOLL };
+
+struct ServerConfig {
+    int port = DEFAULT_PORT;
+    ServerMode mode = ServerMode::EPOLL;
+    unsigned shards = 0;  // 0 = nmero de ncleos
+    size_t queue_max = 1024;
+    size_t max_line = 4096;
+    std::string banned_file;
+    std::string users_file;
+    size_t history = DEFAULT_HISTORY;          // sala padro
+    size_t room_history = DEFAULT_ROOM_HISTORY;  // demais salas
+    HistoryLogOptions history_log;  // dir vazio = histrico s em memria
+    MailboxOptions mailbox;  // max_messages 0 = sem caixas de mensagens
+    OverflowPolicy overflow = OverflowPolicy::DROP_OLDEST;
+    unsigned coalesce_us = 0;  // janela de agrupamento da sada; 0 = desligado
+    IoBackend io = IoBackend::EPOLL;  // s no modo epoll; threads usa sempre epoll
+    Options log;  // fila e descarga do logger
+    Level log_level = Level::INFO;
+    int metrics_port = 0;        // 0 = sem endpoint TCP
+    std::string metrics_socket;  // vazio = sem socket Unix
+    unsigned auth_timeout_ms = DEFAULT_AUTH_TIMEOUT_MS;  // prazo para concluir o login
+    size_t max_pending = DEFAULT_MAX_PENDING;  // conexes ainda sem login
+    unsigned auth_threads = 0;  // 0 = nmero de ncleos
+    size_t auth_queue = DEFAULT_AUTH_QUEUE;  // verificaes aguardando uma thread
+    unsigned auth_cache_ttl_ms = DEFAULT_AUTH_CACHE_TTL_MS;  // 0 = sem cache
+    unsigned kdf_iterations = CredentialStore::DEFAULT_ITERATIONS;
+    bool hash_users = false;  // s converte usuario:senha da entrada e sai
+    std::string node;                // nome na federao (padro: no-<porta>)
+    int peer_port = 0;               // 0 = sem federao
+    std::vector<PeerAddress> peers;  // outros ns
+    unsigned peer_timeout_ms = 3000;
+    std::string upgrade_binary;  // executado no SIGUSR2 (padro: o prprio executvel)
+    BucketLimit msg_limit;   // linhas por usurio
+    BucketLimit byte_limit;  // bytes por usurio
+    BucketLimit conn_limit;  // conexes por endereo IP
+    bool limit_notice = false;  // avisa o usurio quando uma linha  descartada
+};
+
+ServerConfig config;
+
+// Etapas do login
+enum class AuthStage { USERNAME, PASSWORD, VERIFYING, DONE };
+
+struct Shard;
+
 // Estrutura para clientes autenticados
-struct ClientInfo {
-    int fd;
+struct ClientInfo : std::enable_shared_from_this<ClientInfo> {
+    int fd = -1;
     std::string addr;
     std::string username;
-    bool authenticated;
+    std::atomic<bool> authenticated{false};
     std::thread thr;
+
+    // N da federao onde o usurio est conectado. Vazio numa conexo
+    // local; seno a entrada s representa o usurio remoto na presena.
+    std::string node;
+    // Sesso derrubada porque o mesmo usurio entrou em outro n
+    std::atomic<bool> superseded{false};
+
+    // Shard dono da conexo: s a thread dele escreve no socket e mexe em
+    // outq/closed. No modo threads a leitura  feita pela thread do cliente.
+    Shard* shard = nullptr;
+    bool threaded = false;
+    std::atomic<bool> closed{false};
+
+    // Estado da leitura (thread que l do socket)
+    AuthStage stage = AuthStage::USERNAME;
+    std::string pending_user;
+    // S enquanto a verificao roda: numa atualizao a quente o processo
+    // novo verifica de novo
+    std::string pending_password;
+    std::vector<std::string> deferred;  // linhas que chegaram durante a verificao
+    bool throttled = false;  // j avisado do limite; volta a false quando uma linha passa
+    LineFramer framer{config.max_line};
+
+    // Login em andamento: ocupa uma vaga em handshakes_pending at
+    // autenticar ou fechar, e  encerrado se passar do prazo
+    std::atomic<bool> handshaking{false};
+    uint64_t handshake_deadline = 0;  // metrics::now_ns()
+
+    // Fila de sada limitada, esvaziada no EPOLLOUT ou, no io_uring, por um
+    // envio assncrono de cada vez (send_inflight) agendado pelo shard
+    OutboundQueue outq{config.queue_max, config.overflow};
+    bool send_scheduled = false;
+    bool send_inflight = false;
+    uint64_t send_started = 0;  // metrics::now_ns()
+    bool fd_released = false;   // fd j fora do lao e fechado
+
+    // Sada retida pela janela de agrupamento (--coalesce-ms) desde
+    // coalesce_since. coalesce_holds/coalesce_delay_ns somam as retenes e
+    // o atraso que causaram, para o /queue.
+    bool coalescing = false;
+    uint64_t coalesce_since = 0;  // metrics::now_ns()
+    std::atomic<uint64_t> coalesce_holds{0};
+    std::atomic<uint64_t> coalesce_delay_ns{0};
+
+    // Sala atual; room_mtx serializa a troca de sala com o fechamento
+    std::mutex room_mtx;
+    std::shared_ptr<ChatRoom> room;
 };
 
-// Monitor para gerenciar fila thread-safe de mensagens
-class ThreadSafeMessageQueue {
-public:
-    void push(const std::string& msg) {
-        std::lock_guard<std::mutex> lg(mtx_);
-        queue_.push(msg);
-        cv_.notify_one();
-    }
+// Shard: lao de eventos, listener SO_REUSEPORT prprio e sua fatia da
+// tabela de clientes. Outras threads s falam com o shard pela caixa de
+// entrada do lao (EventLoop::post).
+struct Shard {
+    explicit Shard(IoBackend io) : loop(io), uring(loop.backend() == IoBackend::URING) {}
+
+    unsigned id = 0;
+    EventLoop loop;
+    bool uring;
+    int listen_fd = -1;
+    std::unordered_map<int, std::shared_ptr<ClientInfo>> clients;
+    std::thread thr;
 
-    bool pop(std::string& msg, std::chrono::milliseconds timeout) {
-        std::unique_lock<std::mutex> lock(mtx_);
-        if (cv_.wait_for(lock, timeout, [this]{ return !queue_.empty(); })) {
-            msg = std::move(queue_.front());
-            queue_.pop();
-            return true;
-        }
-        return false;
-    }
+    // Logins em andamento na ordem de chegada; como o prazo  o mesmo para
+    // todos, os vencidos esto sempre no comeo
+    std::deque<std::weak_ptr<ClientInfo>> handshakes;
 
-    size_t size() const {
-        std::lock_guard<std::mutex> lg(mtx_);
-        return queue_.size();
-    }
+    // Conexes com sada pendente (io_uring), enviadas todas juntas antes
+    // da prxima espera do lao; send_batch  reaproveitado entre voltas
+    std::vector<std::shared_ptr<ClientInfo>> send_ready;
+    std::vector<std::shared_ptr<ClientInfo>> send_batch;
 
-private:
-    mutable std::mutex mtx_;
-    std::condition_variable cv_;
-    std::queue<std::string> queue_;
-};
+    // Conexes encerradas esperando o envio em andamento terminar antes do
+    // close(), com o prazo para fechar mesmo assim
+    std::deque<std::pair<std::weak_ptr<ClientInfo>, uint64_t>> closing;
 
-// Monitor para histrico de mensagens
-class MessageHistory {
-public:
-    void add(const std::string& msg) {
-        std::lock_guard<std::mutex> lg(mtx_);
-        history_.push_back(msg);
-        if (history_.size() > MAX_HISTORY) {
-            history_.erase(history_.begin());
-        }
-    }
-
-    std::vector<std::string> get_recent(size_t n) const {
-        std::lock_guard<std::mutex> lg(mtx_);
-        size_t start = history_.size() > n ? history_.size() - n : 0;
-        return std::vector<std::string>(history_.begin() + start, history_.end());
-    }
-
-private:
-    mutable std::mutex mtx_;
-    std::vector<std::string> history_;
+    // Conexes com sada retida pela janela de agrupamento, na ordem em que
+    // comearam a esperar; o timer (nico) fica armado para a primeira
+    RingBuffer<std::shared_ptr<ClientInfo>> coalesce;
+    int coalesce_timer = -1;
+    bool coalesce_armed = false;
 };
 
 // Variveis globais protegidas
-std::mutex clients_mtx;
-std::unordered_map<int, std::shared_ptr<ClientInfo>> clients;
-std::unordered_map<std::string, int> username_to_fd;
 std::atomic<bool> running{true};
-int listen_fd = -1;
-MessageHistory msg_history;
-ThreadSafeMessageQueue broadcast_queue;
-
-// Filtro de palavras proibidas
-std::unordered_set<std::string> banned_words = {
+std::atomic<bool> upgrade_requested{false};  // SIGUSR2: passar tudo para o binrio novo
+char** server_argv = nullptr;
+int listen_fd = -1;  // listener do modo threads
+int stop_fd = -1;    // eventfd escrito por SIGINT/SIGTERM; fica aberto at o fim
+std::vector<std::unique_ptr<Shard>> shards;
+std::unique_ptr<RoomRegistry> rooms;
+std::unique_ptr<HistoryLog> history_log;
+// Mensagens privadas para quem est offline (nullptr = desligadas)
+std::unique_ptr<MailboxStore> mailboxes;
+std::atomic<size_t> handshakes_pending{0};
+std::unique_ptr<Federation> federation;  // s com --peer-port
+// Baldes de fichas: mensagens e bytes por usurio, conexes por endereo
+// (nullptr = sem limite)
+std::unique_ptr<RateLimiter> user_limits;
+std::unique_ptr<RateLimiter> ip_limits;
+
+// Filtro de palavras proibidas (lista padro; --banned-words acrescenta)
+std::vector<std::string> banned_words = {
     "banword", "spam", "palavrao"
 };
+WordFilter banned_filter;
 
-// Senhas simples (em produo, usar hash + salt)
-std::unordered_map<std::string, std::string> user_passwords = {
+// Usurios padro; --users acrescenta ou substitui
+const std::pair<const char*, const char*> DEFAULT_USERS[] = {
     {"alice", "senha123"},
     {"bob", "senha456"},
     {"charlie", "senha789"},
     {"admin", "admin123"}
 };
 
-// Funo para broadcast de mensagens
-void broadcast_message(const std::string& msg, int except_fd = -1) {
-    std::lock_guard<std::mutex> lg(clients_mtx);
-    for (auto& pair : clients) {
-        auto& c = pair.second;
-        if (!c || c->fd == except_fd || !c->authenticated) continue;
+// Senhas guardadas como PBKDF2; a verificao roda no pool de autenticao,
+// nunca numa thread de I/O. S  escrito antes de aceitar conexes.
+CredentialStore credentials;
+std::unique_ptr<WorkerPool> auth_pool;
+std::unique_ptr<AuthCache> auth_cache;
+
+// Mtricas (/stats e o endpoint do Prometheus). As sries so criadas aqui,
+// na inicializao esttica; atualiz-las no passa por nenhum lock.
+MetricsRegistry registry;
+std::unique_ptr<MetricsServer> metrics_server;
+
+Counter& m_connections = registry.counter("chat_connections_total", "Conexes aceitas");
+Gauge& m_connections_open = registry.gauge("chat_connections_open", "Conexes abertas");
+Counter& m_auth_attempts = registry.counter("chat_auth_attempts_total", "Tentativas de login");
+Counter& m_auth_failures = registry.counter("chat_auth_failures_total", "Logins recusados");
+Counter& m_handshake_timeouts = registry.counter("chat_handshake_timeouts_total", "Conexes encerradas por no concluir o login no prazo");
+Counter& m_auth_cache_hits = registry.counter("chat_auth_cache_hits_total", "Logins aceitos pelo cache de sesses verificadas");
+Counter& m_auth_rejected = registry.counter("chat_auth_rejected_total", "Logins recusados por fila de verificao cheia");
+Counter& m_handshake_rejected = registry.counter("chat_handshake_rejected_total", "Conexes recusadas por excesso de logins pendentes");
+Counter& m_messages_in = registry.counter("chat_messages_in_total", "Mensagens de chat recebidas");
+Counter& m_messages_out = registry.counter("chat_messages_out_total", "Mensagens enfileiradas para clientes");
+Counter& m_messages_filtered = registry.counter("chat_messages_filtered_total", "Mensagens bloqueadas pelo filtro");
+Counter& m_bytes_in = registry.counter("chat_bytes_in_total", "Bytes lidos dos clientes");
+Counter& m_bytes_out = registry.counter("chat_bytes_out_total", "Bytes escritos para os clientes");
+Counter& m_queue_dropped = registry.counter("chat_outbound_dropped_total", "Mensagens descartadas por fila de sada cheia");
+const char* const LIMITED_HELP = "Eventos recusados por limite de taxa";
+Counter& m_limited_messages = registry.counter("chat_rate_limited_total", LIMITED_HELP, "kind=\"messages\"");
+Counter& m_limited_bytes = registry.counter("chat_rate_limited_total", LIMITED_HELP, "kind=\"bytes\"");
+Counter& m_limited_connections = registry.counter("chat_rate_limited_total", LIMITED_HELP, "kind=\"connections\"");
+
+// Latncia por estgio do caminho de uma mensagem
+const char* const STAGE_HELP = "Tempo gasto em cada estgio, em segundos";
+LatencyHistogram& m_stage_auth = registry.histogram("chat_stage_seconds", STAGE_HELP, "stage=\"auth\"");
+LatencyHistogram& m_stage_auth_queue = registry.histogram("chat_stage_seconds", STAGE_HELP, "stage=\"auth_queue\"");
+LatencyHistogram& m_stage_filter = registry.histogram("chat_stage_seconds", STAGE_HELP, "stage=\"filter\"");
+LatencyHistogram& m_stage_broadcast = registry.histogram("chat_stage_seconds", STAGE_HELP, "stage=\"broadcast\"");
+LatencyHistogram& m_stage_inbox = registry.histogram("chat_stage_seconds", STAGE_HELP, "stage=\"inbox\"");
+LatencyHistogram& m_stage_fanout = registry.histogram("chat_stage_seconds", STAGE_HELP, "stage=\"fanout\"");
+LatencyHistogram& m_stage_history = registry.histogram("chat_stage_seconds", STAGE_HELP, "stage=\"history\"");
+LatencyHistogram& m_stage_flush = registry.histogram("chat_stage_seconds", STAGE_HELP, "stage=\"flush\"");
+LatencyHistogram& m_stage_coalesce = registry.histogram("chat_stage_seconds", STAGE_HELP, "stage=\"coalesce\"");
+
+LockStats presence_lock{
+    registry.histogram("chat_lock_wait_seconds", "Espera para adquirir o lock", "lock=\"presence\""),
+    registry.histogram("chat_lock_hold_seconds", "Tempo com o lock adquirido", "lock=\"presence\"")
+};
 
-        ssize_t n = send(c->fd, msg.data(), msg.size(), MSG_NOSIGNAL);
-        if (n <= 0) {
-            Logger::instance().error("Erro ao enviar para " + c->username +
-                                   " (fd " + std::to_string(c->fd) + ")");
+// Usurios online: leituras sem lock (RCU), escrita s em login e sada
+PresenceRegistry presence{USERS_PAGE, &presence_lock};
+
+// Formatos de log usados em mais de um lugar
+const Format FMT_DISCONNECTED("Cliente {} desconectou");
+const Format FMT_RECV_ERROR("Erro recv() para {}");
+
+// Esvazia a fila de sada no socket, contando bytes e tempo
+bool flush_client(ClientInfo& c) {
+    if (c.send_inflight) return true;
+    uint64_t before = c.outq.sent_bytes();
+    uint64_t t0 = metrics::now_ns();
+    bool ok = c.outq.flush(c.fd);
+    m_stage_flush.record_since(t0);
+    m_bytes_out.inc(c.outq.sent_bytes() - before);
+    return ok;
+}
+
+// io_uring: marca a conexo para o prximo lote de envios do shard
+void schedule_send(ClientInfo& c) {
+    if (c.send_scheduled || c.closed) return;
+    c.send_scheduled = true;
+    c.shard->send_ready.push_back(c.shared_from_this());
+}
+
+// Com --coalesce-ms, a primeira mensagem numa fila vazia no  escrita na
+// hora: a conexo espera a janela e tudo o que chegar at l sai numa s
+// escrita. Retorna false se no deu para armar o timer (escreve j).
+bool hold_output(ClientInfo& c) {
+    if (c.coalescing) return true;
+    Shard& s = *c.shard;
+    if (!s.coalesce_armed) {
+        if (!s.loop.arm_timer(s.coalesce_timer, config.coalesce_us)) return false;
+        s.coalesce_armed = true;
+    }
+    c.coalescing = true;
+    c.coalesce_since = metrics::now_ns();
+    s.coalesce.push_back(c.shared_from_this());
+    return true;
+}
+
+// Enfileira e, se a fila estava vazia, j tenta escrever (no io_uring,
+// agenda o envio para o fim da volta do lao; com janela de agrupamento,
+// para o fim dela). S pode ser
+// chamada na thread do shard dono. Retorna false quando a conexo deve ser
+// encerrada (erro no socket ou estouro com a poltica disconnect).
+bool write_client(ClientInfo& c, MessageRef msg) {
+    if (c.closed) return true;
+
+    bool was_empty = c.outq.empty();
+    uint64_t dropped = c.outq.dropped();
+    if (!c.outq.push(std::move(msg))) {
+        TSLOG_EVERY_MS(Level::WARN, 1000, "Fila de sada cheia para {}; desconectando", c.addr);
+        return false;
+    }
+    m_messages_out.inc();
+    if (c.outq.dropped() != dropped) m_queue_dropped.inc(c.outq.dropped() - dropped);
+    if (!was_empty) return true;
+    if (c.shard->coalesce_timer >= 0 && hold_output(c)) return true;
+    if (c.shard->uring && !c.threaded) {
+        schedule_send(c);
+        return true;
+    }
+    return flush_client(c);
+}
+
+void shard_close(std::shared_ptr<ClientInfo> ci);
+
+// Conexes vm do slab: o bloco de uma conexo encerrada (ClientInfo e o
+// bloco de controle do shared_ptr juntos)  reaproveitado pela prxima
+std::shared_ptr<ClientInfo> new_client() {
+    return std::allocate_shared<ClientInfo>(slab::Allocator<ClientInfo>());
+}
+
+// Entrega na thread do shard dono, encerrando a conexo se necessrio
+void deliver(const std::shared_ptr<ClientInfo>& ci, MessageRef msg) {
+    if (!write_client(*ci, std::move(msg))) shard_close(ci);
+}
+
+// Envia a um cliente de qualquer thread: escreve direto se estivermos no
+// shard dono, seno encaminha pela caixa de entrada dele
+void send_to_client(const std::shared_ptr<ClientInfo>& ci, MessageRef msg) {
+    EventLoop& loop = ci->shard->loop;
+    if (loop.in_loop_thread()) {
+        deliver(ci, std::move(msg));
+        return;
+    }
+    loop.post_pooled([ci, msg] { deliver(ci, msg); });
+}
+
+void send_to_client(const std::shared_ptr<ClientInfo>& ci, std::string data) {
+    send_to_client(ci, make_message(std::move(data)));
+}
+
+// Envia vrias mensagens j formatadas numa nica passagem pelo shard dono
+void send_to_client(const std::shared_ptr<ClientInfo>& ci, std::vector<MessageRef> msgs) {
+    auto run = [ci, msgs = std::move(msgs)] {
+        for (auto& m : msgs) {
+            if (ci->closed) return;
+            deliver(ci, m);
         }
+    };
+    if (ci->shard->loop.in_loop_thread()) {
+        run();
+    } else {
+        ci->shard->loop.post(std::move(run));
+    }
+}
+
+// Entrega um broadcast aos membros de uma sala que pertencem a este shard.
+// O mesmo payload  enfileirado para todos; conexes que precisam ser
+// encerradas s so fechadas depois de percorrer a lista.
+void shard_broadcast(const ChatRoom::MemberList& members, const MessageRef& msg,
+                     const ClientInfo* except) {
+    uint64_t t0 = metrics::now_ns();
+    std::vector<std::shared_ptr<ClientInfo>> failed;
+    for (auto& c : members) {
+        if (c.get() == except || c->closed || !c->authenticated) continue;
+
+        if (!write_client(*c, msg)) {
+            TSLOG_EVERY_MS(Level::ERROR, 1000, "Erro ao enviar para {} (fd {})", c->username, c->fd);
+            failed.push_back(c);
+        }
+    }
+    for (auto& c : failed) shard_close(c);
+    m_stage_fanout.record_since(t0);
+}
+
+// Broadcast para uma sala: o buffer  compartilhado e cada shard que tem
+// membros dela recebe s a lista dos seus; shards sem membros no so
+// acordados
+void broadcast_message(ChatRoom& room, const MessageRef& shared,
+                       std::shared_ptr<ClientInfo> except = nullptr) {
+    uint64_t t0 = metrics::now_ns();
+
+    // Vetores reaproveitados entre mensagens, um por nvel: encerrar uma
+    // conexo no meio do broadcast avisa a sala com outro broadcast
+    thread_local std::deque<ChatRoom::Snapshot> scratch;
+    thread_local size_t depth = 0;
+    if (scratch.size() <= depth) scratch.emplace_back();
+    ChatRoom::Snapshot& members = scratch[depth++];
+    room.snapshot(members);
+    for (size_t i = 0; i < members.size() && i < shards.size(); ++i) {
+        auto list = std::move(members[i]);
+        if (!list) continue;
+        Shard* s = shards[i].get();
+        if (s->loop.in_loop_thread()) {
+            shard_broadcast(*list, shared, except.get());
+        } else {
+            // inbox: tempo entre o post e a execuo no shard de destino
+            s->loop.post_pooled([list, shared, except, t0] {
+                m_stage_inbox.record_since(t0);
+                shard_broadcast(*list, shared, except.get());
+            });
+        }
+    }
+    members.clear();
+    --depth;
+    m_stage_broadcast.record_since(t0);
+}
+
+std::shared_ptr<ClientInfo> find_user(const std::string& username) {
+    return presence.find(username);
+}
+
+// Entrega numa s mensagem (uma escrita) o que ficou guardado para o usurio
+void deliver_mailbox(const std::shared_ptr<ClientInfo>& ci) {
+    std::string batch;
+    size_t n = mailboxes->take(ci->username, batch);
+    if (n == 0) return;
+    std::string count = std::to_string(n);
+    send_to_client(ci, make_message({"[SISTEMA] ", count, " mensagem(ns) privada(s) recebida(s) enquanto offline:\n", batch}));
+    TSLOG_INFO("{} mensagem(ns) guardada(s) entregue(s) a {}", n, ci->username);
+}
+
+// Guarda uma mensagem privada para um usurio cadastrado que est offline.
+// Retorna o aviso para o remetente.
+std::string store_offline(const std::string& to_user, const MessageRef& pm) {
+    if (!mailboxes || !credentials.contains(to_user)) {
+        return "[SISTEMA] Usurio '" + to_user + "' no encontrado.\n";
+    }
+    switch (mailboxes->deposit(to_user, pm)) {
+    case MailboxStore::Result::STORED:
+        // O login pode ter esvaziado a caixa entre a busca e o depsito
+        if (auto c = find_user(to_user); c && c->node.empty()) deliver_mailbox(c);
+        return "[SISTEMA] Usurio '" + to_user + "' est offline; mensagem guardada.\n";
+    case MailboxStore::Result::FULL:
+        return "[SISTEMA] Caixa de mensagens de '" + to_user + "' cheia; mensagem no entregue.\n";
+    default:
+        return "[SISTEMA] No foi possvel guardar a mensagem para '" + to_user + "'.\n";
     }
 }
 
 // Enviar mensagem privada
-void send_private_message(const std::string& from_user, const std::string& to_user,
+void send_private_message(std::shared_ptr<ClientInfo> from, const std::string& to_user,
                          const std::string& msg) {
-    std::lock_guard<std::mutex> lg(clients_mtx);
+    auto to = find_user(to_user);
+    auto pm = make_message({"[PRIVADO de ", from->username, "] ", msg, "\n"});
+    if (!to) {
+        send_to_client(from, store_offline(to_user, pm));
+        return;
+    }
+
+    if (!to->node.empty()) {
+        federation->deliver(to->node, to_user, from->username, std::move(pm));
+    } else {
+        send_to_client(to, std::move(pm));
+    }
+    TSLOG_INFO("Mensagem privada de {} para {}", from->username, to_user);
+}
+
+// Verificar filtro de palavras
+bool contains_banned_word(std::string_view msg) {
+    return banned_filter.matches(msg);
+}
 
-    auto it = username_to_fd.find(to_user);
-    if (it == username_to_fd.end()) {
-        auto from_it = username_to_fd.find(from_user);
-        if (from_it != username_to_fd.end()) {
-            std::string err = "[SISTEMA] Usurio '" + to_user + "' no encontrado.\n";
-            send(from_it->second, err.data(), err.size(), MSG_NOSIGNAL);
+// Carrega palavras proibidas de um arquivo (uma por linha) e compila o filtro
+bool load_banned_words(const std::string& path) {
+    if (!path.empty()) {
+        std::ifstream in(path);
+        if (!in) {
+            Logger::instance().error("No foi possvel abrir lista de palavras: " + path);
+            return false;
+        }
+        std::string word;
+        while (std::getline(in, word)) {
+            if (!word.empty() && word.back() == '\r') word.pop_back();
+            if (!word.empty() && word[0] != '#') banned_words.push_back(word);
         }
-        return;
     }
 
-    int to_fd = it->second;
-    std::string pm = "[PRIVADO de " + from_user + "] " + msg + "\n";
-    ssize_t n = send(to_fd, pm.data(), pm.size(), MSG_NOSIGNAL);
+    banned_filter = WordFilter(banned_words);
+    Logger::instance().info("Filtro de palavras: " + std::to_string(banned_filter.word_count()) +
+                            " palavra(s), " + std::to_string(banned_filter.state_count()) +
+                            " estado(s)" + (banned_filter.prefilter_enabled() ? ", pr-filtro SIMD" : ""));
+    return true;
+}
 
-    if (n > 0) {
-        Logger::instance().info("Mensagem privada de " + from_user + " para " + to_user);
+// Usurios padro e, se houver, o arquivo de --users (linhas "usuario:hash";
+// linhas "usuario:senha" antigas so convertidas na carga)
+bool load_users(const ServerConfig& cfg) {
+    for (const auto& u : DEFAULT_USERS) credentials.add_password(u.first, u.second, cfg.kdf_iterations);
+    if (cfg.users_file.empty()) return true;
+
+    size_t loaded = 0, legacy = 0;
+    std::string error;
+    if (!credentials.load(cfg.users_file, cfg.kdf_iterations, loaded, legacy, error)) {
+        Logger::instance().error("Arquivo de usurios invlido: " + error);
+        return false;
+    }
+    Logger::instance().info("Usurios carregados de " + cfg.users_file + ": " + std::to_string(loaded));
+    if (legacy > 0) {
+        Logger::instance().warn(std::to_string(legacy) + " senha(s) em texto puro em " + cfg.users_file +
+                                "; converta com --hash-users");
     }
+    return true;
 }
 
-// Verificar filtro de palavras
-bool contains_banned_word(const std::string& msg) {
-    std::string lower_msg = msg;
-    std::transform(lower_msg.begin(), lower_msg.end(), lower_msg.begin(), ::tolower);
+// --hash-users: l "usuario:senha" da entrada padro e escreve "usuario:hash"
+int hash_users(const ServerConfig& cfg) {
+    std::string line;
+    size_t n = 0;
+    while (std::getline(std::cin, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        auto colon = line.find(':');
+        if (line.empty() || line[0] == '#' || colon == std::string::npos || colon == 0) {
+            std::cout << line << '\n';
+            continue;
+        }
+        std::cout << line.substr(0, colon) << ':'
+                  << CredentialStore::hash_password(line.substr(colon + 1), cfg.kdf_iterations) << '\n';
+        ++n;
+    }
+    std::cerr << n << " senha(s) convertidas (" << cfg.kdf_iterations << " iteraes)" << std::endl;
+    return 0;
+}
 
-    for (const auto& word : banned_words) {
-        if (lower_msg.find(word) != std::string::npos) {
-            return true;
+// Abre o log persistente e reconstri o histrico recente a partir do fim
+// dele; as mensagens restauradas apontam direto para os segmentos mapeados
+bool open_history_log(const ServerConfig& cfg) {
+    auto t0 = std::chrono::steady_clock::now();
+    try {
+        history_log = std::make_unique<HistoryLog>(cfg.history_log);
+    } catch (const std::exception& e) {
+        Logger::instance().error(std::string("No foi possvel abrir o log de histrico: ") + e.what());
+        return false;
+    }
+
+    MessageHistory& history = rooms->default_room()->history();
+    auto recent = history_log->tail(history.capacity());
+    for (auto& m : recent) history.add(std::move(m));
+
+    auto us = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - t0).count();
+    Logger::instance().info("Log de histrico em " + cfg.history_log.dir + ": " +
+                            std::to_string(history_log->segment_count()) + " segmento(s), " +
+                            std::to_string(recent.size()) + " mensagem(ns) restaurada(s) em " +
+                            std::to_string(us / 1000.0) + " ms");
+    return true;
+}
+
+// Caixas de mensagens offline; com --mailbox-dir, as que ficaram em disco
+// da execuo anterior continuam valendo
+bool open_mailboxes(const ServerConfig& cfg) {
+    try {
+        mailboxes = std::make_unique<MailboxStore>(cfg.mailbox);
+    } catch (const std::exception& e) {
+        TSLOG_ERROR("No foi possvel abrir as caixas de mensagens: {}", e.what());
+        return false;
+    }
+    TSLOG_INFO("Caixas de mensagens: at {} por usurio, {} MB em memria",
+               cfg.mailbox.max_messages, cfg.mailbox.memory_bytes / (1024 * 1024));
+    if (!cfg.mailbox.dir.empty()) {
+        TSLOG_INFO("Caixas de mensagens em disco em {}: {} mensagem(ns) pendente(s)",
+                   cfg.mailbox.dir, mailboxes->messages());
+    }
+    return true;
+}
+
+// Grava no histrico em memria da sala e, se for a sala padro, no log
+// persistente (se houver). Com o log ativo, o histrico guarda a cpia
+// mapeada e a mensagem original  liberada assim que as filas de sada
+// terminam de envi-la.
+void record_history(ChatRoom& room, const MessageRef& msg) {
+    uint64_t t0 = metrics::now_ns();
+    MessageRef stored = msg;
+    if (history_log && &room == rooms->default_room().get()) {
+        if (auto mapped = history_log->append(msg)) {
+            stored = std::move(mapped);
+        } else {
+            static std::atomic<bool> warned{false};
+            if (!warned.exchange(true)) {
+                Logger::instance().error("Falha ao gravar no log de histrico; mensagens ficam s em memria");
+            }
         }
     }
-    return false;
+    room.history().add(std::move(stored));
+    m_stage_history.record_since(t0);
+}
+
+// Mensagem de sala originada neste n: membros locais, histrico e os ns
+// da federao que tm membros na sala
+void publish(ChatRoom& room, const MessageRef& msg, std::shared_ptr<ClientInfo> except = nullptr) {
+    broadcast_message(room, msg, std::move(except));
+    record_history(room, msg);
+    if (federation) federation->room_message(room.name(), msg);
+}
+
+// Remove o usurio da lista de online se o registro ainda for desta conexo
+void unregister_user(const std::shared_ptr<ClientInfo>& ci) {
+    presence.remove(ci->username, ci.get());
 }
 
-// Remover cliente
-void remove_client(int fd) {
-    std::lock_guard<std::mutex> lg(clients_mtx);
+// Sala atual da conexo (nullptr antes do login ou depois de fechada)
+std::shared_ptr<ChatRoom> current_room(ClientInfo& c) {
+    std::lock_guard<std::mutex> lg(c.room_mtx);
+    return c.room;
+}
 
-    auto it = clients.find(fd);
-    if (it != clients.end() && it->second) {
-        username_to_fd.erase(it->second->username);
-        clients.erase(it);
+// Move a conexo para a sala name, avisando as duas salas. Retorna a nova
+// sala, ou nullptr se a conexo j foi fechada.
+std::shared_ptr<ChatRoom> move_to_room(const std::shared_ptr<ClientInfo>& ci, const std::string& name) {
+    std::shared_ptr<ChatRoom> old, room;
+    {
+        std::lock_guard<std::mutex> lg(ci->room_mtx);
+        if (ci->closed) return nullptr;
+        old = std::move(ci->room);
+        if (old) rooms->leave(old, ci.get(), ci->shard->id);
+        room = rooms->join(name, ci, ci->shard->id);
+        ci->room = room;
     }
+    if (federation) federation->user_joined(ci->username, name);
+
+    if (old) publish(*old, make_message({"[SISTEMA] ", ci->username, " saiu da sala ", old->name(), ".\n"}));
+    publish(*room, make_message({"[SISTEMA] ", ci->username, " entrou na sala ", room->name(), ".\n"}), ci);
+    return room;
 }
 
-// Listar usurios online
-std::string list_online_users() {
-    std::lock_guard<std::mutex> lg(clients_mtx);
+// Salas existentes, das mais cheias para as mais vazias
+std::string list_rooms(const std::shared_ptr<ChatRoom>& mine) {
+    auto all = rooms->list();
     std::ostringstream oss;
-    oss << "[SISTEMA] Usurios online: ";
+    oss << "[SISTEMA] Salas (" << all.size() << "):\n";
+    for (size_t i = 0; i < all.size() && i < ROOMS_LISTED; ++i) {
+        oss << "  " << all[i].first << ": " << all[i].second << " membro(s)";
+        if (mine && all[i].first == mine->name()) oss << " (voc est aqui)";
+        oss << "\n";
+    }
+    if (all.size() > ROOMS_LISTED) oss << "  ... e mais " << all.size() - ROOMS_LISTED << "\n";
+    return oss.str();
+}
+
+bool is_admin(const std::shared_ptr<ClientInfo>& ci) {
+    return ci->username == "admin";
+}
 
-    bool first = true;
-    for (const auto& pair : clients) {
-        if (pair.second && pair.second->authenticated) {
-            if (!first) oss << ", ";
-            oss << pair.second->username;
-            first = false;
+// Profundidade da fila de sada de cada usurio online
+std::string list_queue_depths() {
+    std::ostringstream oss;
+    oss << "[SISTEMA] Filas de sada (mx " << config.queue_max << ", "
+        << overflow_policy_to_string(config.overflow) << "):\n";
+    presence.for_each([&oss](const std::string& name, const std::shared_ptr<ClientInfo>& c) {
+        if (!c->node.empty()) return;
+        oss << "  " << name << ": " << c->outq.depth()
+            << " pendente(s), " << c->outq.dropped() << " descartada(s), "
+            << c->outq.sent_messages() << " enviada(s) em " << c->outq.writes() << " escrita(s)";
+        uint64_t holds = c->coalesce_holds.load(std::memory_order_relaxed);
+        if (holds > 0) {
+            oss << ", espera mdia " << std::fixed << std::setprecision(2)
+                << c->coalesce_delay_ns.load(std::memory_order_relaxed) / 1e6 / holds << " ms";
         }
-    }
-    oss << "\n";
+        oss << "\n";
+    });
     return oss.str();
 }
 
+// Resumo das mtricas para o /stats
+std::string format_stats() {
+    return "[SISTEMA] Mtricas:\n" + registry.render_text();
+}
+
+// /users [prefixo] [pgina]: a lista completa sai do cache da verso atual
+// do registro; com prefixo, a pgina  montada na hora
+MessageRef list_online_users(std::istringstream& args) {
+    std::string a, b;
+    args >> a >> b;
+    std::string prefix;
+    size_t page = 1;
+    auto is_number = [](const std::string& s) {
+        return !s.empty() && s.size() < 10 && std::all_of(s.begin(), s.end(), [](unsigned char c) { return std::isdigit(c) != 0; });
+    };
+    if (is_number(a)) {
+        page = std::stoul(a);
+    } else {
+        prefix = a;
+        if (is_number(b)) page = std::stoul(b);
+    }
+
+    MessageRef reply = prefix.empty() ? presence.page(page) : presence.search(prefix, page);
+    return reply ? reply : make_message("[SISTEMA] Pgina inexistente. Uso: /users [prefixo] [pgina]\n");
+}
+
 // Processar comandos
-bool process_command(std::shared_ptr<ClientInfo> ci, const std::string& cmd) {
-    std::istringstream iss(cmd);
+bool process_command(std::shared_ptr<ClientInfo> ci, std::string_view cmd) {
+    std::istringstream iss{std::string(cmd)};
     std::string command;
     iss >> command;
 
@@ -202,8 +744,7 @@ bool process_command(std::shared_ptr<ClientInfo> ci, const std::string& cmd) {
         return false;
     }
     else if (command == "/users" || command == "/list") {
-        std::string list = list_online_users();
-        send(ci->fd, list.data(), list.size(), MSG_NOSIGNAL);
+        send_to_client(ci, list_online_users(iss));
     }
     else if (command == "/msg" || command == "/pm") {
         std::string to_user, message;
@@ -213,251 +754,1697 @@ bool process_command(std::shared_ptr<ClientInfo> ci, const std::string& cmd) {
 
         if (to_user.empty() || message.empty()) {
             std::string err = "[SISTEMA] Uso: /msg <usuario> <mensagem>\n";
-            send(ci->fd, err.data(), err.size(), MSG_NOSIGNAL);
+            send_to_client(ci, err);
         } else {
-            send_private_message(ci->username, to_user, message);
+            send_private_message(ci, to_user, message);
         }
     }
     else if (command == "/history") {
-        auto recent = msg_history.get_recent(10);
-        std::string hist = "[SISTEMA] ltimas mensagens:\n";
-        for (const auto& msg : recent) {
-            hist += msg;
+        // /history [N]: a resposta inteira precisa caber na fila de sada
+        size_t n = DEFAULT_HISTORY_REPLY;
+        std::string arg;
+        if (iss >> arg) {
+            try {
+                n = std::stoul(arg);
+            } catch (const std::exception&) {
+                send_to_client(ci, "[SISTEMA] Uso: /history [N]\n");
+                return true;
+            }
+        }
+        auto room = current_room(*ci);
+        if (!room) return true;
+        n = std::min({n, room->history().capacity(), config.queue_max - 1});
+
+        auto recent = room->history().get_recent(n);
+        recent.insert(recent.begin(), make_message({"[SISTEMA] ltimas mensagens em ", room->name(), ":\n"}));
+        send_to_client(ci, std::move(recent));
+    }
+    else if (command == "/join") {
+        std::string name;
+        iss >> name;
+        auto room = current_room(*ci);
+        if (!RoomRegistry::valid_name(name)) {
+            send_to_client(ci, "[SISTEMA] Uso: /join <sala> (at 32 letras, dgitos, - ou _)\n");
+        } else if (room && room->name() == name) {
+            send_to_client(ci, "[SISTEMA] Voc j est na sala " + name + ".\n");
+        } else if ((room = move_to_room(ci, name))) {
+            send_to_client(ci, "[SISTEMA] Voc entrou na sala " + name + " (" +
+                               std::to_string(room->size()) + " membro(s)).\n");
+        }
+    }
+    else if (command == "/leave") {
+        auto room = current_room(*ci);
+        if (room == rooms->default_room()) {
+            send_to_client(ci, std::string("[SISTEMA] Voc j est na sala ") + DEFAULT_ROOM + ".\n");
+        } else if ((room = move_to_room(ci, DEFAULT_ROOM))) {
+            send_to_client(ci, std::string("[SISTEMA] Voc voltou para a sala ") + DEFAULT_ROOM + ".\n");
+        }
+    }
+    else if (command == "/rooms") {
+        send_to_client(ci, list_rooms(current_room(*ci)));
+    }
+    else if (command == "/queue") {
+        if (!is_admin(ci)) {
+            send_to_client(ci, "[SISTEMA] Comando restrito ao admin.\n");
+        } else {
+            send_to_client(ci, list_queue_depths());
+        }
+    }
+    else if (command == "/stats") {
+        if (!is_admin(ci)) {
+            send_to_client(ci, "[SISTEMA] Comando restrito ao admin.\n");
+        } else {
+            send_to_client(ci, format_stats());
         }
-        send(ci->fd, hist.data(), hist.size(), MSG_NOSIGNAL);
     }
     else if (command == "/help") {
         std::string help =
             "[SISTEMA] Comandos disponveis:\n"
-            "  /users, /list - Listar usurios online\n"
-            "  /msg, /pm <user> <msg> - Mensagem privada\n"
-            "  /history - Ver histrico recente\n"
+            "  /users, /list [prefixo] [pgina] - Listar usurios online\n"
+            "  /msg, /pm <user> <msg> - Mensagem privada (guardada se o usurio estiver offline)\n"
+            "  /history [N] - Ver as ltimas N mensagens da sala (padro 10)\n"
+            "  /join <sala> - Entrar numa sala (criada se no existir)\n"
+            "  /leave - Voltar para a sala geral\n"
+            "  /rooms - Listar salas\n"
+            "  /queue - Filas de sada por usurio (admin)\n"
+            "  /stats - Mtricas do servidor (admin)\n"
             "  /help - Esta ajuda\n"
             "  /quit, /exit - Sair\n";
-        send(ci->fd, help.data(), help.size(), MSG_NOSIGNAL);
+        send_to_client(ci, help);
     }
     else {
         std::string err = "[SISTEMA] Comando desconhecido. Use /help\n";
-        send(ci->fd, err.data(), err.size(), MSG_NOSIGNAL);
+        send_to_client(ci, err);
     }
 
     return true;
 }
 
-// Autenticao do cliente
-bool authenticate_client(std::shared_ptr<ClientInfo> ci) {
-    char buf[256];
+// Reserva uma vaga de login pendente; false quando o limite foi atingido
+bool begin_handshake(ClientInfo& c) {
+    if (handshakes_pending.fetch_add(1) >= config.max_pending) {
+        handshakes_pending.fetch_sub(1);
+        return false;
+    }
+    c.handshaking = true;
+    c.handshake_deadline = metrics::now_ns() + uint64_t(config.auth_timeout_ms) * 1000000ULL;
+    return true;
+}
 
-    // Solicitar username
-    std::string prompt = "Digite seu username: ";
-    send(ci->fd, prompt.data(), prompt.size(), MSG_NOSIGNAL);
+void end_handshake(ClientInfo& c) {
+    if (c.handshaking.exchange(false)) handshakes_pending.fetch_sub(1);
+}
 
-    ssize_t n = recv(ci->fd, buf, sizeof(buf)-1, 0);
-    if (n <= 0) return false;
-    buf[n] = '\0';
+// Manda o aviso sem esperar e fecha uma conexo recm-aceita
+void refuse(int fd, std::string_view notice) {
+    ssize_t n = send(fd, notice.data(), notice.size(), MSG_DONTWAIT | MSG_NOSIGNAL);
+    (void)n;
+    close(fd);
+}
 
-    std::string username(buf);
-    username.erase(std::remove(username.begin(), username.end(), '\n'), username.end());
-    username.erase(std::remove(username.begin(), username.end(), '\r'), username.end());
+// Recusa uma conexo recm-aceita sem criar estado para ela
+void reject_connection(int fd, const std::string& addr) {
+    refuse(fd, "[SISTEMA] Servidor ocupado, tente novamente mais tarde.\n");
+    m_handshake_rejected.inc();
+    TSLOG_EVERY_MS(Level::WARN, 1000, "Conexo de {} recusada: {} logins pendentes", addr, config.max_pending);
+}
 
-    // Solicitar senha
-    prompt = "Digite sua senha: ";
-    send(ci->fd, prompt.data(), prompt.size(), MSG_NOSIGNAL);
+// Verifica a senha no pool de autenticao e chama done(vlida) na thread
+// do pool. Um login repetido dentro do prazo do cache  aceito na hora.
+// Retorna false se a fila do pool estiver cheia.
+bool verify_password(const std::string& username, std::string password,
+                     std::function<void(bool)> done) {
+    m_auth_attempts.inc();
+    if (auth_cache->check(username, password)) {
+        m_auth_cache_hits.inc();
+        done(true);
+        return true;
+    }
 
-    n = recv(ci->fd, buf, sizeof(buf)-1, 0);
-    if (n <= 0) return false;
-    buf[n] = '\0';
+    uint64_t queued = metrics::now_ns();
+    bool accepted = auth_pool->submit([username, password = std::move(password),
+                                       done = std::move(done), queued] {
+        uint64_t t0 = metrics::now_ns();
+        m_stage_auth_queue.record(t0 - queued);
+        bool valid = credentials.verify(username, password);
+        m_stage_auth.record_since(t0);
+        if (valid) auth_cache->remember(username, password);
+        done(valid);
+    });
+    if (!accepted) m_auth_rejected.inc();
+    return accepted;
+}
 
-    std::string password(buf);
-    password.erase(std::remove(password.begin(), password.end(), '\n'), password.end());
-    password.erase(std::remove(password.begin(), password.end(), '\r'), password.end());
+// Limite de conexes por endereo (--conn-limit), conferido antes de criar
+// qualquer estado para a conexo
+bool admit_connection(int fd, const sockaddr_in& cli, const std::string& addr) {
+    if (ip_limits->take(RateLimiter::key_of(ntohl(cli.sin_addr.s_addr)), metrics::now_ns()) == RateVerdict::ALLOW) {
+        return true;
+    }
+    refuse(fd, "[SISTEMA] Conexes demais deste endereo, tente novamente mais tarde.\n");
+    m_limited_connections.inc();
+    TSLOG_EVERY_MS(Level::WARN, 1000, "Conexo de {} recusada: limite de conexes por endereo", addr);
+    return false;
+}
 
-    // Verificar credenciais
-    auto it = user_passwords.find(username);
-    if (it == user_passwords.end() || it->second != password) {
+// Limites por usurio (--msg-limit, --byte-limit). A linha recusada 
+// descartada antes do filtro e do broadcast; com --limit-notice o usurio 
+// avisado uma vez a cada sequncia de recusas.
+bool admit_line(const std::shared_ptr<ClientInfo>& ci, std::string_view line) {
+    RateVerdict v = user_limits->take(RateLimiter::key_of(ci->username), metrics::now_ns(), 1,
+                                      static_cast<double>(line.size()));
+    if (v == RateVerdict::ALLOW) {
+        ci->throttled = false;
+        return true;
+    }
+    (v == RateVerdict::DENY_FIRST ? m_limited_messages : m_limited_bytes).inc();
+    TSLOG_EVERY_MS(Level::WARN, 1000, "Usurio {} acima do limite de {}; linha descartada", ci->username,
+                   v == RateVerdict::DENY_FIRST ? "mensagens" : "bytes");
+    if (config.limit_notice && !ci->throttled) {
+        send_to_client(ci, "[SISTEMA] Limite de mensagens excedido; aguarde antes de enviar mais.\n");
+    }
+    ci->throttled = true;
+    return false;
+}
+
+// Registra como online o usurio cuja senha j foi verificada
+bool login_client(std::shared_ptr<ClientInfo> ci, const std::string& username, bool valid) {
+    if (!valid) {
+        m_auth_failures.inc();
         std::string err = "[SISTEMA] Autenticao falhou!\n";
-        send(ci->fd, err.data(), err.size(), MSG_NOSIGNAL);
-        Logger::instance().warn("Falha de autenticao para username: " + username);
+        send_to_client(ci, err);
+        TSLOG_EVERY_MS(Level::WARN, 1000, "Falha de autenticao para username: {}", username);
+        return false;
+    }
+
+    // Registra como online, a menos que o usurio j esteja
+    ci->username = username;
+    if (!presence.add(username, ci)) {
+        m_auth_failures.inc();
+        std::string err = "[SISTEMA] Usurio j est online!\n";
+        send_to_client(ci, err);
         return false;
     }
 
-    // Verificar se usurio j est online
+    ci->authenticated = true;
+    end_handshake(*ci);
+
+    std::string welcome = "[SISTEMA] Bem-vindo, " + username + "! Use /help para comandos.\n";
+    send_to_client(ci, welcome);
+
+    // Entra na sala padro e notifica os outros membros
+    std::shared_ptr<ChatRoom> room;
     {
-        std::lock_guard<std::mutex> lg(clients_mtx);
-        if (username_to_fd.find(username) != username_to_fd.end()) {
-            std::string err = "[SISTEMA] Usurio j est online!\n";
-            send(ci->fd, err.data(), err.size(), MSG_NOSIGNAL);
+        std::lock_guard<std::mutex> lg(ci->room_mtx);
+        if (ci->closed) {
+            unregister_user(ci);
             return false;
         }
-        username_to_fd[username] = ci->fd;
+        room = rooms->join(DEFAULT_ROOM, ci, ci->shard->id);
+        ci->room = room;
     }
+    if (federation) federation->user_joined(username, DEFAULT_ROOM);
+    publish(*room, make_message({"[SISTEMA] ", username, " entrou no chat.\n"}), ci);
+    if (mailboxes) deliver_mailbox(ci);
 
-    ci->username = username;
-    ci->authenticated = true;
+    TSLOG_INFO("Usurio {} autenticado com sucesso", username);
+    return true;
+}
 
-    std::string welcome = "[SISTEMA] Bem-vindo, " + username + "! Use /help para comandos.\n";
-    send(ci->fd, welcome.data(), welcome.size(), MSG_NOSIGNAL);
+// Trata uma linha recebida de um cliente autenticado.
+// Retorna false quando o cliente pediu para sair.
+bool handle_message(std::shared_ptr<ClientInfo> ci, std::string_view msg) {
+    // Comandos tambm contam (/msg, /history); sair passa sempre
+    if (user_limits && msg != "/quit" && msg != "/exit" && !admit_line(ci, msg)) return true;
+
+    // Processar comandos
+    if (!msg.empty() && msg[0] == '/') {
+        return process_command(ci, msg);
+    }
+
+    m_messages_in.inc();
+
+    // Verificar filtro
+    uint64_t t0 = metrics::now_ns();
+    bool banned = contains_banned_word(msg);
+    m_stage_filter.record_since(t0);
+    if (banned) {
+        m_messages_filtered.inc();
+        std::string notice = "[SISTEMA] Mensagem bloqueada: contm palavra proibida.\n";
+        send_to_client(ci, notice);
+        TSLOG_EVERY_MS(Level::WARN, 1000, "Mensagem de {} bloqueada por filtro", ci->username);
+        return true;
+    }
 
-    // Notificar outros usurios
-    std::string join_msg = "[SISTEMA] " + username + " entrou no chat.\n";
-    broadcast_message(join_msg, ci->fd);
-    msg_history.add(join_msg);
+    // Broadcast da mensagem para a sala atual
+    auto room = current_room(*ci);
+    if (!room) return true;
+    auto full_msg = make_message({"[", ci->username, "] ", msg, "\n"});
+    Logger::instance().log(Level::INFO, "Mensagem: ", full_msg, full_msg->view());
+    TSLOG_SAMPLED(Level::DEBUG, 1000, "Amostra: mensagem de {} na sala {} ({} bytes)",
+                  ci->username, room->name(), full_msg->size());
 
-    Logger::instance().info("Usurio " + username + " autenticado com sucesso");
+    publish(*room, full_msg, ci);
     return true;
 }
 
-// Thread para lidar com cliente
-void handle_client(std::shared_ptr<ClientInfo> ci) {
-    Logger::instance().info("Conexo de " + ci->addr + " (fd " + std::to_string(ci->fd) + ")");
+// Remove da tabela e do lao antes do close() para que o fd no seja
+// reutilizado enquanto ainda est registrado
+void release_fd(ClientInfo& c) {
+    if (c.fd_released) return;
+    c.fd_released = true;
+    c.shard->clients.erase(c.fd);
+    c.shard->loop.remove(c.fd);
+    close(c.fd);
+}
 
-    // Autenticar cliente
-    if (!authenticate_client(ci)) {
-        close(ci->fd);
-        remove_client(ci->fd);
-        return;
+// Encerra a conexo na thread do shard dono
+void shard_close(std::shared_ptr<ClientInfo> ci) {
+    if (ci->closed.exchange(true)) return;
+
+    bool was_authenticated = ci->authenticated.exchange(false);
+    if (was_authenticated) unregister_user(ci);
+    end_handshake(*ci);
+
+    std::shared_ptr<ChatRoom> room;
+    {
+        std::lock_guard<std::mutex> lg(ci->room_mtx);
+        room = std::move(ci->room);
     }
+    if (room) rooms->leave(room, ci.get(), ci->shard->id);
+
+    // No io_uring a escrita fica para o fim da volta do lao, e com janela
+    // de agrupamento para o fim dela. O que ainda estiver na fila (um aviso
+    // antes de desconectar) sai agora ou, com um envio em andamento, quando
+    // ele terminar (send_done)
+    if (ci->shard->uring && !ci->threaded && ci->send_inflight) {
+        ci->shard->closing.emplace_back(ci, metrics::now_ns() + CLOSE_GRACE_MS * 1000000ULL);
+    } else {
+        if (!ci->outq.empty()) flush_client(*ci);
+        release_fd(*ci);
+    }
+    m_connections_open.sub(1);
+
+    // Notificar sada; quem foi substitudo por uma sesso em outro n no
+    // saiu do chat
+    if (was_authenticated && federation) federation->user_left(ci->username);
+    if (was_authenticated && room && !ci->superseded) {
+        publish(*room, make_message({"[SISTEMA] ", ci->username, " saiu do chat.\n"}));
+    }
+}
+
+void close_client(std::shared_ptr<ClientInfo> ci) {
+    if (ci->shard->loop.in_loop_thread()) {
+        shard_close(ci);
+    } else {
+        ci->shard->loop.post([ci] { shard_close(ci); });
+    }
+}
+
+// Encerra um login que passou do prazo (thread do shard dono)
+void expire_handshake(const std::shared_ptr<ClientInfo>& ci) {
+    if (ci->closed || !ci->handshaking) return;
+    m_handshake_timeouts.inc();
+    TSLOG_EVERY_MS(Level::WARN, 1000, "Login de {} no concludo em {} ms; desconectando",
+                   ci->addr, config.auth_timeout_ms);
+    if (write_client(*ci, make_message("\n[SISTEMA] Tempo para login esgotado.\n"))) flush_client(*ci);
+    shard_close(ci);
+}
 
+// Timer do shard: retira da frente da fila os logins vencidos. Entradas de
+// conexes que j autenticaram ou fecharam s so descartadas.
+void sweep_handshakes(Shard& s) {
+    uint64_t now = metrics::now_ns();
+    while (!s.handshakes.empty()) {
+        auto ci = s.handshakes.front().lock();
+        if (ci && ci->handshaking && ci->handshake_deadline > now) break;
+        s.handshakes.pop_front();
+        if (ci) expire_handshake(ci);
+    }
+}
+
+// Fecha as conexes encerradas cujo ltimo envio no terminou no prazo
+// (cliente que no l); remove() cancela o envio
+void sweep_closing(Shard& s) {
+    uint64_t now = metrics::now_ns();
+    while (!s.closing.empty() && s.closing.front().second <= now) {
+        if (auto ci = s.closing.front().first.lock()) release_fd(*ci);
+        s.closing.pop_front();
+    }
+}
+
+// Limita o tempo de espera de recv() no modo threads; 0 desliga
+void set_recv_timeout(int fd, uint64_t ns) {
+    timeval tv{};
+    tv.tv_sec = static_cast<time_t>(ns / 1000000000ULL);
+    tv.tv_usec = static_cast<suseconds_t>((ns % 1000000000ULL) / 1000);
+    if (ns > 0 && tv.tv_sec == 0 && tv.tv_usec == 0) tv.tv_usec = 1;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+// Conclui o login com o resultado da verificao e trata as linhas que
+// chegaram enquanto ela rodava (thread que l do socket)
+bool finish_login(const std::shared_ptr<ClientInfo>& ci, bool valid) {
+    if (ci->closed) return false;
+    ci->pending_password.clear();
+    if (!login_client(ci, ci->pending_user, valid)) return false;
+    ci->stage = AuthStage::DONE;
+
+    auto lines = std::move(ci->deferred);
+    ci->deferred.clear();
+    for (const auto& l : lines) {
+        if (!handle_message(ci, l) || ci->closed) return false;
+    }
+    return true;
+}
+
+// Manda a senha para verificao. No modo reator a resposta volta pela
+// caixa de entrada do shard e a leitura segue normalmente; no modo threads
+// a prpria thread do cliente espera.
+bool start_login(const std::shared_ptr<ClientInfo>& ci, std::string password) {
+    if (ci->threaded) {
+        std::promise<bool> verdict;
+        auto result = verdict.get_future();
+        if (verify_password(ci->pending_user, std::move(password),
+                            [&verdict](bool valid) { verdict.set_value(valid); })) {
+            return finish_login(ci, result.get());
+        }
+    } else {
+        ci->pending_password = password;
+        if (verify_password(ci->pending_user, std::move(password), [ci](bool valid) {
+                auto done = [ci, valid] {
+                    if (!finish_login(ci, valid)) shard_close(ci);
+                };
+                if (ci->shard->loop.in_loop_thread()) {
+                    done();
+                } else {
+                    ci->shard->loop.post(std::move(done));
+                }
+            })) {
+            return true;
+        }
+    }
+
+    send_to_client(ci, "[SISTEMA] Servidor ocupado, tente novamente mais tarde.\n");
+    TSLOG_EVERY_MS(Level::WARN, 1000, "Login de {} recusado: fila de verificao cheia", ci->addr);
+    return false;
+}
+
+// Processa uma linha completa conforme a etapa da conexo.
+// Retorna false quando a conexo deve ser encerrada.
+bool handle_line(std::shared_ptr<ClientInfo> ci, std::string_view line) {
+    switch (ci->stage) {
+        case AuthStage::USERNAME:
+            ci->pending_user.assign(line.data(), line.size());
+            ci->stage = AuthStage::PASSWORD;
+            send_to_client(ci, "Digite sua senha: ");
+            return true;
+
+        case AuthStage::PASSWORD:
+            ci->stage = AuthStage::VERIFYING;
+            return start_login(ci, std::string(line));
+
+        case AuthStage::VERIFYING:
+            // Linhas mandadas junto com a senha esperam o resultado
+            if (ci->deferred.size() >= DEFERRED_MAX) {
+                send_to_client(ci, "[SISTEMA] Aguarde a verificao do login.\n");
+            } else {
+                ci->deferred.emplace_back(line);
+            }
+            return true;
+
+        case AuthStage::DONE:
+            return handle_message(ci, line);
+    }
+    return false;
+}
+
+// Passa um bloco recebido pelo framer e trata todas as linhas completas.
+// Retorna false quando a conexo deve ser encerrada.
+bool consume_input(const std::shared_ptr<ClientInfo>& ci, const char* data, size_t n) {
+    m_bytes_in.inc(n);
+    uint64_t overflowed = ci->framer.overflowed();
+    bool keep = ci->framer.feed(data, n, [&ci](std::string_view line) {
+        return handle_line(ci, line) && !ci->closed;
+    });
+    if (keep && ci->framer.overflowed() != overflowed) {
+        send_to_client(ci, "[SISTEMA] Linha excede " + std::to_string(ci->framer.max_line()) +
+                           " bytes e foi descartada.\n");
+    }
+    return keep;
+}
+
+// Thread para lidar com cliente (modo threads)
+void handle_client(std::shared_ptr<ClientInfo> ci) {
+    TSLOG_INFO("Conexo de {} (fd {})", ci->addr, ci->fd);
+
+    send_to_client(ci, "Digite seu username: ");
+
+    // Durante o login cada recv() espera no mximo at o prazo; quem manda
+    // bytes aos poucos no consegue estend-lo
+    bool timed = false;
     char buf[BUF_SIZE];
     while (running.load()) {
-        ssize_t n = recv(ci->fd, buf, sizeof(buf)-1, 0);
+        if (ci->handshaking) {
+            uint64_t now = metrics::now_ns();
+            if (now >= ci->handshake_deadline) {
+                ci->shard->loop.post([ci] { expire_handshake(ci); });
+                return;
+            }
+            set_recv_timeout(ci->fd, ci->handshake_deadline - now);
+            timed = true;
+        } else if (timed) {
+            set_recv_timeout(ci->fd, 0);
+            timed = false;
+        }
+
+        metrics::syscalls(metrics::Syscall::RECV).inc();
+        ssize_t n = recv(ci->fd, buf, sizeof(buf), 0);
+        if (n < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) continue;
         if (n <= 0) {
             if (n == 0) {
-                Logger::instance().info("Cliente " + ci->username + " desconectou");
+                Logger::instance().logf(Level::INFO, FMT_DISCONNECTED, ci->username);
             } else {
-                Logger::instance().error("Erro recv() para " + ci->username);
+                Logger::instance().logf(Level::ERROR, FMT_RECV_ERROR, ci->username);
             }
             break;
         }
 
-        buf[n] = '\0';
-        std::string msg(buf);
-        msg.erase(std::remove(msg.begin(), msg.end(), '\r'), msg.end());
-        if (!msg.empty() && msg.back() == '\n') msg.pop_back();
+        if (!consume_input(ci, buf, n)) break;
+    }
+
+    close_client(ci);
+}
 
-        // Processar comandos
-        if (!msg.empty() && msg[0] == '/') {
-            if (!process_command(ci, msg)) break;
+// ---- Modo reator (epoll) ----
+
+// L at EAGAIN (edge-triggered); cada bloco lido passa direto pelo framer
+void reactor_read(std::shared_ptr<ClientInfo> ci) {
+    char buf[BUF_SIZE];
+    for (;;) {
+        metrics::syscalls(metrics::Syscall::RECV).inc();
+        ssize_t n = recv(ci->fd, buf, sizeof(buf), 0);
+        if (n > 0) {
+            if (!consume_input(ci, buf, n)) {
+                shard_close(ci);
+                return;
+            }
             continue;
         }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
 
-        // Verificar filtro
-        if (contains_banned_word(msg)) {
-            std::string notice = "[SISTEMA] Mensagem bloqueada: contm palavra proibida.\n";
-            send(ci->fd, notice.data(), notice.size(), MSG_NOSIGNAL);
-            Logger::instance().warn("Mensagem de " + ci->username + " bloqueada por filtro");
-            continue;
+        if (n == 0) {
+            Logger::instance().logf(Level::INFO, FMT_DISCONNECTED, ci->username);
+        } else {
+            Logger::instance().logf(Level::ERROR, FMT_RECV_ERROR, ci->username);
         }
+        shard_close(ci);
+        return;
+    }
+}
 
-        // Broadcast da mensagem
-        std::string full_msg = "[" + ci->username + "] " + msg + "\n";
-        Logger::instance().info("Mensagem de " + ci->username + ": " + msg);
+void reactor_event(std::shared_ptr<ClientInfo> ci, uint32_t events) {
+    if (events & EPOLLOUT) {
+        if (!flush_client(*ci)) {
+            shard_close(ci);
+            return;
+        }
+    }
+    if (!ci->threaded && (events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))) {
+        reactor_read(ci);
+    }
+}
 
-        broadcast_message(full_msg, ci->fd);
-        msg_history.add(full_msg);
+// Timer da janela de agrupamento: libera as conexes cuja janela venceu
+// (a fila est em ordem de prazo) e rearma para a prxima
+void flush_coalesced(Shard& s) {
+    s.coalesce_armed = false;
+    uint64_t window = config.coalesce_us * 1000ULL;
+    uint64_t now = metrics::now_ns();
+    while (!s.coalesce.empty() && s.coalesce.front()->coalesce_since + window <= now) {
+        std::shared_ptr<ClientInfo> ci = std::move(s.coalesce.front());
+        s.coalesce.pop_front();
+        ci->coalescing = false;
+        if (ci->closed || ci->outq.empty()) continue;
+
+        uint64_t held = now - ci->coalesce_since;
+        m_stage_coalesce.record(held);
+        ci->coalesce_holds.fetch_add(1, std::memory_order_relaxed);
+        ci->coalesce_delay_ns.fetch_add(held, std::memory_order_relaxed);
+        if (s.uring && !ci->threaded) {
+            schedule_send(*ci);
+        } else if (!flush_client(*ci)) {
+            shard_close(ci);
+        }
     }
+    if (s.coalesce.empty()) return;
+
+    uint64_t left_us = (s.coalesce.front()->coalesce_since + window - now) / 1000;
+    s.coalesce_armed = s.loop.arm_timer(s.coalesce_timer, std::max<uint64_t>(left_us, 1));
+}
 
-    // Notificar sada
-    std::string leave_msg = "[SISTEMA] " + ci->username + " saiu do chat.\n";
-    broadcast_message(leave_msg);
-    msg_history.add(leave_msg);
+// ---- Backend io_uring do modo reator ----
 
-    close(ci->fd);
-    remove_client(ci->fd);
+// Bloco entregue pelo recv multishot (buffer do anel, vlido s aqui)
+void uring_recv(const std::shared_ptr<ClientInfo>& ci, const char* data, ssize_t n) {
+    if (ci->closed) return;
+    if (n > 0) {
+        if (!consume_input(ci, data, static_cast<size_t>(n))) shard_close(ci);
+        return;
+    }
+    if (n == 0) {
+        Logger::instance().logf(Level::INFO, FMT_DISCONNECTED, ci->username);
+    } else {
+        Logger::instance().logf(Level::ERROR, FMT_RECV_ERROR, ci->username);
+    }
+    shard_close(ci);
 }
 
-void sigint_handler(int) {
-    running.store(false);
-    Logger::instance().info("Sinal de interrupo recebido");
-    if (listen_fd >= 0) {
-        shutdown(listen_fd, SHUT_RDWR);
-        close(listen_fd);
+// Concluso do sendmsg de uma conexo: tira da fila o que foi aceito e, se
+// sobrou algo, volta para o prximo lote
+void send_done(const std::shared_ptr<ClientInfo>& ci, ssize_t n) {
+    ci->send_inflight = false;
+    if (ci->closed) {
+        // Encerrada durante o envio: manda o resto e fecha
+        if (n >= 0) {
+            ci->outq.consume(static_cast<size_t>(n));
+            if (!ci->outq.empty()) flush_client(*ci);
+        }
+        release_fd(*ci);
+        return;
+    }
+    if (n < 0) {
+        ci->outq.release();
+        if (n == -EINTR || n == -EAGAIN) {
+            schedule_send(*ci);
+            return;
+        }
+        TSLOG_EVERY_MS(Level::ERROR, 1000, "Erro sendmsg() para {}: {}", ci->addr, strerror(static_cast<int>(-n)));
+        shard_close(ci);
+        return;
     }
+
+    ci->outq.consume(static_cast<size_t>(n));
+    m_bytes_out.inc(static_cast<uint64_t>(n));
+    m_stage_flush.record_since(ci->send_started);
+    if (!ci->outq.empty()) schedule_send(*ci);
 }
 
-int main(int argc, char** argv) {
-    int port = (argc > 1) ? std::stoi(argv[1]) : DEFAULT_PORT;
+// Antes de cada espera do lao: um sendmsg por conexo com sada pendente,
+// todos entregues ao kernel na mesma io_uring_enter(). Uma conexo tem no
+// mximo um envio em andamento; o que chegar nesse meio tempo vai no prximo.
+void submit_sends(Shard& s) {
+    s.send_batch.swap(s.send_ready);
+    for (auto& ci : s.send_batch) {
+        ci->send_scheduled = false;
+        if (ci->closed || ci->send_inflight || ci->outq.empty()) continue;
+
+        iovec iov[EventLoop::MAX_SEND_IOV];
+        size_t cnt = ci->outq.gather(iov, EventLoop::MAX_SEND_IOV);
+        ci->send_inflight = true;
+        ci->send_started = metrics::now_ns();
+        if (!s.loop.send(ci->fd, iov, cnt, [ci](ssize_t n) { send_done(ci, n); })) {
+            ci->send_inflight = false;
+            ci->outq.release();
+            schedule_send(*ci);
+        }
+    }
+    s.send_batch.clear();
+}
 
-    Logger::instance().init("server.log", Level::DEBUG);
-    Logger::instance().info("=== Servidor de Chat Iniciando ===");
-    Logger::instance().info("Porta: " + std::to_string(port));
+// Registra a conexo no shard dono (executa na thread desse shard). No modo
+// threads o shard s acompanha EPOLLOUT; a leitura fica com a thread do
+// cliente. No io_uring a leitura  um recv multishot e a escrita sai pelos
+// lotes de submit_sends.
+bool shard_attach(std::shared_ptr<ClientInfo> ci) {
+    Shard& s = *ci->shard;
+    m_connections.inc();
+    m_connections_open.add(1);
+    s.clients[ci->fd] = ci;
+    bool ok;
+    if (s.uring && !ci->threaded) {
+        ok = s.loop.recv_multishot(ci->fd, [ci](const char* data, ssize_t n) { uring_recv(ci, data, n); });
+    } else {
+        uint32_t events = ci->threaded ? (EPOLLOUT | EPOLLET) : CLIENT_EVENTS;
+        ok = s.loop.add(ci->fd, events, [ci](uint32_t ev) { reactor_event(ci, ev); });
+    }
+    if (!ok) {
+        TSLOG_ERROR("Falha ao registrar o fd {} no lao", ci->fd);
+        shard_close(ci);
+        return false;
+    }
+    return true;
+}
 
-    std::signal(SIGINT, sigint_handler);
-    std::signal(SIGTERM, sigint_handler);
-    std::signal(SIGPIPE, SIG_IGN);
+// Conexo recm-aceita no shard: entra no login ou  recusada se j houver
+// logins pendentes demais
+void accept_client(Shard& s, int cfd, const sockaddr_in& cli) {
+    std::string addr = std::string(inet_ntoa(cli.sin_addr)) +
+                       ":" + std::to_string(ntohs(cli.sin_port));
+    if (ip_limits && !admit_connection(cfd, cli, addr)) return;
+    auto ci = new_client();
+    if (!begin_handshake(*ci)) {
+        reject_connection(cfd, addr);
+        return;
+    }
+    ci->fd = cfd;
+    ci->addr = std::move(addr);
+    ci->shard = &s;
+
+    TSLOG_INFO("Conexo de {} (fd {}, shard {})", ci->addr, cfd, s.id);
+    if (shard_attach(ci)) {
+        s.handshakes.push_back(ci);
+        send_to_client(ci, "Digite seu username: ");
+    }
+}
+
+// Aceita at ACCEPT_BATCH conexes por vez; se ainda houver fila, continua
+// depois de atender os outros eventos do lao
+void shard_accept(Shard& s) {
+    for (int i = 0; i < ACCEPT_BATCH; ++i) {
+        sockaddr_in cli{};
+        socklen_t cli_len = sizeof(cli);
+        metrics::syscalls(metrics::Syscall::ACCEPT).inc();
+        int cfd = accept4(s.listen_fd, (sockaddr*)&cli, &cli_len,
+                          SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (cfd < 0) {
+            if (errno == EINTR) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK && running.load()) {
+                TSLOG_EVERY_MS(Level::ERROR, 1000, "Falha no accept(): {}", strerror(errno));
+            }
+            return;
+        }
+        accept_client(s, cfd, cli);
+    }
+
+    s.loop.post([&s] { shard_accept(s); });
+}
+
+// Conexo entregue pelo accept multishot; o endereo do cliente no vem
+// junto e  lido com getpeername()
+void uring_accept(Shard& s, int cfd) {
+    if (cfd < 0) {
+        if (running.load()) {
+            TSLOG_EVERY_MS(Level::ERROR, 1000, "Falha no accept(): {}", strerror(-cfd));
+        }
+        return;
+    }
+    sockaddr_in cli{};
+    socklen_t cli_len = sizeof(cli);
+    metrics::syscalls(metrics::Syscall::OTHER).inc();
+    getpeername(cfd, (sockaddr*)&cli, &cli_len);
+    accept_client(s, cfd, cli);
+}
+
+// ---- Federao ----
+// Os handlers rodam na thread da federao. Usurios de outros ns entram
+// na presena como entradas sem conexo (ClientInfo::node), ento /users,
+// /msg e a checagem de login duplicado valem para a federao inteira.
+
+// A entrada vem do mesmo slab das conexes: um bloco reaproveitado, sem
+// alocao alm dele (filas e buffers de um ClientInfo s alocam em uso)
+void add_remote_user(const std::string& node, const std::string& user) {
+    auto stub = new_client();
+    stub->username = user;
+    stub->node = node;
+    presence.add(user, stub);
+}
+
+// Usurio de outro n entrou, trocou de sala ou saiu. Se o mesmo usurio
+// estiver logado aqui, fica a sesso do n de nome menor; o outro n faz a
+// mesma conta e derruba a sua.
+void remote_presence(const std::string& node, const std::string& user, const std::string& room) {
+    auto cur = presence.find(user);
+    if (room.empty()) {
+        if (!cur || cur->node != node) return;
+        presence.remove(user, cur.get());
+        // Num conflito entre dois outros ns a presena passa para o que ficou
+        std::string other = federation->owner(user);
+        if (!other.empty()) add_remote_user(other, user);
+        return;
+    }
+    if (cur && !cur->node.empty()) return;
+    if (cur) {
+        if (config.node < node) return;
+        presence.remove(user, cur.get());
+        cur->superseded = true;
+        static const Format fmt("Usurio {} entrou no n {}; sesso local encerrada");
+        Logger::instance().logf(Level::WARN, fmt, user, node);
+        send_to_client(cur, "[SISTEMA] Sua conta entrou em outro servidor; sesso encerrada.\n");
+        close_client(cur);
+    }
+    add_remote_user(node, user);
+}
+
+// Mensagem de sala vinda de outro n: membros locais e histrico, sem
+// reencaminhar
+void remote_room_message(const std::string& name, MessageRef msg) {
+    auto room = rooms->find(name);
+    if (!room) return;
+    broadcast_message(*room, msg);
+    record_history(*room, msg);
+}
+
+// Mensagem privada vinda de outro n; se o destinatrio j saiu daqui, ela
+// fica na caixa dele e o remetente recebe o mesmo aviso de um /msg local
+void remote_deliver(const std::string& node, const std::string& to, const std::string& from, MessageRef msg) {
+    auto c = presence.find(to);
+    if (c && c->node.empty()) {
+        send_to_client(c, std::move(msg));
+        return;
+    }
+    if (from.empty()) return;
+    std::string notice = c ? "[SISTEMA] Usurio '" + to + "' no encontrado.\n" : store_offline(to, msg);
+    federation->deliver(node, from, "", make_message(std::move(notice)));
+}
+
+// N perdido: seus usurios saem da presena e as salas locais so avisadas
+void remote_node_lost(const std::string& node, const Federation::UserList& users) {
+    static const Format fmt("N {} perdido: {} usurio(s) desconectado(s)");
+    Logger::instance().logf(Level::WARN, fmt, node, users.size());
+    for (const auto& [user, name] : users) {
+        auto cur = presence.find(user);
+        if (!cur || cur->node != node) continue;
+        presence.remove(user, cur.get());
+        std::string other = federation->owner(user);
+        if (!other.empty()) {
+            add_remote_user(other, user);
+            continue;
+        }
+        if (auto room = rooms->find(name)) {
+            auto msg = make_message({"[SISTEMA] ", user, " saiu do chat.\n"});
+            broadcast_message(*room, msg);
+            record_history(*room, msg);
+        }
+    }
+}
 
-    listen_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (listen_fd < 0) {
+bool start_federation(const ServerConfig& cfg) {
+    FederationOptions opts;
+    opts.node = cfg.node;
+    opts.port = cfg.peer_port;
+    opts.timeout_ms = cfg.peer_timeout_ms;
+    opts.heartbeat_ms = std::max(10u, cfg.peer_timeout_ms / 6);
+
+    Federation::Handlers h;
+    h.presence = remote_presence;
+    h.room_message = remote_room_message;
+    h.deliver = remote_deliver;
+    h.node_lost = remote_node_lost;
+    h.event = [](const std::string& text) { Logger::instance().info("Federao: " + text); };
+    try {
+        federation = std::make_unique<Federation>(std::move(opts), std::move(h));
+    } catch (const std::exception& e) {
+        Logger::instance().error(std::string("No foi possvel iniciar a federao: ") + e.what());
+        return false;
+    }
+    for (const auto& peer : cfg.peers) federation->add_peer(peer);
+    federation->start();
+    Logger::instance().info("Federao: n " + cfg.node + " na porta " + std::to_string(federation->port()) +
+                            ", " + std::to_string(cfg.peers.size()) + " outro(s) n(s)");
+    return true;
+}
+
+// Cria um socket de escuta na porta; com reuseport vrios shards podem
+// escutar na mesma porta e o kernel distribui as conexes entre eles
+int open_listener(int port, bool reuseport) {
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
         Logger::instance().error("Falha ao criar socket");
-        return 1;
+        return -1;
     }
 
     int opt = 1;
-    setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt));
+    if (reuseport && setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) < 0) {
+        Logger::instance().error("Falha no SO_REUSEPORT");
+        close(fd);
+        return -1;
+    }
 
     sockaddr_in srv{};
     srv.sin_family = AF_INET;
     srv.sin_addr.s_addr = INADDR_ANY;
     srv.sin_port = htons(port);
 
-    if (bind(listen_fd, (sockaddr*)&srv, sizeof(srv)) < 0) {
+    if (bind(fd, (sockaddr*)&srv, sizeof(srv)) < 0) {
         Logger::instance().error("Falha no bind()");
-        close(listen_fd);
-        return 1;
+        close(fd);
+        return -1;
     }
 
-    if (listen(listen_fd, BACKLOG) < 0) {
+    if (listen(fd, BACKLOG) < 0) {
         Logger::instance().error("Falha no listen()");
-        close(listen_fd);
-        return 1;
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+// Eleva o limite de descritores abertos at o mximo permitido
+void raise_fd_limit() {
+    rlimit rl{};
+    if (getrlimit(RLIMIT_NOFILE, &rl) == 0 && rl.rlim_cur < rl.rlim_max) {
+        rl.rlim_cur = rl.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &rl);
     }
+    Logger::instance().info("Limite de descritores: " + std::to_string(rl.rlim_cur));
+}
 
+// Medidores calculados na leitura e, se pedido, o endpoint do Prometheus
+bool start_metrics(const ServerConfig& cfg) {
+    registry.gauge_fn("chat_users_online", "Usurios autenticados", [] {
+        return static_cast<int64_t>(presence.size());
+    });
+    registry.gauge_fn("chat_handshakes_pending", "Conexes ainda sem login", [] {
+        return static_cast<int64_t>(handshakes_pending.load());
+    });
+    registry.gauge_fn("chat_auth_queue_depth", "Verificaes de senha aguardando uma thread", [] {
+        return static_cast<int64_t>(auth_pool->depth());
+    });
+    registry.gauge_fn("chat_auth_cache_entries", "Sesses verificadas no cache", [] {
+        return static_cast<int64_t>(auth_cache->size());
+    });
+    registry.gauge_fn("chat_presence_version", "Verso do registro de presena", [] {
+        return static_cast<int64_t>(presence.version());
+    });
+    registry.gauge_fn("chat_outbound_queue_depth", "Mensagens pendentes nas filas de sada", [] {
+        int64_t total = 0;
+        presence.for_each([&total](const std::string&, const std::shared_ptr<ClientInfo>& c) {
+            total += c->outq.depth();
+        });
+        return total;
+    }, "agg=\"sum\"");
+    registry.gauge_fn("chat_outbound_queue_depth", "Mensagens pendentes nas filas de sada", [] {
+        int64_t deepest = 0;
+        presence.for_each([&deepest](const std::string&, const std::shared_ptr<ClientInfo>& c) {
+            deepest = std::max<int64_t>(deepest, c->outq.depth());
+        });
+        return deepest;
+    }, "agg=\"max\"");
+    registry.gauge_fn("chat_rooms", "Salas existentes", [] {
+        return static_cast<int64_t>(rooms->count());
+    });
+    registry.gauge_fn("chat_log_dropped", "Linhas descartadas pelo logger", [] {
+        return static_cast<int64_t>(Logger::instance().dropped());
+    });
+    for (size_t i = 0; i < static_cast<size_t>(metrics::Syscall::COUNT); ++i) {
+        auto call = static_cast<metrics::Syscall>(i);
+        registry.counter_fn("chat_syscalls_total", "Syscalls de I/O feitas pelo servidor",
+                            [call] { return metrics::syscalls(call).value(); },
+                            std::string("call=\"") + metrics::syscall_name(call) + "\"");
+    }
+    if (federation) {
+        const Federation::Stats& fs = federation->stats();
+        registry.gauge_fn("chat_federation_peers", "Links de sada ativos para outros ns", [&fs] {
+            return static_cast<int64_t>(fs.peers.load());
+        });
+        registry.gauge_fn("chat_federation_nodes", "Ns com link de entrada ativo", [&fs] {
+            return static_cast<int64_t>(fs.nodes.load());
+        });
+        registry.gauge_fn("chat_federation_remote_users", "Usurios online em outros ns", [&fs] {
+            return static_cast<int64_t>(fs.remote_users.load());
+        });
+        const char* const frames_help = "Frames trocados com outros ns";
+        registry.counter_fn("chat_federation_frames_total", frames_help, [&fs] { return fs.frames_out.load(); }, "dir=\"out\"");
+        registry.counter_fn("chat_federation_frames_total", frames_help, [&fs] { return fs.frames_in.load(); }, "dir=\"in\"");
+        const char* const bytes_help = "Bytes trocados com outros ns";
+        registry.counter_fn("chat_federation_bytes_total", bytes_help, [&fs] { return fs.bytes_out.load(); }, "dir=\"out\"");
+        registry.counter_fn("chat_federation_bytes_total", bytes_help, [&fs] { return fs.bytes_in.load(); }, "dir=\"in\"");
+        registry.counter_fn("chat_federation_batches_total", "Lotes de frames enviados (um send por link e volta do lao)",
+                            [&fs] { return fs.batches_out.load(); });
+        registry.counter_fn("chat_federation_links_lost_total", "Links com outros ns que caram",
+                            [&fs] { return fs.links_lost.load(); });
+    }
+    if (mailboxes) {
+        const MailboxStore::Stats& ms = mailboxes->stats();
+        registry.gauge_fn("chat_mailbox_messages", "Mensagens privadas guardadas para usurios offline", [] {
+            return static_cast<int64_t>(mailboxes->messages());
+        });
+        registry.gauge_fn("chat_mailbox_memory_bytes", "Bytes das caixas de mensagens em memria", [] {
+            return static_cast<int64_t>(mailboxes->memory_bytes());
+        });
+        const char* const mailbox_help = "Mensagens privadas por destino na caixa de mensagens";
+        registry.counter_fn("chat_mailbox_total", mailbox_help, [&ms] { return ms.stored.load(); }, "op=\"stored\"");
+        registry.counter_fn("chat_mailbox_total", mailbox_help, [&ms] { return ms.delivered.load(); }, "op=\"delivered\"");
+        registry.counter_fn("chat_mailbox_total", mailbox_help, [&ms] { return ms.refused.load(); }, "op=\"refused\"");
+        registry.counter_fn("chat_mailbox_total", mailbox_help, [&ms] { return ms.spilled.load(); }, "op=\"spilled\"");
+    }
+    for (auto [limiter, table] : {std::pair{user_limits.get(), "user"}, std::pair{ip_limits.get(), "ip"}}) {
+        if (!limiter) continue;
+        std::string labels = std::string("table=\"") + table + "\"";
+        registry.gauge_fn("chat_rate_limit_entries", "Chaves na tabela de limites de taxa",
+                          [limiter] { return static_cast<int64_t>(limiter->size()); }, labels);
+        registry.counter_fn("chat_rate_limit_evictions_total",
+                            "Chaves ainda em uso descartadas da tabela de limites por falta de espao",
+                            [limiter] { return limiter->evictions(); }, labels);
+    }
+    IoBackend io = shards[0]->loop.backend();
+    for (IoBackend b : {IoBackend::EPOLL, IoBackend::URING}) {
+        registry.gauge_fn("chat_io_backend", "Backend de I/O dos shards (1 = em uso)",
+                          [io, b] { return static_cast<int64_t>(io == b); },
+                          "backend=\"" + io_backend_to_string(b) + "\"");
+    }
+
+    if (cfg.metrics_port <= 0 && cfg.metrics_socket.empty()) return true;
+    try {
+        metrics_server = std::make_unique<MetricsServer>(registry, cfg.metrics_port, cfg.metrics_socket);
+    } catch (const std::exception& e) {
+        Logger::instance().error(std::string("No foi possvel abrir o endpoint de mtricas: ") + e.what());
+        return false;
+    }
+    Logger::instance().info("Mtricas em " +
+                            (cfg.metrics_port > 0 ? "127.0.0.1:" + std::to_string(cfg.metrics_port) : std::string()) +
+                            (cfg.metrics_port > 0 && !cfg.metrics_socket.empty() ? " e " : "") +
+                            cfg.metrics_socket);
+    return true;
+}
+
+bool create_shards(unsigned n) {
+    for (unsigned i = 0; i < n; ++i) {
+        // O modo threads usa sempre epoll no shard de escrita
+        auto s = std::make_unique<Shard>(config.mode == ServerMode::EPOLL ? config.io : IoBackend::EPOLL);
+        s->id = i;
+        Shard* sp = s.get();
+        // Encerramento: o handler do sinal s escreve em stop_fd. O evento
+        // no  consumido, ento todos os laos o veem, mesmo os que ainda
+        // no comearam a rodar, e cada um para sozinho.
+        if (!s->loop.add(stop_fd, EPOLLIN, [sp](uint32_t) {
+                if (sp->id == 0) Logger::instance().info("Sinal de interrupo recebido");
+                sp->loop.stop();
+            })) {
+            Logger::instance().error("Falha ao registrar o aviso de encerramento");
+            return false;
+        }
+        if (config.coalesce_us > 0) {
+            s->coalesce_timer = s->loop.add_oneshot_timer([sp] { flush_coalesced(*sp); });
+            if (s->coalesce_timer < 0) {
+                Logger::instance().error("Falha ao criar o timer da janela de agrupamento");
+                return false;
+            }
+        }
+        shards.push_back(std::move(s));
+    }
+    return true;
+}
+
+// Os logins vencidos so encerrados com atraso de no mximo um dcimo do prazo
+unsigned sweep_interval_ms() {
+    return std::clamp(config.auth_timeout_ms / 10, 10u, 1000u);
+}
+
+bool run_reactor(int port) {
+    raise_fd_limit();
+
+    for (auto& sp : shards) {
+        Shard* s = sp.get();
+        if (s->listen_fd < 0) s->listen_fd = open_listener(port, true);  // herdado numa atualizao
+        if (s->listen_fd < 0) return false;
+        fcntl(s->listen_fd, F_SETFL, fcntl(s->listen_fd, F_GETFL, 0) | O_NONBLOCK);
+        if (s->uring) {
+            s->loop.accept_multishot(s->listen_fd, [s](int fd) { uring_accept(*s, fd); });
+            s->loop.set_before_wait([s] { submit_sends(*s); });
+        } else {
+            s->loop.add(s->listen_fd, EPOLLIN | EPOLLET, [s](uint32_t) { shard_accept(*s); });
+        }
+        if (!s->loop.add_timer(sweep_interval_ms(), [s] {
+                sweep_handshakes(*s);
+                sweep_closing(*s);
+            })) {
+            Logger::instance().error("Falha ao criar o timer de logins pendentes");
+            return false;
+        }
+    }
+
+    Logger::instance().info("Servidor escutando na porta " + std::to_string(port) +
+                            " com " + std::to_string(shards.size()) + " shard(s), I/O " +
+                            io_backend_to_string(shards[0]->loop.backend()));
+
+    for (size_t i = 1; i < shards.size(); ++i) {
+        Shard* s = shards[i].get();
+        s->thr = std::thread([s] { s->loop.run(); });
+    }
+    shards[0]->loop.run();
+
+    for (auto& s : shards) s->loop.stop();
+    for (auto& s : shards) {
+        if (s->thr.joinable()) s->thr.join();
+    }
+    return true;
+}
+
+bool run_threads(int port) {
+    listen_fd = open_listener(port, false);
+    if (listen_fd < 0) return false;
     Logger::instance().info("Servidor escutando na porta " + std::to_string(port));
-    std::cout << "Servidor rodando na porta " << port << std::endl;
-    std::cout << "Usuarios disponiveis: alice, bob, charlie, admin" << std::endl;
-    std::cout << "Senhas: senha123, senha456, senha789, admin123" << std::endl;
+
+    // Um nico shard cuida das escritas; cada cliente tem sua thread de leitura
+    Shard* writer = shards[0].get();
+    writer->thr = std::thread([writer] { writer->loop.run(); });
 
     while (running.load()) {
         sockaddr_in cli{};
         socklen_t cli_len = sizeof(cli);
+        metrics::syscalls(metrics::Syscall::ACCEPT).inc();
         int cfd = accept(listen_fd, (sockaddr*)&cli, &cli_len);
 
         if (cfd < 0) {
             if (!running.load()) break;
-            Logger::instance().error("Falha no accept()");
+            TSLOG_EVERY_MS(Level::ERROR, 1000, "Falha no accept(): {}", strerror(errno));
             continue;
         }
 
         std::string cli_addr = std::string(inet_ntoa(cli.sin_addr)) +
                               ":" + std::to_string(ntohs(cli.sin_port));
+        if (ip_limits && !admit_connection(cfd, cli, cli_addr)) continue;
 
-        auto ci = std::make_shared<ClientInfo>();
+        auto ci = new_client();
+        if (!begin_handshake(*ci)) {
+            reject_connection(cfd, cli_addr);
+            continue;
+        }
         ci->fd = cfd;
         ci->addr = cli_addr;
-        ci->authenticated = false;
+        ci->shard = writer;
+        ci->threaded = true;
 
-        {
-            std::lock_guard<std::mutex> lg(clients_mtx);
-            clients[cfd] = ci;
-        }
+        writer->loop.post([ci] { shard_attach(ci); });
 
         ci->thr = std::thread(&handle_client, ci);
         ci->thr.detach();
     }
 
+    writer->loop.stop();
+    if (writer->thr.joinable()) writer->thr.join();
+    return true;
+}
+
+// ---- Atualizao a quente ----
+// No SIGUSR2 o shard 0 inicia o binrio novo (--upgrade-binary, ou o
+// prprio executvel) e este processo continua atendendo enquanto o novo
+// carrega usurios e filtro. Quando o novo avisa que est pronto os shards
+// param como no encerramento, mas em vez de fechar as conexes este
+// processo passa para ele, por um socket Unix, os listeners e as conexes
+// (SCM_RIGHTS) junto com o estado de cada uma: etapa do login, usurio,
+// linhas guardadas, linha incompleta, sala e sada pendente. Vo tambm o
+// histrico das salas e as caixas de mensagens que s existem em memria.
+// O que os clientes mandarem nesse meio tempo espera no socket.
+
+// Sucessor em andamento. O sinal s escreve em event_fd; o resto roda na
+// thread do shard 0 e, depois que os laos param, em main.
+struct Upgrade {
+    int event_fd = -1;
+    int sock = -1;
+    pid_t pid = -1;
+};
+Upgrade upgrade;
+
+// Sucessor que terminou ou falhou: este processo segue sozinho
+void abandon_upgrade() {
+    if (upgrade.sock >= 0) close(upgrade.sock);
+    if (upgrade.pid > 0) {
+        kill(upgrade.pid, SIGKILL);
+        waitpid(upgrade.pid, nullptr, 0);
+    }
+    upgrade.sock = -1;
+    upgrade.pid = -1;
+}
+
+// Shard 0: o sucessor mandou READY (os laos param e main faz o resto) ou
+// fechou o socket antes disso
+void on_successor(uint32_t) {
+    char step = 0;
+    ssize_t n;
+    while ((n = recv(upgrade.sock, &step, 1, 0)) < 0 && errno == EINTR) {}
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) return;
+    shards[0]->loop.remove(upgrade.sock);
+    if (n == 1 && step == handoff::READY) {
+        TSLOG_INFO("Atualizao a quente: processo {} pronto, parando os shards", upgrade.pid);
+        upgrade_requested.store(true);
+        running.store(false);
+        for (auto& s : shards) s->loop.stop();
+        return;
+    }
+    TSLOG_ERROR("Atualizao a quente: o processo {} terminou antes de ficar pronto; este continua atendendo",
+                upgrade.pid);
+    abandon_upgrade();
+}
+
+// Shard 0, acordado pelo SIGUSR2
+void start_upgrade(uint32_t) {
+    uint64_t v;
+    while (read(upgrade.event_fd, &v, sizeof(v)) > 0) {}
+    if (upgrade.sock >= 0) {
+        TSLOG_WARN("Atualizao a quente j em andamento (processo {})", upgrade.pid);
+        return;
+    }
+    upgrade.pid = handoff::spawn(config.upgrade_binary, server_argv, upgrade.sock);
+    if (upgrade.pid < 0) {
+        TSLOG_ERROR("Atualizao a quente: no foi possvel iniciar {}: {}", config.upgrade_binary, strerror(errno));
+        upgrade.sock = -1;
+        return;
+    }
+    fcntl(upgrade.sock, F_SETFL, fcntl(upgrade.sock, F_GETFL) | O_NONBLOCK);
+    shards[0]->loop.add(upgrade.sock, EPOLLIN | EPOLLRDHUP | EPOLLET, on_successor);
+    TSLOG_INFO("Atualizao a quente: iniciado {} (pid {})", config.upgrade_binary, upgrade.pid);
+}
+
+// Estado serializado, na ordem em que  lido de volta:
+//   verso, listeners
+//   salas: nome, mensagens do histrico
+//   caixas em memria: usurio, mensagem
+//   conexes: shard, endereo, etapa, usurio, senha em verificao,
+//             linhas guardadas, linha incompleta, sala, sada pendente
+// Os fds vo  parte: primeiro os listeners (um por shard), depois as
+// conexes na mesma ordem.
+std::string encode_state(std::vector<int>& fds) {
+    handoff::Writer w;
+    w.u32(HANDOFF_VERSION);
+    w.u32(static_cast<uint32_t>(shards.size()));
+    for (auto& s : shards) fds.push_back(s->listen_fd);
+
+    // O log persistente j guarda o histrico da sala padro
+    auto all = rooms->list();
+    w.u32(static_cast<uint32_t>(all.size()));
+    for (const auto& [name, members] : all) {
+        w.str(name);
+        auto room = rooms->find(name);
+        std::vector<MessageRef> recent;
+        if (room && !(history_log && room == rooms->default_room())) {
+            recent = room->history().get_recent(room->history().capacity());
+        }
+        w.u32(static_cast<uint32_t>(recent.size()));
+        for (const auto& m : recent) w.str(m->view());
+    }
+
+    // Com --mailbox-dir as caixas vo para o disco e o processo novo as l
+    std::vector<std::pair<std::string, MessageRef>> boxed;
+    if (mailboxes && config.mailbox.dir.empty()) {
+        mailboxes->for_each_in_memory([&boxed](const std::string& user, const MessageRef& m) {
+            boxed.emplace_back(user, m);
+        });
+    }
+    w.u32(static_cast<uint32_t>(boxed.size()));
+    for (const auto& [user, m] : boxed) {
+        w.str(user);
+        w.str(m->view());
+    }
+
+    std::vector<std::shared_ptr<ClientInfo>> conns;
+    for (auto& s : shards) {
+        for (auto& [fd, ci] : s->clients) {
+            if (!ci->closed) conns.push_back(ci);
+        }
+    }
+    w.u32(static_cast<uint32_t>(conns.size()));
+    for (auto& ci : conns) {
+        fds.push_back(ci->fd);
+        w.u32(ci->shard->id);
+        w.str(ci->addr);
+        w.u8(static_cast<uint8_t>(ci->stage));
+        w.str(ci->stage == AuthStage::DONE ? ci->username : ci->pending_user);
+        w.str(ci->stage == AuthStage::VERIFYING ? ci->pending_password : std::string());
+        w.u32(static_cast<uint32_t>(ci->deferred.size()));
+        for (const auto& l : ci->deferred) w.str(l);
+        w.str(ci->framer.partial());
+        auto room = current_room(*ci);
+        w.str(room ? room->name() : std::string());
+        std::vector<std::string_view> out;
+        ci->outq.unsent([&out](std::string_view v) { out.push_back(v); });
+        w.u32(static_cast<uint32_t>(out.size()));
+        for (auto v : out) w.str(v);
+    }
+    return w.data();
+}
+
+// Processo antigo, com os shards j parados: passa tudo para o sucessor e
+// espera a confirmao. Em caso de falha as conexes so fechadas como num
+// encerramento normal.
+// Depois que os laos pararam por um READY
+bool hand_off(const ServerConfig& cfg) {
+    auto t0 = std::chrono::steady_clock::now();
+    // Entregas que um shard postou para outro enquanto paravam
+    for (size_t n = 1; n > 0;) {
+        n = 0;
+        for (auto& s : shards) n += s->loop.drain();
+    }
+    std::vector<int> fds;
+    std::string state = encode_state(fds);
+    size_t conns = fds.size() - shards.size();
+
+    // O sucessor abre os mesmos arquivos e portas
+    history_log.reset();
+    metrics_server.reset();
+    if (mailboxes && !cfg.mailbox.dir.empty()) {
+        TSLOG_INFO("{} mensagem(ns) guardada(s) em {}", mailboxes->spill_all(), cfg.mailbox.dir);
+    }
+    mailboxes.reset();
+
+    TSLOG_INFO("Atualizao a quente: passando {} conexo(es) e {} bytes de estado para o processo {}",
+               conns, state.size(), upgrade.pid);
+    // O socket volta a bloquear: send e wait_step esperam com poll
+    fcntl(upgrade.sock, F_SETFL, fcntl(upgrade.sock, F_GETFL) & ~O_NONBLOCK);
+    if (!handoff::send(upgrade.sock, state, fds) || !handoff::wait_step(upgrade.sock, handoff::ACK, HANDOFF_TIMEOUT_MS)) {
+        // Sem confirmao o sucessor ainda no atende ningum; fica s este
+        // processo, que encerra as conexes
+        TSLOG_ERROR("Atualizao a quente: o processo {} no assumiu as conexes", upgrade.pid);
+        abandon_upgrade();
+        return false;
+    }
+    close(upgrade.sock);
+    upgrade.sock = -1;
+    auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - t0).count();
+    TSLOG_INFO("Atualizao a quente: processo {} assumiu em {} ms", upgrade.pid, ms);
+    upgrade.pid = -1;
+    return true;
+}
+
+// Processo novo: avisa READY e recebe o estado antes de abrir o log de
+// histrico e as caixas, que o antigo s libera depois do aviso. Retorna o nmero de listeners (0 em erro).
+unsigned receive_state(int sock, std::string& state, std::vector<int>& fds) {
+    if (!handoff::notify(sock, handoff::READY) || !handoff::receive(sock, state, fds, HANDOFF_TIMEOUT_MS)) return 0;
+    handoff::Reader r(state);
+    uint32_t version = 0, listeners = 0;
+    if (!r.u32(version) || !r.u32(listeners) || version != HANDOFF_VERSION || listeners == 0 ||
+        fds.size() < listeners) {
+        return 0;
+    }
+    return listeners;
+}
+
+// Recoloca as conexes herdadas nos shards (antes de os laos rodarem) e
+// devolve o histrico s salas
+bool restore_state(const std::string& state, const std::vector<int>& fds) {
+    handoff::Reader r(state);
+    uint32_t version = 0, listeners = 0, nrooms = 0;
+    if (!r.u32(version) || !r.u32(listeners) || listeners != shards.size()) return false;
+    for (uint32_t i = 0; i < listeners; ++i) shards[i]->listen_fd = fds[i];
+
+    // As salas voltam a existir quando os membros entram; o histrico 
+    // aplicado depois
+    if (!r.u32(nrooms) || nrooms > state.size()) return false;
+    std::vector<std::pair<std::string, std::vector<MessageRef>>> histories(nrooms);
+    for (auto& [name, msgs] : histories) {
+        uint32_t n = 0;
+        r.str(name);
+        r.u32(n);
+        std::string m;
+        for (uint32_t i = 0; i < n && r.str(m); ++i) msgs.push_back(make_message(m));
+    }
+
+    uint32_t nboxed = 0;
+    r.u32(nboxed);
+    std::string user, m;
+    for (uint32_t i = 0; i < nboxed && r.str(user) && r.str(m); ++i) {
+        if (mailboxes) mailboxes->deposit(user, make_message(m));
+    }
+
+    uint32_t nconns = 0;
+    r.u32(nconns);
+    if (!r.ok() || fds.size() != listeners + size_t(nconns)) return false;
+    size_t online = 0;
+    for (uint32_t k = 0; k < nconns; ++k) {
+        auto ci = new_client();
+        uint32_t shard = 0, ndeferred = 0, nout = 0;
+        uint8_t stage = 0;
+        std::string password, partial, room;
+        r.u32(shard);
+        r.str(ci->addr);
+        r.u8(stage);
+        r.str(ci->pending_user);
+        r.str(password);
+        r.u32(ndeferred);
+        for (uint32_t i = 0; i < ndeferred && r.str(m); ++i) ci->deferred.push_back(m);
+        r.str(partial);
+        r.str(room);
+        r.u32(nout);
+        for (uint32_t i = 0; i < nout && r.str(m); ++i) ci->outq.push(make_message(m));
+        if (!r.ok() || stage > static_cast<uint8_t>(AuthStage::DONE)) return false;
+
+        ci->fd = fds[listeners + k];
+        ci->shard = shards[shard % shards.size()].get();
+        ci->stage = static_cast<AuthStage>(stage);
+        ci->framer.feed(partial.data(), partial.size(), [](std::string_view) { return true; });
+
+        if (ci->stage == AuthStage::DONE) {
+            ci->username = ci->pending_user;
+            if (!presence.add(ci->username, ci)) {
+                close(ci->fd);
+                continue;
+            }
+            ci->authenticated = true;
+            if (!RoomRegistry::valid_name(room)) room = DEFAULT_ROOM;
+            {
+                std::lock_guard<std::mutex> lg(ci->room_mtx);
+                ci->room = rooms->join(room, ci, ci->shard->id);
+            }
+            if (federation) federation->user_joined(ci->username, room);
+            ++online;
+        } else {
+            // Login pela metade: recomea o prazo; uma senha que estava em
+            // verificao  verificada de novo
+            handshakes_pending.fetch_add(1);
+            ci->handshaking = true;
+            ci->handshake_deadline = metrics::now_ns() + uint64_t(config.auth_timeout_ms) * 1000000ULL;
+            ci->shard->handshakes.push_back(ci);
+        }
+        if (!shard_attach(ci)) continue;
+        if (ci->stage == AuthStage::VERIFYING && !start_login(ci, std::move(password))) shard_close(ci);
+    }
+
+    for (auto& [name, msgs] : histories) {
+        auto room = (name == DEFAULT_ROOM) ? rooms->default_room() : rooms->find(name);
+        if (!room) continue;
+        for (auto& msg : msgs) room->history().add(std::move(msg));
+    }
+
+    TSLOG_INFO("Atualizao a quente: {} conexo(es) herdada(s), {} usurio(s) online, {} sala(s)",
+               nconns, online, histories.size());
+    return r.done();
+}
+
+// S chamadas async-signal-safe: o aviso no log e a parada dos laos ficam
+// com os prprios laos, acordados por stop_fd
+void sigint_handler(int) {
+    running.store(false);
+    uint64_t one = 1;
+    ssize_t r = write(stop_fd, &one, sizeof(one));
+    (void)r;
+    if (listen_fd >= 0) {
+        shutdown(listen_fd, SHUT_RDWR);
+    }
+}
+
+// S no modo epoll com backend epoll: no io_uring um envio em andamento
+// no diz quantos bytes saram depois que o lao para
+void sigusr2_handler(int) {
+    uint64_t one = 1;
+    ssize_t r = write(upgrade.event_fd, &one, sizeof(one));
+    (void)r;
+}
+
+void usage(const char* prog) {
+    std::cerr << "Uso: " << prog << " [porta] [--mode threads|epoll] [--io epoll|uring] [--shards N]\n"
+              << "       [--queue-max N] [--overflow drop-oldest|drop-new|disconnect] [--coalesce-ms MS]\n"
+              << "       [--max-line BYTES] [--banned-words ARQUIVO] [--users ARQUIVO]\n"
+              << "       [--history N] [--room-history N] [--history-dir DIR] [--history-fsync always|never|MS]\n"
+              << "       [--history-segment-mb N] [--history-segments N]\n"
+              << "       [--mailbox N] [--mailbox-memory-mb N] [--mailbox-dir DIR]\n"
+              << "       [--log-full block|drop|count] [--log-flush-ms MS] [--log-binary]\n"
+              << "       [--log-level debug|info|warn|error]\n"
+              << "       [--metrics-port N] [--metrics-socket CAMINHO]\n"
+              << "       [--auth-timeout SEG] [--max-pending N] [--auth-threads N] [--auth-queue N]\n"
+              << "       [--auth-cache-ttl SEG] [--kdf-iterations N]\n"
+              << "       [--node NOME] [--peer-port N] [--peer [HOST:]PORTA]... [--peer-timeout SEG]\n"
+              << "       [--upgrade-binary CAMINHO]\n"
+              << "       [--msg-limit TAXA[:RAJADA]] [--byte-limit TAXA[:RAJADA]] [--conn-limit TAXA[:RAJADA]]\n"
+              << "       [--limit-notice]\n"
+              << "       " << prog << " --hash-users [--kdf-iterations N] < usuarios.txt > usuarios.db\n";
+}
+
+bool parse_args(int argc, char** argv, ServerConfig& cfg) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--mode" && i + 1 < argc) {
+            std::string m = argv[++i];
+            if (m == "threads") cfg.mode = ServerMode::THREADS;
+            else if (m == "epoll") cfg.mode = ServerMode::EPOLL;
+            else return false;
+        } else if (arg == "--io" && i + 1 < argc) {
+            if (!parse_io_backend(argv[++i], cfg.io)) return false;
+        } else if (arg == "--shards" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 0, MAX_SHARDS, cfg.shards)) return false;
+        } else if (arg == "--banned-words" && i + 1 < argc) {
+            cfg.banned_file = argv[++i];
+        } else if (arg == "--users" && i + 1 < argc) {
+            cfg.users_file = argv[++i];
+        } else if (arg == "--history" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 1, UINT_MAX, cfg.history)) return false;
+        } else if (arg == "--room-history" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 1, UINT_MAX, cfg.room_history)) return false;
+        } else if (arg == "--history-dir" && i + 1 < argc) {
+            cfg.history_log.dir = argv[++i];
+        } else if (arg == "--history-fsync" && i + 1 < argc) {
+            if (!parse_fsync_policy(argv[++i], cfg.history_log)) return false;
+        } else if (arg == "--history-segment-mb" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 1, 1024 * 1024, cfg.history_log.segment_bytes)) return false;
+            cfg.history_log.segment_bytes *= 1024 * 1024;
+        } else if (arg == "--history-segments" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 1, UINT_MAX, cfg.history_log.max_segments)) return false;
+        } else if (arg == "--mailbox" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 0, UINT_MAX, cfg.mailbox.max_messages)) return false;
+        } else if (arg == "--mailbox-memory-mb" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 0, 1024 * 1024, cfg.mailbox.memory_bytes)) return false;
+            cfg.mailbox.memory_bytes *= 1024 * 1024;
+        } else if (arg == "--mailbox-dir" && i + 1 < argc) {
+            cfg.mailbox.dir = argv[++i];
+        } else if (arg == "--log-full" && i + 1 < argc) {
+            if (!parse_full_policy(argv[++i], cfg.log.on_full)) return false;
+        } else if (arg == "--log-level" && i + 1 < argc) {
+            if (!parse_level(argv[++i], cfg.log_level)) return false;
+        } else if (arg == "--log-binary") {
+            cfg.log.binary = true;
+        } else if (arg == "--log-flush-ms" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 0, UINT_MAX, cfg.log.flush_ms)) return false;
+        } else if (arg == "--metrics-port" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 0, 65535, cfg.metrics_port)) return false;
+        } else if (arg == "--metrics-socket" && i + 1 < argc) {
+            cfg.metrics_socket = argv[++i];
+        } else if (arg == "--auth-timeout" && i + 1 < argc) {
+            if (!parse_millis(argv[++i], MAX_TIMEOUT_SECONDS, cfg.auth_timeout_ms) || cfg.auth_timeout_ms == 0) return false;
+        } else if (arg == "--max-pending" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 1, UINT_MAX, cfg.max_pending)) return false;
+        } else if (arg == "--auth-threads" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 1, 1024, cfg.auth_threads)) return false;
+        } else if (arg == "--auth-queue" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 1, UINT_MAX, cfg.auth_queue)) return false;
+        } else if (arg == "--auth-cache-ttl" && i + 1 < argc) {
+            if (!parse_millis(argv[++i], MAX_TIMEOUT_SECONDS, cfg.auth_cache_ttl_ms)) return false;
+        } else if (arg == "--kdf-iterations" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 1, UINT_MAX, cfg.kdf_iterations)) return false;
+        } else if (arg == "--node" && i + 1 < argc) {
+            cfg.node = argv[++i];
+            if (cfg.node.empty()) return false;
+        } else if (arg == "--peer-port" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 0, 65535, cfg.peer_port)) return false;
+        } else if (arg == "--peer" && i + 1 < argc) {
+            PeerAddress peer;
+            if (!parse_peer_address(argv[++i], peer)) return false;
+            cfg.peers.push_back(peer);
+        } else if (arg == "--peer-timeout" && i + 1 < argc) {
+            if (!parse_millis(argv[++i], MAX_TIMEOUT_SECONDS, cfg.peer_timeout_ms) || cfg.peer_timeout_ms == 0) return false;
+        } else if (arg == "--upgrade-binary" && i + 1 < argc) {
+            cfg.upgrade_binary = argv[++i];
+        } else if (arg == "--msg-limit" && i + 1 < argc) {
+            if (!parse_rate_limit(argv[++i], cfg.msg_limit)) return false;
+        } else if (arg == "--byte-limit" && i + 1 < argc) {
+            if (!parse_rate_limit(argv[++i], cfg.byte_limit)) return false;
+        } else if (arg == "--conn-limit" && i + 1 < argc) {
+            if (!parse_rate_limit(argv[++i], cfg.conn_limit)) return false;
+        } else if (arg == "--limit-notice") {
+            cfg.limit_notice = true;
+        } else if (arg == "--hash-users") {
+            cfg.hash_users = true;
+        } else if (arg == "--max-line" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 1, UINT_MAX, cfg.max_line)) return false;
+        } else if (arg == "--queue-max" && i + 1 < argc) {
+            if (!parse_count(argv[++i], 1, UINT_MAX, cfg.queue_max)) return false;
+        } else if (arg == "--overflow" && i + 1 < argc) {
+            if (!parse_overflow_policy(argv[++i], cfg.overflow)) return false;
+        } else if (arg == "--coalesce-ms" && i + 1 < argc) {
+            if (!parse_millis(argv[++i], 1000, cfg.coalesce_us)) return false;  // ms -> us
+        } else if (!arg.empty() && arg[0] != '-') {
+            if (!parse_count(arg, 1, 65535, cfg.port)) return false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    ServerConfig& cfg = config;
+    if (!parse_args(argc, argv, cfg)) {
+        usage(argv[0]);
+        return 1;
+    }
+    if (cfg.hash_users) return hash_users(cfg);
+    int port = cfg.port;
+    server_argv = argv;
+    if (cfg.upgrade_binary.empty()) {
+        // Caminho lido agora: depois de recompilado o arquivo j  outro
+        char exe[4096];
+        ssize_t n = readlink("/proc/self/exe", exe, sizeof(exe) - 1);
+        cfg.upgrade_binary = (n > 0) ? std::string(exe, n) : std::string(argv[0]);
+    }
+
+    // No modo binrio o log  lido com tslog_decode server.tslog
+    Logger::instance().init(cfg.log.binary ? "server.tslog" : "server.log", cfg.log_level, cfg.log);
+    Logger::instance().info("=== Servidor de Chat Iniciando ===");
+    Logger::instance().info("Porta: " + std::to_string(port));
+
+    // No dependem do estado herdado: numa atualizao a quente rodam
+    // enquanto o processo anterior ainda atende
+    if (!load_banned_words(cfg.banned_file) || !load_users(cfg)) {
+        Logger::instance().shutdown();
+        return 1;
+    }
+
+    // Iniciado por uma atualizao a quente: o estado chega antes de abrir
+    // o histrico e as caixas, e os shards so os mesmos do processo
+    // anterior (um por listener herdado)
+    int handoff_sock = handoff::inherited();
+    std::string handoff_state;
+    std::vector<int> handoff_fds;
+    unsigned inherited_shards = 0;
+    if (handoff_sock >= 0) {
+        inherited_shards = receive_state(handoff_sock, handoff_state, handoff_fds);
+        if (inherited_shards == 0 || cfg.mode != ServerMode::EPOLL) {
+            Logger::instance().error("Atualizao a quente: estado do processo anterior invlido ou incompleto");
+            Logger::instance().shutdown();
+            return 1;
+        }
+    }
+
+    unsigned nshards = 1;
+    if (cfg.mode == ServerMode::EPOLL) {
+        nshards = cfg.shards ? cfg.shards : std::thread::hardware_concurrency();
+        if (nshards == 0) nshards = 1;
+    }
+    if (inherited_shards && inherited_shards != nshards) {
+        TSLOG_WARN("Atualizao a quente: mantendo os {} shard(s) do processo anterior", inherited_shards);
+        nshards = inherited_shards;
+    }
+
+    rooms = std::make_unique<RoomRegistry>(DEFAULT_ROOM, nshards, cfg.history, cfg.room_history);
+    if (!cfg.history_log.dir.empty() && !open_history_log(cfg)) {
+        Logger::instance().shutdown();
+        return 1;
+    }
+    if (cfg.mailbox.max_messages > 0 && !open_mailboxes(cfg)) {
+        Logger::instance().shutdown();
+        return 1;
+    }
+
+    unsigned auth_threads = cfg.auth_threads ? cfg.auth_threads : std::thread::hardware_concurrency();
+    auth_pool = std::make_unique<WorkerPool>(auth_threads ? auth_threads : 1, cfg.auth_queue);
+    auth_cache = std::make_unique<AuthCache>(cfg.auth_cache_ttl_ms, AUTH_CACHE_MAX);
+    if (cfg.msg_limit.enabled() || cfg.byte_limit.enabled()) {
+        user_limits = std::make_unique<RateLimiter>(cfg.msg_limit, cfg.byte_limit, RATE_TABLE_SIZE);
+    }
+    if (cfg.conn_limit.enabled()) {
+        ip_limits = std::make_unique<RateLimiter>(cfg.conn_limit, BucketLimit{}, RATE_TABLE_SIZE);
+    }
+    if (user_limits || ip_limits) {
+        Logger::instance().info("Limites: mensagens " + rate_limit_to_string(cfg.msg_limit) + "; bytes " +
+                                rate_limit_to_string(cfg.byte_limit) + "; conexes por endereo " +
+                                rate_limit_to_string(cfg.conn_limit));
+    }
+    Logger::instance().info("Autenticao: " + std::to_string(auth_pool->threads()) + " thread(s), fila " +
+                            std::to_string(cfg.auth_queue) + ", cache " +
+                            std::to_string(cfg.auth_cache_ttl_ms / 1000) + " s");
+
+    if ((stop_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) < 0) {
+        Logger::instance().error(std::string("Falha ao criar o eventfd de encerramento: ") + strerror(errno));
+        Logger::instance().shutdown();
+        return 1;
+    }
+    std::signal(SIGINT, sigint_handler);
+    std::signal(SIGTERM, sigint_handler);
+    std::signal(SIGPIPE, SIG_IGN);
+
+    if (!create_shards(nshards)) {
+        Logger::instance().shutdown();
+        return 1;
+    }
+    if (cfg.mode == ServerMode::EPOLL && !shards[0]->uring &&
+        (upgrade.event_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) >= 0 &&
+        shards[0]->loop.add(upgrade.event_fd, EPOLLIN | EPOLLET, start_upgrade)) {
+        std::signal(SIGUSR2, sigusr2_handler);
+    } else {
+        // Avisado aqui, uma vez: handler de sinal no pode usar o logger
+        std::signal(SIGUSR2, SIG_IGN);
+        TSLOG_WARN("Atualizao a quente no suportada neste modo (s epoll com I/O epoll); SIGUSR2 ignorado");
+    }
+    if (cfg.coalesce_us > 0) {
+        static const Format fmt("Sada agrupada em janelas de {} us");
+        Logger::instance().logf(Level::INFO, fmt, cfg.coalesce_us);
+    }
+    if (cfg.io == IoBackend::URING) {
+        if (cfg.mode != ServerMode::EPOLL) {
+            Logger::instance().warn("--io uring s vale no modo epoll; usando epoll");
+        } else if (!shards[0]->uring) {
+            Logger::instance().warn("io_uring indisponvel (" + shards[0]->loop.backend_error() +
+                                    "); usando epoll");
+        }
+    }
+
+    if (!cfg.peers.empty() && cfg.peer_port <= 0) {
+        Logger::instance().error("--peer exige --peer-port");
+        Logger::instance().shutdown();
+        return 1;
+    }
+    if (cfg.peer_port > 0) {
+        if (cfg.node.empty()) cfg.node = "no-" + std::to_string(port);
+        if (!start_federation(cfg)) {
+            Logger::instance().shutdown();
+            return 1;
+        }
+    }
+
+    if (handoff_sock >= 0 && !restore_state(handoff_state, handoff_fds)) {
+        Logger::instance().error("Atualizao a quente: no foi possvel restaurar as conexes herdadas");
+        Logger::instance().shutdown();
+        return 1;
+    }
+
+    if (!start_metrics(cfg)) {
+        Logger::instance().shutdown();
+        return 1;
+    }
+
+    // Daqui em diante este processo atende; o anterior s fecha as cpias
+    // dos descritores e sai
+    if (handoff_sock >= 0) {
+        handoff::notify(handoff_sock, handoff::ACK);
+        close(handoff_sock);
+    }
+
+    std::cout << "Servidor rodando na porta " << port << std::endl;
+    std::cout << "Usuarios disponiveis: alice, bob, charlie, admin" << std::endl;
+    std::cout << "Senhas: senha123, senha456, senha789, admin123" << std::endl;
+
+    bool ok = (cfg.mode == ServerMode::EPOLL) ? run_reactor(port) : run_threads(port);
+    federation.reset();
+    auth_pool->stop();
+
+    // As cpias dos descritores fecham abaixo; as conexes seguem abertas
+    // no processo novo
+    bool upgraded = ok && upgrade_requested && hand_off(cfg);
+    abandon_upgrade();  // SIGINT com um sucessor ainda carregando
+    if (upgrade.event_fd >= 0) close(upgrade.event_fd);
+
     // Cleanup
-    {
-        std::lock_guard<std::mutex> lg(clients_mtx);
-        for (auto& pair : clients) {
+    for (auto& s : shards) {
+        for (auto& pair : s->clients) {
             if (pair.second) close(pair.second->fd);
         }
-        clients.clear();
+        s->clients.clear();
+        if (s->listen_fd >= 0) close(s->listen_fd);
     }
 
     if (listen_fd >= 0) close(listen_fd);
-    Logger::instance().info("Servidor encerrado");
+    metrics_server.reset();
+    history_log.reset();
+    if (mailboxes && !cfg.mailbox.dir.empty()) {
+        TSLOG_INFO("{} mensagem(ns) guardada(s) em {}", mailboxes->spill_all(), cfg.mailbox.dir);
+    }
+    mailboxes.reset();
+    Logger::instance().info(upgraded ? "Servidor substitudo pelo processo novo" : "Servidor encerrado");
     Logger::instance().shutdown();
 
-    std::cout << "Servidor encerrado com sucesso.\n";
+    if (!ok || (upgrade_requested && !upgraded)) return 1;
+    std::cout << (upgraded ? "Servidor substitudo pelo processo novo.\n" : "Servidor encerrado com sucesso.\n");
     return 0;
 }
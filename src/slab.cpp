@@ -0,0 +1,182 @@
+#include "slab.hpp"
+
+#include <atomic>
+#include <mutex>
+#include <new>
+
+
+namespace slab {
+
+namespace {
+
+constexpr size_t CLASSES = 10;                // 32 B .. 16 KB
+constexpr size_t CHUNK_BYTES = 256 * 1024;   // pedido ao sistema de cada vez
+constexpr size_t BATCH_BYTES = 64 * 1024;    // movidos entre thread e lista global
+
+static_assert((MIN_BLOCK << (CLASSES - 1)) == MAX_BLOCK, "classes de MIN_BLOCK a MAX_BLOCK");
+
+struct Node {
+    Node* next;
+};
+
+size_t class_of(size_t n) {
+    if (n <= MIN_BLOCK) return 0;
+    // Menor potncia de 2 >= n, contada a partir de MIN_BLOCK
+    return static_cast<size_t>(64 - __builtin_clzll(static_cast<unsigned long long>(n - 1))) - 5;
+}
+
+size_t block_size(size_t c) { return MIN_BLOCK << c; }
+
+// Blocos que uma thread pega ou devolve de uma vez; a lista dela guarda at
+// o dobro disso antes de devolver
+size_t batch_of(size_t c) {
+    size_t n = BATCH_BYTES / block_size(c);
+    return n < 4 ? 4 : n;
+}
+
+struct Global {
+    std::mutex mtx;
+    Node* free[CLASSES] = {};
+    std::atomic<size_t> reserved{0};
+};
+
+// Nunca destruda: blocos podem ser liberados por destrutores estticos
+Global& global() {
+    static Global* g = new Global;
+    return *g;
+}
+
+// Tira at batch blocos da lista global para list; sem blocos livres,
+// divide um chunk novo. Chamada com o mutex global.
+size_t refill(Global& g, size_t c, Node*& list) {
+    size_t want = batch_of(c);
+    size_t got = 0;
+    while (got < want && g.free[c]) {
+        Node* n = g.free[c];
+        g.free[c] = n->next;
+        n->next = list;
+        list = n;
+        ++got;
+    }
+    if (got > 0) return got;
+
+    size_t size = block_size(c);
+    size_t bytes = CHUNK_BYTES < size * want ? size * want : CHUNK_BYTES;
+    char* chunk = static_cast<char*>(::operator new(bytes));
+    g.reserved.fetch_add(bytes, std::memory_order_relaxed);
+    // Um lote para a thread, o resto do chunk para a lista global
+    for (size_t off = 0; off + size <= bytes; off += size) {
+        Node* n = reinterpret_cast<Node*>(chunk + off);
+        if (got < want) {
+            n->next = list;
+            list = n;
+            ++got;
+        } else {
+            n->next = g.free[c];
+            g.free[c] = n;
+        }
+    }
+    return got;
+}
+
+struct Cache {
+    Node* free[CLASSES] = {};
+    size_t count[CLASSES] = {};
+
+    ~Cache();
+};
+
+// Depois que o cache da thread  destrudo (sada da thread), os blocos
+// liberados por ela vo direto para a lista global
+thread_local bool cache_gone = false;
+thread_local Cache cache;
+
+Cache::~Cache() {
+    Global& g = global();
+    std::lock_guard<std::mutex> lg(g.mtx);
+    for (size_t c = 0; c < CLASSES; ++c) {
+        while (free[c]) {
+            Node* n = free[c];
+            free[c] = n->next;
+            n->next = g.free[c];
+            g.free[c] = n;
+        }
+        count[c] = 0;
+    }
+    cache_gone = true;
+}
+
+}
+
+void* allocate(size_t n) {
+    if (n > MAX_BLOCK) return ::operator new(n);
+    size_t c = class_of(n);
+
+    if (cache_gone) {
+        Global& g = global();
+        std::lock_guard<std::mutex> lg(g.mtx);
+        Node* list = nullptr;
+        refill(g, c, list);
+        Node* first = list;
+        list = list->next;
+        while (list) {
+            Node* next = list->next;
+            list->next = g.free[c];
+            g.free[c] = list;
+            list = next;
+        }
+        return first;
+    }
+
+    Cache& tc = cache;
+    if (!tc.free[c]) {
+        Global& g = global();
+        std::lock_guard<std::mutex> lg(g.mtx);
+        tc.count[c] += refill(g, c, tc.free[c]);
+    }
+    Node* b = tc.free[c];
+    tc.free[c] = b->next;
+    --tc.count[c];
+    return b;
+}
+
+void deallocate(void* p, size_t n) noexcept {
+    if (!p) return;
+    if (n > MAX_BLOCK) {
+        ::operator delete(p);
+        return;
+    }
+    size_t c = class_of(n);
+    Node* b = static_cast<Node*>(p);
+
+    if (cache_gone) {
+        Global& g = global();
+        std::lock_guard<std::mutex> lg(g.mtx);
+        b->next = g.free[c];
+        g.free[c] = b;
+        return;
+    }
+
+    Cache& tc = cache;
+    b->next = tc.free[c];
+    tc.free[c] = b;
+    if (++tc.count[c] <= 2 * batch_of(c)) return;
+
+    // Uma thread que s libera (mensagens alocadas por outro shard) devolve
+    // o excesso para quem aloca
+    Global& g = global();
+    std::lock_guard<std::mutex> lg(g.mtx);
+    for (size_t i = batch_of(c); i > 0 && tc.free[c]; --i) {
+        Node* m = tc.free[c];
+        tc.free[c] = m->next;
+        m->next = g.free[c];
+        g.free[c] = m;
+        --tc.count[c];
+    }
+}
+
+size_t reserved_bytes() {
+    return global().reserved.load(std::memory_order_relaxed);
+}
+
+}
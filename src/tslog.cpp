@@ -3,75 +3,389 @@
 #include <thread>
 #include <mutex>
 #include <condition_variable>
-#include <queue>
-#include <fstream>
 #include <chrono>
-#include <iomanip>
 #include <sstream>
 #include <atomic>
-#include <iostream>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <stdexcept>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <climits>
+#include <cctype>
+
+#include <fcntl.h>
+#include <unistd.h>
 
 namespace tslog {
 
-struct LogEntry {
-    Level level;
-    std::string message;
+// Posio da fila. Produtores reservam uma posio com CAS, preenchem e
+// publicam pelo seq; a thread de escrita  a nica consumidora. O texto 
+// copiado para a string da prpria posio, que guarda a capacidade entre
+// usos: depois do aquecimento um log() no aloca memria.
+struct alignas(64) Slot {
+    std::atomic<size_t> seq{0};
+    Level level = Level::INFO;
     std::chrono::system_clock::time_point ts;
-    std::thread::id tid;
+    char tid[24] = {};                   // copiado: a thread pode terminar antes da escrita
+    uint32_t fmt = 0;                    // Format::id(); message tem os argumentos codificados
+    std::string message;
+
+    // Texto compartilhado (ver Logger::log com owner)
+    const char* prefix = nullptr;
+    std::shared_ptr<const void> owner;
+    std::string_view shared;
 };
 
+// Linhas maiores que isto no deixam a capacidade presa na posio
+constexpr size_t SLOT_KEEP_CAPACITY = 4096;
+
+// Formatos registrados; o id 0 fica reservado para texto puro
+constexpr uint32_t MAX_FORMATS = 4096;
+static std::atomic<const char*> g_formats[MAX_FORMATS];
+static std::atomic<uint32_t> g_next_format{1};
+
+Format::Format(const char* text) : text_(text), id_(0) {
+    uint32_t id = g_next_format.fetch_add(1, std::memory_order_relaxed);
+    if (id < MAX_FORMATS) {
+        g_formats[id].store(text, std::memory_order_release);
+        id_ = id;
+    }
+}
+
+const char* format_text(uint32_t id) {
+    return id < MAX_FORMATS ? g_formats[id].load(std::memory_order_acquire) : nullptr;
+}
+
+template <typename T>
+static bool take(const char*& p, const char* end, T& v) {
+    if (static_cast<size_t>(end - p) < sizeof(T)) return false;
+    std::memcpy(&v, p, sizeof(T));
+    p += sizeof(T);
+    return true;
+}
+
+bool render(std::string& out, std::string_view fmt, const char* args, size_t len) {
+    const char* p = args;
+    const char* end = args + len;
+    size_t i = 0;
+    while (i < fmt.size()) {
+        size_t hole = fmt.find("{}", i);
+        if (hole == std::string_view::npos || p == end) {
+            out.append(fmt.data() + i, fmt.size() - i);
+            break;
+        }
+        out.append(fmt.data() + i, hole - i);
+        i = hole + 2;
+
+        uint8_t type;
+        if (!take(p, end, type)) return false;
+        char num[32];
+        switch (type) {
+            case detail::ARG_I64: {
+                int64_t v;
+                if (!take(p, end, v)) return false;
+                out.append(num, std::snprintf(num, sizeof(num), "%lld", static_cast<long long>(v)));
+                break;
+            }
+            case detail::ARG_U64: {
+                uint64_t v;
+                if (!take(p, end, v)) return false;
+                out.append(num, std::snprintf(num, sizeof(num), "%llu", static_cast<unsigned long long>(v)));
+                break;
+            }
+            case detail::ARG_F64: {
+                double v;
+                if (!take(p, end, v)) return false;
+                out.append(num, std::snprintf(num, sizeof(num), "%g", v));
+                break;
+            }
+            case detail::ARG_STR: {
+                uint32_t n;
+                if (!take(p, end, n) || static_cast<size_t>(end - p) < n) return false;
+                out.append(p, n);
+                p += n;
+                break;
+            }
+            case detail::ARG_CHAR:
+            case detail::ARG_BOOL: {
+                char c;
+                if (!take(p, end, c)) return false;
+                if (type == detail::ARG_CHAR) out += c;
+                else out += c ? "true" : "false";
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+    return true;
+}
+
+static const char* level_tag(Level l) {
+    switch (l) {
+        case Level::DEBUG: return "DEBUG";
+        case Level::INFO:  return "INFO ";
+        case Level::WARN:  return "WARN ";
+        case Level::ERROR: return "ERROR";
+        default: return "?????";
+    }
+}
+
+// Identificador da thread formatado uma nica vez por thread
+static const char* this_thread_tag() {
+    thread_local std::string tag = [] {
+        std::ostringstream oss;
+        oss << std::this_thread::get_id();
+        return oss.str().substr(0, sizeof(Slot::tid) - 1);
+    }();
+    return tag.c_str();
+}
+
+static void set_tid(Slot& s) {
+    std::strncpy(s.tid, this_thread_tag(), sizeof(s.tid) - 1);
+}
+
 struct Logger::Impl {
-    std::mutex mtx;
+    std::unique_ptr<Slot[]> slots;
+    size_t mask = 0;
+    alignas(64) std::atomic<size_t> enqueue_pos{0};
+    alignas(64) size_t dequeue_pos = 0;   // s a thread de escrita
+
+    std::mutex mtx;                       // init/shutdown e espera da thread de escrita
     std::condition_variable cv;
-    std::queue<LogEntry> q;
+    std::atomic<bool> sleeping{false};
     std::thread worker;
     std::atomic<bool> running{false};
-    std::atomic<Level> min_level{Level::DEBUG};
-    std::unique_ptr<std::ofstream> ofs;
-    bool to_stdout{false};
+    std::atomic<uint64_t> dropped{0};
+    Options opts;
+    int fd = -1;
+    bool owns_fd = false;
+    std::vector<uint8_t> emitted;        // formatos j escritos nesta sesso (modo binrio)
+
+    // Cache do prefixo "AAAA-MM-DD HH:MM:SS" do segundo atual
+    time_t cached_sec = -1;
+    char cached_prefix[32] = {};
+    size_t cached_len = 0;
 
     Impl() = default;
 
-    void worker_loop() {
-        std::unique_lock<std::mutex> lock(mtx);
-        while (running.load() || !q.empty()) {
-            if (q.empty()) {
-                cv.wait(lock, [this]{ return !running.load() || !q.empty(); });
+    // Bit de enqueue_pos ligado por shutdown: dali em diante nenhuma posio
+    //  reservada, e a thread de escrita sabe quantas ainda vo ser publicadas
+    static constexpr size_t CLOSED = ~(~size_t(0) >> 1);
+
+    // Reserva uma posio; nullptr se a fila estiver cheia ou fechada
+    Slot* try_claim(size_t& pos) {
+        pos = enqueue_pos.load(std::memory_order_relaxed);
+        for (;;) {
+            if (pos & CLOSED) return nullptr;
+            Slot& s = slots[pos & mask];
+            size_t seq = s.seq.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    return &s;
+                }
+            } else if (diff < 0) {
+                return nullptr;
+            } else {
+                pos = enqueue_pos.load(std::memory_order_relaxed);
             }
-            while (!q.empty()) {
-                LogEntry e = std::move(q.front());
-                q.pop();
-                lock.unlock();
-                write_entry(e);
-                lock.lock();
+        }
+    }
+
+    Slot* claim(size_t& pos) {
+        Slot* s = try_claim(pos);
+        if (s || opts.on_full != FullPolicy::BLOCK) return s;
+
+        for (int spins = 0; !s; ++spins) {
+            if (!running.load(std::memory_order_relaxed)) return nullptr;
+            wake();
+            if (spins < 64) std::this_thread::yield();
+            else std::this_thread::sleep_for(std::chrono::microseconds(50));
+            s = try_claim(pos);
+        }
+        return s;
+    }
+
+    // seq_cst aqui e em ready(): o produtor publica e depois olha sleeping;
+    // a thread de escrita marca sleeping e depois olha a fila. Assim um dos
+    // dois sempre v o outro e nenhuma linha fica esperando o timeout.
+    void publish(Slot& s, size_t pos) {
+        s.seq.store(pos + 1);
+        if (sleeping.load()) wake();
+    }
+
+    void wake() {
+        std::lock_guard<std::mutex> lg(mtx);
+        cv.notify_one();
+    }
+
+    bool ready() const {
+        const Slot& s = slots[dequeue_pos & mask];
+        return s.seq.load() == dequeue_pos + 1;
+    }
+
+    void append_timestamp(std::string& out, std::chrono::system_clock::time_point ts) {
+        auto since = ts.time_since_epoch();
+        auto secs = std::chrono::duration_cast<std::chrono::seconds>(since);
+        time_t tt = static_cast<time_t>(secs.count());
+        if (tt != cached_sec) {
+            std::tm tm;
+            localtime_r(&tt, &tm);
+            cached_len = std::strftime(cached_prefix, sizeof(cached_prefix), "%Y-%m-%d %H:%M:%S", &tm);
+            cached_sec = tt;
+        }
+        int ms = static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>(since - secs).count());
+
+        out.append(cached_prefix, cached_len);
+        char frac[4] = {'.', char('0' + ms / 100), char('0' + ms / 10 % 10), char('0' + ms % 10)};
+        out.append(frac, sizeof(frac));
+    }
+
+    // Acrescenta uma entrada ao lote: linha de texto ou registro binrio
+    void append_entry(std::string& out, std::chrono::system_clock::time_point ts, Level level,
+                      const char* tid, uint32_t fmt, std::string_view prefix, std::string_view body) {
+        if (opts.binary) {
+            const char* text = fmt ? format_text(fmt) : nullptr;
+            if (text && !emitted[fmt]) {
+                uint16_t tlen = static_cast<uint16_t>(std::min<size_t>(std::strlen(text), UINT16_MAX));
+                out += 'F';
+                put(out, &fmt, sizeof(fmt));
+                put(out, &tlen, sizeof(tlen));
+                out.append(text, tlen);
+                emitted[fmt] = 1;
             }
+
+            int64_t us = std::chrono::duration_cast<std::chrono::microseconds>(
+                ts.time_since_epoch()).count();
+            uint8_t lv = static_cast<uint8_t>(level);
+            uint8_t tlen = static_cast<uint8_t>(std::strlen(tid));
+            uint32_t blen = static_cast<uint32_t>(prefix.size() + body.size());
+            out += 'E';
+            put(out, &us, sizeof(us));
+            put(out, &lv, sizeof(lv));
+            put(out, &tlen, sizeof(tlen));
+            out.append(tid, tlen);
+            put(out, &fmt, sizeof(fmt));
+            put(out, &blen, sizeof(blen));
+            out += prefix;
+            out += body;
+            return;
+        }
+
+        append_timestamp(out, ts);
+        out += " [";
+        out += level_tag(level);
+        out += "] [TID:";
+        out += tid;
+        out += "] ";
+        out += prefix;
+        if (fmt) {
+            const char* text = format_text(fmt);
+            render(out, text ? text : "", body.data(), body.size());
+        } else {
+            out += body;
         }
-        if (ofs && ofs->is_open()) ofs->flush();
+        out += '\n';
+    }
+
+    static void put(std::string& out, const void* p, size_t n) {
+        out.append(static_cast<const char*>(p), n);
     }
 
-    void write_entry(const LogEntry& e) {
-        auto tt = std::chrono::system_clock::to_time_t(e.ts);
-        auto ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-            e.ts.time_since_epoch()) % 1000;
-        std::tm tm;
-#if defined(_MSC_VER)
-        localtime_s(&tm, &tt);
-#else
-        localtime_r(&tt, &tm);
-#endif
+    // Formata as entradas prontas no lote. Retorna quantas consumiu e marca
+    // urgent se alguma era ERROR.
+    size_t drain(std::string& out, bool& urgent) {
+        size_t n = 0;
+        while (ready()) {
+            Slot& s = slots[dequeue_pos & mask];
 
-        std::ostringstream oss;
-        oss << std::put_time(&tm, "%Y-%m-%d %H:%M:%S")
-            << '.' << std::setfill('0') << std::setw(3) << ms.count()
-            << " [" << level_to_string(e.level) << "]"
-            << " [TID:" << e.tid << "] "
-            << e.message << "\n";
-
-        if (to_stdout) {
-            std::cout << oss.str() << std::flush;
-        } else if (ofs && ofs->is_open()) {
-            (*ofs) << oss.str() << std::flush;
+            if (s.prefix) {
+                std::string_view text = s.shared;
+                if (!text.empty() && text.back() == '\n') text.remove_suffix(1);
+                append_entry(out, s.ts, s.level, s.tid, 0, s.prefix, text);
+                s.owner.reset();
+                s.prefix = nullptr;
+            } else {
+                append_entry(out, s.ts, s.level, s.tid, s.fmt, {}, s.message);
+                if (s.message.capacity() > SLOT_KEEP_CAPACITY) std::string().swap(s.message);
+            }
+            if (s.level == Level::ERROR) urgent = true;
+
+            s.seq.store(dequeue_pos + mask + 1, std::memory_order_release);
+            ++dequeue_pos;
+            ++n;
         }
+        return n;
+    }
+
+    void write_out(std::string& out) {
+        const char* p = out.data();
+        size_t left = out.size();
+        while (left > 0 && fd >= 0) {
+            ssize_t w = ::write(fd, p, left);
+            if (w < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            p += w;
+            left -= static_cast<size_t>(w);
+        }
+        out.clear();
+    }
+
+    void worker_loop() {
+        std::string out;
+        out.reserve(opts.flush_bytes + SLOT_KEEP_CAPACITY);
+        uint64_t reported = 0;
+        auto oldest = std::chrono::steady_clock::now();
+        const auto max_age = std::chrono::milliseconds(opts.flush_ms);
+
+        for (;;) {
+            bool stop = !running.load();
+            bool was_empty = out.empty();
+            bool urgent = false;
+            size_t n = drain(out, urgent);
+
+            if (opts.on_full == FullPolicy::COUNT) {
+                uint64_t d = dropped.load(std::memory_order_relaxed);
+                if (d != reported) {
+                    std::string notice = "tslog: " + std::to_string(d - reported) +
+                                         " linha(s) descartada(s) por fila cheia";
+                    append_entry(out, std::chrono::system_clock::now(), Level::WARN,
+                                 this_thread_tag(), 0, {}, notice);
+                    reported = d;
+                }
+            }
+
+            auto now = std::chrono::steady_clock::now();
+            if (was_empty && !out.empty()) oldest = now;
+            if (!out.empty() && (urgent || out.size() >= opts.flush_bytes ||
+                                 now - oldest >= max_age)) {
+                write_out(out);
+            }
+
+            if (n > 0) continue;
+            if (stop) {
+                // Um produtor pode ter reservado a posio antes do fechamento
+                // e ainda no ter publicado: espera at a ltima reservada
+                if (dequeue_pos == (enqueue_pos.load() & ~CLOSED)) break;
+                std::this_thread::yield();
+                continue;
+            }
+
+            // Nada pronto: dorme at um produtor acordar ou vencer o prazo
+            // da linha mais antiga ainda no lote
+            auto timeout = out.empty() ? max_age : max_age - (now - oldest);
+            std::unique_lock<std::mutex> lock(mtx);
+            sleeping.store(true);
+            if (!ready() && running.load()) cv.wait_for(lock, timeout);
+            sleeping.store(false);
+        }
+        write_out(out);
     }
 };
 
@@ -84,18 +398,42 @@ Logger& Logger::instance() {
 }
 
 void Logger::init(const std::string& filename, Level level) {
+    init(filename, level, Options{});
+}
+
+void Logger::init(const std::string& filename, Level level, const Options& opts) {
     std::lock_guard<std::mutex> lg(pimpl->mtx);
     if (pimpl->running.load()) return;
 
-    pimpl->min_level.store(level);
+    min_level_.store(static_cast<int>(level));
+    pimpl->opts = opts;
+    if (pimpl->opts.flush_ms == 0) pimpl->opts.flush_ms = 1;
 
     if (filename == "stdout") {
-        pimpl->to_stdout = true;
+        pimpl->fd = STDOUT_FILENO;
+        pimpl->owns_fd = false;
     } else {
-        pimpl->ofs = std::make_unique<std::ofstream>(filename, std::ios::app);
-        if (!pimpl->ofs->is_open()) {
+        pimpl->fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+        if (pimpl->fd < 0) {
             throw std::runtime_error("No foi possvel abrir arquivo de log: " + filename);
         }
+        pimpl->owns_fd = true;
+    }
+
+    size_t cap = 2;
+    while (cap < opts.queue_capacity) cap <<= 1;
+    pimpl->slots.reset(new Slot[cap]);
+    for (size_t i = 0; i < cap; ++i) pimpl->slots[i].seq.store(i, std::memory_order_relaxed);
+    pimpl->mask = cap - 1;
+    pimpl->enqueue_pos.store(0);
+    pimpl->dequeue_pos = 0;
+
+    if (opts.binary) {
+        pimpl->emitted.assign(MAX_FORMATS, 0);
+        std::string session(1, 'S');
+        session.append(BINARY_MAGIC, sizeof(BINARY_MAGIC));
+        session.append(reinterpret_cast<const char*>(&BINARY_VERSION), sizeof(BINARY_VERSION));
+        pimpl->write_out(session);
     }
 
     pimpl->running.store(true);
@@ -103,19 +441,69 @@ void Logger::init(const std::string& filename, Level level) {
 }
 
 void Logger::log(Level level, const std::string& msg) {
-    if (level < pimpl->min_level.load()) return;
+    if (!enabled(level)) return;
+    if (!pimpl->running.load(std::memory_order_acquire)) return;
 
-    LogEntry e;
-    e.level = level;
-    e.message = msg;
-    e.ts = std::chrono::system_clock::now();
-    e.tid = std::this_thread::get_id();
+    size_t pos;
+    Slot* s = pimpl->claim(pos);
+    if (!s) {
+        pimpl->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
 
-    {
-        std::lock_guard<std::mutex> lg(pimpl->mtx);
-        pimpl->q.push(std::move(e));
+    s->level = level;
+    s->ts = std::chrono::system_clock::now();
+    set_tid(*s);
+    s->fmt = 0;
+    s->message.assign(msg);
+    pimpl->publish(*s, pos);
+}
+
+void Logger::log_encoded(Level level, const Format& fmt, const char* args, size_t len) {
+    if (!enabled(level)) return;
+    if (fmt.id() == 0) {
+        // Tabela de formatos cheia: formata aqui mesmo
+        std::string text;
+        render(text, fmt.text(), args, len);
+        log(level, text);
+        return;
+    }
+    if (!pimpl->running.load(std::memory_order_acquire)) return;
+
+    size_t pos;
+    Slot* s = pimpl->claim(pos);
+    if (!s) {
+        pimpl->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
     }
-    pimpl->cv.notify_one();
+
+    s->level = level;
+    s->ts = std::chrono::system_clock::now();
+    set_tid(*s);
+    s->fmt = fmt.id();
+    s->message.assign(args, len);
+    pimpl->publish(*s, pos);
+}
+
+void Logger::log(Level level, const char* prefix, std::shared_ptr<const void> owner,
+                 std::string_view text) {
+    if (!enabled(level)) return;
+    if (!pimpl->running.load(std::memory_order_acquire)) return;
+
+    size_t pos;
+    Slot* s = pimpl->claim(pos);
+    if (!s) {
+        pimpl->dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    s->level = level;
+    s->ts = std::chrono::system_clock::now();
+    set_tid(*s);
+    s->prefix = prefix ? prefix : "";
+    s->owner = std::move(owner);
+    s->shared = text;
+    pimpl->publish(*s, pos);
 }
 
 void Logger::debug(const std::string& msg) { log(Level::DEBUG, msg); }
@@ -125,26 +513,49 @@ void Logger::error(const std::string& msg) { log(Level::ERROR, msg); }
 
 void Logger::shutdown() {
     if (!pimpl->running.load()) return;
-    pimpl->running.store(false);
+    {
+        std::lock_guard<std::mutex> lg(pimpl->mtx);
+        // Fecha a fila antes de running: quem v running falso v a fila fechada
+        pimpl->enqueue_pos.fetch_or(Impl::CLOSED);
+        pimpl->running.store(false);
+    }
     pimpl->cv.notify_all();
     if (pimpl->worker.joinable()) pimpl->worker.join();
-    if (pimpl->ofs && pimpl->ofs->is_open()) {
-        pimpl->ofs->close();
+    if (pimpl->owns_fd && pimpl->fd >= 0) {
+        ::close(pimpl->fd);
     }
+    pimpl->fd = -1;
 }
 
 void Logger::set_level(Level level) {
-    pimpl->min_level.store(level);
+    min_level_.store(static_cast<int>(level));
+}
+
+uint64_t Logger::dropped() const {
+    return pimpl->dropped.load(std::memory_order_relaxed);
 }
 
 std::string level_to_string(Level l) {
-    switch(l) {
-        case Level::DEBUG: return "DEBUG";
-        case Level::INFO:  return "INFO ";
-        case Level::WARN:  return "WARN ";
-        case Level::ERROR: return "ERROR";
-        default: return "?????";
-    }
+    return level_tag(l);
+}
+
+bool parse_full_policy(const std::string& s, FullPolicy& out) {
+    if (s == "block") out = FullPolicy::BLOCK;
+    else if (s == "drop") out = FullPolicy::DROP;
+    else if (s == "count") out = FullPolicy::COUNT;
+    else return false;
+    return true;
+}
+
+bool parse_level(const std::string& s, Level& out) {
+    std::string u = s;
+    for (auto& ch : u) ch = static_cast<char>(std::toupper(static_cast<unsigned char>(ch)));
+    if (u == "DEBUG") out = Level::DEBUG;
+    else if (u == "INFO") out = Level::INFO;
+    else if (u == "WARN") out = Level::WARN;
+    else if (u == "ERROR") out = Level::ERROR;
+    else return false;
+    return true;
 }
 
 }
@@ -0,0 +1,146 @@
+// Decodificador offline do modo binrio do tslog: l os registros gravados
+// com Options::binary e imprime as mesmas linhas que o modo texto geraria.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstring>
+#include <ctime>
+#include <cstdio>
+#include "tslog.hpp"
+
+using namespace tslog;
+
+
+struct Reader {
+    const char* p;
+    const char* end;
+
+    template <typename T>
+    bool get(T& v) {
+        if (static_cast<size_t>(end - p) < sizeof(T)) return false;
+        std::memcpy(&v, p, sizeof(T));
+        p += sizeof(T);
+        return true;
+    }
+
+    bool bytes(size_t n, std::string_view& out) {
+        if (static_cast<size_t>(end - p) < n) return false;
+        out = std::string_view(p, n);
+        p += n;
+        return true;
+    }
+};
+
+static void append_timestamp(std::string& out, int64_t us) {
+    time_t tt = static_cast<time_t>(us / 1000000);
+    std::tm tm;
+    localtime_r(&tt, &tm);
+    char buf[40];
+    size_t n = std::strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tm);
+    n += std::snprintf(buf + n, sizeof(buf) - n, ".%03d", static_cast<int>(us / 1000 % 1000));
+    out.append(buf, n);
+}
+
+// Decodifica um arquivo inteiro; retorna false se ele terminar no meio de
+// um registro ou tiver um tipo desconhecido
+static bool decode(const std::string& data, int min_level, std::ostream& os) {
+    Reader r{data.data(), data.data() + data.size()};
+    std::unordered_map<uint32_t, std::string> formats;
+    std::string line;
+
+    while (r.p < r.end) {
+        char type = *r.p++;
+        if (type == 'S') {
+            std::string_view magic;
+            uint32_t version;
+            if (!r.bytes(sizeof(BINARY_MAGIC), magic) || !r.get(version)) return false;
+            if (magic != std::string_view(BINARY_MAGIC, sizeof(BINARY_MAGIC)) || version != BINARY_VERSION) {
+                std::cerr << "Sesso com verso desconhecida" << std::endl;
+                return false;
+            }
+            formats.clear();
+        } else if (type == 'F') {
+            uint32_t id;
+            uint16_t len;
+            std::string_view text;
+            if (!r.get(id) || !r.get(len) || !r.bytes(len, text)) return false;
+            formats[id] = std::string(text);
+        } else if (type == 'E') {
+            int64_t us;
+            uint8_t level, tlen;
+            uint32_t fmt, blen;
+            std::string_view tid, body;
+            if (!r.get(us) || !r.get(level) || !r.get(tlen) || !r.bytes(tlen, tid) ||
+                !r.get(fmt) || !r.get(blen) || !r.bytes(blen, body)) return false;
+            if (level < min_level) continue;
+
+            line.clear();
+            append_timestamp(line, us);
+            line += " [";
+            line += level_to_string(static_cast<Level>(level));
+            line += "] [TID:";
+            line += tid;
+            line += "] ";
+            if (fmt == 0) {
+                line += body;
+            } else {
+                auto it = formats.find(fmt);
+                if (it == formats.end() || !render(line, it->second, body.data(), body.size())) {
+                    line += "<formato " + std::to_string(fmt) + " ilegvel>";
+                }
+            }
+            line += '\n';
+            os << line;
+        } else {
+            std::cerr << "Registro desconhecido no offset " << (r.p - 1 - data.data()) << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+static void usage(const char* prog) {
+    std::cerr << "Uso: " << prog << " [--level DEBUG|INFO|WARN|ERROR] ARQUIVO..." << std::endl;
+}
+
+int main(int argc, char** argv) {
+    int min_level = 0;
+    std::vector<std::string> files;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--level" && i + 1 < argc) {
+            Level level;
+            if (!parse_level(argv[++i], level)) {
+                usage(argv[0]);
+                return 1;
+            }
+            min_level = static_cast<int>(level);
+        } else {
+            files.push_back(arg);
+        }
+    }
+    if (files.empty()) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int rc = 0;
+    for (const auto& f : files) {
+        std::ifstream in(f, std::ios::binary);
+        if (!in) {
+            std::cerr << "No foi possvel abrir " << f << std::endl;
+            rc = 1;
+            continue;
+        }
+        std::ostringstream ss;
+        ss << in.rdbuf();
+        if (!decode(ss.str(), min_level, std::cout)) {
+            std::cerr << f << ": registro truncado ou invlido; parando aqui" << std::endl;
+            rc = 1;
+        }
+    }
+    return rc;
+}
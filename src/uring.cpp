@@ -0,0 +1,147 @@
+#include "uring.hpp"
+#include "metrics.hpp"
+
+#include <stdexcept>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+
+// Recv multishot e anel de buffers fornecidos existem a partir do 6.0
+static bool kernel_at_least(int major, int minor) {
+    utsname u{};
+    int ma = 0, mi = 0;
+    if (uname(&u) != 0 || std::sscanf(u.release, "%d.%d", &ma, &mi) != 2) return false;
+    return ma > major || (ma == major && mi >= minor);
+}
+
+IoUring::IoUring(unsigned entries) {
+    if (!kernel_at_least(6, 0)) {
+        throw std::runtime_error("io_uring exige kernel 6.0 ou mais novo");
+    }
+
+    io_uring_params p{};
+    p.flags = IORING_SETUP_CLAMP;
+    fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &p));
+    if (fd_ < 0) {
+        throw std::runtime_error(std::string("Falha no io_uring_setup(): ") + strerror(errno));
+    }
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_NODROP)) {
+        close(fd_);
+        throw std::runtime_error("io_uring sem os recursos necessrios");
+    }
+
+    // Com SINGLE_MMAP os dois anis dividem o mesmo mapeamento
+    sq_len_ = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    cq_len_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+    if (cq_len_ > sq_len_) sq_len_ = cq_len_;
+    cq_len_ = 0;
+    sq_ptr_ = mmap(nullptr, sq_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                   IORING_OFF_SQ_RING);
+    sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+    void* sqes = (sq_ptr_ == MAP_FAILED) ? MAP_FAILED
+               : mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+                      IORING_OFF_SQES);
+    if (sq_ptr_ == MAP_FAILED || sqes == MAP_FAILED) {
+        if (sq_ptr_ != MAP_FAILED) munmap(sq_ptr_, sq_len_);
+        close(fd_);
+        throw std::runtime_error("Falha ao mapear os anis do io_uring");
+    }
+    cq_ptr_ = sq_ptr_;
+    sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+    char* sq = static_cast<char*>(sq_ptr_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + p.sq_off.head);
+    sq_ktail_ = reinterpret_cast<unsigned*>(sq + p.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<unsigned*>(sq + p.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + p.sq_off.array);
+    sq_entries_ = p.sq_entries;
+    sq_tail_ = sq_submitted_ = *sq_ktail_;
+
+    char* cq = static_cast<char*>(cq_ptr_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + p.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + p.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<unsigned*>(cq + p.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+}
+
+IoUring::~IoUring() {
+    if (br_) munmap(br_, br_len_);
+    if (bufs_) munmap(bufs_, bufs_len_);
+    munmap(sqes_, sqes_len_);
+    munmap(sq_ptr_, sq_len_);
+    close(fd_);
+}
+
+io_uring_sqe* IoUring::get_sqe() {
+    unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sq_tail_ - head >= sq_entries_) return nullptr;
+    unsigned idx = sq_tail_ & sq_mask_;
+    io_uring_sqe* sqe = &sqes_[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[idx] = idx;
+    ++sq_tail_;
+    return sqe;
+}
+
+int IoUring::enter(unsigned wait_nr) {
+    unsigned to_submit = sq_tail_ - sq_submitted_;
+    __atomic_store_n(sq_ktail_, sq_tail_, __ATOMIC_RELEASE);
+    unsigned flags = wait_nr ? IORING_ENTER_GETEVENTS : 0;
+    if (to_submit == 0 && wait_nr == 0) return 0;
+
+    metrics::syscalls(metrics::Syscall::URING_ENTER).inc();
+    int r = static_cast<int>(syscall(__NR_io_uring_enter, fd_, to_submit, wait_nr, flags, nullptr, 0));
+    if (r < 0) return -errno;
+    sq_submitted_ += static_cast<unsigned>(r);
+    return r;
+}
+
+bool IoUring::setup_buffers(uint16_t bgid, unsigned count, unsigned size) {
+    if (br_ || count == 0 || (count & (count - 1)) != 0 || count > 32768) return false;
+
+    br_len_ = count * sizeof(io_uring_buf);
+    void* ring = mmap(nullptr, br_len_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring == MAP_FAILED) return false;
+    bufs_len_ = static_cast<size_t>(count) * size;
+    void* bufs = mmap(nullptr, bufs_len_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (bufs == MAP_FAILED) {
+        munmap(ring, br_len_);
+        return false;
+    }
+
+    io_uring_buf_reg reg{};
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = count;
+    reg.bgid = bgid;
+    if (syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PBUF_RING, &reg, 1) < 0) {
+        munmap(bufs, bufs_len_);
+        munmap(ring, br_len_);
+        return false;
+    }
+
+    br_ = static_cast<io_uring_buf_ring*>(ring);
+    bufs_ = static_cast<char*>(bufs);
+    buf_size_ = size;
+    br_mask_ = count - 1;
+    br_tail_ = 0;
+    for (unsigned i = 0; i < count; ++i) recycle(static_cast<uint16_t>(i));
+    return true;
+}
+
+// A cauda do anel fica sobre o campo resv da primeira entrada. As entradas
+// so indexadas  mo: em C++ o membro flexvel bufs de io_uring_buf_ring
+// no fica no deslocamento 0, como o kernel espera.
+void IoUring::recycle(uint16_t bid) {
+    io_uring_buf* ring = reinterpret_cast<io_uring_buf*>(br_);
+    io_uring_buf& b = ring[br_tail_ & br_mask_];
+    b.addr = reinterpret_cast<uint64_t>(buffer(bid));
+    b.len = buf_size_;
+    b.bid = bid;
+    ++br_tail_;
+    __atomic_store_n(&ring[0].resv, br_tail_, __ATOMIC_RELEASE);
+}
@@ -0,0 +1,138 @@
+#include "word_filter.hpp"
+
+#include <queue>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// O pr-filtro compara cada bloco de 16 bytes com cada byte inicial;
+// acima disso a varredura escalar do autmato sai mais barata
+constexpr int MAX_PREFILTER_BYTES = 8;
+
+static inline unsigned char ascii_lower(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static inline unsigned char ascii_upper(unsigned char c) {
+    return (c >= 'a' && c <= 'z') ? c - ('a' - 'A') : c;
+}
+
+WordFilter::WordFilter(const std::vector<std::string>& words, bool simd_prefilter) {
+    // Classes de bytes: s os bytes que aparecem nas palavras (nas duas
+    // caixas) ganham classe prpria, o resto cai na classe 0. Isso mantm a
+    // tabela de transies pequena mesmo com milhares de palavras.
+    for (const auto& w : words) {
+        for (unsigned char c : w) {
+            unsigned char lc = ascii_lower(c);
+            if (cls_[lc] == 0) {
+                if (nclasses_ == 256) break;
+                cls_[lc] = static_cast<uint8_t>(nclasses_);
+                cls_[ascii_upper(lc)] = static_cast<uint8_t>(nclasses_);
+                ++nclasses_;
+            }
+        }
+    }
+
+    // Trie
+    std::vector<std::vector<int32_t>> go(1, std::vector<int32_t>(nclasses_, -1));
+    std::vector<uint8_t> out(1, 0);
+    for (const auto& w : words) {
+        if (w.empty()) continue;
+        size_t s = 0;
+        for (unsigned char c : w) {
+            uint8_t k = cls_[ascii_lower(c)];
+            if (go[s][k] < 0) {
+                go[s][k] = static_cast<int32_t>(go.size());
+                go.emplace_back(nclasses_, -1);
+                out.push_back(0);
+            }
+            s = go[s][k];
+        }
+        out[s] = 1;
+        ++words_;
+    }
+
+    // Ligaes de falha em largura, j resolvidas na tabela do DFA
+    size_t nstates = go.size();
+    delta_.assign(nstates * nclasses_, 0);
+    std::vector<uint32_t> fail(nstates, 0);
+    std::queue<uint32_t> q;
+
+    for (uint32_t k = 0; k < nclasses_; ++k) {
+        int32_t t = go[0][k];
+        if (t > 0) {
+            delta_[k] = t;
+            q.push(t);
+        }
+    }
+
+    while (!q.empty()) {
+        uint32_t s = q.front();
+        q.pop();
+        out[s] |= out[fail[s]];
+
+        for (uint32_t k = 0; k < nclasses_; ++k) {
+            int32_t t = go[s][k];
+            if (t >= 0) {
+                fail[t] = delta_[fail[s] * nclasses_ + k];
+                delta_[s * nclasses_ + k] = t;
+                q.push(t);
+            } else {
+                delta_[s * nclasses_ + k] = delta_[fail[s] * nclasses_ + k];
+            }
+        }
+    }
+    out_ = std::move(out);
+
+#if defined(__SSE2__)
+    if (simd_prefilter) {
+        int n = 0;
+        for (int b = 0; b < 256 && n <= MAX_PREFILTER_BYTES; ++b) {
+            if (delta_[cls_[b]] != 0) {
+                if (n < MAX_PREFILTER_BYTES) first_[n] = static_cast<unsigned char>(b);
+                ++n;
+            }
+        }
+        nfirst_ = (n <= MAX_PREFILTER_BYTES) ? n : 0;
+    }
+#else
+    (void)simd_prefilter;
+#endif
+}
+
+// A partir de i, acha o prximo byte que pode iniciar uma palavra
+size_t WordFilter::skip_to_candidate(const unsigned char* p, size_t i, size_t n) const {
+#if defined(__SSE2__)
+    while (i + 16 <= n) {
+        __m128i blk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+        __m128i hit = _mm_setzero_si128();
+        for (int k = 0; k < nfirst_; ++k) {
+            hit = _mm_or_si128(hit, _mm_cmpeq_epi8(blk, _mm_set1_epi8(static_cast<char>(first_[k]))));
+        }
+        int mask = _mm_movemask_epi8(hit);
+        if (mask) return i + __builtin_ctz(mask);
+        i += 16;
+    }
+#endif
+    while (i < n && delta_[cls_[p[i]]] == 0) ++i;
+    return i;
+}
+
+bool WordFilter::matches(std::string_view text) const {
+    if (words_ == 0) return false;
+
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(text.data());
+    size_t n = text.size();
+    uint32_t s = 0;
+
+    for (size_t i = 0; i < n; ++i) {
+        if (s == 0 && nfirst_) {
+            i = skip_to_candidate(p, i, n);
+            if (i >= n) break;
+        }
+        s = delta_[s * nclasses_ + cls_[p[i]]];
+        if (out_[s]) return true;
+    }
+    return false;
+}
@@ -0,0 +1,50 @@
+#include "worker_pool.hpp"
+
+
+WorkerPool::WorkerPool(unsigned threads, size_t max_queue)
+    : max_queue_(max_queue ? max_queue : 1) {
+    if (threads == 0) threads = 1;
+    for (unsigned i = 0; i < threads; ++i) threads_.emplace_back([this] { run(); });
+}
+
+WorkerPool::~WorkerPool() {
+    stop();
+}
+
+bool WorkerPool::submit(Job job) {
+    {
+        std::lock_guard<std::mutex> lg(mtx_);
+        if (stopping_ || jobs_.size() >= max_queue_) return false;
+        jobs_.push_back(std::move(job));
+        depth_.store(jobs_.size(), std::memory_order_relaxed);
+    }
+    cv_.notify_one();
+    return true;
+}
+
+void WorkerPool::stop() {
+    {
+        std::lock_guard<std::mutex> lg(mtx_);
+        if (stopping_) return;
+        stopping_ = true;
+    }
+    cv_.notify_all();
+    for (auto& t : threads_) {
+        if (t.joinable()) t.join();
+    }
+}
+
+void WorkerPool::run() {
+    for (;;) {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cv_.wait(lk, [this] { return stopping_ || !jobs_.empty(); });
+            if (jobs_.empty()) return;
+            job = std::move(jobs_.front());
+            jobs_.pop_front();
+            depth_.store(jobs_.size(), std::memory_order_relaxed);
+        }
+        job();
+    }
+}
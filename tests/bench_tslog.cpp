@@ -0,0 +1,124 @@
+// Este programa compila as chamadas DEBUG das macros fora do binrio,
+// independente do nvel escolhido no build
+#undef TSLOG_MIN_LEVEL
+#define TSLOG_MIN_LEVEL 1
+
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+#include "../include/tslog.hpp"
+
+using namespace tslog;
+
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// Argumento com efeito colateral: conta quantas vezes foi avaliado
+static int evaluated = 0;
+static const std::string& user_name() {
+    static const std::string name = "alice";
+    ++evaluated;
+    return name;
+}
+
+template <typename F>
+static double ns_per_call(long calls, F&& fn) {
+    auto t0 = std::chrono::steady_clock::now();
+    for (long i = 0; i < calls; ++i) fn(i);
+    auto t1 = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(t1 - t0).count() / static_cast<double>(calls);
+}
+
+static size_t count_lines(const std::string& path, const std::string& needle) {
+    std::ifstream in(path);
+    std::string line;
+    size_t n = 0;
+    while (std::getline(in, line)) {
+        if (line.find(needle) != std::string::npos) ++n;
+    }
+    return n;
+}
+
+
+int main(int argc, char** argv) {
+    const long calls = (argc > 1) ? std::stol(argv[1]) : 2000000;
+    const std::string path = "bench_tslog_" + std::to_string(getpid()) + ".log";
+
+    Logger::instance().init(path, Level::WARN);
+    Logger& log = Logger::instance();
+    const std::string room = "geral";
+
+    // Abaixo do nvel: a API antiga monta a string antes de descobrir que
+    // a linha no sai; logf s codifica se o nvel passar; as macros nem
+    // avaliam os argumentos; abaixo de TSLOG_MIN_LEVEL no sobra nada
+    double old_api = ns_per_call(calls, [&](long i) {
+        log.info("Mensagem de " + user_name() + " na sala " + room + " (" + std::to_string(i) + " bytes)");
+    });
+    static const Format fmt("Mensagem de {} na sala {} ({} bytes)");
+    double direct = ns_per_call(calls, [&](long i) {
+        log.logf(Level::INFO, fmt, user_name(), room, i);
+    });
+    evaluated = 0;
+    double runtime = ns_per_call(calls, [&](long i) {
+        TSLOG_INFO("Mensagem de {} na sala {} ({} bytes)", user_name(), room, i);
+    });
+    check(evaluated == 0, "argumentos no avaliados abaixo do nvel em tempo de execuo");
+    double compiled = ns_per_call(calls, [&](long i) {
+        TSLOG_DEBUG("Mensagem de {} na sala {} ({} bytes)", user_name(), room, i);
+    });
+    check(evaluated == 0, "chamada abaixo de TSLOG_MIN_LEVEL descartada");
+
+    // Caminho quente com o nvel ligado: limitado por tempo ou amostrado.
+    // Em rajada, o limite deixa sair a primeira linha e suprime o resto.
+    double limited = ns_per_call(calls, [&](long i) {
+        TSLOG_EVERY_MS(Level::WARN, 60000, "limitada: fila cheia para {} ({})", room, i);
+    });
+    double sampled = ns_per_call(calls, [&](long i) {
+        TSLOG_SAMPLED(Level::WARN, 1000, "amostrada: mensagem {}", i);
+    });
+    // Referncia: linha que sai de verdade (s o custo do produtor)
+    double emitted = ns_per_call(calls / 100, [&](long i) {
+        log.logf(Level::WARN, fmt, user_name(), room, i);
+    });
+
+    // Limite curto: depois do intervalo sai uma linha com a contagem
+    for (int round = 0; round < 2; ++round) {
+        for (int i = 0; i < 1000; ++i) TSLOG_EVERY_MS(Level::WARN, 20, "curta: rajada {}", round);
+        usleep(30000);
+    }
+
+    log.shutdown();
+
+    std::printf("Chamada suprimida (%ld chamadas, ns por chamada):\n", calls);
+    std::printf("  info(std::string + ...)     %8.1f\n", old_api);
+    std::printf("  logf abaixo do nvel        %8.1f\n", direct);
+    std::printf("  TSLOG_INFO abaixo do nvel  %8.1f\n", runtime);
+    std::printf("  TSLOG_DEBUG compilado fora  %8.1f\n", compiled);
+    std::printf("  TSLOG_EVERY_MS suprimida    %8.1f\n", limited);
+    std::printf("  TSLOG_SAMPLED 1/1000        %8.1f\n", sampled);
+    std::printf("  logf emitida (referncia)   %8.1f\n", emitted);
+
+    check(count_lines(path, "limitada:") == 1, "rajada limitada a uma linha");
+    check(count_lines(path, "amostrada:") == static_cast<size_t>((calls + 999) / 1000),
+          "uma linha a cada 1000 chamadas amostradas");
+    check(count_lines(path, "curta: rajada 0") == 1 && count_lines(path, "curta: rajada 1 (+999 suprimida(s))") == 1,
+          "linha seguinte ao intervalo conta as suprimidas");
+    std::remove(path.c_str());
+
+    if (failures) {
+        std::cerr << failures << " verificao(es) falharam" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
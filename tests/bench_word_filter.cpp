@@ -0,0 +1,95 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_set>
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include "../include/word_filter.hpp"
+
+
+// Implementao anterior do servidor, mantida como referncia
+static bool naive_contains(const std::unordered_set<std::string>& words, const std::string& msg) {
+    std::string lower_msg = msg;
+    std::transform(lower_msg.begin(), lower_msg.end(), lower_msg.begin(), ::tolower);
+    for (const auto& word : words) {
+        if (lower_msg.find(word) != std::string::npos) return true;
+    }
+    return false;
+}
+
+static std::string random_word(std::mt19937& rng, size_t min_len, size_t max_len) {
+    std::uniform_int_distribution<size_t> len(min_len, max_len);
+    std::uniform_int_distribution<int> ch('a', 'z');
+    std::string w(len(rng), ' ');
+    for (auto& c : w) c = static_cast<char>(ch(rng));
+    return w;
+}
+
+template <typename F>
+static double ns_per_msg(const std::vector<std::string>& msgs, int rounds, F&& fn, size_t& hits) {
+    hits = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int r = 0; r < rounds; ++r) {
+        for (const auto& m : msgs) hits += fn(m) ? 1 : 0;
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    double ns = std::chrono::duration<double, std::nano>(t1 - t0).count();
+    return ns / (static_cast<double>(msgs.size()) * rounds);
+}
+
+
+int main(int argc, char** argv) {
+    const size_t nwords = (argc > 1) ? std::stoul(argv[1]) : 2000;
+    const size_t nmsgs = (argc > 2) ? std::stoul(argv[2]) : 2000;
+    const int rounds = (argc > 3) ? std::stoi(argv[3]) : 5;
+
+    std::mt19937 rng(42);
+    std::vector<std::string> words = {"banword", "spam", "palavrao"};
+    while (words.size() < nwords) words.push_back(random_word(rng, 5, 10));
+    std::unordered_set<std::string> word_set(words.begin(), words.end());
+
+    // Mensagens de ~80 bytes; uma em cada dez contm uma palavra proibida
+    std::vector<std::string> msgs;
+    std::uniform_int_distribution<size_t> pick(0, words.size() - 1);
+    for (size_t i = 0; i < nmsgs; ++i) {
+        std::string m;
+        while (m.size() < 80) m += random_word(rng, 2, 7) + " ";
+        if (i % 10 == 0) {
+            std::string w = words[pick(rng)];
+            w[0] = static_cast<char>(::toupper(w[0]));
+            m.insert(m.size() / 2, " " + w + " ");
+        }
+        msgs.push_back(m);
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    WordFilter filter(words);
+    auto t1 = std::chrono::steady_clock::now();
+    WordFilter small_filter({"banword", "spam", "palavrao"});
+
+    // Os dois mtodos precisam concordar
+    for (const auto& m : msgs) {
+        if (filter.matches(m) != naive_contains(word_set, m)) {
+            std::cerr << "Divergncia na mensagem: " << m << std::endl;
+            return 1;
+        }
+    }
+
+    size_t hits_naive = 0, hits_ac = 0, hits_small = 0, hits_small_naive = 0;
+    std::unordered_set<std::string> small_set = {"banword", "spam", "palavrao"};
+
+    double naive = ns_per_msg(msgs, rounds, [&](const std::string& m) { return naive_contains(word_set, m); }, hits_naive);
+    double ac = ns_per_msg(msgs, rounds, [&](const std::string& m) { return filter.matches(m); }, hits_ac);
+    double small_naive = ns_per_msg(msgs, rounds, [&](const std::string& m) { return naive_contains(small_set, m); }, hits_small_naive);
+    double small = ns_per_msg(msgs, rounds, [&](const std::string& m) { return small_filter.matches(m); }, hits_small);
+
+    std::cout << "palavras=" << words.size() << " mensagens=" << msgs.size()
+              << " estados=" << filter.state_count()
+              << " compilacao_ms=" << std::chrono::duration<double, std::milli>(t1 - t0).count() << "\n";
+    std::cout << "lista grande: ingenuo=" << naive << " ns/msg  aho-corasick=" << ac
+              << " ns/msg  (" << naive / ac << "x)\n";
+    std::cout << "lista padrao: ingenuo=" << small_naive << " ns/msg  aho-corasick=" << small
+              << " ns/msg  pre-filtro=" << (small_filter.prefilter_enabled() ? "sim" : "nao") << "\n";
+    return (hits_naive == hits_ac && hits_small == hits_small_naive) ? 0 : 1;
+}
@@ -0,0 +1,133 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include "../include/chatroom.hpp"
+
+
+// A sala s conhece ClientInfo por ponteiro; aqui basta um id
+struct ClientInfo {
+    int id;
+};
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static size_t members_in(const ChatRoom::Snapshot& snap) {
+    size_t n = 0;
+    for (const auto& list : snap) n += list ? list->size() : 0;
+    return n;
+}
+
+
+int main(int argc, char** argv) {
+    const int nthreads = (argc > 1) ? std::stoi(argv[1]) : 8;
+    const int nrooms = (argc > 2) ? std::stoi(argv[2]) : 1000;
+
+    {
+        ChatRoom room("sala", 2, 10);
+        auto a = std::make_shared<ClientInfo>(ClientInfo{1});
+        auto b = std::make_shared<ClientInfo>(ClientInfo{2});
+        check(room.join(a, 0) && room.join(b, 1), "entrada em shards diferentes");
+        check(!room.join(a, 0), "entrada repetida  recusada");
+        check(room.size() == 2, "tamanho conta os dois shards");
+
+        auto before = room.snapshot();
+        check(before.size() == 2 && before[0]->size() == 1 && before[1]->size() == 1,
+              "cada shard v s os seus membros");
+        check(room.leave(b.get(), 1), "sada de membro");
+        check(!room.leave(b.get(), 1), "sada repetida  ignorada");
+        check(before[1] && before[1]->size() == 1, "retrato antigo no muda com a sada (copy-on-write)");
+        check(!room.snapshot()[1], "shard sem membros fica vazio");
+    }
+
+    // Muitos membros num shard: entrar e sair no copia a lista a cada vez,
+    // e retratos sem mudana no meio so o mesmo objeto
+    {
+        ChatRoom room("grande", 1, 10);
+        std::vector<std::shared_ptr<ClientInfo>> many;
+        auto t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < 100000; ++i) {
+            many.push_back(std::make_shared<ClientInfo>(ClientInfo{i}));
+            room.join(many.back(), 0);
+        }
+        for (int i = 0; i < 100000; i += 2) room.leave(many[i].get(), 0);
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        auto snap = room.snapshot();
+        check(room.size() == 50000 && snap[0]->size() == 50000, "metade saiu da sala grande");
+        bool odd = true;
+        for (const auto& m : *snap[0]) odd = odd && (m->id % 2 == 1);
+        check(odd, "saram exatamente os membros certos");
+        check(room.snapshot()[0] == snap[0], "retrato reaproveitado sem mudanas");
+        std::cout << "100000 entradas e 50000 sadas numa sala em " << secs << " s" << std::endl;
+    }
+
+    {
+        RoomRegistry reg("geral", 2, 100, 10);
+        auto a = std::make_shared<ClientInfo>(ClientInfo{1});
+        auto r = reg.join("xadrez", a, 0);
+        check(reg.count() == 2 && r->size() == 1, "sala criada na primeira entrada");
+        check(reg.join("xadrez", a, 0) == r, "mesmo nome, mesma sala");
+        reg.leave(r, a.get(), 0);
+        check(reg.count() == 1, "sala vazia  removida");
+
+        auto g = reg.join("geral", a, 0);
+        check(g == reg.default_room(), "sala padro registrada pelo nome");
+        reg.leave(g, a.get(), 0);
+        check(reg.count() == 1, "sala padro nunca  removida");
+        check(g->history().capacity() == 100 && r->history().capacity() == 10,
+              "histrico prprio por sala");
+
+        check(RoomRegistry::valid_name("sala_1-a") && !RoomRegistry::valid_name("") &&
+              !RoomRegistry::valid_name("com espao") && !RoomRegistry::valid_name(std::string(33, 'a')),
+              "validao de nomes");
+    }
+
+    // Muitas salas pequenas: cada thread entra e sai de salas prprias e de
+    // algumas compartilhadas ao mesmo tempo; no fim s a padro sobra
+    {
+        RoomRegistry reg("geral", static_cast<unsigned>(nthreads), 100, 10);
+        std::atomic<bool> bad{false};
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int t = 0; t < nthreads; ++t) {
+            threads.emplace_back([&, t] {
+                std::vector<std::shared_ptr<ClientInfo>> me;
+                std::vector<std::shared_ptr<ChatRoom>> joined;
+                for (int i = 0; i < nrooms; ++i) {
+                    me.push_back(std::make_shared<ClientInfo>(ClientInfo{t * nrooms + i}));
+                    std::string name = (i % 10 == 0) ? "comum" + std::to_string(i % 50)
+                                                     : "t" + std::to_string(t) + "_" + std::to_string(i);
+                    joined.push_back(reg.join(name, me.back(), static_cast<unsigned>(t)));
+                }
+                for (int i = 0; i < nrooms; ++i) {
+                    auto snap = joined[i]->snapshot();
+                    if (!snap[t] || snap[t]->empty()) bad = true;
+                }
+                for (int i = 0; i < nrooms; ++i) reg.leave(joined[i], me[i].get(), static_cast<unsigned>(t));
+            });
+        }
+        for (auto& th : threads) th.join();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+        check(!bad, "membro visvel no retrato da prpria sala");
+        check(reg.count() == 1, "todas as salas temporrias removidas");
+        check(members_in(reg.default_room()->snapshot()) == 0, "sala padro vazia");
+        std::cout << nthreads * nrooms << " entradas e sadas em " << secs << " s" << std::endl;
+    }
+
+    if (failures) {
+        std::cerr << failures << " verificao(es) falharam" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
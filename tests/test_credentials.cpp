@@ -0,0 +1,152 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+#include "../include/credentials.hpp"
+#include "../include/worker_pool.hpp"
+
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static std::string hex_of(const crypto::Digest& d) {
+    return crypto::to_hex(d.data(), d.size());
+}
+
+static std::string sha_hex(const std::string& s) {
+    return hex_of(crypto::sha256(s.data(), s.size()));
+}
+
+static std::string pbkdf2_hex(const std::string& pw, const std::string& salt, unsigned it, size_t len) {
+    std::string out(len, '\0');
+    crypto::pbkdf2_sha256(pw, reinterpret_cast<const uint8_t*>(salt.data()), salt.size(), it,
+                          reinterpret_cast<uint8_t*>(&out[0]), len);
+    return crypto::to_hex(reinterpret_cast<const uint8_t*>(out.data()), len);
+}
+
+
+int main(int argc, char** argv) {
+    const unsigned nthreads = (argc > 1) ? std::stoul(argv[1]) : 4;
+    const unsigned iterations = (argc > 2) ? std::stoul(argv[2]) : CredentialStore::DEFAULT_ITERATIONS;
+
+    // Vetores conhecidos (FIPS 180-2, RFC 4231, RFC 7914)
+    check(sha_hex("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", "sha256 vazio");
+    check(sha_hex("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", "sha256 abc");
+    check(sha_hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", "sha256 dois blocos");
+    check(sha_hex(std::string(1000000, 'a')) ==
+          "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0", "sha256 um milho de 'a'");
+    std::string data = "what do ya want for nothing?";
+    check(hex_of(crypto::hmac_sha256("Jefe", 4, data.data(), data.size())) ==
+          "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843", "hmac-sha256");
+    check(pbkdf2_hex("passwd", "salt", 1, 64) ==
+          "55ac046e56e3089fec1691c22544b605f94185216dde0465e68b9d57c20dacbc"
+          "49ca9cccf179b645991664b39d77ef317c71b845b1e30bd509112041d3a19783", "pbkdf2 c=1");
+    check(pbkdf2_hex("Password", "NaCl", 80000, 64) ==
+          "4ddcd8f60b98be21830cee5ef22701f9641a4418d04c0414aeff08876b34ab56"
+          "a1d425a1225833549adb841b51c9b3176a272bdebba1d078478f62b397f33c8d", "pbkdf2 c=80000");
+
+    // Armazenamento
+    {
+        CredentialStore store;
+        check(store.add_password("alice", "senha123", 1000), "cadastro");
+        check(store.verify("alice", "senha123"), "senha correta");
+        check(!store.verify("alice", "senha124") && !store.verify("alice", ""), "senha errada");
+        check(!store.verify("mallory", "senha123"), "usurio inexistente");
+
+        std::string enc = CredentialStore::hash_password("x", 10);
+        check(enc.compare(0, 17, "pbkdf2-sha256$10$") == 0, "formato guardado");
+        check(enc != CredentialStore::hash_password("x", 10), "sal aleatrio");
+        check(!store.add("bob", "pbkdf2-sha256$0$00$00") && !store.add("bob", "md5$1$ab$cd") &&
+              !store.add("bob", enc.substr(0, enc.size() - 2)), "hash invlido  recusado");
+
+        std::string path = "/tmp/test_credentials_" + std::to_string(getpid()) + ".db";
+        {
+            std::ofstream out(path);
+            out << "# comentrio\n"
+                << "bob:" << CredentialStore::hash_password("hunter2", 500) << "\r\n"
+                << "carol:texto-puro\n\n";
+        }
+        size_t loaded = 0, legacy = 0;
+        std::string error;
+        check(store.load(path, 200, loaded, legacy, error) && loaded == 2 && legacy == 1, "carga do arquivo");
+        check(store.verify("bob", "hunter2") && store.verify("carol", "texto-puro") &&
+              !store.verify("bob", "hunter3"), "usurios do arquivo");
+        {
+            std::ofstream out(path, std::ios::app);
+            out << "dave:pbkdf2-sha256$1$zz$zz\n";
+        }
+        check(!store.load(path, 200, loaded, legacy, error) && error.find(":5:") != std::string::npos,
+              "linha invlida aponta o nmero");
+        std::remove(path.c_str());
+    }
+
+    // Cache de sesses verificadas
+    {
+        AuthCache cache(50, 1024);
+        cache.remember("alice", "senha123");
+        check(cache.check("alice", "senha123"), "acerto no cache");
+        check(!cache.check("alice", "outra") && !cache.check("bob", "senha123"), "cache s aceita o mesmo par");
+        std::this_thread::sleep_for(std::chrono::milliseconds(80));
+        check(!cache.check("alice", "senha123") && cache.size() == 0, "entrada vence");
+        AuthCache off(0, 1024);
+        off.remember("alice", "senha123");
+        check(!off.enabled() && !off.check("alice", "senha123"), "cache desligado");
+        AuthCache small(60000, 16);
+        for (int i = 0; i < 100; ++i) small.remember("u" + std::to_string(i), "p");
+        check(small.size() <= 16, "cache limitado");
+    }
+
+    // Pool: fila limitada e todos os trabalhos aceitos executados
+    {
+        WorkerPool pool(1, 2);
+        std::atomic<bool> release{false};
+        std::atomic<int> done{0};
+        check(pool.submit([&] { while (!release) std::this_thread::yield(); ++done; }), "primeiro trabalho");
+        while (pool.depth() != 0) std::this_thread::yield();
+        check(pool.submit([&] { ++done; }) && pool.submit([&] { ++done; }), "fila aceita at o limite");
+        check(!pool.submit([&] { ++done; }), "fila cheia recusa");
+        release = true;
+        pool.stop();
+        check(done == 3 && !pool.submit([] {}), "parada executa o que foi aceito");
+    }
+
+    // Custo da verificao e vazo com vrias threads
+    {
+        CredentialStore store;
+        store.add_password("alice", "senha123", iterations);
+        auto t0 = std::chrono::steady_clock::now();
+        bool ok = store.verify("alice", "senha123");
+        double one_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        check(ok, "verificao com o custo pedido");
+
+        const int N = 4 * static_cast<int>(nthreads);
+        std::atomic<int> verified{0};
+        WorkerPool pool(nthreads, N);
+        t0 = std::chrono::steady_clock::now();
+        for (int i = 0; i < N; ++i) pool.submit([&] { verified += store.verify("alice", "senha123"); });
+        pool.stop();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        check(verified == N, "verificaes em paralelo");
+
+        std::cout << "PBKDF2 com " << iterations << " iteraes: " << one_ms << " ms; "
+                  << N / secs << " verificaes/s com " << nthreads << " thread(s)" << std::endl;
+    }
+
+    if (failures) {
+        std::cerr << failures << " verificao(es) falharam" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
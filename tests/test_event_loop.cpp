@@ -0,0 +1,220 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/epoll.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include "../include/reactor.hpp"
+#include "../include/outbound_queue.hpp"
+#include "../include/metrics.hpp"
+
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// Espera cond por at 2 s
+template <typename F>
+static bool wait_for(F cond) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (!cond()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    return true;
+}
+
+static std::string read_some(int fd) {
+    char buf[256];
+    timeval tv{2, 0};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    ssize_t n = recv(fd, buf, sizeof(buf), 0);
+    return n > 0 ? std::string(buf, n) : std::string();
+}
+
+static void test_outbound_queue() {
+    OutboundQueue q(3, OverflowPolicy::DROP_OLDEST);
+    q.push(make_message("aa"));
+    q.push(make_message("bb"));
+    iovec iov[8];
+    check(q.gather(iov, 8) == 2 && q.in_flight(), "gather fixa as mensagens");
+    check(iov[0].iov_len == 2 && std::memcmp(iov[1].iov_base, "bb", 2) == 0, "iovec do comeo da fila");
+
+    q.push(make_message("cc"));
+    q.push(make_message("dd"));  // cheia: sai "cc", no as fixadas
+    check(q.dropped() == 1 && q.depth() == 3, "descarte respeita o envio em andamento");
+    q.push(make_message("ee"));
+    check(q.dropped() == 2 && q.depth() == 3, "descarte segue depois das fixadas");
+
+    q.consume(3);  // "aa" e metade de "bb"
+    check(!q.in_flight() && q.depth() == 2 && q.sent_bytes() == 3, "consume parcial");
+    check(q.writes() == 1 && q.sent_messages() == 1, "escrita parcial conta s a mensagem inteira");
+    check(q.gather(iov, 8) == 2 && iov[0].iov_len == 1 && std::memcmp(iov[0].iov_base, "b", 1) == 0 &&
+          std::memcmp(iov[1].iov_base, "ee", 2) == 0, "continua do meio da mensagem");
+    q.release();
+    check(!q.in_flight() && q.depth() == 2, "release mantm a fila");
+
+    // Fila cheia em regime (cliente lento): cada push descarta a mais antiga
+    // que no est fixada, e o resto continua em ordem FIFO
+    OutboundQueue full(64, OverflowPolicy::DROP_OLDEST);
+    for (int i = 0; i < 10; ++i) full.push(make_message("m" + std::to_string(i) + "\n"));
+    check(full.gather(iov, 2) == 2, "duas mensagens num envio em andamento");
+    for (int i = 10; i < 1000; ++i) full.push(make_message("m" + std::to_string(i) + "\n"));
+    full.release();
+    iovec all[64];
+    size_t n = full.gather(all, 64);
+    std::string order;
+    for (size_t k = 0; k < n; ++k) order.append(static_cast<const char*>(all[k].iov_base), all[k].iov_len);
+    std::string expected = "m0\nm1\n";
+    for (int i = 1000 - 62; i < 1000; ++i) expected += "m" + std::to_string(i) + "\n";
+    check(full.depth() == 64 && full.dropped() == 1000 - 64, "descarte de uma por push");
+    check(order == expected, "fixadas na frente, depois as 62 mais novas em ordem");
+    full.release();
+
+    // Vrias mensagens acumuladas saem num nico sendmsg
+    int sv[2];
+    socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+    OutboundQueue w(16);
+    for (int i = 0; i < 5; ++i) w.push(make_message("m\n"));
+    check(w.flush(sv[0]) && w.empty() && w.writes() == 1 && w.sent_messages() == 5, "fila acumulada numa escrita");
+    check(read_some(sv[1]) == "m\nm\nm\nm\nm\n", "contedo da escrita agrupada");
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void test_loop(IoBackend backend) {
+    EventLoop loop(backend);
+    if (loop.backend() != backend) {
+        std::cout << "io_uring indisponvel (" << loop.backend_error() << "); s epoll testado" << std::endl;
+        return;
+    }
+    const std::string name = io_backend_to_string(backend);
+    const bool uring = backend == IoBackend::URING;
+
+    std::atomic<int> ticks{0};
+    check(loop.add_timer(5, [&] { ++ticks; }), name + ": timer");
+    std::atomic<int> shots{0};
+    int oneshot = loop.add_oneshot_timer([&] { ++shots; });
+    check(oneshot >= 0, name + ": timer de disparo nico");
+
+    int listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    bind(listen_fd, (sockaddr*)&addr, sizeof(addr));
+    listen(listen_fd, 64);
+    getsockname(listen_fd, (sockaddr*)&addr, &len);
+
+    // Eco: cada conexo aceita devolve o que recebe
+    std::atomic<int> accepted{0}, closed{0};
+    std::vector<int> server_fds;
+    if (uring) {
+        check(loop.accept_multishot(listen_fd, [&](int fd) {
+            if (fd < 0) return;
+            ++accepted;
+            server_fds.push_back(fd);
+            loop.recv_multishot(fd, [&, fd](const char* data, ssize_t n) {
+                if (n <= 0) {
+                    ++closed;
+                    loop.remove(fd);
+                    close(fd);
+                    return;
+                }
+                iovec iov{const_cast<char*>(data), static_cast<size_t>(n)};
+                loop.send(fd, &iov, 1, [](ssize_t) {});
+            });
+        }), name + ": accept multishot");
+    } else {
+        iovec iov{nullptr, 0};
+        check(!loop.accept_multishot(listen_fd, [](int) {}) && !loop.recv_multishot(listen_fd, nullptr) &&
+              !loop.send(listen_fd, &iov, 1, nullptr), name + ": operaes por concluso s no io_uring");
+    }
+
+    std::thread thr([&] { loop.run(); });
+
+    std::atomic<bool> posted{false};
+    loop.post([&] { posted = loop.in_loop_thread(); });
+    check(wait_for([&] { return posted.load(); }), name + ": post roda na thread do lao");
+    check(wait_for([&] { return ticks.load() >= 3; }), name + ": timer dispara");
+
+    // Rearmar substitui o prazo: dispara uma vez s, e de novo s se rearmado
+    loop.post([&] {
+        loop.arm_timer(oneshot, 500000);
+        loop.arm_timer(oneshot, 2000);
+    });
+    check(wait_for([&] { return shots.load() == 1; }), name + ": disparo nico no prazo novo");
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    check(shots.load() == 1, name + ": no repete sem rearmar");
+    loop.post([&] { loop.arm_timer(oneshot, 1000); });
+    check(wait_for([&] { return shots.load() == 2; }), name + ": rearmado dispara de novo");
+
+    if (uring) {
+        const int N = 16;
+        std::vector<int> clients;
+        for (int i = 0; i < N; ++i) {
+            int c = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            connect(c, (sockaddr*)&addr, sizeof(addr));
+            clients.push_back(c);
+        }
+        check(wait_for([&] { return accepted.load() == N; }), name + ": conexes aceitas");
+
+        bool echoed = true;
+        for (int c : clients) {
+            send(c, "ping\n", 5, 0);
+            echoed = echoed && read_some(c) == "ping\n";
+        }
+        check(echoed, name + ": recv multishot e send");
+
+        // Envios preparados na mesma volta saem numa nica io_uring_enter()
+        auto& enters = metrics::syscalls(metrics::Syscall::URING_ENTER);
+        std::atomic<bool> sent{false};
+        uint64_t before = 0;
+        loop.post([&] {
+            before = enters.value();
+            static const char msg[] = "lote\n";
+            for (int fd : server_fds) {
+                iovec iov{const_cast<char*>(msg), sizeof(msg) - 1};
+                loop.send(fd, &iov, 1, [](ssize_t) {});
+            }
+            sent = true;
+        });
+        check(wait_for([&] { return sent.load(); }), name + ": lote preparado");
+        bool got = true;
+        for (int c : clients) got = got && read_some(c) == "lote\n";
+        check(got && enters.value() - before <= 3, name + ": envios em lote (" +
+              std::to_string(enters.value() - before) + " io_uring_enter)");
+
+        for (int c : clients) close(c);
+        check(wait_for([&] { return closed.load() == N; }), name + ": EOF chega ao handler");
+    }
+
+    loop.stop();
+    thr.join();
+    close(listen_fd);
+}
+
+
+int main() {
+    test_outbound_queue();
+    test_loop(IoBackend::EPOLL);
+    test_loop(IoBackend::URING);
+
+    if (failures) {
+        std::cerr << failures << " verificao(es) falharam" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <algorithm>
+#include "../include/federation.hpp"
+
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// Espera cond por at 5 s
+template <typename F>
+static bool wait_for(F cond) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (!cond()) {
+        if (std::chrono::steady_clock::now() > deadline) return false;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+    return true;
+}
+
+// Um n de teste: a federao e o que os handlers dela viram
+struct Node {
+    std::mutex mtx;
+    std::vector<std::string> presence;   // "no:usuario:sala"
+    std::vector<std::string> rooms;      // "sala:texto"
+    std::vector<std::string> delivered;  // "no:para:de:texto"
+    std::vector<std::string> lost;       // "no:N"
+    std::unique_ptr<Federation> fed;
+
+    Node(const std::string& name, int port) {
+        FederationOptions opts;
+        opts.node = name;
+        opts.port = port;
+        opts.heartbeat_ms = 50;
+        opts.timeout_ms = 500;
+        opts.retry_ms = 50;
+
+        Federation::Handlers h;
+        h.presence = [this](const std::string& node, const std::string& user, const std::string& room) {
+            std::lock_guard<std::mutex> lg(mtx);
+            presence.push_back(node + ":" + user + ":" + room);
+        };
+        h.room_message = [this](const std::string& room, MessageRef msg) {
+            std::lock_guard<std::mutex> lg(mtx);
+            rooms.push_back(room + ":" + std::string(msg->view()));
+        };
+        h.deliver = [this](const std::string& node, const std::string& to, const std::string& from, MessageRef msg) {
+            std::lock_guard<std::mutex> lg(mtx);
+            delivered.push_back(node + ":" + to + ":" + from + ":" + std::string(msg->view()));
+        };
+        h.node_lost = [this](const std::string& node, const Federation::UserList& users) {
+            std::lock_guard<std::mutex> lg(mtx);
+            lost.push_back(node + ":" + std::to_string(users.size()));
+        };
+        fed = std::make_unique<Federation>(opts, h);
+        fed->start();
+    }
+
+    bool saw(std::vector<std::string> Node::*list, const std::string& what) {
+        std::lock_guard<std::mutex> lg(mtx);
+        auto& v = this->*list;
+        return std::find(v.begin(), v.end(), what) != v.end();
+    }
+
+    size_t count(std::vector<std::string> Node::*list) {
+        std::lock_guard<std::mutex> lg(mtx);
+        return (this->*list).size();
+    }
+};
+
+static void link_all(std::vector<Node*> nodes) {
+    for (Node* a : nodes) {
+        for (Node* b : nodes) {
+            if (a != b) a->fed->add_peer(PeerAddress{"127.0.0.1", b->fed->port()});
+        }
+    }
+}
+
+static bool meshed(std::vector<Node*> nodes) {
+    return std::all_of(nodes.begin(), nodes.end(), [&](Node* n) {
+        return n->fed->stats().peers.load() == nodes.size() - 1 && n->fed->stats().nodes.load() == nodes.size() - 1;
+    });
+}
+
+
+int main() {
+    PeerAddress addr;
+    check(parse_peer_address("7000", addr) && addr.host == "127.0.0.1" && addr.port == 7000, "endereo s com porta");
+    check(parse_peer_address("10.0.0.2:7001", addr) && addr.host == "10.0.0.2" && addr.port == 7001, "HOST:PORTA");
+    check(!parse_peer_address("x:y", addr) && !parse_peer_address("1.2.3.4:0", addr), "endereos invlidos");
+
+    auto a = std::make_unique<Node>("a", 0);
+    auto b = std::make_unique<Node>("b", 0);
+    auto c = std::make_unique<Node>("c", 0);
+    int c_port = c->fed->port();
+    link_all({a.get(), b.get(), c.get()});
+    check(wait_for([&] { return meshed({a.get(), b.get(), c.get()}); }), "trs ns ligados entre si");
+
+    // Presena replicada
+    a->fed->user_joined("alice", "geral");
+    b->fed->user_joined("bob", "x");
+    c->fed->user_joined("carol", "geral");
+    check(wait_for([&] {
+        return b->saw(&Node::presence, "a:alice:geral") && c->saw(&Node::presence, "a:alice:geral") &&
+               a->saw(&Node::presence, "b:bob:x") && c->saw(&Node::presence, "b:bob:x") &&
+               a->saw(&Node::presence, "c:carol:geral");
+    }), "entradas chegam a todos os ns");
+
+    // Mensagem de sala s vai para quem tem membros nela; a ordem  mantida
+    a->fed->room_message("x", make_message("so para b\n"));
+    a->fed->room_message("geral", make_message("para c\n"));
+    check(wait_for([&] { return c->saw(&Node::rooms, "geral:para c\n") && b->saw(&Node::rooms, "x:so para b\n"); }),
+          "mensagens de sala entregues");
+    check(!c->saw(&Node::rooms, "x:so para b\n") && !b->saw(&Node::rooms, "geral:para c\n"),
+          "ns sem membros na sala no recebem");
+
+    // Troca de sala muda o roteamento
+    c->fed->user_joined("carol", "x");
+    check(wait_for([&] { return a->saw(&Node::presence, "c:carol:x"); }), "troca de sala replicada");
+    a->fed->room_message("x", make_message("agora c tambem\n"));
+    check(wait_for([&] { return c->saw(&Node::rooms, "x:agora c tambem\n"); }), "roteamento segue a troca de sala");
+
+    // Muitas mensagens seguidas saem em poucos send()
+    const int N = 2000;
+    uint64_t frames0 = a->fed->stats().frames_out.load();
+    uint64_t batches0 = a->fed->stats().batches_out.load();
+    size_t before = b->count(&Node::rooms);
+    for (int i = 0; i < N; ++i) a->fed->room_message("x", make_message("m" + std::to_string(i) + "\n"));
+    check(wait_for([&] { return b->count(&Node::rooms) == before + N; }), "rajada entregue por inteiro");
+    check(b->saw(&Node::rooms, "x:m" + std::to_string(N - 1) + "\n"), "ltima mensagem da rajada");
+    uint64_t frames = a->fed->stats().frames_out.load() - frames0;
+    uint64_t batches = a->fed->stats().batches_out.load() - batches0;
+    check(batches > 0 && batches * 4 < frames, "frames agrupados em lotes (" + std::to_string(frames) + " frames, " +
+          std::to_string(batches) + " send)");
+    std::cout << N << " mensagens de sala para 2 ns: " << frames << " frames em " << batches << " lote(s)" << std::endl;
+
+    // Mensagem privada roteada para o n do destinatrio
+    a->fed->deliver("b", "bob", "alice", make_message("oi bob\n"));
+    check(wait_for([&] { return b->saw(&Node::delivered, "a:bob:alice:oi bob\n"); }), "mensagem privada no n de destino");
+
+    // Sada replicada
+    b->fed->user_left("bob");
+    check(wait_for([&] { return a->saw(&Node::presence, "b:bob:") && c->saw(&Node::presence, "b:bob:"); }),
+          "sada replicada");
+
+    // Perda de um n: os outros tiram os usurios dele de uma vez
+    c.reset();
+    check(wait_for([&] { return a->saw(&Node::lost, "c:1") && b->saw(&Node::lost, "c:1"); }), "n perdido");
+    check(a->fed->stats().remote_users.load() == 0 && a->fed->stats().nodes.load() == 1, "presena do n perdido removida");
+
+    // O n volta na mesma porta; os links so refeitos e o HELLO dele e o
+    // dos outros ressincronizam a presena
+    c = std::make_unique<Node>("c", c_port);
+    c->fed->add_peer(PeerAddress{"127.0.0.1", a->fed->port()});
+    c->fed->add_peer(PeerAddress{"127.0.0.1", b->fed->port()});
+    c->fed->user_joined("dave", "geral");
+    check(wait_for([&] { return meshed({a.get(), b.get(), c.get()}); }), "n reconectado");
+    check(wait_for([&] { return c->saw(&Node::presence, "a:alice:geral") && a->saw(&Node::presence, "c:dave:geral"); }),
+          "presena ressincronizada");
+    check(a->fed->stats().links_lost.load() >= 2, "quedas contadas");
+
+    // Um link para si mesmo  recusado
+    a->fed->add_peer(PeerAddress{"127.0.0.1", a->fed->port()});
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    check(a->fed->stats().peers.load() == 2, "link para o prprio n ignorado");
+
+    a.reset();
+    b.reset();
+    c.reset();
+
+    if (failures) {
+        std::cerr << failures << " verificao(es) falharam" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,149 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../include/handoff.hpp"
+
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+
+int main(int argc, char** argv) {
+    const int conns = (argc > 1) ? std::stoi(argv[1]) : 600;
+
+    // Codificao: os campos voltam na ordem e um bloco cortado falha
+    {
+        handoff::Writer w;
+        w.u8(7);
+        w.u32(123456);
+        w.u64(1ULL << 40);
+        w.str("sala-1");
+        w.str(std::string("com\0zero", 8));
+        w.str("");
+
+        handoff::Reader r(w.data());
+        uint8_t a = 0;
+        uint32_t b = 0;
+        uint64_t c = 0;
+        std::string s1, s2, s3;
+        check(r.u8(a) && r.u32(b) && r.u64(c) && r.str(s1) && r.str(s2) && r.str(s3), "leitura dos campos");
+        check(a == 7 && b == 123456 && c == (1ULL << 40), "inteiros");
+        check(s1 == "sala-1" && s2 == std::string("com\0zero", 8) && s3.empty(), "strings");
+        check(r.done(), "bloco lido por inteiro");
+
+        handoff::Reader cut(std::string_view(w.data()).substr(0, w.data().size() - 6));
+        check(cut.u8(a) && cut.u32(b) && cut.u64(c) && cut.str(s1), "comeo do bloco cortado");
+        check(!cut.str(s2) && !cut.ok() && !cut.str(s3), "campo depois do fim falha, e os seguintes tambm");
+    }
+
+    // Transporte: mais descritores do que cabem numa mensagem SCM_RIGHTS;
+    // cada par de sockets continua ligado depois de trocar de processo (aqui,
+    // de descritor)
+    {
+        int sv[2];
+        if (socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, sv) < 0) {
+            std::cerr << "socketpair falhou" << std::endl;
+            return 1;
+        }
+
+        std::vector<int> mine, theirs;
+        for (int i = 0; i < conns; ++i) {
+            int p[2];
+            if (socketpair(AF_UNIX, SOCK_STREAM, 0, p) < 0) {
+                std::cerr << "socketpair falhou em " << i << std::endl;
+                return 1;
+            }
+            mine.push_back(p[0]);
+            theirs.push_back(p[1]);
+        }
+        std::string blob(3 * 1024 * 1024, 'x');
+        for (size_t i = 0; i < blob.size(); i += 4096) blob[i] = static_cast<char>('a' + (i / 4096) % 26);
+
+        // O socket Unix no guarda 3 MB: quem envia precisa de outra thread
+        // enquanto este lado recebe
+        bool sent = false;
+        std::thread sender([&] { sent = handoff::send(sv[0], blob, theirs); });
+        std::string got_blob;
+        std::vector<int> got;
+        bool received = handoff::receive(sv[1], got_blob, got, 5000);
+        sender.join();
+        check(sent && received, "envio e recebimento");
+        check(got.size() == theirs.size(), "todos os descritores");
+        check(got_blob == blob, "bloco intacto");
+
+        bool linked = got.size() == theirs.size();
+        bool cloexec = true;
+        for (size_t i = 0; linked && i < got.size(); ++i) {
+            std::string tag = std::to_string(i);
+            linked = write(mine[i], tag.data(), tag.size()) == static_cast<ssize_t>(tag.size());
+            char buf[16];
+            ssize_t n = read(got[i], buf, sizeof(buf));
+            linked = linked && n == static_cast<ssize_t>(tag.size()) && std::string(buf, n) == tag;
+            cloexec = cloexec && (fcntl(got[i], F_GETFD) & FD_CLOEXEC);
+        }
+        check(linked, "cada descritor recebido  a mesma conexo, na mesma ordem");
+        check(cloexec, "descritores recebidos com FD_CLOEXEC");
+
+        check(handoff::notify(sv[1], handoff::ACK) && handoff::wait_step(sv[0], handoff::ACK, 1000), "confirmao");
+        check(handoff::notify(sv[1], handoff::READY) && !handoff::wait_step(sv[0], handoff::ACK, 1000),
+              "passo fora de ordem");
+
+        for (int fd : mine) close(fd);
+        for (int fd : theirs) close(fd);
+        for (int fd : got) close(fd);
+
+        // Sucessor que morreu (socket fechado) e um que no responde no prazo
+        std::string b;
+        std::vector<int> f;
+        check(!handoff::receive(sv[1], b, f, 100) && f.empty(), "prazo esgotado sem dados");
+        close(sv[1]);
+        check(!handoff::wait_step(sv[0], handoff::ACK, 1000), "sem confirmao com o socket fechado");
+        close(sv[0]);
+    }
+
+    // spawn: o filho recebe o socket em ENV_FD e o que chega por ele
+    {
+        int sock = -1;
+        char* args[] = {const_cast<char*>("/bin/sh"), const_cast<char*>("-c"),
+                        const_cast<char*>("printf 'fd=%s' \"$CHAT_HANDOFF_FD\" >&$CHAT_HANDOFF_FD"), nullptr};
+        pid_t pid = handoff::spawn("/bin/sh", args, sock);
+        check(pid > 0 && sock >= 0, "spawn");
+        std::string out;
+        char buf[64];
+        ssize_t n;
+        while (pid > 0 && (n = read(sock, buf, sizeof(buf))) > 0) out.append(buf, n);
+        check(out.rfind("fd=", 0) == 0 && out.size() > 3, "filho escreve no socket herdado");
+        if (sock >= 0) close(sock);
+        if (pid > 0) waitpid(pid, nullptr, 0);
+
+        int bad = -1;
+        char* none[] = {const_cast<char*>("nao-existe"), nullptr};
+        pid_t p2 = handoff::spawn("/caminho/que/nao/existe", none, bad);
+        check(p2 > 0 && !handoff::wait_step(bad, handoff::READY, 2000), "exec que falha fecha o socket");
+        if (bad >= 0) close(bad);
+        int status = 0;
+        if (p2 > 0) waitpid(p2, &status, 0);
+        check(WIFEXITED(status) && WEXITSTATUS(status) == 127, "filho termina com 127");
+    }
+
+    if (failures) {
+        std::cerr << failures << " verificao(es) falharam" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
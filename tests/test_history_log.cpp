@@ -0,0 +1,162 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+#include <cstdlib>
+#include <thread>
+#include <atomic>
+#include "../include/history_log.hpp"
+
+namespace fs = std::filesystem;
+
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static std::string msg_text(uint64_t i) {
+    return "[alice] mensagem " + std::to_string(i) + "\n";
+}
+
+static bool tail_matches(const std::vector<MessageRef>& tail, uint64_t first) {
+    for (size_t k = 0; k < tail.size(); ++k) {
+        if (tail[k]->view() != msg_text(first + k)) return false;
+    }
+    return true;
+}
+
+static HistoryLogOptions options(const std::string& dir, size_t segment_bytes, size_t max_segments) {
+    HistoryLogOptions o;
+    o.dir = dir;
+    o.segment_bytes = segment_bytes;
+    o.max_segments = max_segments;
+    o.fsync = FsyncPolicy::NEVER;
+    return o;
+}
+
+
+int main(int argc, char** argv) {
+    const uint64_t nmsgs = (argc > 1) ? std::stoull(argv[1]) : 20000;
+
+    char tmpl[] = "/tmp/test_history_log.XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        std::cerr << "mkdtemp falhou" << std::endl;
+        return 1;
+    }
+    const std::string dir = tmpl;
+
+    std::vector<MessageRef> kept;
+    {
+        HistoryLog log(options(dir, 4096, 1000));
+        for (uint64_t i = 0; i < 1000; ++i) {
+            auto m = log.append(make_message(msg_text(i)));
+            check(m && m->view() == msg_text(i), "append devolve a mensagem mapeada");
+        }
+        check(log.segment_count() > 1, "log dividido em vrios segmentos");
+        kept = log.tail(10);
+        check(kept.size() == 10 && tail_matches(kept, 990), "tail das ltimas 10");
+    }
+    check(kept.back()->view() == msg_text(999), "mensagem continua vlida aps fechar o log");
+
+    {
+        HistoryLog log(options(dir, 4096, 1000));
+        check(log.next_seq() == 1000, "fim do log recuperado na reabertura");
+        auto all = log.tail(5000);
+        check(all.size() == 1000 && tail_matches(all, 0), "tail atravessa todos os segmentos");
+
+        // Corrompe o ltimo registro como se a escrita tivesse sido cortada
+        auto last = log.append(make_message(msg_text(1000)));
+        const_cast<char*>(last->data())[3] ^= 0x55;
+    }
+
+    {
+        HistoryLog log(options(dir, 4096, 1000));
+        check(log.next_seq() == 1000, "registro rasgado  descartado");
+        log.append(make_message(msg_text(1000)));
+        auto t = log.tail(3);
+        check(t.size() == 3 && tail_matches(t, 998), "append depois do registro rasgado");
+    }
+
+    // Sem os ndices a partida varre os segmentos e chega ao mesmo resultado
+    for (const auto& e : fs::directory_iterator(dir)) {
+        if (e.path().extension() == ".idx") fs::remove(e.path());
+    }
+    {
+        HistoryLog log(options(dir, 4096, 1000));
+        check(log.next_seq() == 1001, "recuperao sem ndice");
+        check(tail_matches(log.tail(50), 951), "tail sem ndice");
+    }
+    fs::remove_all(dir);
+
+    // Reteno: s os segmentos mais recentes ficam em disco
+    fs::create_directory(dir);
+    {
+        HistoryLog log(options(dir, 4096, 3));
+        for (uint64_t i = 0; i < 2000; ++i) log.append(make_message(msg_text(i)));
+        check(log.segment_count() == 3, "segmentos antigos apagados");
+        auto all = log.tail(5000);
+        check(!all.empty() && all.size() == log.next_seq() - log.first_seq() &&
+              tail_matches(all, log.first_seq()), "tail limitado aos segmentos retidos");
+    }
+    fs::remove_all(dir);
+
+    // tail concorrente com appends e com a reteno apagando segmentos: cada
+    // leitura  um trecho contguo do log, e as mensagens lidas continuam
+    // vlidas depois que o segmento sai do disco
+    fs::create_directory(dir);
+    {
+        HistoryLog log(options(dir, 4096, 3));
+        std::atomic<bool> done{false};
+        std::thread writer([&] {
+            for (uint64_t i = 0; i < 20000; ++i) log.append(make_message(msg_text(i)));
+            done.store(true);
+        });
+        long reads = 0, bad = 0;
+        std::vector<MessageRef> held;
+        while (!done.load()) {
+            auto t = log.tail(50);
+            if (t.empty()) continue;
+            uint64_t first = std::stoull(std::string(t.front()->view()).substr(17));
+            if (!tail_matches(t, first)) ++bad;
+            held = std::move(t);
+            ++reads;
+        }
+        writer.join();
+        check(bad == 0, "tail concorrente contguo e em ordem");
+        check(held.empty() || tail_matches(held, std::stoull(std::string(held.front()->view()).substr(17))),
+              "mensagens lidas sobrevivem  reteno");
+        std::cout << reads << " leitura(s) de tail durante os appends" << std::endl;
+    }
+    fs::remove_all(dir);
+
+    // Tempo de partida com um log maior: s o fim  lido
+    fs::create_directory(dir);
+    {
+        HistoryLog log(options(dir, 1 << 20, 1000));
+        for (uint64_t i = 0; i < nmsgs; ++i) log.append(make_message(msg_text(i)));
+    }
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        HistoryLog log(options(dir, 1 << 20, 1000));
+        auto recent = log.tail(100);
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t0).count();
+        check(log.next_seq() == nmsgs && recent.size() == std::min<uint64_t>(100, nmsgs) &&
+              tail_matches(recent, nmsgs - recent.size()), "partida com log maior");
+        std::cout << "Recuperao de " << nmsgs << " mensagens em " << log.segment_count()
+                  << " segmento(s): " << ms << " ms" << std::endl;
+    }
+    fs::remove_all(dir);
+
+    if (failures) {
+        std::cerr << failures << " falha(s)" << std::endl;
+        return 1;
+    }
+    std::cout << "HistoryLog: todos os testes passaram." << std::endl;
+    return 0;
+}
@@ -0,0 +1,68 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include "../include/line_framer.hpp"
+
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static std::vector<std::string> feed_all(LineFramer& f, const std::vector<std::string>& chunks) {
+    std::vector<std::string> lines;
+    for (const auto& c : chunks) {
+        f.feed(c.data(), c.size(), [&lines](std::string_view l) {
+            lines.emplace_back(l);
+            return true;
+        });
+    }
+    return lines;
+}
+
+
+int main() {
+    {
+        LineFramer f;
+        auto lines = feed_all(f, {"um\ndois\r\ntres\n"});
+        check(lines == std::vector<std::string>{"um", "dois", "tres"}, "vrias linhas num segmento");
+    }
+    {
+        LineFramer f;
+        auto lines = feed_all(f, {"ali", "ce\nsen", "ha", "123\n"});
+        check(lines == std::vector<std::string>{"alice", "senha123"}, "linha dividida entre segmentos");
+        check(f.pending() == 0, "nada pendente aps linha completa");
+    }
+    {
+        LineFramer f(8);
+        auto lines = feed_all(f, {"curta\n", "muito longa demais\n", "ok\n"});
+        check(lines == std::vector<std::string>{"curta", "ok"}, "linha longa descartada");
+        check(f.overflowed() == 1, "contador de linhas longas");
+    }
+    {
+        LineFramer f(8);
+        auto lines = feed_all(f, {"abcdef", "ghijkl", "mnop\n", "ok\n"});
+        check(lines == std::vector<std::string>{"ok"}, "linha longa dividida  descartada at o \\n");
+        check(f.overflowed() == 1, "linha longa dividida conta uma vez");
+    }
+    {
+        LineFramer f;
+        int calls = 0;
+        std::string data = "a\nb\nc\n";
+        bool keep = f.feed(data.data(), data.size(), [&calls](std::string_view) {
+            return ++calls < 2;
+        });
+        check(!keep && calls == 2, "on_line false interrompe o processamento");
+    }
+
+    if (failures) {
+        std::cerr << failures << " falha(s)" << std::endl;
+        return 1;
+    }
+    std::cout << "LineFramer: todos os testes passaram." << std::endl;
+    return 0;
+}
@@ -0,0 +1,188 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <filesystem>
+#include <cstdlib>
+#include "../include/mailbox.hpp"
+
+namespace fs = std::filesystem;
+
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static MessageRef pm(int i) {
+    return make_message("[PRIVADO de bob] msg " + std::to_string(i) + "\n");
+}
+
+static std::string expected(int from, int to) {
+    std::string s;
+    for (int i = from; i < to; ++i) s += "[PRIVADO de bob] msg " + std::to_string(i) + "\n";
+    return s;
+}
+
+static size_t files_in(const std::string& dir) {
+    size_t n = 0;
+    for (const auto& e : fs::directory_iterator(dir)) n += e.is_regular_file() ? 1 : 0;
+    return n;
+}
+
+
+int main(int argc, char** argv) {
+    const int nthreads = (argc > 1) ? std::stoi(argv[1]) : 4;
+    const int ops = (argc > 2) ? std::stoi(argv[2]) : 200000;
+
+    // S memria: ordem, limite por usurio e oramento de memria
+    {
+        MailboxOptions opts;
+        opts.max_messages = 5;
+        MailboxStore box(opts);
+        for (int i = 0; i < 5; ++i) check(box.deposit("alice", pm(i)) == MailboxStore::Result::STORED, "depsito");
+        check(box.deposit("alice", pm(5)) == MailboxStore::Result::FULL, "caixa cheia recusa");
+        check(box.pending("alice") == 5 && box.messages() == 5, "contagem");
+
+        std::string out;
+        check(box.take("alice", out) == 5 && out == expected(0, 5), "entrega na ordem, num s buffer");
+        check(box.take("alice", out) == 0 && box.messages() == 0 && box.memory_bytes() == 0, "caixa vazia depois da entrega");
+
+        opts.memory_bytes = 100;
+        MailboxStore small(opts);
+        check(small.deposit("bob", pm(0)) == MailboxStore::Result::STORED, "cabe na memria");
+        check(small.deposit("carol", make_message(std::string(200, 'x'))) == MailboxStore::Result::FULL,
+              "sem diretrio, memria cheia recusa");
+        check(small.stats().refused.load() == 1, "recusa contada");
+    }
+
+    char tmpl[] = "/tmp/test_mailbox.XXXXXX";
+    if (!mkdtemp(tmpl)) {
+        std::cerr << "mkdtemp falhou" << std::endl;
+        return 1;
+    }
+    const std::string dir = tmpl;
+
+    // Transbordo para o disco: o que j estava em memria vai junto e a
+    // entrega l o disco antes da memria
+    {
+        MailboxOptions opts;
+        opts.dir = dir;
+        opts.memory_bytes = 120;  // ~4 mensagens
+        MailboxStore box(opts);
+        for (int i = 0; i < 10; ++i) box.deposit("alice", pm(i));
+        check(box.stats().spilled.load() > 0 && box.memory_bytes() <= 120, "transbordo para o disco");
+        check(files_in(dir) == 1, "um arquivo por caixa");
+
+        std::string out;
+        check(box.take("alice", out) == 10 && out == expected(0, 10), "disco e memria na ordem de chegada");
+        check(files_in(dir) == 0, "arquivo apagado na entrega");
+    }
+
+    // Reincio: o que estava em memria vai para o disco no destrutor e a
+    // prxima execuo encontra as caixas; registro rasgado no fim  ignorado
+    {
+        MailboxOptions opts;
+        opts.dir = dir;
+        {
+            MailboxStore box(opts);
+            for (int i = 0; i < 3; ++i) box.deposit("joo/x", pm(i));
+            box.deposit("bob", pm(7));
+        }
+        check(files_in(dir) == 2, "caixas gravadas ao encerrar");
+        for (const auto& e : fs::directory_iterator(dir)) {
+            if (e.path().filename().string().rfind("jo", 0) == 0) {
+                std::ofstream(e.path(), std::ios::app | std::ios::binary) << std::string("\x40\0\0\0abc", 7);
+            }
+        }
+
+        MailboxStore box(opts);
+        check(box.messages() == 4 && box.pending("joo/x") == 3, "caixas recuperadas do disco");
+        box.deposit("joo/x", pm(3));
+        std::string out;
+        check(box.take("joo/x", out) == 4 && out == expected(0, 4), "recuperadas + novas, na ordem");
+        out.clear();
+        check(box.take("bob", out) == 1 && out == expected(7, 8), "outra caixa intacta");
+    }
+    // Transbordos e entregas concorrentes na mesma faixa, com o arquivo
+    // lido e gravado fora do lock: nada se perde e cada remetente chega na
+    // ordem em que depositou
+    {
+        MailboxOptions opts;
+        opts.dir = dir;
+        opts.memory_bytes = 200;
+        opts.max_messages = 1000000;
+        MailboxStore box(opts);
+        const int senders = 3, per_sender = 3000;
+        std::vector<std::thread> threads;
+        for (int k = 0; k < senders; ++k) {
+            threads.emplace_back([&box, k] {
+                for (int i = 0; i < per_sender; ++i) {
+                    box.deposit("carol", make_message(std::to_string(k) + " " + std::to_string(i) + "\n"));
+                }
+            });
+        }
+        std::string got;
+        size_t taken = 0;
+        for (int r = 0; r < 200; ++r) taken += box.take("carol", got);
+        for (auto& th : threads) th.join();
+        taken += box.take("carol", got);
+
+        std::vector<int> last(senders, -1);
+        bool ordered = true;
+        size_t lines = 0;
+        for (size_t pos = 0, nl; (nl = got.find('\n', pos)) != std::string::npos; pos = nl + 1, ++lines) {
+            int k = std::stoi(got.substr(pos)), i = std::stoi(got.substr(got.find(' ', pos) + 1));
+            if (i <= last[k]) ordered = false;
+            last[k] = i;
+        }
+        check(taken == senders * per_sender && lines == taken && box.messages() == 0,
+              "transbordo concorrente sem perda");
+        check(ordered, "transbordo concorrente na ordem de cada remetente");
+        check(box.stats().spilled.load() > 0 && files_in(dir) == 0, "transbordo concorrente passou pelo disco");
+    }
+    fs::remove_all(dir);
+
+    // Vazo: cada thread guarda e entrega para os seus usurios; faixas
+    // diferentes no disputam lock
+    for (int t : {1, nthreads}) {
+        MailboxOptions opts;
+        MailboxStore box(opts);
+        MessageRef msg = pm(0);
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int k = 0; k < t; ++k) {
+            threads.emplace_back([&, k] {
+                std::vector<std::string> users;
+                for (int u = 0; u < 64; ++u) users.push_back("u" + std::to_string(k) + "_" + std::to_string(u));
+                std::string out;
+                for (int i = 0; i < ops; ++i) {
+                    const std::string& u = users[i % users.size()];
+                    box.deposit(u, msg);
+                    if ((i / users.size()) % 4 == 3) {  // cada caixa: 4 depsitos, 1 entrega
+                        out.clear();
+                        box.take(u, out);
+                    }
+                }
+            });
+        }
+        for (auto& th : threads) th.join();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        check(box.stats().stored.load() == static_cast<uint64_t>(t) * ops, "todos os depsitos guardados");
+        check(box.messages() + box.stats().delivered.load() == box.stats().stored.load(), "nada perdido");
+        std::cout << t << " thread(s): " << (t * ops) / secs / 1e6 << " M depsitos/s" << std::endl;
+    }
+
+    if (failures) {
+        std::cerr << failures << " verificao(es) falharam" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,175 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "../include/metrics.hpp"
+
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+// UTF-8 estrito: sequncias mnimas, sem substitutos, at U+10FFFF
+static bool valid_utf8(const std::string& s) {
+    for (size_t i = 0; i < s.size();) {
+        unsigned char c = static_cast<unsigned char>(s[i]);
+        if (c < 0x80) {
+            ++i;
+            continue;
+        }
+        size_t n = (c >= 0xc2 && c <= 0xdf) ? 1 : (c >= 0xe0 && c <= 0xef) ? 2 : (c >= 0xf0 && c <= 0xf4) ? 3 : 0;
+        if (n == 0 || s.size() - i <= n) return false;
+        uint32_t cp = c & (0x3f >> n);
+        for (size_t k = 1; k <= n; ++k) {
+            unsigned char cc = static_cast<unsigned char>(s[i + k]);
+            if ((cc & 0xc0) != 0x80) return false;
+            cp = (cp << 6) | (cc & 0x3f);
+        }
+        if ((n == 2 && (cp < 0x800 || (cp >= 0xd800 && cp <= 0xdfff))) || (n == 3 && (cp < 0x10000 || cp > 0x10ffff))) {
+            return false;
+        }
+        i += n + 1;
+    }
+    return true;
+}
+
+static size_t count_of(const std::string& s, const std::string& needle) {
+    size_t n = 0;
+    for (size_t p = s.find(needle); p != std::string::npos; p = s.find(needle, p + 1)) ++n;
+    return n;
+}
+
+// Faz uma requisio HTTP pelo socket Unix e devolve a resposta inteira
+static std::string scrape(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    std::strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+    if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return "";
+    }
+    const char req[] = "GET /metrics HTTP/1.0\r\n\r\n";
+    send(fd, req, sizeof(req) - 1, 0);
+    std::string out;
+    char buf[4096];
+    ssize_t n;
+    while ((n = recv(fd, buf, sizeof(buf), 0)) > 0) out.append(buf, static_cast<size_t>(n));
+    close(fd);
+    return out;
+}
+
+
+int main(int argc, char** argv) {
+    const int nthreads = (argc > 1) ? std::stoi(argv[1]) : 8;
+    const long per_thread = (argc > 2) ? std::stol(argv[2]) : 200000;
+
+    MetricsRegistry reg;
+    Counter& c = reg.counter("test_events_total", "Eventos");
+    Gauge& g = reg.gauge("test_open", "Abertos");
+    LatencyHistogram& fast = reg.histogram("test_stage_seconds", "Estgios", "stage=\"a\"");
+    LatencyHistogram& slow = reg.histogram("test_stage_seconds", "Estgios", "stage=\"b\"");
+    reg.gauge_fn("test_fn", "Calculado", [] { return int64_t(42); });
+    reg.counter_fn("test_ext_total", "Contador externo", [] { return uint64_t(7); });
+
+    std::mutex mtx;
+    LockStats lock{reg.histogram("test_lock_wait_seconds", "Espera"),
+                   reg.histogram("test_lock_hold_seconds", "Posse")};
+    long shared = 0;
+
+    // Atualizaes concorrentes: nenhuma pode se perder
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (int t = 0; t < nthreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (long i = 0; i < per_thread; ++i) {
+                c.inc();
+                g.add(1);
+                fast.record(static_cast<uint64_t>(1000 + (i % 1000)));
+                if (i % 2 == 1) g.sub(1);
+            }
+            slow.record(2000000000ull + t);
+            for (int i = 0; i < 1000; ++i) {
+                TimedLockGuard<std::mutex> lg(mtx, lock);
+                ++shared;
+            }
+        });
+    }
+    for (auto& th : threads) th.join();
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+
+    const uint64_t total = static_cast<uint64_t>(nthreads) * per_thread;
+    check(c.value() == total, "contador soma as clulas de todas as threads");
+    check(g.value() == static_cast<int64_t>(nthreads) * (per_thread - per_thread / 2), "medidor sobe e desce");
+    check(shared == nthreads * 1000L, "TimedLockGuard exclui de fato");
+
+    Histogram h;
+    fast.snapshot(h);
+    check(h.count() == total, "histograma por clula soma todas as amostras");
+    check(h.percentile(0.5) >= 1450 && h.percentile(0.5) <= 1550, "p50 dentro do erro da faixa");
+    check(h.max() == 1999, "mximo exato");
+
+    Histogram lh;
+    lock.hold.snapshot(lh);
+    check(lh.count() == static_cast<uint64_t>(nthreads) * 1000, "tempo de posse registrado por aquisio");
+
+    // HELP escrito nos fontes em Latin-1 (bytes escapados para no depender
+    // da codificao deste arquivo) sai em UTF-8; o que j  UTF-8 fica igual
+    reg.counter("test_latin1_total", "Conex\xf5" "es aceitas");
+    reg.counter("test_utf8_total", "Conex\xc3\xb5" "es recusadas");
+    reg.counter("test_escape_total", "barra \\ e\nquebra");
+
+    // Exposio: uma linha HELP/TYPE por famlia, buckets cumulativos
+    std::string text = reg.render_prometheus();
+    check(valid_utf8(text), "exposio em UTF-8 vlido");
+    check(text.find("# HELP test_latin1_total Conex\xc3\xb5" "es aceitas\n") != std::string::npos, "HELP Latin-1 convertido");
+    check(text.find("# HELP test_utf8_total Conex\xc3\xb5" "es recusadas\n") != std::string::npos, "HELP UTF-8 mantido");
+    check(text.find("# HELP test_escape_total barra \\\\ e\\nquebra\n") != std::string::npos, "HELP com escapes");
+    check(count_of(text, "# TYPE test_stage_seconds histogram") == 1, "famlia de histogramas declarada uma vez");
+    check(text.find("test_events_total " + std::to_string(total) + "\n") != std::string::npos, "valor do contador");
+    check(text.find("test_fn 42\n") != std::string::npos, "medidor calculado");
+    check(text.find("# TYPE test_ext_total counter\ntest_ext_total 7\n") != std::string::npos, "contador externo");
+    check(text.find("test_stage_seconds_bucket{stage=\"a\",le=\"2.5e-06\"} " + std::to_string(total)) != std::string::npos,
+          "todas as amostras de 1-2 us at 2,5 us");
+    check(text.find("test_stage_seconds_bucket{stage=\"a\",le=\"1e-06\"} 0") != std::string::npos,
+          "nenhuma amostra abaixo de 1 us");
+    check(text.find("test_stage_seconds_bucket{stage=\"b\",le=\"1\"} 0") != std::string::npos &&
+          text.find("test_stage_seconds_bucket{stage=\"b\",le=\"2.5\"} " + std::to_string(nthreads)) != std::string::npos,
+          "amostras de 2 s caem entre 1 e 2,5 s");
+    check(text.find("test_stage_seconds_count{stage=\"b\"} " + std::to_string(nthreads)) != std::string::npos,
+          "_count por srie");
+
+    std::string summary = reg.render_text();
+    check(summary.find("test_stage_seconds{stage=\"a\"}: " + std::to_string(total) + " amostra(s)") != std::string::npos,
+          "resumo legvel");
+
+    // Endpoint pelo socket Unix
+    {
+        std::string path = "/tmp/test_metrics_" + std::to_string(getpid()) + ".sock";
+        MetricsServer srv(reg, 0, path);
+        std::string resp = scrape(path);
+        check(resp.rfind("HTTP/1.0 200 OK", 0) == 0, "endpoint responde 200");
+        check(resp.find("test_fn 42\n") != std::string::npos, "endpoint devolve as mtricas");
+    }
+
+    std::cout << total << " atualizaes de contador+medidor+histograma em " << secs << " s ("
+              << secs * 1e9 / total << " ns cada, " << nthreads << " threads)" << std::endl;
+
+    if (failures) {
+        std::cerr << failures << " verificao(es) falharam" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,126 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include "../include/presence.hpp"
+
+
+struct ClientInfo {
+    int id;
+};
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static std::string name_of(int i) {
+    char buf[16];
+    std::snprintf(buf, sizeof(buf), "u%05d", i);
+    return buf;
+}
+
+
+int main(int argc, char** argv) {
+    const int nreaders = (argc > 1) ? std::stoi(argv[1]) : 4;
+    const int nusers = (argc > 2) ? std::stoi(argv[2]) : 10000;
+
+    {
+        PresenceRegistry p(100);
+        auto a = std::make_shared<ClientInfo>(ClientInfo{1});
+        auto b = std::make_shared<ClientInfo>(ClientInfo{2});
+        check(p.add("alice", a), "entrada");
+        check(!p.add("alice", b), "nome j online  recusado");
+        check(p.find("alice") == a && !p.find("bob"), "busca por nome");
+        check(!p.remove("alice", b.get()), "remoo s pela prpria conexo");
+        uint64_t v = p.version();
+        check(p.remove("alice", a.get()) && p.version() != v && p.size() == 0, "remoo muda a verso");
+    }
+
+    {
+        PresenceRegistry p(100);
+        std::vector<std::shared_ptr<ClientInfo>> members;
+        for (int i = 249; i >= 0; --i) {
+            members.push_back(std::make_shared<ClientInfo>(ClientInfo{i}));
+            p.add(name_of(i), members.back());
+        }
+        auto p1 = p.page(1);
+        check(p1 && p1 == p.page(1), "pgina da mesma verso vem do cache");
+        check(p1 && p1->view().find("(250), pgina 1/3: u00000, u00001,") != std::string_view::npos,
+              "pgina ordenada com total e contagem de pginas");
+        check(p.page(3) && p.page(3)->view().find("u00249\n") != std::string_view::npos, "ltima pgina");
+        check(!p.page(4) && !p.page(0), "pgina fora do intervalo");
+
+        auto s = p.search("u0012", 1);
+        check(s && s->view().find("prefixo 'u0012' (10): u00120,") != std::string_view::npos,
+              "busca por prefixo");
+        check(!p.search("x", 2), "prefixo sem resultados tem s uma pgina");
+
+        p.add("u99999", std::make_shared<ClientInfo>(ClientInfo{-1}));
+        check(p.page(1) != p1, "nova verso invalida o cache");
+        check(p1->view().find("(250)") != std::string_view::npos, "pgina antiga continua vlida para quem a tem");
+    }
+
+    // Leitores sem lock enquanto escritores entram e saem
+    {
+        PresenceRegistry p(100);
+        std::vector<std::shared_ptr<ClientInfo>> members;
+        for (int i = 0; i < nusers; ++i) members.push_back(std::make_shared<ClientInfo>(ClientInfo{i}));
+        for (int i = 0; i < nusers; i += 2) p.add(name_of(i), members[i]);
+
+        std::atomic<bool> stop{false};
+        std::atomic<bool> bad{false};
+        std::atomic<uint64_t> lookups{0};
+        std::vector<std::thread> readers;
+        for (int r = 0; r < nreaders; ++r) {
+            readers.emplace_back([&, r] {
+                uint64_t n = 0;
+                for (int i = r; !stop.load(std::memory_order_relaxed); i = (i + 7) % nusers, ++n) {
+                    auto m = p.find(name_of(i));
+                    if (m && m->id != i) bad = true;
+                    // Os pares nunca saem
+                    if (i % 2 == 0 && !m) bad = true;
+                    if (n % 1024 == 0 && !p.page(1)) bad = true;
+                }
+                lookups += n;
+            });
+        }
+
+        auto t0 = std::chrono::steady_clock::now();
+        for (int round = 0; round < 3; ++round) {
+            for (int i = 1; i < nusers; i += 2) p.add(name_of(i), members[i]);
+            for (int i = 1; i < nusers; i += 2) p.remove(name_of(i), members[i].get());
+        }
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        stop = true;
+        for (auto& t : readers) t.join();
+
+        check(!bad, "leitores sempre veem um retrato consistente");
+        check(p.size() == static_cast<size_t>((nusers + 1) / 2), "tamanho final");
+        rcu::reclaim();
+        check(rcu::pending() == 0, "tabelas antigas liberadas sem leitores ativos");
+
+        auto t1 = std::chrono::steady_clock::now();
+        const int N = 1000000;
+        int found = 0;
+        for (int i = 0; i < N; ++i) found += p.find(name_of((i * 2) % nusers)) != nullptr;
+        double find_ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t1).count() / N;
+        check(found == N, "buscas sem concorrncia");
+
+        std::cout << 3 * nusers << " entradas/sadas em " << secs << " s com " << nreaders
+                  << " leitor(es) (" << lookups.load() << " buscas); busca: " << find_ns << " ns" << std::endl;
+    }
+
+    if (failures) {
+        std::cerr << failures << " verificao(es) falharam" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
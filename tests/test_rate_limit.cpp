@@ -0,0 +1,120 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include "../include/rate_limit.hpp"
+
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+constexpr uint64_t SEC = 1000000000ULL;
+
+
+int main(int argc, char** argv) {
+    const int nthreads = (argc > 1) ? std::stoi(argv[1]) : 4;
+    const int ops = (argc > 2) ? std::stoi(argv[2]) : 1000000;
+
+    // Formato das opes
+    {
+        BucketLimit l;
+        check(parse_rate_limit("20", l) && l.rate == 20 && l.burst == 20, "taxa sem rajada");
+        check(parse_rate_limit("0.5", l) && l.rate == 0.5 && l.burst == 1, "rajada mnima de 1");
+        check(parse_rate_limit("5:40", l) && l.rate == 5 && l.burst == 40, "taxa e rajada");
+        check(parse_rate_limit("0", l) && !l.enabled(), "0 desliga");
+        check(!parse_rate_limit("", l) && !parse_rate_limit("x", l) && !parse_rate_limit("5:", l) &&
+              !parse_rate_limit("-1", l) && !parse_rate_limit("5:0", l) && !parse_rate_limit("5x", l),
+              "valores invlidos");
+    }
+
+    // Um balde: rajada inicial, recusa, reabastecimento pelo tempo decorrido
+    {
+        RateLimiter rl(BucketLimit{10, 5});
+        uint64_t k = RateLimiter::key_of("alice");
+        uint64_t t = 100 * SEC;
+        int passed = 0;
+        for (int i = 0; i < 8; ++i) passed += rl.take(k, t) == RateVerdict::ALLOW;
+        check(passed == 5, "rajada de 5");
+        check(rl.take(k, t + SEC / 20) == RateVerdict::DENY_FIRST, "meia ficha ainda no basta");
+        check(rl.take(k, t + SEC / 10) == RateVerdict::ALLOW, "uma ficha depois de 100 ms");
+        check(rl.take(k, t + SEC / 10) == RateVerdict::DENY_FIRST, "e s uma");
+        passed = 0;
+        for (int i = 0; i < 8; ++i) passed += rl.take(k, t + 60 * SEC) == RateVerdict::ALLOW;
+        check(passed == 5, "parado muito tempo volta s at a rajada");
+        check(rl.take(RateLimiter::key_of("bob"), t) == RateVerdict::ALLOW, "chaves independentes");
+        check(rl.take(k, t) == RateVerdict::DENY_FIRST, "relgio para trs no reabastece");
+    }
+
+    // Dois baldes: a recusa do segundo no gasta o primeiro; custo acima da
+    // rajada passa com o balde cheio
+    {
+        RateLimiter rl(BucketLimit{100, 100}, BucketLimit{1000, 1000});
+        uint64_t k = RateLimiter::key_of("carol");
+        uint64_t t = SEC;
+        check(rl.take(k, t, 1, 900) == RateVerdict::ALLOW, "cabe nos dois");
+        check(rl.take(k, t, 1, 200) == RateVerdict::DENY_SECOND, "bytes acabaram");
+        check(rl.take(k, t, 1, 100) == RateVerdict::ALLOW, "o que sobrou ainda passa");
+        check(rl.take(k, t + 2 * SEC, 1, 5000) == RateVerdict::ALLOW, "linha maior que a rajada, balde cheio");
+        check(rl.take(k, t + 2 * SEC, 1, 1) == RateVerdict::DENY_SECOND, "e esvazia o balde");
+
+        RateLimiter off{BucketLimit{}};
+        check(!off.enabled() && off.take(k, t, 1e9) == RateVerdict::ALLOW && off.size() == 0, "desligado no guarda nada");
+    }
+
+    // Tabela cheia: entradas que j encheriam de novo so reaproveitadas sem
+    // contar como descarte; s chaves ainda em uso contam
+    {
+        RateLimiter rl(BucketLimit{1, 2}, BucketLimit{}, 1);
+        size_t cap = rl.capacity();
+        check(cap == RateLimiter::STRIPES * RateLimiter::PROBE, "capacidade mnima");
+        uint64_t t = SEC;
+        for (uint32_t i = 0; i < 4 * cap; ++i) rl.take(RateLimiter::key_of(i), t);
+        check(rl.size() == cap && rl.evictions() == 3 * cap, "chaves em uso descartadas quando no h espao");
+
+        uint64_t before = rl.evictions();
+        for (uint32_t i = 0; i < 4 * cap; ++i) rl.take(RateLimiter::key_of(i + 100000), t + 10 * SEC);
+        check(rl.evictions() == before + 3 * cap, "entradas cheias de novo reaproveitadas sem descarte");
+    }
+
+    // Vazo com vrias threads, cada uma com seu conjunto de usurios
+    {
+        // Rajadas enormes e reabastecimento lento: nada fica parado (cheio), ento
+        // cada usurio mantm a sua entrada
+        RateLimiter rl(BucketLimit{1, 1e12}, BucketLimit{1, 1e15});
+        std::atomic<uint64_t> allowed{0};
+        auto t0 = std::chrono::steady_clock::now();
+        std::vector<std::thread> threads;
+        for (int th = 0; th < nthreads; ++th) {
+            threads.emplace_back([&, th] {
+                std::vector<uint64_t> keys;
+                for (int u = 0; u < 1000; ++u) keys.push_back(RateLimiter::key_of("user" + std::to_string(th * 1000 + u)));
+                uint64_t ok = 0;
+                for (int i = 0; i < ops; ++i) {
+                    ok += rl.take(keys[i % keys.size()], SEC + i, 1, 128) == RateVerdict::ALLOW;
+                }
+                allowed += ok;
+            });
+        }
+        for (auto& t : threads) t.join();
+        double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+        check(allowed == static_cast<uint64_t>(nthreads) * ops, "tudo dentro do limite passa");
+        check(rl.size() == static_cast<size_t>(nthreads) * 1000 && rl.evictions() == 0, "uma entrada por usurio");
+        std::cout << nthreads << " thread(s): " << (nthreads * ops / secs / 1e6) << " M consultas/s ("
+                  << (secs * 1e9 / ops) << " ns cada)" << std::endl;
+    }
+
+    if (failures) {
+        std::cerr << failures << " verificao(es) falharam" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,223 @@
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <sys/socket.h>
+#include <unistd.h>
+#include "../include/slab.hpp"
+#include "../include/ring_buffer.hpp"
+#include "../include/message.hpp"
+#include "../include/line_framer.hpp"
+#include "../include/word_filter.hpp"
+#include "../include/chatroom.hpp"
+#include "../include/outbound_queue.hpp"
+#include "../include/reactor.hpp"
+#include "../include/metrics.hpp"
+#include "../include/tslog.hpp"
+
+using namespace tslog;
+
+
+// Contador de alocaes: s conta nas threads que ligaram counting (a do
+// teste e a do lao), para que a thread de escrita do logger no entre
+static std::atomic<uint64_t> allocations{0};
+static thread_local bool counting = false;
+
+void* operator new(size_t n) {
+    if (counting) allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(n ? n : 1)) return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+
+// Na sala, cada membro  uma conexo com sua fila de sada e um socketpair
+// no lugar do cliente
+struct ClientInfo {
+    int fd = -1;
+    int peer = -1;
+    OutboundQueue outq{1024};
+};
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static void test_slab() {
+    void* a = slab::allocate(100);
+    std::memset(a, 1, 100);
+    slab::deallocate(a, 100);
+    void* b = slab::allocate(120);  // mesma classe (128): o bloco volta
+    check(a == b, "bloco liberado  reaproveitado");
+    slab::deallocate(b, 120);
+
+    void* big = slab::allocate(slab::MAX_BLOCK + 1);
+    std::memset(big, 2, slab::MAX_BLOCK + 1);
+    slab::deallocate(big, slab::MAX_BLOCK + 1);
+
+    // Uma thread aloca e outra s libera: o excesso volta pela lista global
+    // e a memria reservada no cresce sem limite
+    const int N = 20000;
+    std::vector<void*> blocks(N);
+    size_t reserved = 0;
+    for (int round = 0; round < 5; ++round) {
+        for (auto& p : blocks) p = slab::allocate(256);
+        std::thread t([&] {
+            for (auto p : blocks) slab::deallocate(p, 256);
+        });
+        t.join();
+        if (round == 1) reserved = slab::reserved_bytes();
+    }
+    check(slab::reserved_bytes() == reserved, "blocos liberados por outra thread voltam a ser usados");
+}
+
+static void test_ring() {
+    RingBuffer<int> r;
+    for (int i = 0; i < 5; ++i) r.push_back(i);
+    r.pop_front();
+    r.pop_front();
+    for (int i = 5; i < 12; ++i) r.push_back(i);  // d a volta e cresce
+    check(r.size() == 10 && r.front() == 2 && r[9] == 11, "ordem mantida ao crescer");
+    r.erase(3);  // sai o 5
+    check(r.size() == 9 && r[2] == 4 && r[3] == 6 && r[8] == 11, "erase no meio");
+    r.erase(0);  // sai o 2
+    r.erase(7);  // sai o 11, o ltimo
+    check(r.size() == 7 && r.front() == 3 && r[1] == 4 && r[2] == 6 && r[6] == 10, "erase nas pontas");
+    r.push_back(12);
+    check(r.size() == 8 && r[7] == 12, "push depois de erase");
+    size_t cap = r.capacity();
+    for (int i = 0; i < 1000; ++i) {
+        r.push_back(i);
+        r.pop_front();
+    }
+    check(r.capacity() == cap, "capacidade estvel em regime");
+}
+
+
+int main() {
+    test_slab();
+    test_ring();
+
+    Logger::instance().init("/dev/null", Level::INFO);
+
+    // Caminho de uma mensagem de chat, como no servidor: framer, filtro,
+    // montagem, log, snapshot da sala, fila de sada e sendmsg de cada
+    // membro deste shard, post para o shard de outros membros, histrico
+    // e mtricas
+    LineFramer framer(4096);
+    WordFilter filter({"spam", "palavrao"});
+    ChatRoom room("geral", 2, 50);
+    LatencyHistogram fanout;
+
+    EventLoop other;
+    std::thread other_thr([&] { other.run(); });
+    other.post([] { counting = true; });
+
+    std::vector<std::shared_ptr<ClientInfo>> members;
+    for (int i = 0; i < 8; ++i) {
+        auto c = std::make_shared<ClientInfo>();
+        int sv[2];
+        socketpair(AF_UNIX, SOCK_STREAM, 0, sv);
+        c->fd = sv[0];
+        c->peer = sv[1];
+        room.join(c, i % 2);
+        members.push_back(c);
+    }
+
+    std::atomic<uint64_t> remote_done{0};
+    ChatRoom::Snapshot snap;
+    const char* const user = "alice";
+    char chunk[256];
+    char drain[65536];
+
+    auto handle = [&](int i) {
+        int len = std::snprintf(chunk, sizeof(chunk), "mensagem numero %d para a sala\n", i);
+        framer.feed(chunk, static_cast<size_t>(len), [&](std::string_view line) {
+            uint64_t t0 = metrics::now_ns();
+            if (filter.matches(line)) return true;
+            MessageRef msg = make_message({"[", user, "] ", line, "\n"});
+            Logger::instance().log(Level::INFO, "Mensagem: ", msg, msg->view());
+
+            room.snapshot(snap);
+            for (auto& list : snap) {
+                if (!list) continue;
+                if (list == snap[0]) {
+                    for (auto& c : *list) {
+                        c->outq.push(msg);
+                        c->outq.flush(c->fd);
+                    }
+                } else {
+                    other.post_pooled([list, msg, &remote_done] {
+                        for (auto& c : *list) {
+                            c->outq.push(msg);
+                            c->outq.flush(c->fd);
+                        }
+                        remote_done.fetch_add(1, std::memory_order_release);
+                    });
+                }
+            }
+            snap.clear();
+            room.history().add(std::move(msg));
+            fanout.record_since(t0);
+            return true;
+        });
+        for (auto& c : members) {
+            while (recv(c->peer, drain, sizeof(drain), MSG_DONTWAIT) > 0) {}
+        }
+    };
+
+    // Aquecimento: listas do slab, capacidade das filas, clulas das mtricas
+    counting = true;
+    const int WARMUP = 2000, N = 20000;
+    for (int i = 0; i < WARMUP; ++i) handle(i);
+    while (remote_done.load(std::memory_order_acquire) < WARMUP) std::this_thread::yield();
+
+    uint64_t before = allocations.load();
+    for (int i = WARMUP; i < WARMUP + N; ++i) {
+        handle(i);
+        // Sem esperar o outro lao, as tarefas dele se acumulariam sem limite
+        while (remote_done.load(std::memory_order_acquire) < static_cast<uint64_t>(i + 1)) std::this_thread::yield();
+    }
+    uint64_t hot = allocations.load() - before;
+    counting = false;
+    check(hot == 0, "caminho da mensagem sem alocaes (" + std::to_string(hot) + " em " + std::to_string(N) + ")");
+    std::cout << N << " mensagens para " << members.size() << " membros em 2 shards: " << hot
+              << " alocao(es) no alocador global" << std::endl;
+
+    // Para comparao: como as mensagens eram montadas antes
+    counting = true;
+    before = allocations.load();
+    for (int i = 0; i < 1000; ++i) {
+        std::string bytes = "[alice] mensagem numero qualquer para a sala\n";
+        auto old = std::make_shared<const MessageBuffer>(std::move(bytes));
+    }
+    uint64_t old_allocs = allocations.load() - before;
+    counting = false;
+    std::cout << "std::string + make_shared: " << old_allocs / 1000.0 << " alocao(es) por mensagem" << std::endl;
+
+    other.stop();
+    other_thr.join();
+    for (auto& c : members) {
+        close(c->fd);
+        close(c->peer);
+    }
+    Logger::instance().shutdown();
+
+    if (failures) {
+        std::cerr << failures << " verificao(es) falharam" << std::endl;
+        return 1;
+    }
+    std::cout << "OK" << std::endl;
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <unistd.h>
+#include "../include/tslog.hpp"
+
+
+using namespace tslog;
+
+static int failures = 0;
+
+static void check(bool cond, const std::string& what) {
+    if (!cond) {
+        std::cerr << "FALHOU: " << what << std::endl;
+        ++failures;
+    }
+}
+
+static std::string read_file(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+static const Format FMT_TIPOS("str={} int={} neg={} u={} d={} c={} b={}");
+
+
+int main() {
+    const std::string text_path = "/tmp/test_tslog_texto." + std::to_string(getpid()) + ".log";
+    const std::string bin_path = "/tmp/test_tslog_binario." + std::to_string(getpid()) + ".tslog";
+    const std::string user = "alice";
+
+    // Modo texto: a thread de escrita formata os argumentos
+    Logger::instance().init(text_path, Level::DEBUG);
+    Logger::instance().logf(Level::INFO, FMT_TIPOS, user, 42, -7, 18446744073709551615ull, 2.5, 'x', true);
+    Logger::instance().logf(Level::INFO, FMT_TIPOS, "curto");
+    Logger::instance().shutdown();
+
+    std::string text = read_file(text_path);
+    check(text.find("str=alice int=42 neg=-7 u=18446744073709551615 d=2.5 c=x b=true\n") != std::string::npos,
+          "formatao no modo texto");
+    check(text.find("str=curto int={} neg={}") != std::string::npos, "argumentos faltando ficam como {}");
+
+    // Modo binrio: s o id do formato e os argumentos crus vo para o arquivo
+    Options opts;
+    opts.binary = true;
+    Logger::instance().init(bin_path, Level::INFO, opts);
+    Logger::instance().logf(Level::INFO, FMT_TIPOS, user, 1, 2, 3u, 4.0, 'y', false);
+    Logger::instance().logf(Level::INFO, FMT_TIPOS, user, 5, 6, 7u, 8.0, 'z', true);
+    Logger::instance().info("texto puro");
+
+    // Abaixo do nvel mnimo: nada  codificado
+    const int N = 10000000;
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < N; ++i) {
+        Logger::instance().logf(Level::DEBUG, FMT_TIPOS, user, i, -i, 0u, 0.0, 'c', false);
+    }
+    double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - t0).count() / N;
+    Logger::instance().shutdown();
+
+    std::string bin = read_file(bin_path);
+    check(bin.size() > 13 && bin[0] == 'S' && bin.compare(1, 8, BINARY_MAGIC, 8) == 0, "sesso no incio do arquivo");
+    size_t first = bin.find(FMT_TIPOS.text());
+    check(first != std::string::npos && bin.find(FMT_TIPOS.text(), first + 1) == std::string::npos,
+          "formato gravado uma nica vez");
+    check(bin.find("str=alice") == std::string::npos, "nada formatado no modo binrio");
+    check(bin.find("texto puro") != std::string::npos, "texto puro preservado");
+    check(bin.size() < 400, "chamadas abaixo do nvel no geram registros");
+
+    std::remove(text_path.c_str());
+    std::remove(bin_path.c_str());
+
+    std::cout << "Chamada abaixo do nvel mnimo: " << ns << " ns" << std::endl;
+    if (failures) {
+        std::cerr << failures << " falha(s)" << std::endl;
+        return 1;
+    }
+    std::cout << "tslog binrio: todos os testes passaram." << std::endl;
+    return 0;
+}
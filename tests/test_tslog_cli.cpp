@@ -1,6 +1,10 @@
 #include <iostream>
+#include <fstream>
+#include <string>
 #include <thread>
 #include <vector>
+#include <cstdio>
+#include <unistd.h>
 #include "../include/tslog.hpp"
 
 
@@ -19,8 +23,22 @@ int main(int argc, char** argv) {
 const int nthreads = (argc > 1) ? std::stoi(argv[1]) : 8;
 const int msgs = (argc > 2) ? std::stoi(argv[2]) : 200;
 
+// Com uma poltica (block|drop|count) a fila fica pequena para exercitar o
+// caminho de fila cheia
+Options opts;
+if (argc > 3) {
+if (!parse_full_policy(argv[3], opts.on_full)) {
+std::cerr << "Uso: " << argv[0] << " [threads] [mensagens] [block|drop|count]" << std::endl;
+return 1;
+}
+opts.queue_capacity = 64;
+}
+
 
-Logger::instance().init("stdout", Level::DEBUG);
+// Num arquivo, para conferir o que foi escrito
+const std::string path = "/tmp/test_tslog_" + std::to_string(getpid()) + ".log";
+std::remove(path.c_str());
+Logger::instance().init(path, Level::DEBUG, opts);
 
 
 std::vector<std::thread> workers;
@@ -31,10 +49,48 @@ workers.emplace_back(worker_fn, i, msgs);
 
 for (auto &t : workers) t.join();
 
-std::this_thread::sleep_for(std::chrono::milliseconds(200));
 Logger::instance().shutdown();
 
 
-std::cout << "Test concludo. Veja as sadas de log acima." << std::endl;
+// Cada linha de um worker aparece uma vez, e as de um mesmo worker na
+// ordem em que foram registradas (a fila  FIFO por produtor)
+uint64_t written = 0;
+bool ordered = true;
+std::vector<long> last(nthreads, -1);
+std::ifstream in(path);
+std::string line;
+while (std::getline(in, line)) {
+size_t p = line.find("worker ");
+if (p == std::string::npos) continue;
+int idx = -1;
+long seq = -1;
+if (std::sscanf(line.c_str() + p, "worker %d message %ld", &idx, &seq) != 2 || idx < 0 || idx >= nthreads ||
+    seq <= last[idx]) {
+ordered = false;
+continue;
+}
+last[idx] = seq;
+++written;
+}
+in.close();
+std::remove(path.c_str());
+
+const uint64_t expected = static_cast<uint64_t>(nthreads) * msgs;
+const uint64_t dropped = Logger::instance().dropped();
+std::cout << written << " linha(s) escrita(s), " << dropped << " descartada(s) por fila cheia, de " << expected
+          << std::endl;
+
+bool ok = ordered;
+if (!ordered) std::cerr << "FALHOU: linhas fora de ordem ou ilegveis" << std::endl;
+if (opts.on_full == FullPolicy::BLOCK && (written != expected || dropped != 0)) {
+std::cerr << "FALHOU: com block todas as linhas devem ser escritas" << std::endl;
+ok = false;
+}
+if (written + dropped != expected) {
+std::cerr << "FALHOU: escritas + descartadas deve ser o total registrado" << std::endl;
+ok = false;
+}
+if (!ok) return 1;
+std::cout << "Test concludo." << std::endl;
 return 0;
 }